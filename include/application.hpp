@@ -18,37 +18,43 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 
+
 #pragma once
 
-#include <vulkan/vulkan.h>
+#include "frame_capture.hpp"
+#include "metrics_server.hpp"
+#include "particle_renderer.hpp"
+#include "replay_player.hpp"
+#include "simulator.hpp"
+#include "splat_renderer.hpp"
+#include "state_publisher.hpp"
 
 #include <glfw/glfw3.h>
 
-#define GLM_FORCE_RADIANS
-#define GLM_FORCE_DEPTH_ZERO_TO_ONE
-#include <glm/glm.hpp>
-
 #include <chrono>
 #include <cstdint>
+#include <memory>
+#include <string>
 #include <vector>
 #include <atomic>
 
-// constants
-#define SPH_NUM_PARTICLES 20000
-#define SPH_PARTICLE_RADIUS 0.005f
-
-#define SPH_WORK_GROUP_SIZE 128
-// work group count is the ceiling of particle count divided by work group size
-#define SPH_NUM_WORK_GROUPS ((SPH_NUM_PARTICLES + SPH_WORK_GROUP_SIZE - 1) / SPH_WORK_GROUP_SIZE)
-
 namespace sph
 {
 
+// windowed front end: renders the particles of a simulator sharing its vulkan context
 class application
 {
 public:
     application();
-    explicit application(int64_t scene_id);
+    // with a trace path, CPU frame phases and GPU passes are recorded and written there as Chrome trace JSON on exit.
+    // With a capture path prefix, every capture interval steps is also rendered offscreen and written to a file, with
+    // a publish name, every publish interval steps is also copied into that shared memory. With splat, the window is
+    // drawn by splat_renderer instead of particle_renderer. With a metrics port, every frame is published to a
+    // metrics server and the passes of every step are timed. With a replay path, the frames of that trajectory are
+    // drawn instead of stepping the simulator, which is configured with its particle count
+    explicit application(const simulation_parameters& parameters, const std::string& trace_path = "", const frame_capture_options& capture_options = frame_capture_options(),
+        const state_publisher_options& publish_options = state_publisher_options(), bool splat = false, const metrics_server_options& metrics_options = metrics_server_options(),
+        const replay_player_options& replay_options = replay_player_options());
     application(const application&) = delete;
     ~application();
     void run();
@@ -61,39 +67,18 @@ private:
     void destroy_vulkan();
 
     void main_loop();
-    void run_simulation();
     void render();
 
-    void create_instance();
-    void create_debug_callback();
-    void create_surface();
-    void select_physical_device();
-    void create_logical_device();
-    void get_device_queues();
     void create_swapchain();
     void get_swapchain_images();
     void create_swapchain_image_views();
-    void create_render_pass();
     void create_swapchain_frame_buffers();
 
-    void create_descriptor_pool();
-    void create_pipeline_cache();
-    void create_buffers();
-
-    void create_graphics_pipeline_layout();
-    void create_graphics_pipeline();
     void create_graphics_command_pool();
     void create_graphics_command_buffers();
     void create_semaphores();
 
-    void create_compute_descriptor_set_layout();
-    void update_compute_descriptor_sets();
-    void create_compute_pipeline_layout();
-    void create_compute_pipelines();
-    void create_compute_command_pool();
-    void create_compute_command_buffer();
-
-    void set_initial_particle_data();
+    void check_neighbor_list_overflow();
 
     GLFWwindow* window = NULL;
     uint32_t window_height = 1000;
@@ -103,85 +88,45 @@ private:
     double frame_time = 0;
 
     bool paused = false;
-    uint64_t scene_id = 0;
+
+    std::string trace_path;
+    // declared before the simulator so that they are destroyed after it
+    std::unique_ptr<trace_recorder> tracer;
+    std::unique_ptr<vulkan_context> context;
+    simulator particle_simulator;
+    frame_capture_options capture_options;
+    std::unique_ptr<frame_capture> capture;
+    state_publisher_options publish_options;
+    std::unique_ptr<state_publisher> publisher;
+    metrics_server_options metrics_options;
+    std::unique_ptr<metrics_server> metrics;
+    replay_player_options replay_options;
+    std::unique_ptr<replay_player> replay;
 
     // vulkan resources
-    VkInstance instance_handle = VK_NULL_HANDLE;
-    VkDebugReportCallbackEXT debug_report_callback_handle = VK_NULL_HANDLE;
-    VkPhysicalDevice physical_device_handle = VK_NULL_HANDLE;
-    VkPhysicalDeviceFeatures physical_device_features;
-    std::vector<VkExtensionProperties> physical_device_extensions;
-    VkPhysicalDeviceProperties physical_device_properties;
-    VkPhysicalDeviceMemoryProperties physical_device_memory_properties;
-    VkDevice logical_device_handle = VK_NULL_HANDLE;
-    VkSurfaceKHR surface_handle = VK_NULL_HANDLE;
-    VkSurfaceCapabilitiesKHR surface_capabilities;
     VkSurfaceFormatKHR surface_format;
-    std::vector<VkPresentModeKHR> surface_presentation_modes;
     VkSwapchainKHR swapchain_handle;
     std::vector<VkImage> swapchain_image_handles;
     std::vector<VkImageView> swapchain_image_view_handles;
     std::vector<VkFramebuffer> swapchain_frame_buffer_handles;
 
-    std::vector<VkShaderModule> shader_module_handles;
-
-    VkRenderPass render_pass_handle = VK_NULL_HANDLE;
-
-    uint32_t graphics_presentation_compute_queue_family_index = UINT32_MAX;
-
-    VkQueue presentation_queue_handle = VK_NULL_HANDLE;
-    VkQueue graphics_queue_handle = VK_NULL_HANDLE;
-    VkQueue compute_queue_handle = VK_NULL_HANDLE;
+    // one of them, the frame buffers are only created for the render pass of particle_renderer
+    bool splat = false;
+    std::unique_ptr<particle_renderer> renderer;
+    std::unique_ptr<splat_renderer> compute_renderer;
 
     VkCommandPool graphics_command_pool_handle = VK_NULL_HANDLE;
     std::vector<VkCommandBuffer> graphics_command_buffer_handles;
 
-    VkCommandPool compute_command_pool_handle = VK_NULL_HANDLE;
-    VkCommandBuffer compute_command_buffer_handle = VK_NULL_HANDLE;
-
-    VkDescriptorPool global_descriptor_pool_handle = VK_NULL_HANDLE;
-
-    VkDescriptorSetLayout compute_descriptor_set_layout_handle = VK_NULL_HANDLE;
-    VkDescriptorSet compute_descriptor_set_handle = VK_NULL_HANDLE;
-
-    VkDescriptorSetLayout graphics_descriptor_set_layout_handle = VK_NULL_HANDLE;
-    VkDescriptorSet graphics_descriptor_set_handle = VK_NULL_HANDLE;
-
-    VkPipelineCache global_pipeline_cache_handle = VK_NULL_HANDLE;
-
-    VkPipelineLayout graphics_pipeline_layout_handle = VK_NULL_HANDLE;
-    VkPipeline graphics_pipeline_handle = VK_NULL_HANDLE;
-
-    VkPipelineLayout compute_pipeline_layout_handle = VK_NULL_HANDLE;
-    VkPipeline compute_pipeline_handles[3] = { VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE };
-
-    VkBuffer packed_particles_buffer_handle = VK_NULL_HANDLE;
-    VkDeviceMemory packed_particles_memory_handle = VK_NULL_HANDLE;
+    uint32_t reported_neighbor_list_overflow_count = 0;
 
     // synchronization
     VkSemaphore image_available_semaphore_handle = VK_NULL_HANDLE;
     VkSemaphore render_finished_semaphore_handle = VK_NULL_HANDLE;
 
-    // helper functions
-    VkShaderModule create_shader_module_from_file(std::string path_to_file);
-    // get index to the memory type
-    uint32_t get_memory_type_index(uint32_t type, VkMemoryPropertyFlags memory_property_flags);
-
     // rendering routine
     VkPipelineStageFlags wait_dst_stage_mask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
     uint32_t image_index;
-    VkSubmitInfo compute_submit_info
-    {
-        VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        NULL,
-        0,
-        NULL,
-        0,
-        1,
-        &compute_command_buffer_handle,
-        0,
-        NULL
-    };
     VkSubmitInfo graphics_submit_info
     {
         VK_STRUCTURE_TYPE_SUBMIT_INFO,
@@ -205,20 +150,6 @@ private:
         &image_index,
         NULL
     };
-    // ssbo sizes
-    const uint64_t position_ssbo_size = sizeof(glm::vec2) * SPH_NUM_PARTICLES;
-    const uint64_t velocity_ssbo_size = sizeof(glm::vec2) * SPH_NUM_PARTICLES;
-    const uint64_t force_ssbo_size = sizeof(glm::vec2) * SPH_NUM_PARTICLES;
-    const uint64_t density_ssbo_size = sizeof(float) * SPH_NUM_PARTICLES;
-    const uint64_t pressure_ssbo_size = sizeof(float) * SPH_NUM_PARTICLES;
-
-    const uint64_t packed_buffer_size = position_ssbo_size + velocity_ssbo_size + force_ssbo_size + density_ssbo_size + pressure_ssbo_size;
-    // ssbo offsets
-    const uint64_t position_ssbo_offset = 0;
-    const uint64_t velocity_ssbo_offset = position_ssbo_size;
-    const uint64_t force_ssbo_offset = velocity_ssbo_offset + velocity_ssbo_size;
-    const uint64_t density_ssbo_offset = force_ssbo_offset + force_ssbo_size;
-    const uint64_t pressure_ssbo_offset = density_ssbo_offset + density_ssbo_size;
 };
 
 } // namespace sph
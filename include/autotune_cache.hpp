@@ -0,0 +1,67 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include "vulkan_context.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace sph
+{
+
+// launch configuration of one compute pipeline
+struct kernel_launch_configuration
+{
+    uint32_t work_group_size = 0;
+    // 0 for the default subgroup size, otherwise required through VK_EXT_subgroup_size_control
+    uint32_t required_subgroup_size = 0;
+};
+
+// autotuned launch configurations, stored as one line per key in a text file. The key identifies the device, the
+// driver and whatever else the results depend on, so a driver update or another device tunes again
+class autotune_cache
+{
+public:
+    explicit autotune_cache(const std::string& path);
+
+    // vendor, device, driver version and pipeline cache UUID of the context, followed by the given suffix
+    static std::string make_key(const vulkan_context& context, const std::string& suffix);
+
+    // false if the key is missing or its entry does not have the given number of configurations
+    bool find(const std::string& key, std::vector<kernel_launch_configuration>& configurations) const;
+    // replaces the entry of the key and rewrites the file
+    void store(const std::string& key, const std::vector<kernel_launch_configuration>& configurations);
+
+private:
+    struct entry
+    {
+        std::string key;
+        std::vector<kernel_launch_configuration> configurations;
+    };
+
+    std::string path;
+    std::vector<entry> entries;
+};
+
+} // namespace sph
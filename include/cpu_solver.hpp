@@ -0,0 +1,95 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include "simulator.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sph
+{
+
+// multithreaded CPU port of the scalar density, force and integrate passes for any set of particles of a single
+// ensemble member. The neighbors are found every step in a cell list with cells of one smoothing length, so no
+// neighbor lists are kept between steps. Mirrors the Muller et al. kernels and semi-implicit Euler. The worker
+// threads are started once with the solver and wait between the passes
+class cpu_solver
+{
+public:
+    // thread_count 0 uses every hardware thread
+    explicit cpu_solver(const simulation_parameters& parameters, uint32_t thread_count = 0);
+    cpu_solver(const cpu_solver&) = delete;
+    // stops the worker threads
+    ~cpu_solver();
+
+    // one step of every particle of the state, which may hold any number of them. Density and pressure are
+    // derived from the positions at the start of the step, mass is ignored. poll, if set, is called on the calling
+    // thread between the passes and while it waits for the workers, for callers that watch other work meanwhile
+    void step(particle_state& state, const std::function<void()>& poll = nullptr);
+
+    uint32_t get_thread_count() const;
+
+private:
+    // calls function(first, last) on consecutive ranges of [0, count), the first one on the calling thread and one
+    // on each worker, and waits for them
+    void parallel_for(uint32_t count, const std::function<void(uint32_t, uint32_t)>& function);
+    void run_worker(uint32_t index);
+    void build_cell_list(const particle_state& state);
+    // calls function(j) for every other particle in the 3x3 cells around particle i
+    template<typename function_type>
+    void for_each_neighbor_candidate(uint32_t i, const function_type& function) const;
+
+    simulation_parameters parameters;
+    uint32_t thread_count = 1;
+
+    // particle indices sorted by cell key, and the key of every one of them in the same order
+    std::vector<uint32_t> sorted_indices;
+    std::vector<uint64_t> sorted_keys;
+    // cell of every particle
+    std::vector<glm::ivec2> cells;
+    // cells per row of the bounding box of the particles
+    int64_t row_width = 1;
+    std::vector<glm::vec2> force;
+    // of the current step, NULL outside of it
+    const std::function<void()>* poll = NULL;
+
+    // thread_count - 1 workers, each takes the range of its index in every pass
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable job_available;
+    std::condition_variable job_done;
+    const std::function<void(uint32_t, uint32_t)>* job = NULL;
+    uint32_t job_count = 0;
+    uint32_t job_chunk = 0;
+    // incremented for every pass, so a worker takes each one once
+    uint64_t job_generation = 0;
+    // workers still busy with the current pass
+    uint32_t busy_worker_count = 0;
+    bool stopping = false;
+};
+
+} // namespace sph
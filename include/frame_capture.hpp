@@ -0,0 +1,125 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include "particle_renderer.hpp"
+#include "simulator.hpp"
+#include "splat_renderer.hpp"
+#include "vulkan_context.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace sph
+{
+
+struct frame_capture_options
+{
+    // images are written to <path_prefix><frame index, 6 digits>.png or .rgba, capture is off when empty
+    std::string path_prefix;
+    // steps between captures, used by the windowed and headless loops
+    uint32_t interval = 1;
+    uint32_t width = 1000;
+    uint32_t height = 1000;
+    // raw writes tightly packed 8-bit sRGB RGBA rows without a header (ffmpeg -f rawvideo -pixel_format rgba),
+    // otherwise uncompressed PNG, which any tool reads but is as large as the raw image
+    bool raw = false;
+    // images between the device and the encoders, capture only waits when every one of them is still in flight
+    uint32_t ring_size = 4;
+    uint32_t worker_count = 2;
+    // draw with splat_renderer instead of particle_renderer
+    bool splat = false;
+};
+
+// renders the particles into an offscreen image and writes it to a file without a window or a swapchain, so it also
+// runs headless on a software device. The draw goes to the compute queue after the submitted steps and the image is
+// copied into a ring of host visible buffers, which worker threads encode and write while the simulation goes on
+class frame_capture
+{
+public:
+    // the queue family of the context must support graphics, the simulator must be initialized on the context and
+    // outlive the capture
+    frame_capture(simulator& particle_simulator, const frame_capture_options& options);
+    frame_capture(const frame_capture&) = delete;
+    // waits for every captured image to be written
+    ~frame_capture();
+
+    // queue an image of the particles after the steps submitted so far, returns without waiting for the device or
+    // the file unless the whole ring is in flight
+    void capture();
+    uint64_t get_captured_frame_count() const;
+
+private:
+    struct ring_slot
+    {
+        VkBuffer buffer_handle = VK_NULL_HANDLE;
+        VkDeviceMemory memory_handle = VK_NULL_HANDLE;
+        const uint8_t* mapped_memory = NULL;
+        VkCommandBuffer command_buffer_handle = VK_NULL_HANDLE;
+        // signaled when the copy into the buffer is done
+        VkFence fence_handle = VK_NULL_HANDLE;
+        uint64_t frame_index = 0;
+        // from the submission until the encoder has written the file
+        bool in_flight = false;
+    };
+
+    void create_image();
+    void create_frame_buffer();
+    void create_ring();
+    void record_command_buffer(const ring_slot& slot);
+    void encode(ring_slot& slot);
+    void run_worker();
+
+    simulator* particle_simulator = NULL;
+    const vulkan_context* context = NULL;
+    frame_capture_options options;
+    uint64_t captured_frame_count = 0;
+
+    // one of them, depending on options.splat
+    std::unique_ptr<particle_renderer> renderer;
+    std::unique_ptr<splat_renderer> splat;
+
+    // vulkan resources
+    VkImage image_handle = VK_NULL_HANDLE;
+    VkDeviceMemory image_memory_handle = VK_NULL_HANDLE;
+    VkImageView image_view_handle = VK_NULL_HANDLE;
+    VkFramebuffer frame_buffer_handle = VK_NULL_HANDLE;
+    VkCommandPool command_pool_handle = VK_NULL_HANDLE;
+    std::vector<ring_slot> ring;
+    uint32_t next_slot = 0;
+
+    // encoders, the slots in the queue are in flight and owned by the workers until they clear in_flight
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable job_available;
+    std::condition_variable slot_available;
+    std::deque<uint32_t> jobs;
+    bool stopping = false;
+};
+
+} // namespace sph
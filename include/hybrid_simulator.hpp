@@ -0,0 +1,134 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include "cpu_solver.hpp"
+#include "simulator.hpp"
+#include "vulkan_context.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace sph
+{
+
+struct hybrid_options
+{
+    // share of the particles the device steps before the first measurement
+    float initial_device_fraction = 0.75f;
+    // move the split towards the measured throughputs of both backends after every step
+    bool tune = true;
+    // host threads of the CPU solver, 0 keeps one hardware thread for the submissions
+    uint32_t cpu_thread_count = 0;
+    // neither backend gets fewer particles, so that a bad measurement cannot starve it
+    uint32_t min_backend_particle_count = 1024;
+};
+
+// steps a scene on the device and the host at the same time. Every step sorts the particles along x and gives the slab
+// left of the split to a simulator and the slab right of it to the cpu solver, each with a halo of the particles within
+// two smoothing lengths of the other slab, so that both step their owned particles like an in-core simulator. The
+// device slab goes up and its owned particles come back through buffers that stay mapped, and the simulator only holds
+// the slab with some room to spare, so the device work follows the split. The device works while the host steps its
+// slab, whose solver polls the device fence between its passes, and the split follows the measured throughputs, so
+// neither backend waits long for the other. Needs a single ensemble member, semi-implicit Euler and the Muller et al.
+// kernels, and is not available with adaptive resolution, sleeping or time bins
+class hybrid_simulator
+{
+public:
+    hybrid_simulator();
+    hybrid_simulator(const hybrid_simulator&) = delete;
+    ~hybrid_simulator();
+
+    void configure(const simulation_parameters& parameters, const hybrid_options& options = hybrid_options());
+    // create a headless vulkan context owned by the simulator
+    void initialize();
+    // the context must outlive the simulator
+    void initialize(vulkan_context& context);
+
+    // every step returns when both slabs are back in host memory
+    void step(uint32_t step_count = 1);
+    void read_state(particle_state& state) const;
+    void write_state(const particle_state& state);
+
+    const simulation_parameters& get_parameters() const;
+    uint64_t get_step_count() const;
+    // share of the owned particles the device steps next
+    float get_device_fraction() const;
+    // wall time of the last step of each backend, the device time includes the uploads and read backs
+    double get_device_step_seconds() const;
+    double get_host_step_seconds() const;
+
+private:
+    void initialize_vulkan();
+    void destroy_vulkan();
+    // replace the simulator with one that holds capacity particles, the upload and download buffers keep room for
+    // the whole scene
+    void create_engine(uint32_t capacity);
+    // copy the slots of the simulator up and its first owned_particle_count particles down
+    void record_command_buffers(uint32_t owned_particle_count);
+    void step_once();
+    void tune_split(uint32_t device_particle_count, uint32_t host_particle_count);
+
+    simulation_parameters parameters;
+    hybrid_options options;
+    float halo_width = 0;
+    float device_fraction = 0;
+    uint64_t step_count = 0;
+    double device_step_seconds = 0;
+    double host_step_seconds = 0;
+
+    // the scene on the host, stepped from current into next
+    particle_state current_state;
+    particle_state next_state;
+    // particle indices sorted by x, reused between steps because the order changes little
+    std::vector<uint32_t> sorted_indices;
+    // the slab of the host, owned particles first, then the halo
+    particle_state host_state;
+    // positions far outside the domain and apart from each other for the unused slots of the device
+    std::vector<glm::vec2> parking_positions;
+
+    std::unique_ptr<vulkan_context> owned_context;
+    vulkan_context* context = NULL;
+    // holds the device slab with its halo and parked slots after it, recreated when the slab outgrows it or shrinks
+    // to less than half of it
+    std::unique_ptr<simulator> engine;
+    uint32_t device_capacity = 0;
+    // slots from which the upload buffer holds parking positions, up to the capacity
+    uint32_t first_parked_slot = 0;
+    std::unique_ptr<cpu_solver> solver;
+    VkCommandPool command_pool_handle = VK_NULL_HANDLE;
+    // positions and velocities up, and positions, velocities, densities and pressures down, each tightly packed over
+    // the device capacity
+    VkBuffer upload_buffer_handle = VK_NULL_HANDLE;
+    VkDeviceMemory upload_memory_handle = VK_NULL_HANDLE;
+    char* mapped_upload_memory = NULL;
+    VkBuffer download_buffer_handle = VK_NULL_HANDLE;
+    VkDeviceMemory download_memory_handle = VK_NULL_HANDLE;
+    const char* mapped_download_memory = NULL;
+    VkCommandBuffer upload_command_buffer_handle = VK_NULL_HANDLE;
+    VkCommandBuffer download_command_buffer_handle = VK_NULL_HANDLE;
+    // signaled when the owned particles of the device are back in the download buffer
+    VkFence fence_handle = VK_NULL_HANDLE;
+};
+
+} // namespace sph
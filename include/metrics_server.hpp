@@ -0,0 +1,113 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include "simulator.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+// frame times kept for the percentiles, the latest ones
+#define SPH_METRICS_FRAME_TIME_COUNT 256u
+
+namespace sph
+{
+
+struct metrics_server_options
+{
+    // TCP port of the endpoint, 0 disables the server in the windowed and headless loops
+    uint16_t port = 0;
+    // loopback only, "0.0.0.0" serves every interface
+    std::string bind_address = "127.0.0.1";
+    // steps between the steps whose passes are timed, and of a chunk of the headless loop
+    uint32_t interval = 16;
+};
+
+// what the step loop publishes, copied as a whole into the snapshot the server reads
+struct metrics_snapshot
+{
+    uint64_t step_count = 0;
+    uint32_t particle_count = 0;
+    uint32_t active_particle_count = 0;
+    uint32_t awake_particle_count = 0;
+    // over the publications of about the last second
+    double steps_per_second = 0;
+    step_pass_times pass_times;
+    // frame n (from 1) is at (n - 1) % SPH_METRICS_FRAME_TIME_COUNT
+    uint64_t frame_count = 0;
+    double frame_time_sum_seconds = 0;
+    float frame_time_seconds[SPH_METRICS_FRAME_TIME_COUNT] = {};
+    uint64_t device_buffer_size = 0;
+    uint64_t neighbor_list_buffer_size = 0;
+    uint32_t neighbor_list_build_count = 0;
+    uint32_t neighbor_list_overflow_count = 0;
+    uint32_t grid_rebuild_count = 0;
+    uint32_t grid_move_count = 0;
+    uint32_t max_neighbor_count = 0;
+    uint32_t split_count = 0;
+    uint32_t merge_count = 0;
+};
+
+// serves the metrics of a simulator in the Prometheus text format at http://<bind address>:<port>/metrics from a
+// background thread. The step loop records frames and publishes into a snapshot guarded by a sequence, like the
+// slots of shared_state.hpp, so it never waits for a scrape; a scrape that overlaps a publication copies again. The
+// percentiles and the resident memory of the process are computed on the server thread
+class metrics_server
+{
+public:
+    // binds and listens before returning, throws if the port is taken
+    explicit metrics_server(const metrics_server_options& options);
+    metrics_server(const metrics_server&) = delete;
+    // stops the server thread within its poll interval
+    ~metrics_server();
+
+    // wall time of one frame of the windowed loop or device time of one chunk of steps of the headless loop
+    void record_frame(double seconds);
+    // copy the counters of the simulator and the recorded frames into the snapshot, reads only host memory
+    void publish(const simulator& particle_simulator);
+    uint16_t get_port() const;
+
+private:
+    void serve();
+    // a consistent copy of the latest publication
+    void read_snapshot(metrics_snapshot& snapshot) const;
+    std::string format(const metrics_snapshot& snapshot) const;
+
+    metrics_server_options options;
+    // written by the step loop only
+    metrics_snapshot pending_snapshot;
+    std::chrono::steady_clock::time_point rate_start_time;
+    uint64_t rate_start_step_count = 0;
+    // 2n - 1 while publication n is copied into published_snapshot and 2n once it is complete
+    std::atomic<uint64_t> sequence = 0;
+    metrics_snapshot published_snapshot;
+
+    // a SOCKET on Windows, a file descriptor elsewhere
+    intptr_t listen_socket = -1;
+    std::atomic<bool> stopping = false;
+    std::thread server_thread;
+};
+
+} // namespace sph
@@ -0,0 +1,124 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include "simulator.hpp"
+#include "vulkan_context.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace sph
+{
+
+struct out_of_core_options
+{
+    // particles owned by one tile, the device only holds two tiles with their halos at a time
+    uint32_t tile_particle_count = 32768;
+    // room for the halo of a tile, 0 estimates it from the halo width and the rest spacing with a margin for
+    // compression. A step throws when a halo does not fit
+    uint32_t halo_particle_count = 0;
+};
+
+// steps scenes larger than the device memory. The particles live in host memory, and every step splits them into
+// tiles of tile_particle_count particles along x. A tile is uploaded with a halo of the particles within two
+// smoothing lengths, so its density, pressure and force are the ones of the whole scene, and stepped once on one of
+// two simulators whose particle count is the tile capacity. Its particles are read back, the halo is discarded, and
+// the other simulator works on the next tile meanwhile, which hides the gathering and scattering on the host behind
+// the device work. Needs a single ensemble member and is not available with adaptive resolution or sleeping
+class out_of_core_simulator
+{
+public:
+    out_of_core_simulator();
+    out_of_core_simulator(const out_of_core_simulator&) = delete;
+    ~out_of_core_simulator();
+
+    void configure(const simulation_parameters& parameters, const out_of_core_options& options = out_of_core_options());
+    // create a headless vulkan context owned by the simulator
+    void initialize();
+    // the context must outlive the simulator
+    void initialize(vulkan_context& context);
+
+    // every step streams the whole scene through the device and returns when it is back in host memory
+    void step(uint32_t step_count = 1);
+    void read_state(particle_state& state) const;
+    void write_state(const particle_state& state);
+
+    const simulation_parameters& get_parameters() const;
+    uint64_t get_step_count() const;
+    // tiles of the last step
+    uint32_t get_tile_count() const;
+    // particles one simulator holds, owned and halo
+    uint32_t get_tile_capacity() const;
+
+private:
+    // one simulator with the buffers and command buffers that stream tiles through it
+    struct tile_slot
+    {
+        std::unique_ptr<simulator> engine;
+        VkBuffer upload_buffer_handle = VK_NULL_HANDLE;
+        VkDeviceMemory upload_memory_handle = VK_NULL_HANDLE;
+        char* mapped_upload_memory = NULL;
+        VkBuffer download_buffer_handle = VK_NULL_HANDLE;
+        VkDeviceMemory download_memory_handle = VK_NULL_HANDLE;
+        const char* mapped_download_memory = NULL;
+        VkCommandBuffer upload_command_buffer_handle = VK_NULL_HANDLE;
+        VkCommandBuffer download_command_buffer_handle = VK_NULL_HANDLE;
+        // signaled when the particles of the tile are back in the download buffer
+        VkFence fence_handle = VK_NULL_HANDLE;
+        // first and last index in the sorted order of the tile in flight, first == last when the slot is free
+        uint32_t first_particle = 0;
+        uint32_t last_particle = 0;
+    };
+
+    void initialize_vulkan();
+    void destroy_vulkan();
+    void create_slot(tile_slot& slot);
+    void record_command_buffers(tile_slot& slot);
+    void step_once();
+    // wait for the tile in flight on the slot, if any, and copy its owned particles into the next state
+    void collect_tile(tile_slot& slot);
+
+    simulation_parameters parameters;
+    out_of_core_options options;
+    uint32_t tile_capacity = 0;
+    float halo_width = 0;
+    uint64_t step_count = 0;
+    uint32_t tile_count = 0;
+
+    // the scene on the host, stepped from current into next
+    particle_state current_state;
+    particle_state next_state;
+    // particle indices sorted by x, reused between steps because the order changes little
+    std::vector<uint32_t> sorted_indices;
+    // positions far outside the domain and apart from each other for the unused slots of a tile, so that they
+    // neither interact with the tile nor with each other
+    std::vector<glm::vec2> parking_positions;
+
+    std::unique_ptr<vulkan_context> owned_context;
+    vulkan_context* context = NULL;
+    VkCommandPool command_pool_handle = VK_NULL_HANDLE;
+    tile_slot slots[2];
+};
+
+} // namespace sph
@@ -0,0 +1,63 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include "simulator.hpp"
+#include "vulkan_context.hpp"
+
+#include <cstdint>
+
+namespace sph
+{
+
+// draws the particles of the first ensemble member as points into color attachments of one format and size, shared
+// by the window and the offscreen frame capture
+class particle_renderer
+{
+public:
+    // the attachment is cleared at the start of the render pass and left in final_layout, e.g. for presentation or
+    // for copying it out
+    particle_renderer(const vulkan_context& context, VkFormat format, VkImageLayout final_layout, uint32_t width, uint32_t height);
+    particle_renderer(const particle_renderer&) = delete;
+    ~particle_renderer();
+
+    VkRenderPass get_render_pass() const;
+    uint32_t get_width() const;
+    uint32_t get_height() const;
+    // the whole render pass, into a framebuffer created for the render pass and the size of the renderer
+    void record_draw(VkCommandBuffer command_buffer_handle, VkFramebuffer framebuffer_handle, const simulator& particle_simulator) const;
+
+private:
+    void create_render_pass(VkFormat format, VkImageLayout final_layout);
+    void create_pipeline_layout();
+    void create_pipeline();
+
+    const vulkan_context* context = NULL;
+    uint32_t width = 0;
+    uint32_t height = 0;
+
+    VkRenderPass render_pass_handle = VK_NULL_HANDLE;
+    VkPipelineLayout pipeline_layout_handle = VK_NULL_HANDLE;
+    VkPipeline pipeline_handle = VK_NULL_HANDLE;
+};
+
+} // namespace sph
@@ -0,0 +1,54 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include "simulator.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace sph
+{
+
+// CPU port of the compute shaders, used to validate them. Every pair within the smoothing length is visited in
+// ascending index order, which is the order of the neighbor lists in the deterministic mode.
+class reference_solver
+{
+public:
+    // parameters as returned by simulator::get_parameters, with the ensemble member ranges filled in
+    explicit reference_solver(const simulation_parameters& parameters);
+
+    void set_state(const particle_state& state);
+    const particle_state& get_state() const;
+    void step(uint32_t step_count = 1);
+
+private:
+    void compute_density_pressure();
+    void compute_force();
+    void integrate();
+
+    simulation_parameters parameters;
+    particle_state state;
+    std::vector<glm::vec2> force;
+};
+
+} // namespace sph
@@ -0,0 +1,49 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace sph
+{
+
+struct regression_options
+{
+    // holds one golden snapshot per scene
+    std::string golden_directory = "golden";
+    // overwrite the golden snapshots with the results of this run instead of comparing against them
+    bool update_golden = false;
+    // kept small so that the CPU reference finishes in seconds
+    uint32_t particle_count = 2000;
+    uint32_t step_count = 1000;
+    // largest position difference in simulation units (the domain is [-1, 1]), velocities are compared relative
+    // to the largest speed of the expected state
+    float golden_tolerance = 1e-5f;
+    float reference_tolerance = 1e-3f;
+};
+
+// run every scene in deterministic mode and compare the final state against the golden snapshot, when there is
+// one, and the CPU reference solver, returns the number of failed comparisons
+uint32_t run_regression(const regression_options& options);
+
+} // namespace sph
@@ -0,0 +1,46 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include "simulator.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace sph
+{
+
+struct render_benchmark_options
+{
+    // the particles are spread uniformly over the whole domain, so every count covers the image the same way
+    std::vector<uint32_t> particle_counts = { 16384, 65536, 262144, 1048576 };
+    // draws recorded into one submission per renderer and particle count
+    uint32_t frame_count = 100;
+    uint32_t width = 1000;
+    uint32_t height = 1000;
+};
+
+// draw the same particles offscreen with particle_renderer and with splat_renderer for every particle count and print
+// the frame rates of both. The simulator is configured from parameters with one ensemble member and is not stepped
+void run_render_benchmark(const simulation_parameters& parameters, const render_benchmark_options& options);
+
+} // namespace sph
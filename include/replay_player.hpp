@@ -0,0 +1,149 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include "simulator.hpp"
+#include "trajectory.hpp"
+#include "vulkan_context.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace sph
+{
+
+struct replay_player_options
+{
+    // trajectory file written by trajectory_writer, replay is off when empty
+    std::string path;
+    // trajectory frames per second of wall time, negative plays backwards
+    double frames_per_second = 60;
+    // start over at the other end instead of stopping at the last frame
+    bool loop = true;
+    // staging buffers between the decoders and the device, the frames ahead of the playback position are decoded
+    // into them while the current one is drawn
+    uint32_t ring_size = 6;
+    // decoder threads, 0 uses half of the hardware threads
+    uint32_t worker_count = 0;
+};
+
+// plays a trajectory file back through the particle buffer of a simulator that is not stepped, so the renderers draw
+// the recorded frames like live ones. Worker threads decode the frames ahead of the playback position from the mapped
+// file straight into a ring of host visible staging buffers, and the frame due at an update is copied into the
+// positions on the graphics queue before the draw. Frames that are not decoded in time are skipped rather than waited
+// for, so playback keeps its speed when the decoders fall behind
+class replay_player
+{
+public:
+    // the simulator must be initialized with the particle count of the trajectory and a single ensemble member, and
+    // outlive the player
+    replay_player(simulator& particle_simulator, const replay_player_options& options);
+    replay_player(const replay_player&) = delete;
+    // waits for the decoders and the uploads in flight
+    ~replay_player();
+
+    // advance the playback position by the wall time since the last update when playing, and submit the copy of
+    // the frame at the position when it differs from the one in the particle buffer and is decoded
+    void update(bool playing);
+    // move the playback position, wrapped when looping and clamped otherwise
+    void seek(double frame);
+    void set_frames_per_second(double frames_per_second);
+    double get_frames_per_second() const;
+
+    uint64_t get_frame_count() const;
+    // the frame in the particle buffer, UINT64_MAX before the first one is uploaded
+    uint64_t get_frame() const;
+    // the simulation step the frame in the particle buffer was recorded at
+    uint64_t get_step_count() const;
+    // frames the playback passed without them being uploaded because the decoders fell behind
+    uint64_t get_skipped_frame_count() const;
+
+private:
+    enum class slot_state
+    {
+        free,
+        decoding,
+        ready,
+        // the frame could not be decoded, kept so that it is not requested again
+        failed,
+        uploading
+    };
+
+    struct ring_slot
+    {
+        VkBuffer buffer_handle = VK_NULL_HANDLE;
+        VkDeviceMemory memory_handle = VK_NULL_HANDLE;
+        float* mapped_memory = NULL;
+        VkCommandBuffer command_buffer_handle = VK_NULL_HANDLE;
+        // signaled when the copy into the particle buffer is done
+        VkFence fence_handle = VK_NULL_HANDLE;
+        uint64_t frame = 0;
+        slot_state state = slot_state::free;
+    };
+
+    void set_position(double frame);
+    void create_ring();
+    void record_command_buffer(const ring_slot& slot);
+    void upload(ring_slot& slot);
+    void prefetch(uint64_t frame, int64_t stride);
+    // frames from one to the other in the playback direction, UINT64_MAX if the playback does not get there
+    uint64_t get_playback_distance(uint64_t from_frame, uint64_t to_frame) const;
+    void run_worker(trajectory_reader* reader);
+
+    simulator* particle_simulator = NULL;
+    const vulkan_context* context = NULL;
+    replay_player_options options;
+    // the index and the step counts, the workers have their own readers
+    trajectory_reader reader;
+    uint32_t particle_count = 0;
+
+    double position = 0;
+    // frames the position moved at the last update, the stride of the prefetch
+    double last_advance = 0;
+    std::chrono::steady_clock::time_point last_update_time;
+    bool first_update = true;
+    uint64_t displayed_frame = UINT64_MAX;
+    uint64_t skipped_frame_count = 0;
+    // the next upload follows a seek rather than playback, so the frames between are not counted as skipped
+    bool seeked = false;
+
+    // vulkan resources
+    VkCommandPool command_pool_handle = VK_NULL_HANDLE;
+    std::vector<ring_slot> ring;
+
+    // decoders, the slots in the queue are decoding and owned by the workers until they change the state
+    std::vector<std::unique_ptr<trajectory_reader>> worker_readers;
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable job_available;
+    std::deque<uint32_t> jobs;
+    bool stopping = false;
+};
+
+} // namespace sph
@@ -0,0 +1,124 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// layout of the shared memory the simulator publishes particle snapshots into, readable without vulkan
+#define SPH_SHARED_STATE_MAGIC 0x53485053u
+#define SPH_SHARED_STATE_VERSION 1u
+#define SPH_SHARED_STATE_MAX_SLOTS 16u
+// position, velocity, density, pressure and mass, in the order of sph::particle_field
+#define SPH_SHARED_STATE_FIELD_COUNT 5u
+
+namespace sph
+{
+
+// one snapshot buffer of the ring, the frame n (from 1) goes to slot (n - 1) % slot_count. The sequence is 2n - 1
+// while frame n is written and 2n once it is complete, so a reader copies the data between two loads of the same
+// even sequence
+struct shared_state_slot
+{
+    std::atomic<uint64_t> sequence;
+    // simulator step count of the snapshot
+    uint64_t step_count;
+};
+
+// at offset 0 of the shared memory. Every field of a snapshot is a tightly packed array of particle_count
+// elements: vec2 (two floats) for position and velocity, float for the rest
+struct shared_state_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slot_count;
+    uint32_t particle_count;
+    // bit i set if field i is published
+    uint32_t field_mask;
+    uint32_t reserved;
+    // slot i starts at first_slot_offset + i * slot_size bytes from the start of the shared memory
+    uint64_t first_slot_offset;
+    uint64_t slot_size;
+    // from the start of a slot, UINT64_MAX for fields that are not published
+    uint64_t field_offsets[SPH_SHARED_STATE_FIELD_COUNT];
+    // the latest complete frame, 0 before the first
+    std::atomic<uint64_t> latest_frame;
+    shared_state_slot slots[SPH_SHARED_STATE_MAX_SLOTS];
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared state needs address-free 64-bit atomics");
+
+// named shared memory: POSIX shm_open on Linux and macOS, a pagefile-backed file mapping on Windows
+class shared_memory_region
+{
+public:
+    shared_memory_region() = default;
+    shared_memory_region(const shared_memory_region&) = delete;
+    ~shared_memory_region();
+
+    // create or replace the region, which is removed again when the creator closes it
+    void create(const std::string& name, size_t size);
+    void open_read_only(const std::string& name);
+    void close();
+
+    void* get_data() const;
+    size_t get_size() const;
+
+private:
+    std::string name;
+    bool owner = false;
+    void* data = NULL;
+    size_t size = 0;
+#ifdef _WIN32
+    void* mapping_handle = NULL;
+#endif
+};
+
+// what a consumer gets of a snapshot, fields that are not published stay empty
+struct shared_state_frame
+{
+    uint64_t frame = 0;
+    uint64_t step_count = 0;
+    // two floats per particle for position and velocity, one for the rest
+    std::vector<float> fields[SPH_SHARED_STATE_FIELD_COUNT];
+};
+
+// maps the published state read-only, for consumer processes
+class shared_state_reader
+{
+public:
+    explicit shared_state_reader(const std::string& name);
+
+    const shared_state_header& get_header() const;
+    // copy the latest complete frame if it is newer than frame.frame, false if there is none. Never waits for the
+    // publisher, a frame overwritten during the copy is retried with the then latest one
+    bool read_latest(shared_state_frame& frame) const;
+
+private:
+    shared_memory_region region;
+    const shared_state_header* header = NULL;
+};
+
+} // namespace sph
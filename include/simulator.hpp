@@ -0,0 +1,603 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include "autotune_cache.hpp"
+#include "trace.hpp"
+#include "vulkan_context.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// constants
+#define SPH_NUM_PARTICLES 20000
+#define SPH_PARTICLE_RADIUS 0.005f
+// mass of a particle at the base resolution, merged particles have twice this
+#define SPH_PARTICLE_MASS 0.02f
+
+// default work group size of every compute pipeline, replaced by the autotuner's choice
+#define SPH_WORK_GROUP_SIZE 128
+
+// neighbor lists hold every particle within smoothing length + skin and are reused until a particle has moved more
+// than half the skin since the last build, or the lists are older than the max age
+#define SPH_NEIGHBOR_SKIN 0.005f
+#define SPH_MAX_NEIGHBORS 64
+#define SPH_NEIGHBOR_LIST_MAX_AGE 64
+
+// the subgroup kernels handle each particle with a cluster of this many subgroup invocations
+#define SPH_SUBGROUP_CLUSTER_SIZE 4
+
+// samples of the kernel tables over (r / h)^2 in [0, 1], mirrors KERNEL_TABLE_SIZE in sph_kernels.glsl
+#define SPH_KERNEL_TABLE_SIZE 256
+
+// time step of the built-in scenes with semi-implicit Euler
+#define SPH_TIME_STEP 0.0001f
+
+// timestamps written per traced step, at the start, after each of the five passes and after the resolution update
+#define SPH_STEP_TIMESTAMP_COUNT 7
+
+// traced variants of the step command buffer, each with its own timestamps, that take turns
+#define SPH_TRACED_STEP_SLOT_COUNT 4
+
+namespace sph
+{
+
+// per particle arrays of the packed particle buffer that can be copied out, position and velocity are vec2
+enum class particle_field : uint32_t
+{
+    position,
+    velocity,
+    density,
+    pressure,
+    mass
+};
+
+// advances the velocities and positions in the integrate pass, all of them evaluate the forces once per step
+enum class time_integrator : uint32_t
+{
+    // velocity first, then position with the new velocity
+    semi_implicit_euler,
+    // kick-drift-kick velocity Verlet, keeps the half step velocity per particle
+    leapfrog,
+    // Beeman's predictor-corrector, keeps the corrected velocity and the last two accelerations per particle
+    predictor_corrector
+};
+
+// smoothing kernels of the density, pressure gradient and viscosity terms, all with the normalization the resting
+// density was tuned with
+enum class smoothing_kernel : uint32_t
+{
+    // poly6, spiky gradient and viscosity Laplacian of Muller et al.
+    muller,
+    cubic_spline,
+    wendland
+};
+
+// how the passes evaluate the smoothing kernel
+enum class kernel_evaluation : uint32_t
+{
+    analytic,
+    // linear interpolation in a table of SPH_KERNEL_TABLE_SIZE samples built by every work group in shared memory
+    shared_table,
+    // the same table built once at initialization in a uniform buffer
+    uniform_table
+};
+
+// mirrors neighbor_list_status_block in the compute shaders
+struct neighbor_list_status
+{
+    // indirect dispatch arguments of the neighbor list build
+    VkDispatchIndirectCommand build_dispatch;
+    uint32_t steps_since_build;
+    uint32_t build_count;
+    // number of particles that had more than max_neighbors neighbors, accumulated over all builds
+    uint32_t overflow_count;
+    uint32_t max_neighbor_count;
+    // with the incremental hashed grid, the indirect dispatch arguments of emptying the table and inserting every
+    // particle, which the check only sets on the steps that rebuild the grid
+    VkDispatchIndirectCommand grid_clear_dispatch;
+    VkDispatchIndirectCommand grid_insert_dispatch;
+    // nodes in use since the last rebuild, one per particle and one for every move to another table entry since
+    uint32_t grid_node_count;
+    // the next step rebuilds the grid, set when the moves ran out of nodes or the host replaced the particles
+    uint32_t grid_rebuild_requested;
+    // accumulated over all steps
+    uint32_t grid_rebuild_count;
+    uint32_t grid_move_count;
+};
+
+// mirrors adaptive_resolution_status_block in the compute shaders, which is followed there by the stack of the
+// indices of the unused particle slots
+struct adaptive_resolution_status
+{
+    // indirect dispatch arguments of the resolution update passes
+    VkDispatchIndirectCommand update_dispatch;
+    uint32_t steps_since_update;
+    // unused particle slots, the active particle count is the total particle count minus this
+    uint32_t free_slot_count;
+    // of the last update, folded into the counts below by the next step
+    uint32_t merged_slot_count;
+    uint32_t split_request_count;
+    // accumulated over all updates
+    uint32_t split_count;
+    uint32_t merge_count;
+    // splits that found no unused slot
+    uint32_t failed_split_count;
+};
+
+// mirrors particle_activity_status_block in the compute shaders
+struct particle_activity_status
+{
+    // indirect dispatch arguments of density and pressure, force and integrate over the awake particles, or density
+    // and pressure and force over the particles whose time bin is due
+    VkDispatchIndirectCommand density_dispatch;
+    VkDispatchIndirectCommand force_dispatch;
+    VkDispatchIndirectCommand integrate_dispatch;
+    // counted by the check of the current step, the due particles with time bins
+    uint32_t awake_count;
+    // awake particles of the last step
+    uint32_t last_awake_count;
+    // times a particle fell asleep and was woken, accumulated
+    uint32_t sleep_count;
+    uint32_t wake_count;
+    // with time bins, substeps since the particles were written, and the times a particle ended its block early for
+    // a faster neighbor, accumulated
+    uint32_t substep;
+    uint32_t early_update_count;
+    // with persistent threads, the next unclaimed slots of density and pressure and of force, zeroed every step
+    uint32_t density_queue_head;
+    uint32_t force_queue_head;
+};
+
+// mirrors member_parameters in the compute shaders
+struct ensemble_member_parameters
+{
+    // set by the simulator, the particles of a member are stored contiguously in member order
+    uint32_t first_particle = 0;
+    uint32_t particle_count = 0;
+    float stiffness = 2000.f;
+    float resting_density = 1000.f;
+    float viscosity = 3000.f;
+    float wall_damping = 0.3f;
+    // OpenGL y-axis is pointing up, while Vulkan y-axis is pointing down.
+    // So in OpenGL this is negative, but in Vulkan this is positive.
+    glm::vec2 gravity = glm::vec2(0, 9806.65f);
+};
+
+// passed to simulator::configure before initialize
+struct simulation_parameters
+{
+    // 0: dropping a cube of water, 1: dam break
+    uint64_t scene_id = 0;
+    // particles per ensemble member
+    uint32_t particle_count = SPH_NUM_PARTICLES;
+    // independent simulations stepped together in the same dispatches, neighbor search never crosses members
+    uint32_t ensemble_size = 1;
+    // one entry per member, or empty to give every member the default parameters
+    std::vector<ensemble_member_parameters> member_parameters;
+    float neighbor_skin = SPH_NEIGHBOR_SKIN;
+    uint32_t max_neighbors = SPH_MAX_NEIGHBORS;
+    uint32_t neighbor_list_max_age = SPH_NEIGHBOR_LIST_MAX_AGE;
+    // use the subgroup kernels when the device supports them
+    bool allow_subgroup_kernels = true;
+    // bit-reproducible steps on a given device and driver: neighbors are summed in ascending index order by the
+    // scalar kernels, and nothing that feeds the particles depends on the order of atomics or subgroup reductions
+    bool deterministic = false;
+    // time candidate work group sizes, and subgroup sizes with VK_EXT_subgroup_size_control, for every compute
+    // pipeline at initialization and cache the fastest per device and driver in autotune_cache_path
+    bool autotune = true;
+    std::string autotune_cache_path = "autotune_cache.txt";
+    // split particles at the free surface and in vortices and merge pairs of them in the calm bulk, so the surface
+    // keeps its detail with fewer active particles. Slots freed by merges are reused by splits, so particle_count
+    // is the capacity. Uses the scalar kernels and needs a single ensemble member outside of deterministic mode
+    bool adaptive_resolution = false;
+    // steps between resolution updates
+    uint32_t resolution_interval = 16;
+    // merged particles below this fraction of the resting density are at the free surface and split
+    float surface_density_ratio = 0.9f;
+    // particles at or above this fraction of the resting density are in the bulk and may merge
+    float merge_density_ratio = 1.f;
+    // merged particles split above this vorticity magnitude (1/s), others only merge below half of it
+    float split_vorticity = 2000.f;
+    // put particles to sleep after sleep_steps steps in a row below sleep_speed and sleep_acceleration, and skip
+    // them in density, force and integrate until a moving neighbor wakes them. Not available with adaptive resolution
+    bool sleeping = false;
+    float sleep_speed = 0.5f;
+    float sleep_acceleration = 500.f;
+    uint32_t sleep_steps = 64;
+    // evaluate every pair once in density and force, from half neighbor lists, and add the contributions to both
+    // particles with float atomics. Needs shaderBufferFloat32AtomicAdd of VK_EXT_shader_atomic_float, otherwise the
+    // gather kernels run. Not deterministic and not available with adaptive resolution or sleeping
+    bool symmetric_pairs = false;
+    // run density and pressure and force with persistent threads: fewer work groups than particles, whose subgroups
+    // claim batches of particles from an atomic queue until it runs dry, so the subgroups that draw crowded particles
+    // do not hold up whole work groups. Has its own density and force kernels, not available with symmetric pairs
+    bool persistent_threads = false;
+    // work groups of the persistent passes, 0 for a quarter of the work groups the particles would need
+    uint32_t persistent_work_group_count = 0;
+    // build the neighbor lists from a spatial hash of the cells around each particle instead of testing every pair.
+    // The table has a power of two entries of at least twice the particle count, so its memory follows the particle
+    // count and not the extent of the scene. Uses the scalar build kernel
+    bool hashed_grid = false;
+    // the integration keeps the hashed grid current: a particle that moves to another table entry is linked into its
+    // new chain and leaves a tombstone in the old one, so a step costs as much as the particles that changed entries.
+    // The grid is rebuilt when the tombstones exceed this fraction of the particle count. 0 rebuilds it with every
+    // neighbor list build instead, as does adaptive resolution
+    float grid_fragmentation_limit = 0.25f;
+    // leave out the walls of the [-1, 1] square, so the particles move without bounds. Combine with hashed_grid,
+    // whose memory does not depend on how far they spread
+    bool open_domain = false;
+    // seconds per step, larger steps need a scheme that stays stable with them
+    float time_step = SPH_TIME_STEP;
+    // the per-particle state of leapfrog and the predictor-corrector is only allocated when they are selected. It
+    // is reset by write_state. Not available with adaptive resolution, whose merges and splits have no history
+    time_integrator integrator = time_integrator::semi_implicit_euler;
+    // power-of-two time bins per particle. With more than one, a step is a substep of time_step and a particle in
+    // bin b only gets its density, pressure and force evaluated every 2^b steps, so the few fast particles of a
+    // splash no longer set the step of the whole fluid. A due particle takes the largest bin whose step stays below
+    // time_bin_courant times the time it takes to cross the smoothing length, and at most one above the bins of
+    // its neighbors. Needs semi-implicit Euler, not available with adaptive resolution, sleeping or symmetric pairs
+    uint32_t time_bin_count = 1;
+    float time_bin_courant = 0.25f;
+    // every kernel is defined once in shader/sph_kernels.glsl. The viscosity of the members is tuned for the Muller
+    // et al. kernels, whose Laplacian is smaller than that of the others
+    smoothing_kernel kernel = smoothing_kernel::muller;
+    kernel_evaluation kernel_lookup = kernel_evaluation::analytic;
+};
+
+// GPU time of the passes of one step, in the order they are recorded. The resolution update only counts with
+// adaptive resolution
+struct step_pass_times
+{
+    uint32_t pass_count = 0;
+    double time_ns[SPH_STEP_TIMESTAMP_COUNT - 1] = {};
+    // number of the step the times belong to, from 1
+    uint64_t step = 0;
+    // device time per step between the starts of this step and of the step read before it, 0 for the first
+    double step_period_ns = 0;
+};
+
+// name of a pass of step_pass_times, as in the traces
+const char* get_step_pass_name(uint32_t pass);
+
+// per-particle arrays, one entry per particle of every ensemble member in member order
+struct particle_state
+{
+    std::vector<glm::vec2> position;
+    std::vector<glm::vec2> velocity;
+    // derived from position and velocity every step, ignored by write_state
+    std::vector<float> density;
+    std::vector<float> pressure;
+    // zero for unused slots with adaptive resolution, write_state gives every particle SPH_PARTICLE_MASS when empty
+    std::vector<float> mass;
+};
+
+// the particles of the scene parameters.scene_id at rest, the same scene for every ensemble member, which is what
+// initialize starts from
+particle_state create_scene_state(const simulation_parameters& parameters);
+
+class simulator
+{
+public:
+    simulator();
+    simulator(const simulator&) = delete;
+    ~simulator();
+
+    void configure(const simulation_parameters& parameters);
+    // create a headless vulkan context owned by the simulator
+    void initialize();
+    // run on a context shared with e.g. a renderer, the context must outlive the simulator
+    void initialize(vulkan_context& context);
+    // record the GPU time of every pass of every step, must be called before initialize. The recorder must be
+    // calibrated against the same context and outlive the simulator
+    void set_trace_recorder(trace_recorder* tracer);
+    // time the passes of one step in every interval steps with device timestamps, 0 disables, must be called before
+    // initialize. The timestamps are read once they are available without waiting for them, and a step whose
+    // timestamps cannot be written because every traced variant is still in flight is not timed. A trace recorder
+    // times every step instead
+    void set_pass_timing(uint32_t interval);
+
+    // submit the steps to the compute queue and return without waiting for them
+    void step(uint32_t step_count = 1);
+    // wait for the submitted steps, then copy the particles between the device and the host
+    void read_state(particle_state& state);
+    void write_state(const particle_state& state);
+    // wait for the submitted steps and copy the particle buffer into a host visible buffer that stays mapped at the
+    // same address until the simulator is destroyed, so views of it need no further copies. Every field lies at the
+    // offset of get_particle_field_buffer_info and is overwritten by the next read back
+    const void* read_back();
+    // replace the physical parameters of a member between steps, its particle range is kept
+    void set_member_parameters(uint32_t member, const ensemble_member_parameters& member_parameters);
+    // make the next step build the neighbor lists and the hashed grid, for embedders that copy particles into the
+    // particle buffer themselves. The submitted steps must be complete, as the flags are in host visible memory read
+    // by the device
+    void invalidate_neighbor_lists();
+    void wait_idle();
+
+    const simulation_parameters& get_parameters() const;
+    // particle count times ensemble size
+    uint32_t get_total_particle_count() const;
+    vulkan_context& get_context() const;
+    // number of submitted steps
+    uint64_t get_step_count() const;
+    bool is_using_subgroup_kernels() const;
+    bool is_using_symmetric_pairs() const;
+    bool is_using_persistent_threads() const;
+    // positions are tightly packed vec2 at offset 0 so the buffer can be bound as a vertex buffer, the first
+    // particle_count of them belong to the first ensemble member. The compute queue
+    // writes them, so readers on other queues must synchronize with the steps themselves
+    VkBuffer get_particle_buffer() const;
+    // range of one field of every particle of every ensemble member in the particle buffer, for copies out of it
+    VkDescriptorBufferInfo get_particle_field_buffer_info(particle_field field) const;
+    // updated by the device without synchronization, read only for statistics
+    const neighbor_list_status& get_neighbor_list_status() const;
+    // updated by the device without synchronization like the neighbor list status, all zero without adaptive resolution
+    const adaptive_resolution_status& get_adaptive_resolution_status() const;
+    uint32_t get_active_particle_count() const;
+    // updated by the device without synchronization like the neighbor list status, all zero without sleeping
+    const particle_activity_status& get_particle_activity_status() const;
+    // of the last step, the active particle count without sleeping and time bins
+    uint32_t get_awake_particle_count() const;
+    VkDeviceSize get_neighbor_list_buffer_size() const;
+    // device local buffers of the steps, without the staging and read back buffers
+    VkDeviceSize get_device_buffer_size() const;
+    // of the latest step whose timestamps were read, pass_count is 0 before the first and without tracing or pass
+    // timing. Written by step and wait_idle
+    const step_pass_times& get_last_step_pass_times() const;
+
+private:
+    void initialize_vulkan();
+    void destroy_vulkan();
+
+    void compute_buffer_layout();
+    void create_descriptor_pool();
+    void create_buffers();
+    void create_compute_descriptor_set_layout();
+    void update_compute_descriptor_sets();
+    void create_compute_pipeline_layout();
+    void create_compute_pipelines();
+    VkPipeline create_compute_pipeline(uint32_t pipeline_index, const kernel_launch_configuration& configuration) const;
+    uint32_t get_particles_per_work_group(uint32_t pipeline_index, uint32_t work_group_size) const;
+    uint32_t get_work_group_count(uint32_t pipeline_index, uint32_t work_group_size) const;
+    bool is_subgroup_kernel(uint32_t pipeline_index) const;
+    // pick the launch configuration of every pipeline from the cache or by timing the candidates, before the
+    // final pipelines are created
+    void autotune();
+    std::vector<kernel_launch_configuration> get_candidate_configurations(uint32_t pipeline_index) const;
+    // nanoseconds per dispatch, the queues of the persistent passes are emptied before every dispatch when asked
+    double time_compute_pipeline(VkPipeline pipeline_handle, uint32_t work_group_count, bool reset_work_queues) const;
+    void create_compute_command_pool();
+    void create_compute_command_buffer();
+    // timestamp_query_base is UINT32_MAX for the untraced command buffer
+    void record_compute_command_buffer(VkCommandBuffer command_buffer_handle, uint32_t timestamp_query_base);
+    // the untraced command buffer step_count times, in batches
+    void submit_steps(uint32_t step_count);
+    void step_traced(uint32_t step_count);
+    void step_sampled(uint32_t step_count);
+    // pass the timestamps of the previous submission of a traced command buffer to the recorder and to the last step
+    // pass times, returns false without waiting when they are not available yet
+    bool collect_step_timestamps(uint32_t index, bool wait);
+    // every traced command buffer whose timestamps are available, oldest first
+    void collect_available_step_timestamps(bool wait);
+
+    void set_initial_particle_data();
+    void set_ensemble_data();
+    // the lists are stale, so the next step builds them, and the statistics are zero
+    void reset_neighbor_list_status();
+    // unused slots are the ones without mass
+    void reset_adaptive_resolution_status(const std::vector<float>& mass);
+    // every particle is awake and in the awake list, and in the first time bin
+    void reset_particle_activity();
+    // fill the uniform kernel table when the passes read it
+    void build_kernel_table();
+    // insert the current positions into the emptied hashed grid, for the autotuner's timed builds
+    void fill_hashed_grid();
+    // staging buffer for write_state and the initial data, created on first use
+    void create_staging_buffer();
+    // target of read_back, created on first use
+    void create_readback_buffer();
+
+    simulation_parameters parameters;
+    uint32_t total_particle_count = 0;
+    uint64_t step_count = 0;
+
+    std::unique_ptr<vulkan_context> owned_context;
+    vulkan_context* context = NULL;
+    trace_recorder* tracer = NULL;
+    uint32_t pass_timing_interval = 0;
+    step_pass_times last_step_pass_times;
+
+    bool use_subgroup_kernels = false;
+    bool use_symmetric_pairs = false;
+    bool use_persistent_threads = false;
+    // per compute pipeline, in the order of compute_pipeline_handles
+    kernel_launch_configuration launch_configurations[5];
+    uint32_t work_group_counts[5] = { 0, 0, 0, 0, 0 };
+
+    // vulkan resources
+    VkCommandPool compute_command_pool_handle = VK_NULL_HANDLE;
+    VkCommandBuffer compute_command_buffer_handle = VK_NULL_HANDLE;
+    // step submits the same command buffer in batches of at most 256, the array is reused between calls
+    std::vector<VkCommandBuffer> step_command_buffer_handles;
+    // with a trace recorder or pass timing, copies of the command buffer that also write timestamps into their part
+    // of the pool. They are used in turn, next_traced_command_buffer is the oldest
+    VkQueryPool timestamp_query_pool_handle = VK_NULL_HANDLE;
+    VkCommandBuffer traced_command_buffer_handles[SPH_TRACED_STEP_SLOT_COUNT] = {};
+    bool traced_step_pending[SPH_TRACED_STEP_SLOT_COUNT] = {};
+    // signaled once a traced step is complete, so its timestamps are checked for without a query that waits
+    VkFence traced_step_fence_handles[SPH_TRACED_STEP_SLOT_COUNT] = {};
+    // number of the step submitted with each traced command buffer
+    uint64_t traced_step_numbers[SPH_TRACED_STEP_SLOT_COUNT] = {};
+    uint32_t next_traced_command_buffer = 0;
+    // start of the latest step whose timestamps were read, for the step period
+    uint64_t last_traced_step_start = 0;
+
+    VkDescriptorPool descriptor_pool_handle = VK_NULL_HANDLE;
+    VkDescriptorSetLayout compute_descriptor_set_layout_handle = VK_NULL_HANDLE;
+    VkDescriptorSet compute_descriptor_set_handle = VK_NULL_HANDLE;
+
+    VkPipelineLayout compute_pipeline_layout_handle = VK_NULL_HANDLE;
+    // density and pressure, force, integrate, check neighbor list, build neighbor list, then the resolution update:
+    // classify, pair, merge and split, which are only created with adaptive resolution and are not autotuned, and
+    // the insertion into the hashed grid, which is only created with the hashed grid and runs with the build's size,
+    // the build of the uniform kernel table, which only runs at initialization, and the emptying of the hash table,
+    // which is only created with the incremental grid
+    VkPipeline compute_pipeline_handles[12] = { VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE };
+
+    VkBuffer packed_particles_buffer_handle = VK_NULL_HANDLE;
+    VkDeviceMemory packed_particles_memory_handle = VK_NULL_HANDLE;
+
+    VkBuffer neighbor_list_buffer_handle = VK_NULL_HANDLE;
+    VkDeviceMemory neighbor_list_memory_handle = VK_NULL_HANDLE;
+
+    // host visible so the indirect dispatch arguments and the statistics can be read without a copy
+    VkBuffer neighbor_list_status_buffer_handle = VK_NULL_HANDLE;
+    VkDeviceMemory neighbor_list_status_memory_handle = VK_NULL_HANDLE;
+    neighbor_list_status* mapped_neighbor_list_status = NULL;
+
+    // member index of every particle and the member parameters, written once at initialization
+    VkBuffer ensemble_buffer_handle = VK_NULL_HANDLE;
+    VkDeviceMemory ensemble_memory_handle = VK_NULL_HANDLE;
+
+    // host visible like the neighbor list status, so write_state can fill the stack of unused slots directly
+    VkBuffer adaptive_resolution_status_buffer_handle = VK_NULL_HANDLE;
+    VkDeviceMemory adaptive_resolution_status_memory_handle = VK_NULL_HANDLE;
+    adaptive_resolution_status* mapped_adaptive_resolution_status = NULL;
+    // decision and merge partner of every particle
+    VkBuffer resolution_work_buffer_handle = VK_NULL_HANDLE;
+    VkDeviceMemory resolution_work_memory_handle = VK_NULL_HANDLE;
+
+    // host visible like the neighbor list status, holds the indirect dispatch arguments of the awake particles
+    VkBuffer particle_activity_status_buffer_handle = VK_NULL_HANDLE;
+    VkDeviceMemory particle_activity_status_memory_handle = VK_NULL_HANDLE;
+    particle_activity_status* mapped_particle_activity_status = NULL;
+    // calm steps and wake flag of every particle, and the awake list
+    VkBuffer particle_activity_buffer_handle = VK_NULL_HANDLE;
+    VkDeviceMemory particle_activity_memory_handle = VK_NULL_HANDLE;
+    // velocity and accelerations carried between steps by the time integrator
+    VkBuffer integrator_state_buffer_handle = VK_NULL_HANDLE;
+    VkDeviceMemory integrator_state_memory_handle = VK_NULL_HANDLE;
+    // kernel samples read as a uniform buffer and written as a storage buffer, allocated with every evaluation so
+    // that the uniform block of the shaders is always bound in full
+    VkBuffer kernel_table_buffer_handle = VK_NULL_HANDLE;
+    VkDeviceMemory kernel_table_memory_handle = VK_NULL_HANDLE;
+
+    VkBuffer staging_buffer_handle = VK_NULL_HANDLE;
+    VkDeviceMemory staging_memory_handle = VK_NULL_HANDLE;
+    void* mapped_staging_memory = NULL;
+    VkBuffer readback_buffer_handle = VK_NULL_HANDLE;
+    VkDeviceMemory readback_memory_handle = VK_NULL_HANDLE;
+    const void* mapped_readback_memory = NULL;
+
+    VkSubmitInfo compute_submit_info
+    {
+        VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        NULL,
+        0,
+        NULL,
+        0,
+        1,
+        &compute_command_buffer_handle,
+        0,
+        NULL
+    };
+
+    // ssbo sizes
+    uint64_t position_ssbo_size = 0;
+    uint64_t velocity_ssbo_size = 0;
+    uint64_t force_ssbo_size = 0;
+    uint64_t density_ssbo_size = 0;
+    uint64_t pressure_ssbo_size = 0;
+    uint64_t mass_ssbo_size = 0;
+
+    uint64_t packed_buffer_size = 0;
+    // ssbo offsets, aligned to minStorageBufferOffsetAlignment
+    uint64_t position_ssbo_offset = 0;
+    uint64_t velocity_ssbo_offset = 0;
+    uint64_t force_ssbo_offset = 0;
+    uint64_t density_ssbo_offset = 0;
+    uint64_t pressure_ssbo_offset = 0;
+    uint64_t mass_ssbo_offset = 0;
+
+    // neighbor list ssbo sizes
+    uint64_t neighbor_list_ssbo_size = 0;
+    uint64_t neighbor_reference_position_ssbo_size = 0;
+    uint64_t neighbor_count_ssbo_size = 0;
+    // first node of every hash table entry, the nodes of the chains and, with the incremental grid, the node and
+    // entry of every particle, one entry each without them
+    uint64_t grid_cell_head_ssbo_size = 0;
+    uint64_t grid_node_ssbo_size = 0;
+    uint64_t grid_particle_ssbo_size = 0;
+
+    uint64_t neighbor_buffer_size = 0;
+    // neighbor list ssbo offsets
+    uint64_t neighbor_list_ssbo_offset = 0;
+    uint64_t neighbor_reference_position_ssbo_offset = 0;
+    uint64_t neighbor_count_ssbo_offset = 0;
+    uint64_t grid_cell_head_ssbo_offset = 0;
+    uint64_t grid_node_ssbo_offset = 0;
+    uint64_t grid_particle_ssbo_offset = 0;
+    // entries of the hash table, a power of two
+    uint32_t hash_table_size = 1;
+    // the integration maintains the hashed grid, and the nodes it can hand out before a rebuild, one per particle
+    // and the fragmentation limit on top
+    bool use_incremental_grid = false;
+    uint32_t grid_node_count = 1;
+
+    // ensemble ssbo sizes
+    uint64_t member_index_ssbo_size = 0;
+    uint64_t member_parameters_ssbo_size = 0;
+
+    uint64_t ensemble_buffer_size = 0;
+    // ensemble ssbo offsets
+    uint64_t member_index_ssbo_offset = 0;
+    uint64_t member_parameters_ssbo_offset = 0;
+
+    // adaptive resolution sizes, a single slot without adaptive resolution
+    uint64_t adaptive_resolution_status_buffer_size = 0;
+    uint64_t resolution_work_buffer_size = 0;
+
+    // particle activity ssbo sizes, a single slot without sleeping, and for the awake list and the time bins
+    // without time bins
+    uint64_t particle_activity_ssbo_size = 0;
+    uint64_t awake_list_ssbo_size = 0;
+    uint64_t time_bin_ssbo_size = 0;
+
+    uint64_t particle_activity_buffer_size = 0;
+    // particle activity ssbo offsets
+    uint64_t particle_activity_ssbo_offset = 0;
+    uint64_t awake_list_ssbo_offset = 0;
+    uint64_t time_bin_ssbo_offset = 0;
+    // density and pressure and force run over the awake list, with sleeping or time bins
+    bool use_awake_list = false;
+
+    // a single slot with semi-implicit Euler
+    uint64_t integrator_state_buffer_size = 0;
+};
+
+} // namespace sph
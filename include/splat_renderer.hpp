@@ -0,0 +1,78 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include "simulator.hpp"
+#include "vulkan_context.hpp"
+
+#include <cstdint>
+
+namespace sph
+{
+
+// draws the particles of the first ensemble member like particle_renderer, but splats them from a compute shader into
+// a buffer of packed depth and colour with atomics instead of rasterizing points, then resolves the buffer into a
+// storage image and blits that to the target. It avoids the fixed-function point setup and the ROP contention of
+// overlapping points at high particle counts
+class splat_renderer
+{
+public:
+    // the simulator must be initialized and outlive the renderer. The target is overwritten entirely and left in
+    // final_layout; it needs VK_IMAGE_USAGE_TRANSFER_DST_BIT and a format that supports blits, which the swapchain
+    // and the frame capture formats do on common devices
+    splat_renderer(const simulator& particle_simulator, VkFormat target_format, VkImageLayout final_layout, uint32_t width, uint32_t height);
+    splat_renderer(const splat_renderer&) = delete;
+    ~splat_renderer();
+
+    uint32_t get_width() const;
+    uint32_t get_height() const;
+    // the splat, the resolve and the blit into a target image of the size of the renderer, including the barriers
+    // against the previous draw and the steps submitted before on the same queue
+    void record_draw(VkCommandBuffer command_buffer_handle, VkImage target_image_handle) const;
+
+private:
+    void create_splat_buffer();
+    void create_color_image();
+    void create_descriptor_set(const simulator& particle_simulator);
+    void create_pipelines();
+
+    const vulkan_context* context = NULL;
+    VkImageLayout final_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t particle_count = 0;
+
+    // vulkan resources
+    VkBuffer splat_buffer_handle = VK_NULL_HANDLE;
+    VkDeviceMemory splat_memory_handle = VK_NULL_HANDLE;
+    VkImage color_image_handle = VK_NULL_HANDLE;
+    VkDeviceMemory color_image_memory_handle = VK_NULL_HANDLE;
+    VkImageView color_image_view_handle = VK_NULL_HANDLE;
+    VkDescriptorPool descriptor_pool_handle = VK_NULL_HANDLE;
+    VkDescriptorSetLayout descriptor_set_layout_handle = VK_NULL_HANDLE;
+    VkDescriptorSet descriptor_set_handle = VK_NULL_HANDLE;
+    VkPipelineLayout pipeline_layout_handle = VK_NULL_HANDLE;
+    // splat, resolve
+    VkPipeline pipeline_handles[2] = { VK_NULL_HANDLE, VK_NULL_HANDLE };
+};
+
+} // namespace sph
@@ -0,0 +1,105 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include "shared_state.hpp"
+#include "simulator.hpp"
+#include "vulkan_context.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace sph
+{
+
+struct state_publisher_options
+{
+    // name of the shared memory, "/sph_state" style on POSIX, "Local\sph_state" style on Windows
+    std::string name;
+    // steps between snapshots, used by the windowed and headless loops
+    uint32_t interval = 1;
+    // snapshots in the ring, at least 2 so the latest complete one is never overwritten while a reader copies it
+    uint32_t slot_count = 3;
+    std::vector<particle_field> fields = { particle_field::position, particle_field::velocity };
+};
+
+// publishes snapshots of the particles into a ring in named shared memory (see shared_state.hpp), which other
+// processes map read-only. With VK_EXT_external_memory_host the ring is imported as buffer memory and the device
+// copies the fields straight into it, otherwise through one host visible buffer per slot and a memcpy. The publisher
+// never waits for the device or for readers: a snapshot that finds no free slot is dropped
+class state_publisher
+{
+public:
+    // the simulator must be initialized and outlive the publisher
+    state_publisher(simulator& particle_simulator, const state_publisher_options& options);
+    state_publisher(const state_publisher&) = delete;
+    // waits for the snapshots in flight and removes the shared memory name
+    ~state_publisher();
+
+    // queue a snapshot of the particles after the steps submitted so far, false if it was dropped
+    bool publish();
+    // make the snapshots the device has finished visible to readers, publish does this as well
+    void poll();
+    uint64_t get_published_frame_count() const;
+    uint64_t get_dropped_frame_count() const;
+    bool is_zero_copy() const;
+
+private:
+    struct ring_slot
+    {
+        VkBuffer buffer_handle = VK_NULL_HANDLE;
+        VkDeviceMemory memory_handle = VK_NULL_HANDLE;
+        // the staging buffer mapping without the import, NULL otherwise
+        const void* staging_memory = NULL;
+        VkCommandBuffer command_buffer_handle = VK_NULL_HANDLE;
+        VkFence fence_handle = VK_NULL_HANDLE;
+    };
+
+    void create_region();
+    // false if the device cannot import the slot, then nothing is left to destroy
+    bool import_slot(ring_slot& slot, void* slot_data);
+    void create_staging_slot(ring_slot& slot);
+    void create_ring();
+    void record_command_buffer(const ring_slot& slot);
+    // wait for the fence if wait is set, otherwise stop at the first frame still in flight
+    void complete_frames(bool wait);
+
+    simulator* particle_simulator = NULL;
+    const vulkan_context* context = NULL;
+    state_publisher_options options;
+    bool zero_copy = false;
+
+    shared_memory_region region;
+    shared_state_header* header = NULL;
+    uint64_t slot_alignment = 0;
+    // frames are numbered from 1, frames up to completed_frame_count are visible to readers
+    uint64_t submitted_frame_count = 0;
+    uint64_t completed_frame_count = 0;
+    uint64_t dropped_frame_count = 0;
+
+    // vulkan resources
+    VkCommandPool command_pool_handle = VK_NULL_HANDLE;
+    std::vector<ring_slot> ring;
+};
+
+} // namespace sph
@@ -0,0 +1,100 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include "vulkan_context.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace sph
+{
+
+// collects CPU phases and GPU passes on one timeline and writes them as Chrome trace JSON, which chrome://tracing
+// and Perfetto open
+class trace_recorder
+{
+public:
+    enum class track : uint32_t
+    {
+        cpu = 1,
+        gpu = 2
+    };
+
+    trace_recorder();
+
+    // relate the device timestamps of the context's queue family to the host clock, through
+    // VK_EXT_calibrated_timestamps when the context enabled it, otherwise by waiting for a timestamp written by the
+    // device, which places the GPU events up to one submission latency too late
+    void calibrate(const vulkan_context& context);
+    bool is_calibrated() const;
+
+    // nanoseconds on the host clock since the recorder was created
+    uint64_t now() const;
+    void add_cpu_event(const char* name, uint64_t begin_ns, uint64_t end_ns);
+    // raw device timestamps as written by vkCmdWriteTimestamp
+    void add_gpu_event(const char* name, uint64_t begin_ticks, uint64_t end_ticks);
+
+    void write(const std::string& path) const;
+
+private:
+    struct event
+    {
+        const char* name;
+        track event_track;
+        uint64_t begin_ns;
+        uint64_t end_ns;
+    };
+
+    int64_t gpu_ticks_to_ns(uint64_t ticks) const;
+
+    std::chrono::steady_clock::time_point start_time;
+    // bounded so that a forgotten trace does not grow without limit, later events are dropped
+    static const size_t max_event_count = 1 << 20;
+    std::vector<event> events;
+    size_t dropped_event_count = 0;
+
+    bool calibrated = false;
+    double timestamp_period_ns = 1;
+    uint64_t timestamp_mask = ~0ull;
+    // a device timestamp and the host time (since start_time) at which it was taken
+    uint64_t calibration_ticks = 0;
+    int64_t calibration_ns = 0;
+};
+
+// records a CPU event for the lifetime of the object, does nothing without a recorder
+class scoped_trace_event
+{
+public:
+    scoped_trace_event(trace_recorder* recorder, const char* name);
+    scoped_trace_event(const scoped_trace_event&) = delete;
+    ~scoped_trace_event();
+
+private:
+    trace_recorder* recorder;
+    const char* name;
+    uint64_t begin_ns = 0;
+};
+
+} // namespace sph
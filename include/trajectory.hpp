@@ -0,0 +1,207 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// compressed particle trajectories, readable without vulkan. A file is a header, the frames one after another and an
+// index of every frame at the end
+#define SPH_TRAJECTORY_MAGIC 0x54485053u
+#define SPH_TRAJECTORY_VERSION 1u
+// position and velocity, in the order of sph::particle_field
+#define SPH_TRAJECTORY_FIELD_COUNT 2u
+// values per Rice coded block, each block has its own parameter
+#define SPH_TRAJECTORY_BLOCK_SIZE 128u
+
+namespace sph
+{
+
+// at offset 0 of the file
+struct trajectory_file_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t particle_count;
+    uint32_t keyframe_interval;
+    // of the index written on close, 0 if the writer did not close the file, then readers scan the frames
+    uint64_t index_offset;
+    uint64_t frame_count;
+};
+
+// before the coded values of every frame
+struct trajectory_frame_header
+{
+    // bytes of the frame including this header
+    uint64_t size;
+    uint64_t step_count;
+    // the keyframe the frame is coded against, itself for keyframes
+    uint64_t keyframe;
+    // quantization step of each field, a decoded value is within half of it from the written one. The steps of a
+    // frame are those of its keyframe
+    float quantum[SPH_TRAJECTORY_FIELD_COUNT];
+};
+
+// one entry per frame at index_offset
+struct trajectory_index_entry
+{
+    uint64_t offset;
+    uint64_t step_count;
+    uint64_t keyframe;
+};
+
+struct trajectory_writer_options
+{
+    // a frame is written every interval steps by the headless loop, the writer is off when the path is empty
+    std::string path;
+    uint32_t interval = 10;
+    // largest error of a decoded position and velocity, the quantization step is twice that
+    float position_precision = 1e-5f;
+    float velocity_precision = 1e-3f;
+    // frames between keyframes, the others are coded as the difference to the keyframe before them, so reading any
+    // frame decodes at most two
+    uint32_t keyframe_interval = 16;
+    // frames between write_frame and the encoders, write_frame only waits when all of them are still being encoded
+    uint32_t queue_size = 8;
+    uint32_t worker_count = 2;
+};
+
+// quantizes the frames to the precision of the options, codes every frame against its keyframe and entropy codes the
+// residuals on worker threads. The frames are appended in order as they complete and the index is written on close
+class trajectory_writer
+{
+public:
+    // replaces the file
+    trajectory_writer(uint32_t particle_count, const trajectory_writer_options& options);
+    trajectory_writer(const trajectory_writer&) = delete;
+    // closes the file
+    ~trajectory_writer();
+
+    // copy the fields, two floats per particle each, and return once a worker has taken them or there is room in the
+    // queue. Keyframes are quantized here, the frames coded against them on the workers
+    void write_frame(uint64_t step_count, const float* position, const float* velocity);
+    // wait for the queued frames and write the index and the header
+    void close();
+    uint64_t get_frame_count() const;
+    // bytes written so far, without the index
+    uint64_t get_file_size() const;
+
+private:
+    struct job
+    {
+        uint64_t frame = 0;
+        uint64_t step_count = 0;
+        uint64_t keyframe = 0;
+        std::vector<float> values[SPH_TRAJECTORY_FIELD_COUNT];
+        // of the keyframe, shared by the frames coded against it
+        std::shared_ptr<const std::vector<int64_t>> keyframe_values[SPH_TRAJECTORY_FIELD_COUNT];
+    };
+
+    void run_worker();
+    std::vector<uint8_t> encode(const job& frame_job) const;
+    // append the completed frames that are next in order, with the mutex held
+    void flush_completed();
+
+    uint32_t particle_count = 0;
+    trajectory_writer_options options;
+    float quantum[SPH_TRAJECTORY_FIELD_COUNT] = {};
+    std::ofstream file;
+    uint64_t file_size = 0;
+    uint64_t frame_count = 0;
+    std::vector<trajectory_index_entry> index;
+    // the latest keyframe and its quantized values
+    uint64_t keyframe = 0;
+    std::shared_ptr<const std::vector<int64_t>> keyframe_values[SPH_TRAJECTORY_FIELD_COUNT];
+    bool closed = false;
+
+    std::vector<std::thread> workers;
+    mutable std::mutex mutex;
+    std::condition_variable job_available;
+    std::condition_variable job_done;
+    std::deque<std::unique_ptr<job>> jobs;
+    // jobs taken by the workers or waiting in the queue
+    uint32_t pending_job_count = 0;
+    // coded frames that wait for the ones before them
+    std::map<uint64_t, std::vector<uint8_t>> completed;
+    uint64_t next_written_frame = 0;
+    bool stopping = false;
+};
+
+// what a reader gets of a frame, two floats per particle for each field
+struct trajectory_frame
+{
+    uint64_t frame = 0;
+    uint64_t step_count = 0;
+    std::vector<float> fields[SPH_TRAJECTORY_FIELD_COUNT];
+};
+
+// random access to the frames of a memory mapped trajectory file. Seeking is constant time through the index, and the
+// quantized values of the last keyframe are kept, so reading the frames of one keyframe in any order decodes it once.
+// Not thread safe, threads use a reader each, which share the pages of the file
+class trajectory_reader
+{
+public:
+    explicit trajectory_reader(const std::string& path);
+    trajectory_reader(const trajectory_reader&) = delete;
+    ~trajectory_reader();
+
+    uint32_t get_particle_count() const;
+    uint64_t get_frame_count() const;
+    uint64_t get_step_count(uint64_t frame) const;
+    void read_frame(uint64_t frame, trajectory_frame& result);
+    // only the positions, two floats per particle, without decoding the velocities of the frame
+    void read_positions(uint64_t frame, float* position);
+
+private:
+    void unmap();
+    // the first field_count fields into the outputs
+    void read_fields(uint64_t frame, uint32_t field_count, float* const* outputs);
+    trajectory_frame_header get_frame_header(uint64_t frame) const;
+    // the residuals of the first field_count fields, against the particle before for keyframes and against the
+    // keyframe otherwise
+    void decode(uint64_t frame, uint32_t field_count, std::vector<int64_t> (&values)[SPH_TRAJECTORY_FIELD_COUNT]) const;
+
+    std::string path;
+    const uint8_t* data = NULL;
+    uint64_t size = 0;
+#ifdef _WIN32
+    void* file_handle = NULL;
+    void* mapping_handle = NULL;
+#endif
+    trajectory_file_header header = {};
+    std::vector<trajectory_index_entry> index;
+    uint64_t cached_keyframe = UINT64_MAX;
+    uint32_t cached_keyframe_field_count = 0;
+    std::vector<int64_t> cached_keyframe_values[SPH_TRAJECTORY_FIELD_COUNT];
+    // reused between reads
+    std::vector<int64_t> residuals[SPH_TRAJECTORY_FIELD_COUNT];
+};
+
+} // namespace sph
@@ -0,0 +1,88 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include "simulator.hpp"
+#include "trajectory.hpp"
+#include "vulkan_context.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace sph
+{
+
+// feeds a trajectory writer from the device without waiting for the steps. Each frame copies the positions and
+// velocities of the first member into a ring of persistently mapped buffers on the compute queue, and is handed to
+// the writer once the fence of its slot is signaled. A frame that finds every slot in flight waits for the oldest one
+class trajectory_capture
+{
+public:
+    // the simulator must be initialized, both must outlive the capture
+    trajectory_capture(simulator& particle_simulator, trajectory_writer& writer, uint32_t slot_count = 3);
+    trajectory_capture(const trajectory_capture&) = delete;
+    // hands the frames in flight to the writer
+    ~trajectory_capture();
+
+    // queue a frame of the particles after the steps submitted so far
+    void capture();
+    // hand the frames the device has finished to the writer, capture does this as well
+    void poll();
+    // wait for the frames in flight and hand them to the writer, before the writer is closed
+    void flush();
+    // frames that had to wait for the oldest slot, more slots or a longer interval avoid them
+    uint64_t get_stalled_frame_count() const;
+
+private:
+    struct ring_slot
+    {
+        VkBuffer buffer_handle = VK_NULL_HANDLE;
+        VkDeviceMemory memory_handle = VK_NULL_HANDLE;
+        // positions of the first member followed by its velocities
+        const float* mapped_memory = NULL;
+        VkCommandBuffer command_buffer_handle = VK_NULL_HANDLE;
+        VkFence fence_handle = VK_NULL_HANDLE;
+        uint64_t step_count = 0;
+    };
+
+    void create_ring();
+    void record_command_buffer(const ring_slot& slot);
+    // wait for the fence if wait is set, otherwise stop at the first frame still in flight. At most frame_limit
+    // frames are completed
+    void complete_frames(bool wait, uint64_t frame_limit = UINT64_MAX);
+
+    simulator* particle_simulator = NULL;
+    const vulkan_context* context = NULL;
+    trajectory_writer* writer = NULL;
+    uint32_t slot_count = 0;
+    // bytes of one field of the first member
+    VkDeviceSize field_size = 0;
+    uint64_t submitted_frame_count = 0;
+    uint64_t completed_frame_count = 0;
+    uint64_t stalled_frame_count = 0;
+
+    // vulkan resources
+    VkCommandPool command_pool_handle = VK_NULL_HANDLE;
+    std::vector<ring_slot> ring;
+};
+
+} // namespace sph
@@ -0,0 +1,112 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace sph
+{
+
+struct vulkan_context_create_info
+{
+    // extensions needed on top of the ones the context always enables, e.g. the ones glfw needs for its surface
+    std::vector<const char*> instance_extensions;
+    std::vector<const char*> device_extensions;
+    // enabled when the device supports them, check with is_device_extension_enabled
+    std::vector<const char*> optional_device_extensions;
+    // optional, called right after the instance is created; the selected queue family must then be able to present
+    // to the returned surface, which the context owns from then on
+    std::function<VkSurfaceKHR(VkInstance)> create_surface;
+};
+
+// instance, device and queues shared by the simulator and whatever renders or consumes its results
+class vulkan_context
+{
+public:
+    vulkan_context();
+    explicit vulkan_context(const vulkan_context_create_info& create_info);
+    vulkan_context(const vulkan_context&) = delete;
+    ~vulkan_context();
+
+    // get index to the memory type
+    uint32_t get_memory_type_index(uint32_t type_bits, VkMemoryPropertyFlags memory_property_flags) const;
+    // create a buffer and bind it to a dedicated allocation
+    void create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags memory_property_flags, VkBuffer& buffer_handle, VkDeviceMemory& memory_handle) const;
+    // the caller destroys the module, which may happen as soon as the pipelines using it are created
+    VkShaderModule create_shader_module_from_file(const std::string& path_to_file) const;
+    // record a command buffer with the callback, submit it to the compute queue and wait for it
+    void execute_one_time_commands(const std::function<void(VkCommandBuffer)>& record_commands) const;
+
+    bool is_device_extension_available(const char* extension_name) const;
+    bool is_device_extension_enabled(const char* extension_name) const;
+
+    VkInstance instance_handle = VK_NULL_HANDLE;
+    VkDebugReportCallbackEXT debug_report_callback_handle = VK_NULL_HANDLE;
+    VkSurfaceKHR surface_handle = VK_NULL_HANDLE;
+
+    VkPhysicalDevice physical_device_handle = VK_NULL_HANDLE;
+    VkPhysicalDeviceFeatures physical_device_features;
+    std::vector<VkExtensionProperties> physical_device_extensions;
+    VkPhysicalDeviceProperties physical_device_properties;
+    VkPhysicalDeviceSubgroupProperties physical_device_subgroup_properties;
+    // zero unless the device supports VK_EXT_subgroup_size_control, which the context enables when available
+    VkPhysicalDeviceSubgroupSizeControlPropertiesEXT physical_device_subgroup_size_control_properties;
+    // the enabled features of VK_EXT_subgroup_size_control, all false without the extension
+    VkPhysicalDeviceSubgroupSizeControlFeaturesEXT subgroup_size_control_features;
+    // the enabled features of VK_EXT_shader_atomic_float, which the context enables when available, all false without it
+    VkPhysicalDeviceShaderAtomicFloatFeaturesEXT shader_atomic_float_features;
+    VkPhysicalDeviceMemoryProperties physical_device_memory_properties;
+
+    VkDevice logical_device_handle = VK_NULL_HANDLE;
+
+    // graphics and presentation are only guaranteed when a surface was requested; without one the family is
+    // only required to support compute
+    uint32_t queue_family_index = UINT32_MAX;
+    VkQueueFlags queue_family_flags = 0;
+    // 0 if the queues cannot write timestamps
+    uint32_t queue_family_timestamp_valid_bits = 0;
+    VkQueue graphics_queue_handle = VK_NULL_HANDLE;
+    VkQueue compute_queue_handle = VK_NULL_HANDLE;
+    VkQueue presentation_queue_handle = VK_NULL_HANDLE;
+
+    VkPipelineCache global_pipeline_cache_handle = VK_NULL_HANDLE;
+
+private:
+    void create_instance(const std::vector<const char*>& extra_instance_extensions);
+    void create_debug_callback();
+    void select_physical_device();
+    void create_logical_device(const std::vector<const char*>& extra_device_extensions, const std::vector<const char*>& optional_device_extensions);
+    void get_device_queues();
+    void create_pipeline_cache();
+    void create_transient_command_pool();
+
+    uint32_t queue_count = 0;
+    std::vector<std::string> enabled_device_extensions;
+    VkCommandPool transient_command_pool_handle = VK_NULL_HANDLE;
+};
+
+} // namespace sph
@@ -5,5 +5,5 @@ If(!(test-path -PathType container $path))
 }
 Get-ChildItem -Recurse -Include ("*.vert", "*.frag", "*.comp", "*.geom", "*.tesc", "*.tese") | Foreach {
   $outfile = [System.IO.Path]::GetFullPath((Join-Path (Join-Path $pwd "../bin") ($_.Name + ".spv")))
-  & $env:VULKAN_SDK\Bin\glslangvalidator.exe -V $_.FullName -o $outfile
+  & $env:VULKAN_SDK\Bin\glslangvalidator.exe -V --target-env vulkan1.3 $_.FullName -o $outfile
 }
@@ -10,7 +10,7 @@ for exts in ('*.vert', '*.frag', '*.comp', '*.geom', '*.tesc', '*.tese'):
 failed_files = []
 for shader_file in shader_files:
     print("compiling %s\n" % shader_file)
-    if subprocess.call("glslangvalidator -V %s -o ../bin/%s.spv" % (shader_file, shader_file), shell=True) != 0:
+    if subprocess.call("glslangvalidator -V --target-env vulkan1.3 %s -o ../bin/%s.spv" % (shader_file, shader_file), shell=True) != 0:
         failed_files.append(shader_file)
 
 for failed_file in failed_files:
@@ -0,0 +1,146 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Smoothing kernels shared by the density, force and resolution passes. Every kernel is defined once here by its
+// shape on the unit support q = r / h, and is evaluated analytically or from a table of KERNEL_TABLE_SIZE samples
+// over q^2 in [0, 1], held in shared memory or in a uniform buffer. Included after PI_FLOAT is defined, shaders call
+// load_kernel_table at the start of main, while every invocation of the work group is still alive
+
+// kernel, set by the host through a specialization constant
+#define MULLER_KERNELS 0
+#define CUBIC_SPLINE_KERNEL 1
+#define WENDLAND_KERNEL 2
+layout(constant_id = 25) const uint SMOOTHING_KERNEL = MULLER_KERNELS;
+
+// evaluation, set by the host through a specialization constant
+#define ANALYTIC_KERNEL 0
+#define SHARED_KERNEL_TABLE 1
+#define UNIFORM_KERNEL_TABLE 2
+layout(constant_id = 26) const uint KERNEL_EVALUATION = ANALYTIC_KERNEL;
+
+// mirrors SPH_KERNEL_TABLE_SIZE in simulator.hpp
+#define KERNEL_TABLE_SIZE 256
+
+// kernel, derivative and viscosity Laplacian shapes of every sample, filled once by build_kernel_table.comp
+layout(std140, binding = 20) uniform kernel_table_block
+{
+    vec4 uniform_kernel_table[KERNEL_TABLE_SIZE];
+};
+
+shared vec4 shared_kernel_table[KERNEL_EVALUATION == SHARED_KERNEL_TABLE ? KERNEL_TABLE_SIZE : 1];
+
+// W = x / h^3, dW/dr = y / h^4 and the Laplacian of the viscosity term = z / h^5. All kernels have the 3D
+// normalization of the Muller et al. kernels, which the resting density was tuned with. The Muller et al. kernels
+// are poly6 for the density, spiky for the pressure gradient and the viscosity kernel for the Laplacian, the others
+// use their own derivative and the Laplacian approximation -2 / r dW/dr of Brookshaw
+vec3 kernel_shape(float q)
+{
+    if (SMOOTHING_KERNEL == CUBIC_SPLINE_KERNEL)
+    {
+        float sigma = 8.f / PI_FLOAT;
+        if (q <= 0.5f)
+        {
+            return sigma * vec3(6.f * (q * q * q - q * q) + 1.f, 6.f * (3.f * q * q - 2.f * q), -12.f * (3.f * q - 2.f));
+        }
+        float s = 1.f - q;
+        return sigma * vec3(2.f * s * s * s, -6.f * s * s, 12.f * s * s / q);
+    }
+    if (SMOOTHING_KERNEL == WENDLAND_KERNEL)
+    {
+        float sigma = 21.f / (2.f * PI_FLOAT);
+        float s = 1.f - q;
+        return sigma * vec3(s * s * s * s * (1.f + 4.f * q), -20.f * q * s * s * s, 40.f * s * s * s);
+    }
+    float s = 1.f - q;
+    return vec3(315.f / (64.f * PI_FLOAT) * pow(1.f - q * q, 3), -45.f / PI_FLOAT * s * s, 45.f / PI_FLOAT * s);
+}
+
+// sample k lies at q^2 = k / (KERNEL_TABLE_SIZE - 1)
+vec3 kernel_table_sample(uint k)
+{
+    return kernel_shape(sqrt(float(k) / float(KERNEL_TABLE_SIZE - 1)));
+}
+
+void load_kernel_table()
+{
+    if (KERNEL_EVALUATION == SHARED_KERNEL_TABLE)
+    {
+        for (uint k = gl_LocalInvocationIndex; k < KERNEL_TABLE_SIZE; k += gl_WorkGroupSize.x)
+        {
+            shared_kernel_table[k] = vec4(kernel_table_sample(k), 0);
+        }
+        barrier();
+    }
+}
+
+// linear interpolation between the samples around q^2, zero outside the support
+vec3 kernel_table_lookup(float q2)
+{
+    float x = clamp(q2, 0.f, 1.f) * float(KERNEL_TABLE_SIZE - 1);
+    uint k = min(uint(x), KERNEL_TABLE_SIZE - 2);
+    vec4 a = KERNEL_EVALUATION == SHARED_KERNEL_TABLE ? shared_kernel_table[k] : uniform_kernel_table[k];
+    vec4 b = KERNEL_EVALUATION == SHARED_KERNEL_TABLE ? shared_kernel_table[k + 1] : uniform_kernel_table[k + 1];
+    return mix(a.xyz, b.xyz, x - float(k));
+}
+
+// kernel W(r, h), for r < h
+float kernel_value(float r, float h)
+{
+    if (KERNEL_EVALUATION != ANALYTIC_KERNEL)
+    {
+        return kernel_table_lookup(r * r / (h * h)).x / (h * h * h);
+    }
+    if (SMOOTHING_KERNEL == MULLER_KERNELS)
+    {
+        // poly6 kernel
+        return 315.f * pow(h * h - r * r, 3) / (64.f * PI_FLOAT * pow(h, 9));
+    }
+    return kernel_shape(r / h).x / (h * h * h);
+}
+
+// radial derivative dW/dr, the gradient at the first particle of a pair is this times the normalized difference
+float kernel_derivative(float r, float h)
+{
+    if (KERNEL_EVALUATION != ANALYTIC_KERNEL)
+    {
+        return kernel_table_lookup(r * r / (h * h)).y / (h * h * h * h);
+    }
+    if (SMOOTHING_KERNEL == MULLER_KERNELS)
+    {
+        // gradient of spiky kernel
+        return -45.f / (PI_FLOAT * pow(h, 6)) * pow(h - r, 2);
+    }
+    return kernel_shape(r / h).y / (h * h * h * h);
+}
+
+// Laplacian used by the viscosity term
+float kernel_laplacian(float r, float h)
+{
+    if (KERNEL_EVALUATION != ANALYTIC_KERNEL)
+    {
+        return kernel_table_lookup(r * r / (h * h)).z / (h * h * h * h * h);
+    }
+    if (SMOOTHING_KERNEL == MULLER_KERNELS)
+    {
+        // Laplacian of viscosity kernel
+        return 45.f / (PI_FLOAT * pow(h, 6)) * (h - r);
+    }
+    return kernel_shape(r / h).z / (h * h * h * h * h);
+}
@@ -0,0 +1,116 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "autotune_cache.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <stdexcept>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+
+namespace sph
+{
+
+	autotune_cache::autotune_cache(const std::string& path)
+		: path(path)
+	{
+		// a missing file is an empty cache, malformed lines are skipped
+		std::ifstream file(path);
+		std::string line;
+		while (std::getline(file, line))
+		{
+			std::istringstream line_stream(line);
+			entry cache_entry;
+			if (!(line_stream >> cache_entry.key) || cache_entry.key[0] == '#')
+			{
+				continue;
+			}
+			kernel_launch_configuration configuration;
+			while (line_stream >> configuration.work_group_size >> configuration.required_subgroup_size)
+			{
+				cache_entry.configurations.push_back(configuration);
+			}
+			if (!cache_entry.configurations.empty())
+			{
+				entries.push_back(cache_entry);
+			}
+		}
+	}
+
+	std::string autotune_cache::make_key(const vulkan_context& context, const std::string& suffix)
+	{
+		const VkPhysicalDeviceProperties& properties = context.physical_device_properties;
+		std::ostringstream key;
+		key << std::hex << std::setfill('0') << std::setw(4) << properties.vendorID << ':' << std::setw(4) << properties.deviceID
+			<< ':' << std::setw(8) << properties.driverVersion << ':';
+		for (uint32_t i = 0; i < VK_UUID_SIZE; i++)
+		{
+			key << std::setw(2) << static_cast<uint32_t>(properties.pipelineCacheUUID[i]);
+		}
+		key << ':' << suffix;
+		return key.str();
+	}
+
+	bool autotune_cache::find(const std::string& key, std::vector<kernel_launch_configuration>& configurations) const
+	{
+		auto found = std::find_if(entries.begin(), entries.end(), [&key](const entry& cache_entry) { return cache_entry.key == key; });
+		if (found == entries.end() || found->configurations.size() != configurations.size())
+		{
+			return false;
+		}
+		configurations = found->configurations;
+		return true;
+	}
+
+	void autotune_cache::store(const std::string& key, const std::vector<kernel_launch_configuration>& configurations)
+	{
+		auto found = std::find_if(entries.begin(), entries.end(), [&key](const entry& cache_entry) { return cache_entry.key == key; });
+		if (found == entries.end())
+		{
+			entries.push_back({ key, configurations });
+		}
+		else
+		{
+			found->configurations = configurations;
+		}
+
+		std::ofstream file(path);
+		if (!file)
+		{
+			std::cout << "[WARN] cannot write autotune cache " << path << std::endl;
+			return;
+		}
+		file << "# vendor:device:driver:pipeline cache uuid:kernel variant:particle count:the parameters that change the work of the kernels, then work group size and required subgroup size (0: default) per pipeline" << std::endl;
+		for (const entry& cache_entry : entries)
+		{
+			file << cache_entry.key;
+			for (const kernel_launch_configuration& configuration : cache_entry.configurations)
+			{
+				file << ' ' << configuration.work_group_size << ' ' << configuration.required_subgroup_size;
+			}
+			file << std::endl;
+		}
+	}
+
+} // namespace sph
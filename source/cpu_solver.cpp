@@ -0,0 +1,298 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "cpu_solver.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+
+namespace sph
+{
+
+	// mirror the constants of the compute shaders
+	static const float pi = 3.1415927410125732421875f;
+	static const float smoothing_length = 4 * SPH_PARTICLE_RADIUS;
+
+	cpu_solver::cpu_solver(const simulation_parameters& parameters, uint32_t thread_count)
+		: parameters(parameters)
+	{
+		if (parameters.ensemble_size != 1 || parameters.adaptive_resolution || parameters.integrator != time_integrator::semi_implicit_euler
+			|| parameters.kernel != smoothing_kernel::muller)
+		{
+			throw std::runtime_error("the CPU solver needs a single ensemble member, semi-implicit Euler and the Muller et al. kernels, and is not available with adaptive resolution");
+		}
+		if (this->parameters.member_parameters.empty())
+		{
+			this->parameters.member_parameters.resize(1);
+		}
+		this->thread_count = thread_count ? thread_count : std::max(1u, std::thread::hardware_concurrency());
+		for (uint32_t i = 1; i < this->thread_count; i++)
+		{
+			workers.emplace_back(&cpu_solver::run_worker, this, i);
+		}
+	}
+
+	cpu_solver::~cpu_solver()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		job_available.notify_all();
+		for (std::thread& worker : workers)
+		{
+			worker.join();
+		}
+	}
+
+	uint32_t cpu_solver::get_thread_count() const
+	{
+		return thread_count;
+	}
+
+	void cpu_solver::parallel_for(uint32_t count, const std::function<void(uint32_t, uint32_t)>& function)
+	{
+		const uint32_t chunk = (count + thread_count - 1) / thread_count;
+		std::unique_lock<std::mutex> lock(mutex);
+		job = &function;
+		job_count = count;
+		job_chunk = chunk;
+		job_generation++;
+		busy_worker_count = static_cast<uint32_t>(workers.size());
+		lock.unlock();
+		job_available.notify_all();
+
+		// the calling thread takes the first range
+		function(0u, std::min(chunk, count));
+		if (poll)
+		{
+			(*poll)();
+		}
+		lock.lock();
+		while (busy_worker_count > 0)
+		{
+			if (poll)
+			{
+				job_done.wait_for(lock, std::chrono::microseconds(100));
+				lock.unlock();
+				(*poll)();
+				lock.lock();
+			}
+			else
+			{
+				job_done.wait(lock);
+			}
+		}
+		job = NULL;
+	}
+
+	void cpu_solver::run_worker(uint32_t index)
+	{
+		uint64_t generation = 0;
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true)
+		{
+			job_available.wait(lock, [this, generation]() { return stopping || job_generation != generation; });
+			if (stopping)
+			{
+				return;
+			}
+			generation = job_generation;
+			const std::function<void(uint32_t, uint32_t)>& function = *job;
+			const uint32_t first = index * job_chunk;
+			const uint32_t last = std::min(first + job_chunk, job_count);
+			lock.unlock();
+			if (first < last)
+			{
+				function(first, last);
+			}
+			lock.lock();
+			if (--busy_worker_count == 0)
+			{
+				job_done.notify_one();
+			}
+		}
+	}
+
+	void cpu_solver::build_cell_list(const particle_state& state)
+	{
+		const uint32_t particle_count = static_cast<uint32_t>(state.position.size());
+		glm::vec2 min_position = state.position[0];
+		glm::vec2 max_position = state.position[0];
+		for (const glm::vec2& position : state.position)
+		{
+			min_position = glm::min(min_position, position);
+			max_position = glm::max(max_position, position);
+		}
+		row_width = static_cast<int64_t>(std::floor((max_position.x - min_position.x) / smoothing_length)) + 1;
+
+		cells.resize(particle_count);
+		sorted_keys.resize(particle_count);
+		sorted_indices.resize(particle_count);
+		std::vector<uint64_t> keys(particle_count);
+		parallel_for(particle_count, [&](uint32_t first, uint32_t last)
+			{
+				for (uint32_t i = first; i < last; i++)
+				{
+					const glm::vec2 cell = glm::floor((state.position[i] - min_position) / smoothing_length);
+					cells[i] = glm::ivec2(cell);
+					keys[i] = static_cast<uint64_t>(cells[i].y) * row_width + cells[i].x;
+				}
+			});
+		std::iota(sorted_indices.begin(), sorted_indices.end(), 0u);
+		std::sort(sorted_indices.begin(), sorted_indices.end(), [&keys](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+		for (uint32_t k = 0; k < particle_count; k++)
+		{
+			sorted_keys[k] = keys[sorted_indices[k]];
+		}
+	}
+
+	template<typename function_type>
+	void cpu_solver::for_each_neighbor_candidate(uint32_t i, const function_type& function) const
+	{
+		// the cells of a row of the 3x3 block are consecutive keys, so each row is one range of the sorted particles
+		const glm::ivec2 cell = cells[i];
+		for (int y = std::max(cell.y - 1, 0); y <= cell.y + 1; y++)
+		{
+			const uint64_t first_key = static_cast<uint64_t>(y) * row_width + std::max(cell.x - 1, 0);
+			const uint64_t last_key = static_cast<uint64_t>(y) * row_width + std::min<int64_t>(cell.x + 1, row_width - 1);
+			auto first = std::lower_bound(sorted_keys.begin(), sorted_keys.end(), first_key);
+			auto last = std::upper_bound(first, sorted_keys.end(), last_key);
+			for (auto key = first; key != last; ++key)
+			{
+				const uint32_t j = sorted_indices[key - sorted_keys.begin()];
+				if (j != i)
+				{
+					function(j);
+				}
+			}
+		}
+	}
+
+	void cpu_solver::step(particle_state& state, const std::function<void()>& poll)
+	{
+		const uint32_t particle_count = static_cast<uint32_t>(state.position.size());
+		if (state.velocity.size() != particle_count)
+		{
+			throw std::runtime_error("particle state has different position and velocity counts");
+		}
+		if (particle_count == 0)
+		{
+			return;
+		}
+		state.density.resize(particle_count);
+		state.pressure.resize(particle_count);
+		force.resize(particle_count);
+		this->poll = poll ? &poll : NULL;
+		build_cell_list(state);
+		const ensemble_member_parameters& member = parameters.member_parameters[0];
+
+		// compute density and pressure
+		parallel_for(particle_count, [&](uint32_t first, uint32_t last)
+			{
+				for (uint32_t i = first; i < last; i++)
+				{
+					// the particle itself with r = 0 comes first, like the self term of the shader
+					float density_sum = SPH_PARTICLE_MASS * /* poly6 kernel */ 315.f * std::pow(smoothing_length * smoothing_length, 3.f) / (64.f * pi * std::pow(smoothing_length, 9.f));
+					for_each_neighbor_candidate(i, [&](uint32_t j)
+						{
+							const float r = glm::length(state.position[i] - state.position[j]);
+							if (r < smoothing_length)
+							{
+								density_sum += SPH_PARTICLE_MASS * /* poly6 kernel */ 315.f * std::pow(smoothing_length * smoothing_length - r * r, 3.f) / (64.f * pi * std::pow(smoothing_length, 9.f));
+							}
+						});
+					state.density[i] = density_sum;
+					state.pressure[i] = std::max(member.stiffness * (density_sum - member.resting_density), 0.f);
+				}
+			});
+
+		// compute all forces
+		parallel_for(particle_count, [&](uint32_t first, uint32_t last)
+			{
+				for (uint32_t i = first; i < last; i++)
+				{
+					glm::vec2 pressure_force(0, 0);
+					glm::vec2 viscosity_force(0, 0);
+					for_each_neighbor_candidate(i, [&](uint32_t j)
+						{
+							const glm::vec2 delta = state.position[i] - state.position[j];
+							const float r = glm::length(delta);
+							if (r < smoothing_length)
+							{
+								pressure_force -= SPH_PARTICLE_MASS * (state.pressure[i] + state.pressure[j]) / (2.f * state.density[j]) *
+									// gradient of spiky kernel
+									-45.f / (pi * std::pow(smoothing_length, 6.f)) * std::pow(smoothing_length - r, 2.f) * glm::normalize(delta);
+								viscosity_force += SPH_PARTICLE_MASS * (state.velocity[j] - state.velocity[i]) / state.density[j] *
+									// Laplacian of viscosity kernel
+									45.f / (pi * std::pow(smoothing_length, 6.f)) * (smoothing_length - r);
+							}
+						});
+					force[i] = pressure_force + member.viscosity * viscosity_force + state.density[i] * member.gravity;
+				}
+			});
+
+		// integrate, the neighbors have read the old velocities by now
+		parallel_for(particle_count, [&](uint32_t first, uint32_t last)
+			{
+				for (uint32_t i = first; i < last; i++)
+				{
+					const glm::vec2 acceleration = force[i] / state.density[i];
+					glm::vec2 new_velocity = state.velocity[i] + parameters.time_step * acceleration;
+					glm::vec2 new_position = state.position[i] + parameters.time_step * new_velocity;
+
+					// boundary conditions, only one wall per step like the shader, none in an open domain
+					if (!parameters.open_domain)
+					{
+						if (new_position.x < -1)
+						{
+							new_position.x = -1;
+							new_velocity.x *= -1 * member.wall_damping;
+						}
+						else if (new_position.x > 1)
+						{
+							new_position.x = 1;
+							new_velocity.x *= -1 * member.wall_damping;
+						}
+						else if (new_position.y < -1)
+						{
+							new_position.y = -1;
+							new_velocity.y *= -1 * member.wall_damping;
+						}
+						else if (new_position.y > 1)
+						{
+							new_position.y = 1;
+							new_velocity.y *= -1 * member.wall_damping;
+						}
+					}
+
+					state.velocity[i] = new_velocity;
+					state.position[i] = new_position;
+				}
+			});
+		this->poll = NULL;
+	}
+
+} // namespace sph
@@ -0,0 +1,466 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "frame_capture.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace sph
+{
+
+	// PNG with stored (uncompressed) deflate blocks, so the capture needs no compression library
+	static uint32_t update_crc32(uint32_t crc, const uint8_t* data, size_t size)
+	{
+		// initialized once even when several workers get here first
+		static const std::array<uint32_t, 256> table = []()
+		{
+			std::array<uint32_t, 256> entries{};
+			for (uint32_t n = 0; n < 256; n++)
+			{
+				uint32_t c = n;
+				for (int k = 0; k < 8; k++)
+				{
+					c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+				}
+				entries[n] = c;
+			}
+			return entries;
+		}();
+		crc = ~crc;
+		for (size_t i = 0; i < size; i++)
+		{
+			crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+		}
+		return ~crc;
+	}
+
+	static void append_big_endian(std::vector<uint8_t>& bytes, uint32_t value)
+	{
+		bytes.push_back(static_cast<uint8_t>(value >> 24));
+		bytes.push_back(static_cast<uint8_t>(value >> 16));
+		bytes.push_back(static_cast<uint8_t>(value >> 8));
+		bytes.push_back(static_cast<uint8_t>(value));
+	}
+
+	static void append_png_chunk(std::vector<uint8_t>& png, const char* type, const std::vector<uint8_t>& data)
+	{
+		append_big_endian(png, static_cast<uint32_t>(data.size()));
+		const size_t type_offset = png.size();
+		png.insert(png.end(), type, type + 4);
+		png.insert(png.end(), data.begin(), data.end());
+		append_big_endian(png, update_crc32(0, png.data() + type_offset, png.size() - type_offset));
+	}
+
+	static std::vector<uint8_t> encode_png(const uint8_t* rgba, uint32_t width, uint32_t height)
+	{
+		static const uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+		std::vector<uint8_t> png(signature, signature + sizeof(signature));
+
+		// 8-bit RGBA, no interlacing
+		std::vector<uint8_t> header;
+		append_big_endian(header, width);
+		append_big_endian(header, height);
+		header.insert(header.end(), { 8, 6, 0, 0, 0 });
+		append_png_chunk(png, "IHDR", header);
+
+		// every row starts with filter type 0
+		const size_t pitch = static_cast<size_t>(width) * 4;
+		std::vector<uint8_t> rows((pitch + 1) * height);
+		for (uint32_t y = 0; y < height; y++)
+		{
+			rows[y * (pitch + 1)] = 0;
+			std::memcpy(&rows[y * (pitch + 1) + 1], rgba + y * pitch, pitch);
+		}
+
+		// zlib stream of stored blocks of at most 65535 bytes, followed by the Adler-32 of the rows
+		std::vector<uint8_t> data{ 0x78, 0x01 };
+		data.reserve(2 + rows.size() + (rows.size() / 65535 + 1) * 5 + 4);
+		for (size_t offset = 0; offset < rows.size(); offset += 65535)
+		{
+			const uint16_t length = static_cast<uint16_t>(std::min<size_t>(rows.size() - offset, 65535));
+			const bool last = offset + length == rows.size();
+			data.insert(data.end(), { static_cast<uint8_t>(last ? 1 : 0), static_cast<uint8_t>(length), static_cast<uint8_t>(length >> 8),
+				static_cast<uint8_t>(~length), static_cast<uint8_t>(~length >> 8) });
+			data.insert(data.end(), rows.begin() + offset, rows.begin() + offset + length);
+		}
+		uint32_t adler_a = 1;
+		uint32_t adler_b = 0;
+		for (uint8_t byte : rows)
+		{
+			adler_a = (adler_a + byte) % 65521;
+			adler_b = (adler_b + adler_a) % 65521;
+		}
+		append_big_endian(data, adler_b << 16 | adler_a);
+		append_png_chunk(png, "IDAT", data);
+		append_png_chunk(png, "IEND", {});
+		return png;
+	}
+
+	frame_capture::frame_capture(simulator& particle_simulator, const frame_capture_options& options)
+		: particle_simulator(&particle_simulator), context(&particle_simulator.get_context()), options(options)
+	{
+		if (!(context->queue_family_flags & VK_QUEUE_GRAPHICS_BIT))
+		{
+			throw std::runtime_error("frame capture needs a queue family with graphics support");
+		}
+		if (options.ring_size == 0 || options.worker_count == 0 || options.width == 0 || options.height == 0)
+		{
+			throw std::runtime_error("frame capture needs at least one ring slot, one worker and a non-empty image");
+		}
+		// sRGB like the swapchain, so the files look like the window
+		if (options.splat)
+		{
+			splat = std::make_unique<splat_renderer>(particle_simulator, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, options.width, options.height);
+			create_image();
+		}
+		else
+		{
+			renderer = std::make_unique<particle_renderer>(*context, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, options.width, options.height);
+			create_image();
+			create_frame_buffer();
+		}
+		create_ring();
+		for (uint32_t i = 0; i < options.worker_count; i++)
+		{
+			workers.emplace_back(&frame_capture::run_worker, this);
+		}
+	}
+
+	frame_capture::~frame_capture()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		job_available.notify_all();
+		// the workers finish the queued jobs before they stop
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+
+		VkDevice logical_device_handle = context->logical_device_handle;
+		for (auto& slot : ring)
+		{
+			vkDestroyFence(logical_device_handle, slot.fence_handle, NULL);
+			vkFreeCommandBuffers(logical_device_handle, command_pool_handle, 1, &slot.command_buffer_handle);
+			vkUnmapMemory(logical_device_handle, slot.memory_handle);
+			vkDestroyBuffer(logical_device_handle, slot.buffer_handle, NULL);
+			vkFreeMemory(logical_device_handle, slot.memory_handle, NULL);
+		}
+		vkDestroyCommandPool(logical_device_handle, command_pool_handle, NULL);
+		vkDestroyFramebuffer(logical_device_handle, frame_buffer_handle, NULL);
+		vkDestroyImageView(logical_device_handle, image_view_handle, NULL);
+		vkDestroyImage(logical_device_handle, image_handle, NULL);
+		vkFreeMemory(logical_device_handle, image_memory_handle, NULL);
+	}
+
+	void frame_capture::capture()
+	{
+		const uint32_t index = next_slot;
+		ring_slot& slot = ring[index];
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			slot_available.wait(lock, [&slot]() { return !slot.in_flight; });
+		}
+		if (vkResetFences(context->logical_device_handle, 1, &slot.fence_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("fence reset failed");
+		}
+		// the same queue as the steps, so the draw sees the positions of every step submitted before
+		const VkSubmitInfo submit_info
+		{
+			VK_STRUCTURE_TYPE_SUBMIT_INFO,
+			NULL,
+			0,
+			NULL,
+			NULL,
+			1,
+			&slot.command_buffer_handle,
+			0,
+			NULL
+		};
+		if (vkQueueSubmit(context->compute_queue_handle, 1, &submit_info, slot.fence_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("frame capture submission failed");
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			slot.frame_index = captured_frame_count++;
+			slot.in_flight = true;
+			jobs.push_back(index);
+		}
+		job_available.notify_one();
+		next_slot = (next_slot + 1) % options.ring_size;
+	}
+
+	uint64_t frame_capture::get_captured_frame_count() const
+	{
+		return captured_frame_count;
+	}
+
+	void frame_capture::create_image()
+	{
+		VkImageCreateInfo image_create_info
+		{
+			VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+			NULL,
+			0,
+			VK_IMAGE_TYPE_2D,
+			VK_FORMAT_R8G8B8A8_SRGB,
+			{ options.width, options.height, 1 },
+			1,
+			1,
+			VK_SAMPLE_COUNT_1_BIT,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+			VK_SHARING_MODE_EXCLUSIVE,
+			0,
+			NULL,
+			VK_IMAGE_LAYOUT_UNDEFINED
+		};
+		if (vkCreateImage(context->logical_device_handle, &image_create_info, NULL, &image_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("image creation failed");
+		}
+		VkMemoryRequirements memory_requirements;
+		vkGetImageMemoryRequirements(context->logical_device_handle, image_handle, &memory_requirements);
+		VkMemoryAllocateInfo memory_allocate_info
+		{
+			VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+			NULL,
+			memory_requirements.size,
+			context->get_memory_type_index(memory_requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+		};
+		if (vkAllocateMemory(context->logical_device_handle, &memory_allocate_info, NULL, &image_memory_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("image memory allocation failed");
+		}
+		vkBindImageMemory(context->logical_device_handle, image_handle, image_memory_handle, 0);
+
+		VkImageViewCreateInfo image_view_create_info
+		{
+			VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+			NULL,
+			0,
+			image_handle,
+			VK_IMAGE_VIEW_TYPE_2D,
+			VK_FORMAT_R8G8B8A8_SRGB,
+			{ VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY },
+			{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }
+		};
+		if (vkCreateImageView(context->logical_device_handle, &image_view_create_info, NULL, &image_view_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("image view creation failed");
+		}
+	}
+
+	void frame_capture::create_frame_buffer()
+	{
+		VkFramebufferCreateInfo framebuffer_create_info
+		{
+			VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+			NULL,
+			0,
+			renderer->get_render_pass(),
+			1,
+			&image_view_handle,
+			options.width,
+			options.height,
+			1
+		};
+		if (vkCreateFramebuffer(context->logical_device_handle, &framebuffer_create_info, NULL, &frame_buffer_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("frame buffer creation failed");
+		}
+	}
+
+	void frame_capture::create_ring()
+	{
+		VkCommandPoolCreateInfo command_pool_create_info
+		{
+			VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+			NULL,
+			0,
+			context->queue_family_index
+		};
+		if (vkCreateCommandPool(context->logical_device_handle, &command_pool_create_info, NULL, &command_pool_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("command pool creation failed");
+		}
+
+		const VkDeviceSize image_size = static_cast<VkDeviceSize>(options.width) * options.height * 4;
+		ring.resize(options.ring_size);
+		for (auto& slot : ring)
+		{
+			// read by the encoders straight from the mapping
+			context->create_buffer(image_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				slot.buffer_handle, slot.memory_handle);
+			void* mapped_memory = NULL;
+			vkMapMemory(context->logical_device_handle, slot.memory_handle, 0, image_size, 0, &mapped_memory);
+			slot.mapped_memory = static_cast<const uint8_t*>(mapped_memory);
+
+			VkCommandBufferAllocateInfo command_buffer_allocate_info
+			{
+				VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+				NULL,
+				command_pool_handle,
+				VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+				1
+			};
+			if (vkAllocateCommandBuffers(context->logical_device_handle, &command_buffer_allocate_info, &slot.command_buffer_handle) != VK_SUCCESS)
+			{
+				throw std::runtime_error("command buffer allocation failed");
+			}
+			VkFenceCreateInfo fence_create_info
+			{
+				VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+				NULL,
+				0
+			};
+			if (vkCreateFence(context->logical_device_handle, &fence_create_info, NULL, &slot.fence_handle) != VK_SUCCESS)
+			{
+				throw std::runtime_error("fence creation failed");
+			}
+			record_command_buffer(slot);
+		}
+	}
+
+	void frame_capture::record_command_buffer(const ring_slot& slot)
+	{
+		VkCommandBufferBeginInfo command_buffer_begin_info
+		{
+			VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			NULL,
+			0,
+			NULL
+		};
+		if (vkBeginCommandBuffer(slot.command_buffer_handle, &command_buffer_begin_info) != VK_SUCCESS)
+		{
+			throw std::runtime_error("command buffer begin failed");
+		}
+
+		if (splat)
+		{
+			// waits for the steps and the copy of the previous capture itself
+			splat->record_draw(slot.command_buffer_handle, image_handle);
+		}
+		else
+		{
+			// Barrier: the integration of the last step writes the positions, the draw reads them as vertices
+			VkMemoryBarrier compute_to_vertex_memory_barrier
+			{
+				VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+				NULL,
+				VK_ACCESS_SHADER_WRITE_BIT,
+				VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT
+			};
+			vkCmdPipelineBarrier(slot.command_buffer_handle, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &compute_to_vertex_memory_barrier, 0, NULL, 0, NULL);
+
+			// the render pass waits for the copy of the previous capture and leaves the image ready for this one
+			renderer->record_draw(slot.command_buffer_handle, frame_buffer_handle, *particle_simulator);
+		}
+
+		VkBufferImageCopy buffer_image_copy
+		{
+			0,
+			0,
+			0,
+			{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+			{ 0, 0, 0 },
+			{ options.width, options.height, 1 }
+		};
+		vkCmdCopyImageToBuffer(slot.command_buffer_handle, image_handle, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.buffer_handle, 1, &buffer_image_copy);
+
+		// Barrier: the encoders read the buffer on the host after the fence
+		VkMemoryBarrier transfer_to_host_memory_barrier
+		{
+			VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			NULL,
+			VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_ACCESS_HOST_READ_BIT
+		};
+		vkCmdPipelineBarrier(slot.command_buffer_handle, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &transfer_to_host_memory_barrier, 0, NULL, 0, NULL);
+
+		if (vkEndCommandBuffer(slot.command_buffer_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("command buffer end failed");
+		}
+	}
+
+	void frame_capture::run_worker()
+	{
+		while (true)
+		{
+			uint32_t index = 0;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				job_available.wait(lock, [this]() { return stopping || !jobs.empty(); });
+				if (jobs.empty())
+				{
+					return;
+				}
+				index = jobs.front();
+				jobs.pop_front();
+			}
+			encode(ring[index]);
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				ring[index].in_flight = false;
+			}
+			slot_available.notify_all();
+		}
+	}
+
+	void frame_capture::encode(ring_slot& slot)
+	{
+		// a failed image is reported and skipped rather than stopping the simulation
+		if (vkWaitForFences(context->logical_device_handle, 1, &slot.fence_handle, VK_TRUE, UINT64_MAX) != VK_SUCCESS)
+		{
+			std::cout << "[ERROR] frame capture: waiting for frame " << slot.frame_index << " failed" << std::endl;
+			return;
+		}
+		std::ostringstream path;
+		path << options.path_prefix << std::setw(6) << std::setfill('0') << slot.frame_index << (options.raw ? ".rgba" : ".png");
+		std::ofstream file(path.str(), std::ios::binary);
+		if (options.raw)
+		{
+			file.write(reinterpret_cast<const char*>(slot.mapped_memory), static_cast<std::streamsize>(options.width) * options.height * 4);
+		}
+		else
+		{
+			const std::vector<uint8_t> png = encode_png(slot.mapped_memory, options.width, options.height);
+			file.write(reinterpret_cast<const char*>(png.data()), static_cast<std::streamsize>(png.size()));
+		}
+		if (!file)
+		{
+			std::cout << "[ERROR] frame capture: failed to write " << path.str() << std::endl;
+		}
+	}
+
+} // namespace sph
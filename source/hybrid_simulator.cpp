@@ -0,0 +1,526 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "hybrid_simulator.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+
+namespace sph
+{
+
+	// as in the compute shaders
+	static const float smoothing_length = 4 * SPH_PARTICLE_RADIUS;
+
+	hybrid_simulator::hybrid_simulator()
+	{
+	}
+
+	hybrid_simulator::~hybrid_simulator()
+	{
+		if (context)
+		{
+			destroy_vulkan();
+		}
+	}
+
+	void hybrid_simulator::configure(const simulation_parameters& parameters, const hybrid_options& options)
+	{
+		if (context)
+		{
+			throw std::runtime_error("simulator must be configured before it is initialized");
+		}
+		// the slabs change every step, and merges, splits, sleep, time bins and the history of the time integrators
+		// would need state that moves with the particles between the backends
+		if (parameters.ensemble_size != 1 || parameters.adaptive_resolution || parameters.sleeping || parameters.time_bin_count > 1
+			|| parameters.integrator != time_integrator::semi_implicit_euler || parameters.kernel != smoothing_kernel::muller)
+		{
+			throw std::runtime_error("hybrid simulation needs a single ensemble member, semi-implicit Euler and the Muller et al. kernels, and is not available with adaptive resolution, sleeping or time bins");
+		}
+		if (!parameters.member_parameters.empty() && parameters.member_parameters.size() != 1)
+		{
+			throw std::runtime_error("member parameters must be empty or have one entry per ensemble member");
+		}
+		if (!(options.initial_device_fraction >= 0 && options.initial_device_fraction <= 1))
+		{
+			throw std::runtime_error("initial device fraction must be between 0 and 1");
+		}
+		this->parameters = parameters;
+		this->options = options;
+		// the force on a particle needs the densities of its neighbors, which need their own neighbors, so the halo
+		// reaches two smoothing lengths beyond the slab, with the skin as a margin for rounding
+		halo_width = 2 * smoothing_length + parameters.neighbor_skin;
+		device_fraction = options.initial_device_fraction;
+		const uint32_t thread_count = options.cpu_thread_count ? options.cpu_thread_count : std::max(2u, std::thread::hardware_concurrency()) - 1;
+		solver = std::make_unique<cpu_solver>(parameters, thread_count);
+		write_state(create_scene_state(parameters));
+	}
+
+	void hybrid_simulator::initialize()
+	{
+		owned_context = std::make_unique<vulkan_context>();
+		initialize(*owned_context);
+	}
+
+	void hybrid_simulator::initialize(vulkan_context& context)
+	{
+		if (this->context)
+		{
+			throw std::runtime_error("simulator is already initialized");
+		}
+		if (!solver)
+		{
+			throw std::runtime_error("simulator must be configured before it is initialized");
+		}
+		this->context = &context;
+		initialize_vulkan();
+	}
+
+	// room for a device slab with its halo, in steps of an eighth of the scene with a quarter to spare. The simulator
+	// is recreated when the slab outgrows it or needs half of it at most, so only when the split moves far
+	static uint32_t get_device_capacity(uint32_t slab_particle_count, uint32_t particle_count)
+	{
+		const uint32_t granularity = std::max((particle_count + 7) / 8, 1u);
+		const uint64_t capacity = (std::max(static_cast<uint64_t>(slab_particle_count) * 5 / 4, uint64_t(1)) + granularity - 1) / granularity * granularity;
+		return static_cast<uint32_t>(std::min<uint64_t>(capacity, particle_count));
+	}
+
+	void hybrid_simulator::initialize_vulkan()
+	{
+		// the command buffers are recorded again every step for the particle counts of the slab
+		VkCommandPoolCreateInfo command_pool_create_info
+		{
+			VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+			NULL,
+			VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+			context->queue_family_index
+		};
+		if (vkCreateCommandPool(context->logical_device_handle, &command_pool_create_info, NULL, &command_pool_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("command pool creation failed");
+		}
+
+		const uint32_t particle_count = parameters.particle_count;
+		parking_positions.resize(particle_count);
+		for (uint32_t i = 0; i < particle_count; i++)
+		{
+			// further apart than the neighbor search radius
+			parking_positions[i] = glm::vec2(4 + 0.1f * (i % 1024), 4 + 0.1f * (i / 1024));
+		}
+
+		// room for the whole scene, as the device slab can grow to it
+		const VkDeviceSize upload_size = 2 * sizeof(glm::vec2) * particle_count;
+		context->create_buffer(upload_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			upload_buffer_handle, upload_memory_handle);
+		void* mapped_memory = NULL;
+		vkMapMemory(context->logical_device_handle, upload_memory_handle, 0, upload_size, 0, &mapped_memory);
+		mapped_upload_memory = static_cast<char*>(mapped_memory);
+
+		// cached memory makes the scattering on the host fast, where the device has it
+		const VkDeviceSize download_size = (2 * sizeof(glm::vec2) + 2 * sizeof(float)) * particle_count;
+		VkMemoryPropertyFlags memory_property_flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+		const VkPhysicalDeviceMemoryProperties& memory_properties = context->physical_device_memory_properties;
+		if (std::none_of(memory_properties.memoryTypes, memory_properties.memoryTypes + memory_properties.memoryTypeCount,
+			[memory_property_flags](const VkMemoryType& memory_type) { return (memory_type.propertyFlags & memory_property_flags) == memory_property_flags; }))
+		{
+			memory_property_flags &= ~VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+		}
+		context->create_buffer(download_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, memory_property_flags, download_buffer_handle, download_memory_handle);
+		vkMapMemory(context->logical_device_handle, download_memory_handle, 0, download_size, 0, &mapped_memory);
+		mapped_download_memory = static_cast<const char*>(mapped_memory);
+
+		VkCommandBuffer command_buffer_handles[2];
+		VkCommandBufferAllocateInfo command_buffer_allocate_info
+		{
+			VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+			NULL,
+			command_pool_handle,
+			VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+			2
+		};
+		if (vkAllocateCommandBuffers(context->logical_device_handle, &command_buffer_allocate_info, command_buffer_handles) != VK_SUCCESS)
+		{
+			throw std::runtime_error("command buffers allocation failed");
+		}
+		upload_command_buffer_handle = command_buffer_handles[0];
+		download_command_buffer_handle = command_buffer_handles[1];
+
+		VkFenceCreateInfo fence_create_info
+		{
+			VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+			NULL,
+			0
+		};
+		if (vkCreateFence(context->logical_device_handle, &fence_create_info, NULL, &fence_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("fence creation failed");
+		}
+
+		const uint32_t min_particle_count = std::min(options.min_backend_particle_count, particle_count / 2);
+		create_engine(get_device_capacity(std::max(static_cast<uint32_t>(device_fraction * particle_count + 0.5f), min_particle_count), particle_count));
+	}
+
+	void hybrid_simulator::destroy_vulkan()
+	{
+		VkDevice logical_device_handle = context->logical_device_handle;
+		vkQueueWaitIdle(context->compute_queue_handle);
+		vkDestroyFence(logical_device_handle, fence_handle, NULL);
+		VkCommandBuffer command_buffer_handles[]{ upload_command_buffer_handle, download_command_buffer_handle };
+		vkFreeCommandBuffers(logical_device_handle, command_pool_handle, 2, command_buffer_handles);
+		vkDestroyBuffer(logical_device_handle, upload_buffer_handle, NULL);
+		vkFreeMemory(logical_device_handle, upload_memory_handle, NULL);
+		vkDestroyBuffer(logical_device_handle, download_buffer_handle, NULL);
+		vkFreeMemory(logical_device_handle, download_memory_handle, NULL);
+		engine.reset();
+		vkDestroyCommandPool(logical_device_handle, command_pool_handle, NULL);
+	}
+
+	void hybrid_simulator::create_engine(uint32_t capacity)
+	{
+		// the previous simulator has no step in flight, the last step waited for its download
+		engine.reset();
+		simulation_parameters engine_parameters = parameters;
+		engine_parameters.particle_count = capacity;
+		engine = std::make_unique<simulator>();
+		engine->configure(engine_parameters);
+		engine->initialize(*context);
+		device_capacity = capacity;
+		// the layout of the upload buffer follows the capacity, so every parked slot is written again
+		first_parked_slot = capacity;
+	}
+
+	void hybrid_simulator::record_command_buffers(uint32_t owned_particle_count)
+	{
+		VkCommandBufferBeginInfo command_buffer_begin_info
+		{
+			VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			NULL,
+			VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+			NULL
+		};
+		const VkDeviceSize vec2_size = sizeof(glm::vec2) * device_capacity;
+		const VkDeviceSize float_size = sizeof(float) * device_capacity;
+		const VkBuffer particle_buffer_handle = engine->get_particle_buffer();
+		const VkDeviceSize position_offset = engine->get_particle_field_buffer_info(particle_field::position).offset;
+		const VkDeviceSize velocity_offset = engine->get_particle_field_buffer_info(particle_field::velocity).offset;
+		const VkDeviceSize density_offset = engine->get_particle_field_buffer_info(particle_field::density).offset;
+		const VkDeviceSize pressure_offset = engine->get_particle_field_buffer_info(particle_field::pressure).offset;
+
+		// every slot goes up, as the device moves the parked ones too, which are at most a fraction of the slab
+		if (vkBeginCommandBuffer(upload_command_buffer_handle, &command_buffer_begin_info) != VK_SUCCESS)
+		{
+			throw std::runtime_error("command buffer begin failed");
+		}
+		const VkBufferCopy upload_copy_regions[]
+		{
+			{ 0, position_offset, vec2_size },
+			{ vec2_size, velocity_offset, vec2_size }
+		};
+		vkCmdCopyBuffer(upload_command_buffer_handle, upload_buffer_handle, particle_buffer_handle, 2, upload_copy_regions);
+		// Barrier: the step that follows in the next submission reads and integrates the uploaded particles
+		VkMemoryBarrier transfer_to_compute_memory_barrier
+		{
+			VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			NULL,
+			VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+		};
+		vkCmdPipelineBarrier(upload_command_buffer_handle, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &transfer_to_compute_memory_barrier, 0, NULL, 0, NULL);
+		if (vkEndCommandBuffer(upload_command_buffer_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("command buffer end failed");
+		}
+
+		// only the owned particles come back, the halo is stepped by the host
+		if (vkBeginCommandBuffer(download_command_buffer_handle, &command_buffer_begin_info) != VK_SUCCESS)
+		{
+			throw std::runtime_error("command buffer begin failed");
+		}
+		// Barrier: the step submitted before writes the particles
+		VkMemoryBarrier compute_to_transfer_memory_barrier
+		{
+			VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			NULL,
+			VK_ACCESS_SHADER_WRITE_BIT,
+			VK_ACCESS_TRANSFER_READ_BIT
+		};
+		vkCmdPipelineBarrier(download_command_buffer_handle, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &compute_to_transfer_memory_barrier, 0, NULL, 0, NULL);
+		const VkDeviceSize owned_vec2_size = sizeof(glm::vec2) * owned_particle_count;
+		const VkDeviceSize owned_float_size = sizeof(float) * owned_particle_count;
+		const VkBufferCopy download_copy_regions[]
+		{
+			{ position_offset, 0, owned_vec2_size },
+			{ velocity_offset, vec2_size, owned_vec2_size },
+			{ density_offset, 2 * vec2_size, owned_float_size },
+			{ pressure_offset, 2 * vec2_size + float_size, owned_float_size }
+		};
+		vkCmdCopyBuffer(download_command_buffer_handle, particle_buffer_handle, download_buffer_handle, 4, download_copy_regions);
+		// Barrier: the host reads the download buffer after the fence
+		VkMemoryBarrier transfer_to_host_memory_barrier
+		{
+			VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			NULL,
+			VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_ACCESS_HOST_READ_BIT
+		};
+		vkCmdPipelineBarrier(download_command_buffer_handle, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &transfer_to_host_memory_barrier, 0, NULL, 0, NULL);
+		if (vkEndCommandBuffer(download_command_buffer_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("command buffer end failed");
+		}
+	}
+
+	void hybrid_simulator::step(uint32_t step_count)
+	{
+		if (!context)
+		{
+			throw std::runtime_error("simulator must be initialized before it is stepped");
+		}
+		for (uint32_t i = 0; i < step_count; i++)
+		{
+			step_once();
+		}
+	}
+
+	// stable like std::stable_sort, and linear when the particles only swapped places with their neighbors since the
+	// last step, instead of sorting the whole scene again
+	static void insertion_sort_by_x(std::vector<uint32_t>& indices, const std::vector<glm::vec2>& position)
+	{
+		for (size_t i = 1; i < indices.size(); i++)
+		{
+			const uint32_t index = indices[i];
+			const float x = position[index].x;
+			size_t j = i;
+			for (; j > 0 && x < position[indices[j - 1]].x; j--)
+			{
+				indices[j] = indices[j - 1];
+			}
+			indices[j] = index;
+		}
+	}
+
+	void hybrid_simulator::step_once()
+	{
+		const std::vector<glm::vec2>& position = current_state.position;
+		const uint32_t particle_count = parameters.particle_count;
+		// stable, so that equal x keep their order and deterministic runs stay deterministic
+		insertion_sort_by_x(sorted_indices, position);
+
+		// the device owns [0, split) of the sorted order and the host owns [split, particle_count)
+		const uint32_t min_particle_count = std::min(options.min_backend_particle_count, particle_count / 2);
+		const uint32_t split = std::clamp(static_cast<uint32_t>(device_fraction * particle_count + 0.5f), min_particle_count, particle_count - min_particle_count);
+		const auto by_x_lower = [&position](uint32_t a, float x) { return position[a].x < x; };
+		const auto by_x_upper = [&position](float x, uint32_t a) { return x < position[a].x; };
+		const uint32_t last_device_halo_particle = split == 0 ? 0 : static_cast<uint32_t>(std::upper_bound(sorted_indices.begin() + split, sorted_indices.end(),
+			position[sorted_indices[split - 1]].x + halo_width, by_x_upper) - sorted_indices.begin());
+		const uint32_t first_host_halo_particle = split == particle_count ? split : static_cast<uint32_t>(std::lower_bound(sorted_indices.begin(), sorted_indices.begin() + split,
+			position[sorted_indices[split]].x - halo_width, by_x_lower) - sorted_indices.begin());
+
+		const auto device_start = std::chrono::steady_clock::now();
+		const uint32_t capacity = get_device_capacity(last_device_halo_particle, particle_count);
+		if (last_device_halo_particle > device_capacity || 2 * capacity <= device_capacity)
+		{
+			create_engine(capacity);
+		}
+		// the device slab in sorted order, which starts with its owned particles, then the parked slots. Only the
+		// slots that held slab particles in the last step are parked again
+		glm::vec2* upload_position = reinterpret_cast<glm::vec2*>(mapped_upload_memory);
+		glm::vec2* upload_velocity = upload_position + device_capacity;
+		for (uint32_t i = 0; i < last_device_halo_particle; i++)
+		{
+			upload_position[i] = position[sorted_indices[i]];
+			upload_velocity[i] = current_state.velocity[sorted_indices[i]];
+		}
+		if (last_device_halo_particle < first_parked_slot)
+		{
+			std::copy(parking_positions.begin() + last_device_halo_particle, parking_positions.begin() + first_parked_slot, upload_position + last_device_halo_particle);
+			std::fill(upload_velocity + last_device_halo_particle, upload_velocity + first_parked_slot, glm::vec2(0, 0));
+		}
+		first_parked_slot = last_device_halo_particle;
+		record_command_buffers(split);
+
+		// the previous step is complete, so the status of the simulator is not in use
+		engine->invalidate_neighbor_lists();
+		VkSubmitInfo submit_info
+		{
+			VK_STRUCTURE_TYPE_SUBMIT_INFO,
+			NULL,
+			0,
+			NULL,
+			NULL,
+			1,
+			&upload_command_buffer_handle,
+			0,
+			NULL
+		};
+		if (vkQueueSubmit(context->compute_queue_handle, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS)
+		{
+			throw std::runtime_error("compute queue submission failed");
+		}
+		engine->step();
+		submit_info.pCommandBuffers = &download_command_buffer_handle;
+		if (vkQueueSubmit(context->compute_queue_handle, 1, &submit_info, fence_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("compute queue submission failed");
+		}
+		const uint32_t host_slab_particle_count = particle_count - first_host_halo_particle;
+		host_state.position.resize(host_slab_particle_count);
+		host_state.velocity.resize(host_slab_particle_count);
+		const auto host_start = std::chrono::steady_clock::now();
+		for (uint32_t i = first_host_halo_particle; i < particle_count; i++)
+		{
+			host_state.position[i - first_host_halo_particle] = position[sorted_indices[i]];
+			host_state.velocity[i - first_host_halo_particle] = current_state.velocity[sorted_indices[i]];
+		}
+		// the solver polls the fence between its passes and while it waits for its workers, only to time the device
+		bool device_done = false;
+		std::chrono::steady_clock::time_point compute_end;
+		const std::function<void()> poll_device = [this, &device_done, &compute_end]()
+			{
+				if (!device_done && vkGetFenceStatus(context->logical_device_handle, fence_handle) == VK_SUCCESS)
+				{
+					device_done = true;
+					compute_end = std::chrono::steady_clock::now();
+				}
+			};
+		solver->step(host_state, poll_device);
+		const auto host_end = std::chrono::steady_clock::now();
+		if (!device_done)
+		{
+			if (vkWaitForFences(context->logical_device_handle, 1, &fence_handle, VK_TRUE, UINT64_MAX) != VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to wait for the device slab");
+			}
+			compute_end = std::chrono::steady_clock::now();
+		}
+		vkResetFences(context->logical_device_handle, 1, &fence_handle);
+
+		const auto read_start = std::chrono::steady_clock::now();
+		const glm::vec2* download_position = reinterpret_cast<const glm::vec2*>(mapped_download_memory);
+		const glm::vec2* download_velocity = download_position + device_capacity;
+		const float* download_density = reinterpret_cast<const float*>(download_velocity + device_capacity);
+		const float* download_pressure = download_density + device_capacity;
+		for (uint32_t i = 0; i < split; i++)
+		{
+			const uint32_t particle = sorted_indices[i];
+			next_state.position[particle] = download_position[i];
+			next_state.velocity[particle] = download_velocity[i];
+			next_state.density[particle] = download_density[i];
+			next_state.pressure[particle] = download_pressure[i];
+		}
+		const auto read_end = std::chrono::steady_clock::now();
+		// the scattering waits for the host, so only its own time counts
+		device_step_seconds = std::chrono::duration<double>((compute_end - device_start) + (read_end - read_start)).count();
+		host_step_seconds = std::chrono::duration<double>(host_end - host_start).count();
+
+		for (uint32_t i = split; i < particle_count; i++)
+		{
+			const uint32_t particle = sorted_indices[i];
+			next_state.position[particle] = host_state.position[i - first_host_halo_particle];
+			next_state.velocity[particle] = host_state.velocity[i - first_host_halo_particle];
+			next_state.density[particle] = host_state.density[i - first_host_halo_particle];
+			next_state.pressure[particle] = host_state.pressure[i - first_host_halo_particle];
+		}
+
+		std::swap(current_state.position, next_state.position);
+		std::swap(current_state.velocity, next_state.velocity);
+		std::swap(current_state.density, next_state.density);
+		std::swap(current_state.pressure, next_state.pressure);
+		step_count++;
+		if (options.tune)
+		{
+			// the device steps every slot of the simulator, the host its slab
+			tune_split(device_capacity, host_slab_particle_count);
+		}
+	}
+
+	void hybrid_simulator::tune_split(uint32_t device_particle_count, uint32_t host_particle_count)
+	{
+		if (device_step_seconds <= 0 || host_step_seconds <= 0)
+		{
+			return;
+		}
+		// particles per second of each backend including its halo, and the fraction that makes both take as long.
+		// Half of the way each step, so that one noisy measurement does not swing the split
+		const double device_rate = device_particle_count / device_step_seconds;
+		const double host_rate = host_particle_count / host_step_seconds;
+		const double balanced_fraction = device_rate / (device_rate + host_rate);
+		device_fraction = static_cast<float>(std::clamp(device_fraction + 0.5 * (balanced_fraction - device_fraction), 0.0, 1.0));
+	}
+
+	void hybrid_simulator::read_state(particle_state& state) const
+	{
+		state = current_state;
+	}
+
+	void hybrid_simulator::write_state(const particle_state& state)
+	{
+		const uint32_t particle_count = parameters.particle_count;
+		if (state.position.size() != particle_count || state.velocity.size() != particle_count)
+		{
+			throw std::runtime_error("particle state does not match the configured particle count");
+		}
+		current_state.position = state.position;
+		current_state.velocity = state.velocity;
+		// derived by the next step
+		current_state.density.assign(particle_count, 0);
+		current_state.pressure.assign(particle_count, 0);
+		current_state.mass.assign(particle_count, SPH_PARTICLE_MASS);
+		next_state = current_state;
+		sorted_indices.resize(particle_count);
+		for (uint32_t i = 0; i < particle_count; i++)
+		{
+			sorted_indices[i] = i;
+		}
+		// the steps keep the order up to date with the few particles that pass each other
+		const std::vector<glm::vec2>& position = current_state.position;
+		std::stable_sort(sorted_indices.begin(), sorted_indices.end(), [&position](uint32_t a, uint32_t b) { return position[a].x < position[b].x; });
+	}
+
+	const simulation_parameters& hybrid_simulator::get_parameters() const
+	{
+		return parameters;
+	}
+
+	uint64_t hybrid_simulator::get_step_count() const
+	{
+		return step_count;
+	}
+
+	float hybrid_simulator::get_device_fraction() const
+	{
+		return device_fraction;
+	}
+
+	double hybrid_simulator::get_device_step_seconds() const
+	{
+		return device_step_seconds;
+	}
+
+	double hybrid_simulator::get_host_step_seconds() const
+	{
+		return host_step_seconds;
+	}
+
+} // namespace sph
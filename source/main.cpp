@@ -18,12 +18,780 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 
+
 #include "application.hpp"
+#include "cpu_solver.hpp"
+#include "hybrid_simulator.hpp"
+#include "metrics_server.hpp"
+#include "out_of_core_simulator.hpp"
+#include "regression.hpp"
+#include "render_benchmark.hpp"
+#include "trajectory.hpp"
+#include "trajectory_capture.hpp"
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <numeric>
+#include <string>
+
+// steps the same scene with the gather kernels and with symmetric pairs and prints both throughputs, the symmetric
+// passes do half the pair work but pay for the atomics
+static void run_pair_benchmark(sph::simulation_parameters parameters, uint32_t step_count)
+{
+    double steps_per_second[2] = { 0, 0 };
+    for (int symmetric = 0; symmetric < 2; symmetric++)
+    {
+        parameters.symmetric_pairs = symmetric != 0;
+        sph::simulator simulator;
+        simulator.configure(parameters);
+        simulator.initialize();
+        if (parameters.symmetric_pairs && !simulator.is_using_symmetric_pairs())
+        {
+            std::cout << "[WARN] symmetric pairs are not supported by the device, nothing to compare" << std::endl;
+            return;
+        }
+        // settle the clocks and fill the neighbor lists first
+        simulator.step(std::max(1u, step_count / 10));
+        simulator.wait_idle();
+        auto start = std::chrono::high_resolution_clock::now();
+        simulator.step(step_count);
+        simulator.wait_idle();
+        auto end = std::chrono::high_resolution_clock::now();
+        steps_per_second[symmetric] = step_count / (1e-9 * std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+        std::cout << "[INFO] " << (symmetric ? "symmetric pairs" : "gather") << ": " << steps_per_second[symmetric] << " steps/s" << std::endl;
+    }
+    std::cout << "[INFO] symmetric pairs speedup: " << steps_per_second[1] / steps_per_second[0] << "x" << std::endl;
+}
+
+// steps the same scene with the one-invocation-per-particle density and force passes and with persistent threads, and
+// prints the mean and the slowest GPU time of the two passes per step. Imbalance shows in the slowest steps
+static void run_persistent_benchmark(sph::simulation_parameters parameters, uint32_t step_count)
+{
+    double mean_time_ns[2] = { 0, 0 };
+    for (int persistent = 0; persistent < 2; persistent++)
+    {
+        parameters.persistent_threads = persistent != 0;
+        sph::simulator simulator;
+        simulator.configure(parameters);
+        simulator.set_pass_timing(1);
+        simulator.initialize();
+        // settle the clocks and fill the neighbor lists first
+        simulator.step(std::max(1u, step_count / 10));
+        simulator.wait_idle();
+        double total_time_ns = 0;
+        double max_time_ns = 0;
+        uint32_t timed_step_count = 0;
+        // every step is timed unless the traced command buffers are all in flight, each timed step counts once
+        uint64_t last_timed_step = simulator.get_last_step_pass_times().step;
+        auto add_pass_times = [&]()
+        {
+            const sph::step_pass_times& pass_times = simulator.get_last_step_pass_times();
+            if (pass_times.pass_count > 3 && pass_times.step != last_timed_step)
+            {
+                const double time_ns = pass_times.time_ns[2] + pass_times.time_ns[3];
+                total_time_ns += time_ns;
+                max_time_ns = std::max(max_time_ns, time_ns);
+                timed_step_count++;
+                last_timed_step = pass_times.step;
+            }
+        };
+        for (uint32_t step = 0; step < step_count; step++)
+        {
+            simulator.step();
+            add_pass_times();
+        }
+        simulator.wait_idle();
+        add_pass_times();
+        mean_time_ns[persistent] = total_time_ns / std::max(timed_step_count, 1u);
+        std::cout << "[INFO] " << (persistent ? "persistent threads" : "one invocation per particle") << ": density and force " << 1e-3 * mean_time_ns[persistent]
+            << " us per step on average, " << 1e-3 * max_time_ns << " us at most" << std::endl;
+    }
+    std::cout << "[INFO] persistent threads speedup of density and force: " << mean_time_ns[0] / mean_time_ns[1] << "x" << std::endl;
+}
+
+// steps the same scene with a range of neighbor skins and list lengths around the defaults and prints, for each
+// pair, the memory of the neighbor lists, the rebuilds and overflows of the timed steps and the throughput. A larger
+// skin rebuilds less often but makes the lists longer, and lists that are too short overflow and drop neighbors
+static void run_neighbor_benchmark(sph::simulation_parameters parameters, uint32_t step_count)
+{
+    const float skins[] = { 0.5f * SPH_NEIGHBOR_SKIN, SPH_NEIGHBOR_SKIN, 2 * SPH_NEIGHBOR_SKIN, 4 * SPH_NEIGHBOR_SKIN };
+    const uint32_t max_neighbor_counts[] = { SPH_MAX_NEIGHBORS / 2, SPH_MAX_NEIGHBORS, 3 * SPH_MAX_NEIGHBORS / 2, 2 * SPH_MAX_NEIGHBORS };
+    for (float skin : skins)
+    {
+        for (uint32_t max_neighbors : max_neighbor_counts)
+        {
+            parameters.neighbor_skin = skin;
+            parameters.max_neighbors = max_neighbors;
+            sph::simulator simulator;
+            simulator.configure(parameters);
+            simulator.initialize();
+            // settle the clocks and fill the neighbor lists first
+            simulator.step(std::max(1u, step_count / 10));
+            simulator.wait_idle();
+            const sph::neighbor_list_status settled_status = simulator.get_neighbor_list_status();
+            auto start = std::chrono::high_resolution_clock::now();
+            simulator.step(step_count);
+            simulator.wait_idle();
+            auto end = std::chrono::high_resolution_clock::now();
+            const sph::neighbor_list_status& status = simulator.get_neighbor_list_status();
+            const double steps_per_second = step_count / (1e-9 * std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+            std::cout << "[INFO] skin " << skin << ", " << max_neighbors << " neighbors: " << simulator.get_neighbor_list_buffer_size() / 1024
+                << " KiB of lists, " << status.build_count - settled_status.build_count << " rebuilds, " << status.overflow_count - settled_status.overflow_count
+                << " overflows, " << steps_per_second << " steps/s" << std::endl;
+        }
+    }
+}
+
+// names of the time integrators on the command line and in the benchmark output
+static const char* const integrator_names[] = { "euler", "leapfrog", "predictor-corrector" };
+
+// a run is stable while every particle is finite and slower than a few times the speed of a fall across the domain
+static bool is_stable(const sph::particle_state& state, float speed_limit)
+{
+    for (size_t i = 0; i < state.position.size(); i++)
+    {
+        const glm::vec2 position = state.position[i];
+        const glm::vec2 velocity = state.velocity[i];
+        if (!std::isfinite(position.x) || !std::isfinite(position.y) || !(glm::dot(velocity, velocity) < speed_limit * speed_limit))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// runs both built-in scenes with every time integrator at growing multiples of the default time step for the same
+// simulated time, and prints the largest stable time step and the wall-clock time per simulated second at it
+static void run_integrator_benchmark(sph::simulation_parameters parameters, double simulated_seconds)
+{
+    static const float time_step_factors[] = { 1.f, 1.5f, 2.f, 3.f, 4.f, 6.f, 8.f };
+    // the stability is checked this many times during a run, an explosion may calm down again against the walls
+    const uint32_t check_count = 10;
+    const float speed_limit = 4 * std::sqrt(2 * glm::length(sph::ensemble_member_parameters().gravity) * 2);
+    for (uint64_t scene_id = 0; scene_id < 2; scene_id++)
+    {
+        parameters.scene_id = scene_id;
+        for (uint32_t integrator = 0; integrator < 3; integrator++)
+        {
+            parameters.integrator = static_cast<sph::time_integrator>(integrator);
+            float stable_time_step = 0;
+            double seconds_per_simulated_second = 0;
+            for (float factor : time_step_factors)
+            {
+                parameters.time_step = factor * SPH_TIME_STEP;
+                const uint32_t steps_per_check = std::max(1u, static_cast<uint32_t>(std::ceil(simulated_seconds / parameters.time_step / check_count)));
+                sph::simulator simulator;
+                simulator.configure(parameters);
+                simulator.initialize();
+                sph::particle_state state;
+                bool stable = true;
+                double seconds = 0;
+                for (uint32_t check = 0; check < check_count && stable; check++)
+                {
+                    auto start = std::chrono::high_resolution_clock::now();
+                    simulator.step(steps_per_check);
+                    simulator.wait_idle();
+                    auto end = std::chrono::high_resolution_clock::now();
+                    seconds += 1e-9 * std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+                    simulator.read_state(state);
+                    stable = is_stable(state, speed_limit);
+                }
+                if (!stable)
+                {
+                    break;
+                }
+                stable_time_step = parameters.time_step;
+                seconds_per_simulated_second = seconds / (static_cast<double>(steps_per_check) * check_count * parameters.time_step);
+            }
+            if (stable_time_step == 0)
+            {
+                std::cout << "[WARN] scene " << scene_id << ", " << integrator_names[integrator] << ": unstable at the default time step" << std::endl;
+                continue;
+            }
+            std::cout << "[INFO] scene " << scene_id << ", " << integrator_names[integrator] << ": largest stable time step " << stable_time_step
+                << " s, " << seconds_per_simulated_second << " s per simulated second" << std::endl;
+        }
+    }
+}
+
+// pairs of particles closer than the smoothing length, found with a sweep over the particles sorted by x
+static uint64_t count_interacting_pairs(const sph::particle_state& state, float smoothing_length)
+{
+    std::vector<uint32_t> order(state.position.size());
+    std::iota(order.begin(), order.end(), 0u);
+    std::sort(order.begin(), order.end(), [&state](uint32_t a, uint32_t b) { return state.position[a].x < state.position[b].x; });
+    uint64_t pair_count = 0;
+    for (size_t a = 0; a < order.size(); a++)
+    {
+        for (size_t b = a + 1; b < order.size() && state.position[order[b]].x - state.position[order[a]].x < smoothing_length; b++)
+        {
+            const glm::vec2 delta = state.position[order[a]] - state.position[order[b]];
+            pair_count += glm::dot(delta, delta) < smoothing_length * smoothing_length ? 1 : 0;
+        }
+    }
+    return pair_count;
+}
+
+// steps the scene with every smoothing kernel and kernel evaluation and prints the step time per interacting pair.
+// The accuracy of the tables is the difference to the analytic kernel over one step from the same state: the
+// largest relative density error and the largest acceleration error relative to the RMS acceleration
+static void run_kernel_benchmark(sph::simulation_parameters parameters, uint32_t step_count)
+{
+    static const char* const kernel_names[] = { "muller", "cubic spline", "wendland" };
+    static const char* const evaluation_names[] = { "analytic", "shared table", "uniform table" };
+    for (uint32_t kernel = 0; kernel < 3; kernel++)
+    {
+        parameters.kernel = static_cast<sph::smoothing_kernel>(kernel);
+        // the state the one step comparisons start from, and the analytic result of that step
+        sph::particle_state start_state;
+        sph::particle_state analytic_state;
+        for (uint32_t evaluation = 0; evaluation < 3; evaluation++)
+        {
+            parameters.kernel_lookup = static_cast<sph::kernel_evaluation>(evaluation);
+            sph::simulator simulator;
+            simulator.configure(parameters);
+            simulator.initialize();
+            // settle the clocks and fill the neighbor lists first
+            simulator.step(std::max(1u, step_count / 10));
+            simulator.wait_idle();
+            auto start = std::chrono::high_resolution_clock::now();
+            simulator.step(step_count);
+            simulator.wait_idle();
+            auto end = std::chrono::high_resolution_clock::now();
+            const double seconds_per_step = 1e-9 * std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / step_count;
+
+            sph::particle_state state;
+            if (evaluation == 0)
+            {
+                simulator.read_state(start_state);
+            }
+            simulator.write_state(start_state);
+            simulator.step(1);
+            simulator.read_state(state);
+            // every particle of a pair evaluates the kernel for the other in the gather kernels
+            const uint64_t pair_count = count_interacting_pairs(start_state, 4 * SPH_PARTICLE_RADIUS);
+            std::cout << "[INFO] " << kernel_names[kernel] << ", " << evaluation_names[evaluation] << ": " << 1e3 * seconds_per_step << " ms per step, "
+                << 1e9 * seconds_per_step / std::max<uint64_t>(1, 2 * pair_count) << " ns per pair evaluation";
+            if (evaluation == 0)
+            {
+                analytic_state = state;
+                std::cout << std::endl;
+                continue;
+            }
+
+            double max_density_error = 0;
+            double max_acceleration_error = 0;
+            double acceleration_square_sum = 0;
+            for (size_t i = 0; i < state.position.size(); i++)
+            {
+                max_density_error = std::max(max_density_error, static_cast<double>(std::abs(state.density[i] - analytic_state.density[i]) / analytic_state.density[i]));
+                max_acceleration_error = std::max(max_acceleration_error, static_cast<double>(glm::length(state.velocity[i] - analytic_state.velocity[i])));
+                const glm::vec2 velocity_change = analytic_state.velocity[i] - start_state.velocity[i];
+                acceleration_square_sum += glm::dot(velocity_change, velocity_change);
+            }
+            // both accelerations are the velocity changes over the same time step, which cancels
+            const double rms_acceleration = std::sqrt(acceleration_square_sum / state.position.size());
+            std::cout << ", max density error " << max_density_error << ", max acceleration error " << max_acceleration_error / std::max(rms_acceleration, 1e-30)
+                << " of the RMS acceleration" << std::endl;
+        }
+    }
+}
+
+// steps the scene tile by tile through the device and prints the throughput and the tiling
+static void run_out_of_core(const sph::simulation_parameters& parameters, const sph::out_of_core_options& options, uint32_t step_count)
+{
+    sph::out_of_core_simulator simulator;
+    simulator.configure(parameters, options);
+    simulator.initialize();
+    auto start = std::chrono::high_resolution_clock::now();
+    simulator.step(step_count);
+    auto end = std::chrono::high_resolution_clock::now();
+    const double seconds = 1e-9 * std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    std::cout << "[INFO] " << step_count << " out-of-core steps of " << parameters.particle_count << " particles in " << simulator.get_tile_count()
+        << " tiles of capacity " << simulator.get_tile_capacity() << " in " << seconds << " s (" << step_count / seconds << " steps/s, "
+        << step_count * static_cast<double>(parameters.particle_count) / seconds << " particle steps/s)" << std::endl;
+}
+
+// steps the scene split between the device and the host and prints the throughput and the split it settled on
+static void run_hybrid(const sph::simulation_parameters& parameters, uint32_t step_count)
+{
+    sph::hybrid_simulator simulator;
+    simulator.configure(parameters);
+    simulator.initialize();
+    auto start = std::chrono::high_resolution_clock::now();
+    simulator.step(step_count);
+    auto end = std::chrono::high_resolution_clock::now();
+    const double seconds = 1e-9 * std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    std::cout << "[INFO] " << step_count << " hybrid steps of " << parameters.particle_count << " particles in " << seconds << " s (" << step_count / seconds
+        << " steps/s, " << step_count * static_cast<double>(parameters.particle_count) / seconds << " particle steps/s), device fraction "
+        << simulator.get_device_fraction() << ", last step " << 1e3 * simulator.get_device_step_seconds() << " ms on the device and "
+        << 1e3 * simulator.get_host_step_seconds() << " ms on the host" << std::endl;
+}
+
+// steps the same scene on the device alone, on the host alone with the cpu solver and split between both, and prints
+// the three throughputs. The hybrid run is timed after the split has settled
+static void run_hybrid_benchmark(const sph::simulation_parameters& parameters, uint32_t step_count)
+{
+    double steps_per_second[3] = { 0, 0, 0 };
+    {
+        sph::simulator simulator;
+        simulator.configure(parameters);
+        simulator.initialize();
+        // settle the clocks and fill the neighbor lists first
+        simulator.step(std::max(1u, step_count / 10));
+        simulator.wait_idle();
+        auto start = std::chrono::high_resolution_clock::now();
+        simulator.step(step_count);
+        simulator.wait_idle();
+        auto end = std::chrono::high_resolution_clock::now();
+        steps_per_second[0] = step_count / (1e-9 * std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+        std::cout << "[INFO] device: " << steps_per_second[0] << " steps/s" << std::endl;
+    }
+    {
+        sph::cpu_solver solver(parameters);
+        sph::particle_state state = sph::create_scene_state(parameters);
+        auto start = std::chrono::high_resolution_clock::now();
+        for (uint32_t i = 0; i < step_count; i++)
+        {
+            solver.step(state);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        steps_per_second[1] = step_count / (1e-9 * std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+        std::cout << "[INFO] host, " << solver.get_thread_count() << " threads: " << steps_per_second[1] << " steps/s" << std::endl;
+    }
+    {
+        sph::hybrid_simulator simulator;
+        simulator.configure(parameters);
+        simulator.initialize();
+        simulator.step(std::max(1u, step_count / 10));
+        auto start = std::chrono::high_resolution_clock::now();
+        simulator.step(step_count);
+        auto end = std::chrono::high_resolution_clock::now();
+        steps_per_second[2] = step_count / (1e-9 * std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+        std::cout << "[INFO] hybrid, device fraction " << simulator.get_device_fraction() << ": " << steps_per_second[2] << " steps/s" << std::endl;
+    }
+    std::cout << "[INFO] hybrid speedup: " << steps_per_second[2] / steps_per_second[0] << "x over the device, " << steps_per_second[2] / steps_per_second[1]
+        << "x over the host" << std::endl;
+}
 
 int main(int argc, char** argv)
 {
+    // "-regression" compares deterministic runs against the golden snapshots and the CPU reference, add
+    // "-update-golden" to regenerate the snapshots after an intended change of the results
+    if (std::find(argv, argv + argc, std::string("-regression")) != argv + argc)
+    {
+        sph::regression_options options;
+        options.update_golden = std::find(argv, argv + argc, std::string("-update-golden")) != argv + argc;
+        return sph::run_regression(options) == 0 ? 0 : 1;
+    }
+
+    sph::simulation_parameters parameters;
     // use alternate scene if "-a" is specified in the command line argument
-    sph::application app((std::find(argv, argv + argc, std::string("-a")) != argv + argc) ? 1 : 0);
+    parameters.scene_id = (std::find(argv, argv + argc, std::string("-a")) != argv + argc) ? 1 : 0;
+    // "-adaptive" splits and merges particles so that the calm bulk is simulated at a coarser resolution
+    parameters.adaptive_resolution = std::find(argv, argv + argc, std::string("-adaptive")) != argv + argc;
+    // "-sleep" skips particles at rest until a moving neighbor wakes them
+    parameters.sleeping = std::find(argv, argv + argc, std::string("-sleep")) != argv + argc;
+    // "-symmetric" evaluates every pair once and adds its contributions to both particles with float atomics
+    parameters.symmetric_pairs = std::find(argv, argv + argc, std::string("-symmetric")) != argv + argc;
+    // "-persistent" runs density and force with persistent threads that claim batches of particles from a queue,
+    // "-persistent-work-groups <count>" sets how many work groups they have
+    parameters.persistent_threads = std::find(argv, argv + argc, std::string("-persistent")) != argv + argc;
+    auto persistent_work_groups_argument = std::find(argv, argv + argc, std::string("-persistent-work-groups"));
+    if (persistent_work_groups_argument != argv + argc && persistent_work_groups_argument + 1 != argv + argc)
+    {
+        parameters.persistent_work_group_count = static_cast<uint32_t>(std::stoul(*(persistent_work_groups_argument + 1)));
+    }
+    // "-hashed" builds the neighbor lists from a spatial hash instead of testing every pair
+    parameters.hashed_grid = std::find(argv, argv + argc, std::string("-hashed")) != argv + argc;
+    // "-grid-fragmentation <fraction>" rebuilds the hashed grid once the moves have left that many tombstones per
+    // particle (default 0.25), 0 rebuilds it with every neighbor list build
+    auto grid_fragmentation_argument = std::find(argv, argv + argc, std::string("-grid-fragmentation"));
+    if (grid_fragmentation_argument != argv + argc && grid_fragmentation_argument + 1 != argv + argc)
+    {
+        parameters.grid_fragmentation_limit = std::stof(*(grid_fragmentation_argument + 1));
+    }
+    // "-open" removes the walls, so the particles spread without bounds
+    parameters.open_domain = std::find(argv, argv + argc, std::string("-open")) != argv + argc;
+    // "-integrator <euler|leapfrog|predictor-corrector>" selects the time integrator, "-time-step <seconds>" its step
+    auto integrator_argument = std::find(argv, argv + argc, std::string("-integrator"));
+    if (integrator_argument != argv + argc && integrator_argument + 1 != argv + argc)
+    {
+        auto integrator_name = std::find(std::begin(integrator_names), std::end(integrator_names), std::string(*(integrator_argument + 1)));
+        if (integrator_name == std::end(integrator_names))
+        {
+            std::cout << "[ERROR] unknown integrator " << *(integrator_argument + 1) << std::endl;
+            return 1;
+        }
+        parameters.integrator = static_cast<sph::time_integrator>(integrator_name - std::begin(integrator_names));
+    }
+    // "-kernel <muller|cubic-spline|wendland>" selects the smoothing kernel, "-kernel-table <shared|uniform>" evaluates
+    // it from a table
+    static const char* const kernel_arguments[] = { "muller", "cubic-spline", "wendland" };
+    auto kernel_argument = std::find(argv, argv + argc, std::string("-kernel"));
+    if (kernel_argument != argv + argc && kernel_argument + 1 != argv + argc)
+    {
+        auto kernel_name = std::find(std::begin(kernel_arguments), std::end(kernel_arguments), std::string(*(kernel_argument + 1)));
+        if (kernel_name == std::end(kernel_arguments))
+        {
+            std::cout << "[ERROR] unknown kernel " << *(kernel_argument + 1) << std::endl;
+            return 1;
+        }
+        parameters.kernel = static_cast<sph::smoothing_kernel>(kernel_name - std::begin(kernel_arguments));
+    }
+    auto kernel_table_argument = std::find(argv, argv + argc, std::string("-kernel-table"));
+    if (kernel_table_argument != argv + argc && kernel_table_argument + 1 != argv + argc)
+    {
+        parameters.kernel_lookup = std::string(*(kernel_table_argument + 1)) == "uniform" ? sph::kernel_evaluation::uniform_table : sph::kernel_evaluation::shared_table;
+    }
+    auto time_step_argument = std::find(argv, argv + argc, std::string("-time-step"));
+    if (time_step_argument != argv + argc && time_step_argument + 1 != argv + argc)
+    {
+        parameters.time_step = std::stof(*(time_step_argument + 1));
+    }
+    // "-time-bins <count>" gives every particle one of that many power-of-two time steps, the smallest being the time
+    // step, "-time-bin-courant <factor>" sets how much of the time to cross a smoothing length a step may take
+    auto time_bins_argument = std::find(argv, argv + argc, std::string("-time-bins"));
+    if (time_bins_argument != argv + argc && time_bins_argument + 1 != argv + argc)
+    {
+        parameters.time_bin_count = static_cast<uint32_t>(std::stoul(*(time_bins_argument + 1)));
+    }
+    auto time_bin_courant_argument = std::find(argv, argv + argc, std::string("-time-bin-courant"));
+    if (time_bin_courant_argument != argv + argc && time_bin_courant_argument + 1 != argv + argc)
+    {
+        parameters.time_bin_courant = std::stof(*(time_bin_courant_argument + 1));
+    }
+    // "-particles <count>" sets the particle count of a member, the scenes fill the domain at about 40000
+    auto particles_argument = std::find(argv, argv + argc, std::string("-particles"));
+    if (particles_argument != argv + argc && particles_argument + 1 != argv + argc)
+    {
+        parameters.particle_count = static_cast<uint32_t>(std::stoul(*(particles_argument + 1)));
+    }
+    // "-ensemble <members>" steps that many independent copies of the scene together, only the first is drawn
+    auto ensemble_argument = std::find(argv, argv + argc, std::string("-ensemble"));
+    if (ensemble_argument != argv + argc && ensemble_argument + 1 != argv + argc)
+    {
+        parameters.ensemble_size = static_cast<uint32_t>(std::stoul(*(ensemble_argument + 1)));
+    }
+
+    // "-benchmark-pairs <steps>" compares the throughput of the gather kernels and of symmetric pairs
+    auto benchmark_pairs_argument = std::find(argv, argv + argc, std::string("-benchmark-pairs"));
+    if (benchmark_pairs_argument != argv + argc && benchmark_pairs_argument + 1 != argv + argc)
+    {
+        run_pair_benchmark(parameters, static_cast<uint32_t>(std::stoul(*(benchmark_pairs_argument + 1))));
+        return 0;
+    }
+
+    // "-benchmark-persistent <steps>" compares the GPU time of density and force with and without persistent threads
+    auto benchmark_persistent_argument = std::find(argv, argv + argc, std::string("-benchmark-persistent"));
+    if (benchmark_persistent_argument != argv + argc && benchmark_persistent_argument + 1 != argv + argc)
+    {
+        run_persistent_benchmark(parameters, static_cast<uint32_t>(std::stoul(*(benchmark_persistent_argument + 1))));
+        return 0;
+    }
+
+    // "-benchmark-neighbors <steps>" compares the neighbor list memory, rebuilds, overflows and throughput of a range
+    // of neighbor skins and list lengths
+    auto benchmark_neighbors_argument = std::find(argv, argv + argc, std::string("-benchmark-neighbors"));
+    if (benchmark_neighbors_argument != argv + argc && benchmark_neighbors_argument + 1 != argv + argc)
+    {
+        run_neighbor_benchmark(parameters, std::max(1u, static_cast<uint32_t>(std::stoul(*(benchmark_neighbors_argument + 1)))));
+        return 0;
+    }
+
+    // "-benchmark-integrators <simulated seconds>" finds the largest stable time step of every integrator in both
+    // scenes and prints the wall-clock time per simulated second at it
+    auto benchmark_integrators_argument = std::find(argv, argv + argc, std::string("-benchmark-integrators"));
+    if (benchmark_integrators_argument != argv + argc && benchmark_integrators_argument + 1 != argv + argc)
+    {
+        run_integrator_benchmark(parameters, std::stod(*(benchmark_integrators_argument + 1)));
+        return 0;
+    }
+
+    // "-benchmark-kernels <steps>" compares the step time and the accuracy of every smoothing kernel and evaluation
+    auto benchmark_kernels_argument = std::find(argv, argv + argc, std::string("-benchmark-kernels"));
+    if (benchmark_kernels_argument != argv + argc && benchmark_kernels_argument + 1 != argv + argc)
+    {
+        run_kernel_benchmark(parameters, std::max(1u, static_cast<uint32_t>(std::stoul(*(benchmark_kernels_argument + 1)))));
+        return 0;
+    }
+
+    // "-benchmark-hybrid <steps>" compares the throughput of the device, of the host and of both together
+    auto benchmark_hybrid_argument = std::find(argv, argv + argc, std::string("-benchmark-hybrid"));
+    if (benchmark_hybrid_argument != argv + argc && benchmark_hybrid_argument + 1 != argv + argc)
+    {
+        run_hybrid_benchmark(parameters, std::max(1u, static_cast<uint32_t>(std::stoul(*(benchmark_hybrid_argument + 1)))));
+        return 0;
+    }
+
+    // "-benchmark-render <frames>" compares the frame rates of the graphics pipeline and of the compute splats for
+    // growing particle counts
+    auto benchmark_render_argument = std::find(argv, argv + argc, std::string("-benchmark-render"));
+    if (benchmark_render_argument != argv + argc && benchmark_render_argument + 1 != argv + argc)
+    {
+        sph::render_benchmark_options options;
+        options.frame_count = std::max(1u, static_cast<uint32_t>(std::stoul(*(benchmark_render_argument + 1))));
+        sph::run_render_benchmark(parameters, options);
+        return 0;
+    }
+
+    // "-splat" draws the window and the captures with the compute splat renderer instead of the graphics pipeline
+    const bool splat = std::find(argv, argv + argc, std::string("-splat")) != argv + argc;
+
+    // "-trace <file>" writes a Chrome trace of the CPU frame phases and the GPU passes of every step
+    std::string trace_path;
+    auto trace_argument = std::find(argv, argv + argc, std::string("-trace"));
+    if (trace_argument != argv + argc && trace_argument + 1 != argv + argc)
+    {
+        trace_path = *(trace_argument + 1);
+    }
+
+    // "-capture <path prefix>" renders the particles offscreen every "-capture-interval <steps>" steps (default 1) and
+    // writes them as PNG, or as raw RGBA with "-capture-raw"
+    sph::frame_capture_options capture_options;
+    auto capture_argument = std::find(argv, argv + argc, std::string("-capture"));
+    if (capture_argument != argv + argc && capture_argument + 1 != argv + argc)
+    {
+        capture_options.path_prefix = *(capture_argument + 1);
+    }
+    auto capture_interval_argument = std::find(argv, argv + argc, std::string("-capture-interval"));
+    if (capture_interval_argument != argv + argc && capture_interval_argument + 1 != argv + argc)
+    {
+        capture_options.interval = std::max(1u, static_cast<uint32_t>(std::stoul(*(capture_interval_argument + 1))));
+    }
+    capture_options.raw = std::find(argv, argv + argc, std::string("-capture-raw")) != argv + argc;
+    capture_options.splat = splat;
+
+    // "-publish <shared memory name>" copies positions and velocities every "-publish-interval <steps>" steps (default 1)
+    // into shared memory, where other processes read the latest snapshot with sph::shared_state_reader
+    sph::state_publisher_options publish_options;
+    auto publish_argument = std::find(argv, argv + argc, std::string("-publish"));
+    if (publish_argument != argv + argc && publish_argument + 1 != argv + argc)
+    {
+        publish_options.name = *(publish_argument + 1);
+    }
+    auto publish_interval_argument = std::find(argv, argv + argc, std::string("-publish-interval"));
+    if (publish_interval_argument != argv + argc && publish_interval_argument + 1 != argv + argc)
+    {
+        publish_options.interval = std::max(1u, static_cast<uint32_t>(std::stoul(*(publish_interval_argument + 1))));
+    }
+
+    // "-trajectory <path>" writes the first member every "-trajectory-interval <steps>" steps (default 10) to a
+    // compressed trajectory file, with "-trajectory-precision <position> <velocity>" as the largest errors
+    sph::trajectory_writer_options trajectory_options;
+    auto trajectory_argument = std::find(argv, argv + argc, std::string("-trajectory"));
+    if (trajectory_argument != argv + argc && trajectory_argument + 1 != argv + argc)
+    {
+        trajectory_options.path = *(trajectory_argument + 1);
+    }
+    auto trajectory_interval_argument = std::find(argv, argv + argc, std::string("-trajectory-interval"));
+    if (trajectory_interval_argument != argv + argc && trajectory_interval_argument + 1 != argv + argc)
+    {
+        trajectory_options.interval = std::max(1u, static_cast<uint32_t>(std::stoul(*(trajectory_interval_argument + 1))));
+    }
+    auto trajectory_precision_argument = std::find(argv, argv + argc, std::string("-trajectory-precision"));
+    if (trajectory_precision_argument != argv + argc && trajectory_precision_argument + 2 < argv + argc)
+    {
+        trajectory_options.position_precision = std::stof(*(trajectory_precision_argument + 1));
+        trajectory_options.velocity_precision = std::stof(*(trajectory_precision_argument + 2));
+    }
+
+    // "-metrics <port>" serves Prometheus metrics of the run at http://127.0.0.1:<port>/metrics, "-metrics-address
+    // <address>" binds another interface and "-metrics-interval <steps>" sets the steps between the timed steps
+    // (default 16)
+    sph::metrics_server_options metrics_options;
+    auto metrics_argument = std::find(argv, argv + argc, std::string("-metrics"));
+    if (metrics_argument != argv + argc && metrics_argument + 1 != argv + argc)
+    {
+        metrics_options.port = static_cast<uint16_t>(std::stoul(*(metrics_argument + 1)));
+    }
+    auto metrics_address_argument = std::find(argv, argv + argc, std::string("-metrics-address"));
+    if (metrics_address_argument != argv + argc && metrics_address_argument + 1 != argv + argc)
+    {
+        metrics_options.bind_address = *(metrics_address_argument + 1);
+    }
+    auto metrics_interval_argument = std::find(argv, argv + argc, std::string("-metrics-interval"));
+    if (metrics_interval_argument != argv + argc && metrics_interval_argument + 1 != argv + argc)
+    {
+        metrics_options.interval = std::max(1u, static_cast<uint32_t>(std::stoul(*(metrics_interval_argument + 1))));
+    }
+
+    // "-replay <path>" draws the frames of a trajectory file in the window instead of simulating, at
+    // "-replay-speed <frames per second>" (default 60, negative plays backwards)
+    sph::replay_player_options replay_options;
+    auto replay_argument = std::find(argv, argv + argc, std::string("-replay"));
+    if (replay_argument != argv + argc && replay_argument + 1 != argv + argc)
+    {
+        replay_options.path = *(replay_argument + 1);
+    }
+    auto replay_speed_argument = std::find(argv, argv + argc, std::string("-replay-speed"));
+    if (replay_speed_argument != argv + argc && replay_speed_argument + 1 != argv + argc)
+    {
+        replay_options.frames_per_second = std::stod(*(replay_speed_argument + 1));
+    }
+
+    // "-headless <steps>" runs the simulator without a window and reports its throughput
+    auto headless_argument = std::find(argv, argv + argc, std::string("-headless"));
+    if (headless_argument != argv + argc && headless_argument + 1 != argv + argc)
+    {
+        const uint32_t step_count = static_cast<uint32_t>(std::stoul(*(headless_argument + 1)));
+        // "-out-of-core <tile particles>" keeps the particles in host memory and streams them through the device in
+        // tiles of that many particles
+        auto out_of_core_argument = std::find(argv, argv + argc, std::string("-out-of-core"));
+        if (out_of_core_argument != argv + argc && out_of_core_argument + 1 != argv + argc)
+        {
+            sph::out_of_core_options options;
+            options.tile_particle_count = static_cast<uint32_t>(std::stoul(*(out_of_core_argument + 1)));
+            run_out_of_core(parameters, options, step_count);
+            return 0;
+        }
+        // "-hybrid" steps part of the particles on the host at the same time as the rest on the device
+        if (std::find(argv, argv + argc, std::string("-hybrid")) != argv + argc)
+        {
+            run_hybrid(parameters, step_count);
+            return 0;
+        }
+        sph::trace_recorder tracer;
+        sph::vulkan_context_create_info context_create_info;
+        if (!trace_path.empty())
+        {
+            context_create_info.optional_device_extensions.push_back(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+        }
+        if (!publish_options.name.empty())
+        {
+            context_create_info.optional_device_extensions.push_back(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME);
+        }
+        sph::vulkan_context context(context_create_info);
+        sph::simulator simulator;
+        simulator.configure(parameters);
+        simulator.set_pass_timing(metrics_options.port != 0 ? metrics_options.interval : 0);
+        if (!trace_path.empty())
+        {
+            tracer.calibrate(context);
+            simulator.set_trace_recorder(&tracer);
+        }
+        simulator.initialize(context);
+        std::unique_ptr<sph::frame_capture> capture;
+        if (!capture_options.path_prefix.empty())
+        {
+            capture = std::make_unique<sph::frame_capture>(simulator, capture_options);
+        }
+        std::unique_ptr<sph::state_publisher> publisher;
+        if (!publish_options.name.empty())
+        {
+            publisher = std::make_unique<sph::state_publisher>(simulator, publish_options);
+        }
+        std::unique_ptr<sph::metrics_server> metrics;
+        if (metrics_options.port != 0)
+        {
+            metrics = std::make_unique<sph::metrics_server>(metrics_options);
+        }
+        std::unique_ptr<sph::trajectory_writer> trajectory;
+        std::unique_ptr<sph::trajectory_capture> trajectory_capture;
+        if (!trajectory_options.path.empty())
+        {
+            trajectory = std::make_unique<sph::trajectory_writer>(parameters.particle_count, trajectory_options);
+            trajectory_capture = std::make_unique<sph::trajectory_capture>(simulator, *trajectory);
+        }
+        auto start = std::chrono::high_resolution_clock::now();
+        if (capture || publisher || metrics || trajectory)
+        {
+            // the steps up to the next capture or snapshot in one submission each, the results are written while the
+            // next ones run. The metrics take the place of the frames of the window with chunks of metrics interval
+            // steps, whose device time is the period of the timed steps. Nothing waits for the device for them
+            const uint32_t metrics_interval = metrics_options.interval;
+            uint64_t last_timed_step = 0;
+            const uint32_t chunk = std::gcd(std::gcd(capture ? capture_options.interval : 0u, publisher ? publish_options.interval : 0u),
+                std::gcd(metrics ? metrics_interval : 0u, trajectory ? trajectory_options.interval : 0u));
+            for (uint32_t submitted = 0; submitted < step_count; submitted += chunk)
+            {
+                sph::scoped_trace_event event(trace_path.empty() ? NULL : &tracer, "step and output submit");
+                simulator.step(std::min(chunk, step_count - submitted));
+                if (metrics && simulator.get_step_count() % metrics_interval == 0)
+                {
+                    // a chunk is recorded once the timestamps of a new timed step have been read
+                    const sph::step_pass_times& pass_times = simulator.get_last_step_pass_times();
+                    if (pass_times.step != last_timed_step && pass_times.step_period_ns > 0)
+                    {
+                        metrics->record_frame(1e-9 * metrics_interval * pass_times.step_period_ns);
+                        last_timed_step = pass_times.step;
+                    }
+                    metrics->publish(simulator);
+                }
+                if (capture && simulator.get_step_count() % capture_options.interval == 0)
+                {
+                    capture->capture();
+                }
+                if (publisher && simulator.get_step_count() % publish_options.interval == 0)
+                {
+                    publisher->publish();
+                }
+                if (trajectory && simulator.get_step_count() % trajectory_options.interval == 0)
+                {
+                    // copied on the device behind the chunk, coded on the workers of the writer once the copy is done
+                    trajectory_capture->capture();
+                }
+            }
+        }
+        else
+        {
+            sph::scoped_trace_event event(trace_path.empty() ? NULL : &tracer, "step submit");
+            simulator.step(step_count);
+        }
+        {
+            sph::scoped_trace_event event(trace_path.empty() ? NULL : &tracer, "wait idle");
+            simulator.wait_idle();
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        const double seconds = 1e-9 * std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+        std::cout << "[INFO] " << step_count << " steps of " << parameters.ensemble_size << " ensemble members in " << seconds << " s ("
+            << step_count / seconds << " steps/s, " << step_count * static_cast<double>(simulator.get_total_particle_count()) / seconds << " particle steps/s)" << std::endl;
+        if (parameters.adaptive_resolution)
+        {
+            std::cout << "[INFO] " << simulator.get_active_particle_count() << " of " << simulator.get_total_particle_count() << " particles active" << std::endl;
+        }
+        if (parameters.sleeping)
+        {
+            std::cout << "[INFO] " << simulator.get_awake_particle_count() << " of " << simulator.get_total_particle_count() << " particles awake" << std::endl;
+        }
+        if (parameters.time_bin_count > 1)
+        {
+            std::cout << "[INFO] " << simulator.get_awake_particle_count() << " of " << simulator.get_total_particle_count() << " particles due in the last step, "
+                << simulator.get_particle_activity_status().early_update_count << " blocks ended early" << std::endl;
+        }
+        if (capture)
+        {
+            const uint64_t frame_count = capture->get_captured_frame_count();
+            capture.reset();
+            std::cout << "[INFO] " << frame_count << " images written to " << capture_options.path_prefix << "*" << (capture_options.raw ? ".rgba" : ".png") << std::endl;
+        }
+        if (trajectory)
+        {
+            const uint64_t stalled_frame_count = trajectory_capture->get_stalled_frame_count();
+            trajectory_capture.reset();
+            trajectory->close();
+            std::cout << "[INFO] " << trajectory->get_frame_count() << " frames written to " << trajectory_options.path << ", " << trajectory->get_file_size()
+                << " bytes, " << trajectory->get_frame_count() * parameters.particle_count * 4 * sizeof(float) << " bytes uncompressed" << std::endl;
+            if (stalled_frame_count > 0)
+            {
+                std::cout << "[WARN] " << stalled_frame_count << " trajectory frames waited for the device, a longer interval avoids it" << std::endl;
+            }
+        }
+        if (publisher)
+        {
+            publisher->poll();
+            std::cout << "[INFO] " << publisher->get_published_frame_count() << " snapshots published to " << publish_options.name << ", "
+                << publisher->get_dropped_frame_count() << " dropped" << std::endl;
+        }
+        if (!trace_path.empty())
+        {
+            tracer.write(trace_path);
+            std::cout << "[INFO] trace written to " << trace_path << std::endl;
+        }
+        return 0;
+    }
+
+    sph::application app(parameters, trace_path, capture_options, publish_options, splat, metrics_options, replay_options);
     app.run();
 }
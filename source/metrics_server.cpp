@@ -0,0 +1,354 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "metrics_server.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace sph
+{
+
+#ifdef _WIN32
+	typedef SOCKET socket_handle;
+	static const socket_handle invalid_socket = INVALID_SOCKET;
+
+	static void close_socket(socket_handle handle)
+	{
+		closesocket(handle);
+	}
+#else
+	typedef int socket_handle;
+	static const socket_handle invalid_socket = -1;
+
+	static void close_socket(socket_handle handle)
+	{
+		close(handle);
+	}
+#endif
+
+#ifdef MSG_NOSIGNAL
+	// a scraper that hangs up early must not raise SIGPIPE in the simulation
+	static const int send_flags = MSG_NOSIGNAL;
+#else
+	static const int send_flags = 0;
+#endif
+
+	// how long the server thread blocks before it checks whether it should stop, and how long a client may take to
+	// send its request
+	static const long poll_interval_ms = 100;
+
+	// resident set of the process, 0 where it is not known
+	static uint64_t get_resident_memory_size()
+	{
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters;
+		if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		{
+			return counters.WorkingSetSize;
+		}
+		return 0;
+#else
+		// pages of the whole program and of the resident set
+		std::ifstream statm("/proc/self/statm");
+		uint64_t size_pages = 0;
+		uint64_t resident_pages = 0;
+		if (statm >> size_pages >> resident_pages)
+		{
+			return resident_pages * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+		}
+		return 0;
+#endif
+	}
+
+	metrics_server::metrics_server(const metrics_server_options& options)
+		: options(options)
+	{
+#ifdef _WIN32
+		WSADATA wsa_data;
+		if (WSAStartup(MAKEWORD(2, 2), &wsa_data) != 0)
+		{
+			throw std::runtime_error("WSAStartup failed");
+		}
+#endif
+		socket_handle handle = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if (handle == invalid_socket)
+		{
+#ifdef _WIN32
+			WSACleanup();
+#endif
+			throw std::runtime_error("metrics socket creation failed");
+		}
+		// a restarted run can take the port while the connections of the previous one linger
+		const int reuse_address = 1;
+		setsockopt(handle, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse_address), sizeof(reuse_address));
+		sockaddr_in address = {};
+		address.sin_family = AF_INET;
+		address.sin_port = htons(options.port);
+		if (inet_pton(AF_INET, options.bind_address.c_str(), &address.sin_addr) != 1
+			|| bind(handle, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(handle, 8) != 0)
+		{
+			close_socket(handle);
+#ifdef _WIN32
+			WSACleanup();
+#endif
+			throw std::runtime_error("failed to listen for metrics on " + options.bind_address + ":" + std::to_string(options.port));
+		}
+		listen_socket = static_cast<intptr_t>(handle);
+		rate_start_time = std::chrono::steady_clock::now();
+		server_thread = std::thread(&metrics_server::serve, this);
+		std::cout << "[INFO] metrics served at http://" << options.bind_address << ":" << options.port << "/metrics" << std::endl;
+	}
+
+	metrics_server::~metrics_server()
+	{
+		stopping = true;
+		server_thread.join();
+		close_socket(static_cast<socket_handle>(listen_socket));
+#ifdef _WIN32
+		WSACleanup();
+#endif
+	}
+
+	void metrics_server::record_frame(double seconds)
+	{
+		pending_snapshot.frame_time_seconds[pending_snapshot.frame_count % SPH_METRICS_FRAME_TIME_COUNT] = static_cast<float>(seconds);
+		pending_snapshot.frame_count++;
+		pending_snapshot.frame_time_sum_seconds += seconds;
+	}
+
+	void metrics_server::publish(const simulator& particle_simulator)
+	{
+		// everything read here is in host memory, the status blocks are updated by the device without synchronization
+		const neighbor_list_status& neighbor_status = particle_simulator.get_neighbor_list_status();
+		const adaptive_resolution_status& resolution_status = particle_simulator.get_adaptive_resolution_status();
+		pending_snapshot.step_count = particle_simulator.get_step_count();
+		pending_snapshot.particle_count = particle_simulator.get_total_particle_count();
+		pending_snapshot.active_particle_count = particle_simulator.get_active_particle_count();
+		pending_snapshot.awake_particle_count = particle_simulator.get_awake_particle_count();
+		pending_snapshot.pass_times = particle_simulator.get_last_step_pass_times();
+		pending_snapshot.device_buffer_size = particle_simulator.get_device_buffer_size();
+		pending_snapshot.neighbor_list_buffer_size = particle_simulator.get_neighbor_list_buffer_size();
+		pending_snapshot.neighbor_list_build_count = neighbor_status.build_count;
+		pending_snapshot.neighbor_list_overflow_count = neighbor_status.overflow_count;
+		pending_snapshot.grid_rebuild_count = neighbor_status.grid_rebuild_count;
+		pending_snapshot.grid_move_count = neighbor_status.grid_move_count;
+		pending_snapshot.max_neighbor_count = neighbor_status.max_neighbor_count;
+		pending_snapshot.split_count = resolution_status.split_count;
+		pending_snapshot.merge_count = resolution_status.merge_count;
+
+		// the rate over whole seconds, so that publishing every frame does not make it jitter
+		const auto now = std::chrono::steady_clock::now();
+		const double seconds = std::chrono::duration<double>(now - rate_start_time).count();
+		if (seconds >= 1)
+		{
+			pending_snapshot.steps_per_second = (pending_snapshot.step_count - rate_start_step_count) / seconds;
+			rate_start_time = now;
+			rate_start_step_count = pending_snapshot.step_count;
+		}
+
+		const uint64_t published_sequence = sequence.load(std::memory_order_relaxed);
+		sequence.store(published_sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		std::memcpy(&published_snapshot, &pending_snapshot, sizeof(metrics_snapshot));
+		sequence.store(published_sequence + 2, std::memory_order_release);
+	}
+
+	uint16_t metrics_server::get_port() const
+	{
+		return options.port;
+	}
+
+	void metrics_server::read_snapshot(metrics_snapshot& snapshot) const
+	{
+		while (true)
+		{
+			const uint64_t published_sequence = sequence.load(std::memory_order_acquire);
+			if (published_sequence % 2 != 0)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+			std::memcpy(&snapshot, &published_snapshot, sizeof(metrics_snapshot));
+			// the copy is only valid if the step loop did not start another publication in the meantime
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (sequence.load(std::memory_order_relaxed) == published_sequence)
+			{
+				return;
+			}
+		}
+	}
+
+	std::string metrics_server::format(const metrics_snapshot& snapshot) const
+	{
+		std::ostringstream text;
+		const auto header = [&text](const char* name, const char* type, const char* help)
+		{
+			text << "# HELP " << name << " " << help << "\n# TYPE " << name << " " << type << "\n";
+		};
+
+		header("sph_steps_total", "counter", "Simulation steps submitted.");
+		text << "sph_steps_total " << snapshot.step_count << "\n";
+		header("sph_steps_per_second", "gauge", "Steps submitted per second over about the last second.");
+		text << "sph_steps_per_second " << snapshot.steps_per_second << "\n";
+		header("sph_particles", "gauge", "Particle slots of every ensemble member.");
+		text << "sph_particles " << snapshot.particle_count << "\n";
+		header("sph_active_particles", "gauge", "Particles in use, fewer than the slots with adaptive resolution.");
+		text << "sph_active_particles " << snapshot.active_particle_count << "\n";
+		header("sph_awake_particles", "gauge", "Particles stepped in the last step, fewer than the active ones with sleeping or time bins.");
+		text << "sph_awake_particles " << snapshot.awake_particle_count << "\n";
+
+		if (snapshot.pass_times.pass_count > 0)
+		{
+			header("sph_gpu_pass_seconds", "gauge", "GPU time of every pass of the latest timed step.");
+			for (uint32_t pass = 0; pass < snapshot.pass_times.pass_count; pass++)
+			{
+				text << "sph_gpu_pass_seconds{pass=\"" << get_step_pass_name(pass) << "\"} " << 1e-9 * snapshot.pass_times.time_ns[pass] << "\n";
+			}
+		}
+
+		// nearest rank percentiles of the latest frames
+		header("sph_frame_time_seconds", "summary", "Wall time of a frame, or device time of a chunk of steps when headless.");
+		const uint32_t frame_time_count = static_cast<uint32_t>(std::min<uint64_t>(snapshot.frame_count, SPH_METRICS_FRAME_TIME_COUNT));
+		if (frame_time_count > 0)
+		{
+			std::vector<float> frame_times(snapshot.frame_time_seconds, snapshot.frame_time_seconds + frame_time_count);
+			std::sort(frame_times.begin(), frame_times.end());
+			for (double quantile : { 0.5, 0.9, 0.99, 1.0 })
+			{
+				const uint32_t rank = std::max(1u, static_cast<uint32_t>(std::ceil(quantile * frame_time_count)));
+				text << "sph_frame_time_seconds{quantile=\"" << quantile << "\"} " << frame_times[rank - 1] << "\n";
+			}
+		}
+		text << "sph_frame_time_seconds_sum " << snapshot.frame_time_sum_seconds << "\n";
+		text << "sph_frame_time_seconds_count " << snapshot.frame_count << "\n";
+
+		header("sph_device_buffer_bytes", "gauge", "Device local buffers of the simulator.");
+		text << "sph_device_buffer_bytes " << snapshot.device_buffer_size << "\n";
+		header("sph_neighbor_list_buffer_bytes", "gauge", "Neighbor list buffer, part of the device local buffers.");
+		text << "sph_neighbor_list_buffer_bytes " << snapshot.neighbor_list_buffer_size << "\n";
+		header("sph_process_resident_bytes", "gauge", "Resident memory of the process, 0 where it is not known.");
+		text << "sph_process_resident_bytes " << get_resident_memory_size() << "\n";
+
+		header("sph_neighbor_list_builds_total", "counter", "Neighbor list builds.");
+		text << "sph_neighbor_list_builds_total " << snapshot.neighbor_list_build_count << "\n";
+		header("sph_neighbor_list_overflows_total", "counter", "Particles that had more neighbors than max_neighbors, over all builds.");
+		text << "sph_neighbor_list_overflows_total " << snapshot.neighbor_list_overflow_count << "\n";
+		header("sph_max_neighbors", "gauge", "Largest neighbor count of any particle in any build.");
+		text << "sph_max_neighbors " << snapshot.max_neighbor_count << "\n";
+		header("sph_grid_rebuilds_total", "counter", "Rebuilds of the incremental hashed grid.");
+		text << "sph_grid_rebuilds_total " << snapshot.grid_rebuild_count << "\n";
+		header("sph_grid_moves_total", "counter", "Particles the integration moved to another entry of the incremental hashed grid.");
+		text << "sph_grid_moves_total " << snapshot.grid_move_count << "\n";
+		header("sph_splits_total", "counter", "Particle splits of adaptive resolution.");
+		text << "sph_splits_total " << snapshot.split_count << "\n";
+		header("sph_merges_total", "counter", "Particle merges of adaptive resolution.");
+		text << "sph_merges_total " << snapshot.merge_count << "\n";
+		return text.str();
+	}
+
+	void metrics_server::serve()
+	{
+		const socket_handle server_handle = static_cast<socket_handle>(listen_socket);
+		metrics_snapshot snapshot;
+		while (!stopping)
+		{
+			fd_set read_set;
+			FD_ZERO(&read_set);
+			FD_SET(server_handle, &read_set);
+			timeval timeout = { 0, poll_interval_ms * 1000 };
+			if (select(static_cast<int>(server_handle) + 1, &read_set, NULL, NULL, &timeout) <= 0)
+			{
+				continue;
+			}
+			const socket_handle client_handle = accept(server_handle, NULL, NULL);
+			if (client_handle == invalid_socket)
+			{
+				continue;
+			}
+
+			// one request per connection, read until the end of its header or until the client stalls
+			std::string request;
+			char buffer[1024];
+			while (request.find("\r\n\r\n") == std::string::npos && request.size() < 8192)
+			{
+				FD_ZERO(&read_set);
+				FD_SET(client_handle, &read_set);
+				timeout = { 0, poll_interval_ms * 1000 };
+				if (select(static_cast<int>(client_handle) + 1, &read_set, NULL, NULL, &timeout) <= 0)
+				{
+					break;
+				}
+				const int received = static_cast<int>(recv(client_handle, buffer, sizeof(buffer), 0));
+				if (received <= 0)
+				{
+					break;
+				}
+				request.append(buffer, received);
+			}
+
+			std::string response;
+			if (request.rfind("GET /metrics ", 0) == 0 || request.rfind("GET /metrics?", 0) == 0)
+			{
+				read_snapshot(snapshot);
+				const std::string body = format(snapshot);
+				response = "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\nContent-Length: " + std::to_string(body.size())
+					+ "\r\nConnection: close\r\n\r\n" + body;
+			}
+			else
+			{
+				response = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+			}
+			for (size_t sent = 0; sent < response.size();)
+			{
+				const int result = static_cast<int>(send(client_handle, response.data() + sent, static_cast<int>(response.size() - sent), send_flags));
+				if (result <= 0)
+				{
+					break;
+				}
+				sent += result;
+			}
+			close_socket(client_handle);
+		}
+	}
+
+} // namespace sph
@@ -0,0 +1,455 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "out_of_core_simulator.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace sph
+{
+
+	// as in the compute shaders
+	static const float smoothing_length = 4 * SPH_PARTICLE_RADIUS;
+
+	out_of_core_simulator::out_of_core_simulator()
+	{
+	}
+
+	out_of_core_simulator::~out_of_core_simulator()
+	{
+		if (context)
+		{
+			destroy_vulkan();
+		}
+	}
+
+	void out_of_core_simulator::configure(const simulation_parameters& parameters, const out_of_core_options& options)
+	{
+		if (context)
+		{
+			throw std::runtime_error("simulator must be configured before it is initialized");
+		}
+		// a tile only holds one member, and merges, splits, sleep, time bins and the history of the time integrators
+		// would need state that outlives a tile
+		if (parameters.ensemble_size != 1 || parameters.adaptive_resolution || parameters.sleeping || parameters.time_bin_count > 1
+			|| parameters.integrator != time_integrator::semi_implicit_euler)
+		{
+			throw std::runtime_error("out-of-core simulation needs a single ensemble member and semi-implicit Euler, and is not available with adaptive resolution, sleeping or time bins");
+		}
+		if (!parameters.member_parameters.empty() && parameters.member_parameters.size() != 1)
+		{
+			throw std::runtime_error("member parameters must be empty or have one entry per ensemble member");
+		}
+		if (options.tile_particle_count == 0)
+		{
+			throw std::runtime_error("tile particle count must be at least 1");
+		}
+		this->parameters = parameters;
+		this->options = options;
+		// the force on a particle needs the densities of its neighbors, which need their own neighbors, so the halo
+		// reaches two smoothing lengths beyond the tile, with the skin as a margin for rounding
+		halo_width = 2 * smoothing_length + parameters.neighbor_skin;
+		uint32_t halo_particle_count = options.halo_particle_count;
+		if (halo_particle_count == 0)
+		{
+			// a band of halo_width on both sides across the height of the domain at rest spacing, twice for compression
+			const float rest_spacing = 2 * SPH_PARTICLE_RADIUS;
+			halo_particle_count = static_cast<uint32_t>(2 * 2 * halo_width * 2 / (rest_spacing * rest_spacing));
+		}
+		tile_capacity = static_cast<uint32_t>(std::min<uint64_t>(static_cast<uint64_t>(options.tile_particle_count) + halo_particle_count, parameters.particle_count));
+		write_state(create_scene_state(parameters));
+	}
+
+	void out_of_core_simulator::initialize()
+	{
+		owned_context = std::make_unique<vulkan_context>();
+		initialize(*owned_context);
+	}
+
+	void out_of_core_simulator::initialize(vulkan_context& context)
+	{
+		if (this->context)
+		{
+			throw std::runtime_error("simulator is already initialized");
+		}
+		if (tile_capacity == 0)
+		{
+			throw std::runtime_error("simulator must be configured before it is initialized");
+		}
+		this->context = &context;
+		initialize_vulkan();
+	}
+
+	void out_of_core_simulator::initialize_vulkan()
+	{
+		VkCommandPoolCreateInfo command_pool_create_info
+		{
+			VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+			NULL,
+			0,
+			context->queue_family_index
+		};
+		if (vkCreateCommandPool(context->logical_device_handle, &command_pool_create_info, NULL, &command_pool_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("command pool creation failed");
+		}
+
+		parking_positions.resize(tile_capacity);
+		for (uint32_t i = 0; i < tile_capacity; i++)
+		{
+			// further apart than the neighbor search radius
+			parking_positions[i] = glm::vec2(4 + 0.1f * (i % 1024), 4 + 0.1f * (i / 1024));
+		}
+
+		for (tile_slot& slot : slots)
+		{
+			create_slot(slot);
+		}
+	}
+
+	void out_of_core_simulator::destroy_vulkan()
+	{
+		VkDevice logical_device_handle = context->logical_device_handle;
+		vkQueueWaitIdle(context->compute_queue_handle);
+		for (tile_slot& slot : slots)
+		{
+			vkDestroyFence(logical_device_handle, slot.fence_handle, NULL);
+			vkFreeCommandBuffers(logical_device_handle, command_pool_handle, 1, &slot.upload_command_buffer_handle);
+			vkFreeCommandBuffers(logical_device_handle, command_pool_handle, 1, &slot.download_command_buffer_handle);
+			vkDestroyBuffer(logical_device_handle, slot.upload_buffer_handle, NULL);
+			vkFreeMemory(logical_device_handle, slot.upload_memory_handle, NULL);
+			vkDestroyBuffer(logical_device_handle, slot.download_buffer_handle, NULL);
+			vkFreeMemory(logical_device_handle, slot.download_memory_handle, NULL);
+			slot.engine.reset();
+		}
+		vkDestroyCommandPool(logical_device_handle, command_pool_handle, NULL);
+	}
+
+	void out_of_core_simulator::create_slot(tile_slot& slot)
+	{
+		simulation_parameters engine_parameters = parameters;
+		engine_parameters.particle_count = tile_capacity;
+		slot.engine = std::make_unique<simulator>();
+		slot.engine->configure(engine_parameters);
+		slot.engine->initialize(*context);
+
+		// positions and velocities up, and positions, velocities, densities and pressures down, each tightly packed
+		// over the tile capacity
+		const VkDeviceSize upload_size = 2 * sizeof(glm::vec2) * tile_capacity;
+		context->create_buffer(upload_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			slot.upload_buffer_handle, slot.upload_memory_handle);
+		void* mapped_memory = NULL;
+		vkMapMemory(context->logical_device_handle, slot.upload_memory_handle, 0, upload_size, 0, &mapped_memory);
+		slot.mapped_upload_memory = static_cast<char*>(mapped_memory);
+
+		// cached memory makes the scattering on the host fast, where the device has it
+		const VkDeviceSize download_size = (2 * sizeof(glm::vec2) + 2 * sizeof(float)) * tile_capacity;
+		VkMemoryPropertyFlags memory_property_flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+		const VkPhysicalDeviceMemoryProperties& memory_properties = context->physical_device_memory_properties;
+		if (std::none_of(memory_properties.memoryTypes, memory_properties.memoryTypes + memory_properties.memoryTypeCount,
+			[memory_property_flags](const VkMemoryType& memory_type) { return (memory_type.propertyFlags & memory_property_flags) == memory_property_flags; }))
+		{
+			memory_property_flags &= ~VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+		}
+		context->create_buffer(download_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, memory_property_flags, slot.download_buffer_handle, slot.download_memory_handle);
+		vkMapMemory(context->logical_device_handle, slot.download_memory_handle, 0, download_size, 0, &mapped_memory);
+		slot.mapped_download_memory = static_cast<const char*>(mapped_memory);
+
+		VkCommandBuffer command_buffer_handles[2];
+		VkCommandBufferAllocateInfo command_buffer_allocate_info
+		{
+			VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+			NULL,
+			command_pool_handle,
+			VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+			2
+		};
+		if (vkAllocateCommandBuffers(context->logical_device_handle, &command_buffer_allocate_info, command_buffer_handles) != VK_SUCCESS)
+		{
+			throw std::runtime_error("command buffers allocation failed");
+		}
+		slot.upload_command_buffer_handle = command_buffer_handles[0];
+		slot.download_command_buffer_handle = command_buffer_handles[1];
+
+		VkFenceCreateInfo fence_create_info
+		{
+			VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+			NULL,
+			0
+		};
+		if (vkCreateFence(context->logical_device_handle, &fence_create_info, NULL, &slot.fence_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("fence creation failed");
+		}
+		record_command_buffers(slot);
+	}
+
+	void out_of_core_simulator::record_command_buffers(tile_slot& slot)
+	{
+		VkCommandBufferBeginInfo command_buffer_begin_info
+		{
+			VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			NULL,
+			0,
+			NULL
+		};
+		const VkDeviceSize vec2_size = sizeof(glm::vec2) * tile_capacity;
+		const VkDeviceSize float_size = sizeof(float) * tile_capacity;
+		const VkBuffer particle_buffer_handle = slot.engine->get_particle_buffer();
+		const VkDeviceSize position_offset = slot.engine->get_particle_field_buffer_info(particle_field::position).offset;
+		const VkDeviceSize velocity_offset = slot.engine->get_particle_field_buffer_info(particle_field::velocity).offset;
+		const VkDeviceSize density_offset = slot.engine->get_particle_field_buffer_info(particle_field::density).offset;
+		const VkDeviceSize pressure_offset = slot.engine->get_particle_field_buffer_info(particle_field::pressure).offset;
+
+		// the whole capacity every time, so that the command buffers do not depend on the tile
+		if (vkBeginCommandBuffer(slot.upload_command_buffer_handle, &command_buffer_begin_info) != VK_SUCCESS)
+		{
+			throw std::runtime_error("command buffer begin failed");
+		}
+		const VkBufferCopy upload_copy_regions[]
+		{
+			{ 0, position_offset, vec2_size },
+			{ vec2_size, velocity_offset, vec2_size }
+		};
+		vkCmdCopyBuffer(slot.upload_command_buffer_handle, slot.upload_buffer_handle, particle_buffer_handle, 2, upload_copy_regions);
+		// Barrier: the step that follows in the next submission reads and integrates the uploaded particles
+		VkMemoryBarrier transfer_to_compute_memory_barrier
+		{
+			VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			NULL,
+			VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+		};
+		vkCmdPipelineBarrier(slot.upload_command_buffer_handle, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &transfer_to_compute_memory_barrier, 0, NULL, 0, NULL);
+		if (vkEndCommandBuffer(slot.upload_command_buffer_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("command buffer end failed");
+		}
+
+		if (vkBeginCommandBuffer(slot.download_command_buffer_handle, &command_buffer_begin_info) != VK_SUCCESS)
+		{
+			throw std::runtime_error("command buffer begin failed");
+		}
+		// Barrier: the step submitted before writes the particles
+		VkMemoryBarrier compute_to_transfer_memory_barrier
+		{
+			VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			NULL,
+			VK_ACCESS_SHADER_WRITE_BIT,
+			VK_ACCESS_TRANSFER_READ_BIT
+		};
+		vkCmdPipelineBarrier(slot.download_command_buffer_handle, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &compute_to_transfer_memory_barrier, 0, NULL, 0, NULL);
+		const VkBufferCopy download_copy_regions[]
+		{
+			{ position_offset, 0, vec2_size },
+			{ velocity_offset, vec2_size, vec2_size },
+			{ density_offset, 2 * vec2_size, float_size },
+			{ pressure_offset, 2 * vec2_size + float_size, float_size }
+		};
+		vkCmdCopyBuffer(slot.download_command_buffer_handle, particle_buffer_handle, slot.download_buffer_handle, 4, download_copy_regions);
+		// Barrier: the host reads the download buffer after the fence
+		VkMemoryBarrier transfer_to_host_memory_barrier
+		{
+			VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			NULL,
+			VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_ACCESS_HOST_READ_BIT
+		};
+		vkCmdPipelineBarrier(slot.download_command_buffer_handle, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &transfer_to_host_memory_barrier, 0, NULL, 0, NULL);
+		if (vkEndCommandBuffer(slot.download_command_buffer_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("command buffer end failed");
+		}
+	}
+
+	void out_of_core_simulator::step(uint32_t step_count)
+	{
+		if (!context)
+		{
+			throw std::runtime_error("simulator must be initialized before it is stepped");
+		}
+		for (uint32_t i = 0; i < step_count; i++)
+		{
+			step_once();
+		}
+	}
+
+	void out_of_core_simulator::step_once()
+	{
+		const std::vector<glm::vec2>& position = current_state.position;
+		const uint32_t particle_count = parameters.particle_count;
+		// stable, so that equal x keep their order and deterministic runs stay deterministic
+		std::stable_sort(sorted_indices.begin(), sorted_indices.end(), [&position](uint32_t a, uint32_t b) { return position[a].x < position[b].x; });
+
+		tile_count = (particle_count + options.tile_particle_count - 1) / options.tile_particle_count;
+		for (uint32_t tile = 0; tile < tile_count; tile++)
+		{
+			tile_slot& slot = slots[tile % 2];
+			// the tile before the previous one, while the device works on the previous one
+			collect_tile(slot);
+
+			const uint32_t first_particle = tile * options.tile_particle_count;
+			const uint32_t last_particle = std::min(first_particle + options.tile_particle_count, particle_count);
+			const float min_x = position[sorted_indices[first_particle]].x - halo_width;
+			const float max_x = position[sorted_indices[last_particle - 1]].x + halo_width;
+			const uint32_t first_halo_particle = static_cast<uint32_t>(std::lower_bound(sorted_indices.begin(), sorted_indices.begin() + first_particle, min_x,
+				[&position](uint32_t a, float x) { return position[a].x < x; }) - sorted_indices.begin());
+			const uint32_t last_halo_particle = static_cast<uint32_t>(std::upper_bound(sorted_indices.begin() + last_particle, sorted_indices.end(), max_x,
+				[&position](float x, uint32_t a) { return x < position[a].x; }) - sorted_indices.begin());
+			if (last_halo_particle - first_halo_particle > tile_capacity)
+			{
+				throw std::runtime_error("a tile and its halo do not fit in the tile capacity, raise out_of_core_options::halo_particle_count");
+			}
+
+			// owned particles first, so that they are the first ones of the download, then the halo and the parked slots
+			glm::vec2* upload_position = reinterpret_cast<glm::vec2*>(slot.mapped_upload_memory);
+			glm::vec2* upload_velocity = upload_position + tile_capacity;
+			uint32_t slot_index = 0;
+			const auto upload = [&](uint32_t first, uint32_t last)
+			{
+				for (uint32_t i = first; i < last; i++, slot_index++)
+				{
+					upload_position[slot_index] = position[sorted_indices[i]];
+					upload_velocity[slot_index] = current_state.velocity[sorted_indices[i]];
+				}
+			};
+			upload(first_particle, last_particle);
+			upload(first_halo_particle, first_particle);
+			upload(last_particle, last_halo_particle);
+			std::copy(parking_positions.begin() + slot_index, parking_positions.end(), upload_position + slot_index);
+			std::fill(upload_velocity + slot_index, upload_velocity + tile_capacity, glm::vec2(0, 0));
+
+			// the previous tile of the slot is complete, so its status is not in use
+			slot.engine->invalidate_neighbor_lists();
+			VkSubmitInfo submit_info
+			{
+				VK_STRUCTURE_TYPE_SUBMIT_INFO,
+				NULL,
+				0,
+				NULL,
+				NULL,
+				1,
+				&slot.upload_command_buffer_handle,
+				0,
+				NULL
+			};
+			if (vkQueueSubmit(context->compute_queue_handle, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS)
+			{
+				throw std::runtime_error("compute queue submission failed");
+			}
+			slot.engine->step();
+			submit_info.pCommandBuffers = &slot.download_command_buffer_handle;
+			if (vkQueueSubmit(context->compute_queue_handle, 1, &submit_info, slot.fence_handle) != VK_SUCCESS)
+			{
+				throw std::runtime_error("compute queue submission failed");
+			}
+			slot.first_particle = first_particle;
+			slot.last_particle = last_particle;
+		}
+		for (tile_slot& slot : slots)
+		{
+			collect_tile(slot);
+		}
+
+		std::swap(current_state.position, next_state.position);
+		std::swap(current_state.velocity, next_state.velocity);
+		std::swap(current_state.density, next_state.density);
+		std::swap(current_state.pressure, next_state.pressure);
+		step_count++;
+	}
+
+	void out_of_core_simulator::collect_tile(tile_slot& slot)
+	{
+		if (slot.first_particle == slot.last_particle)
+		{
+			return;
+		}
+		if (vkWaitForFences(context->logical_device_handle, 1, &slot.fence_handle, VK_TRUE, UINT64_MAX) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to wait for a tile");
+		}
+		vkResetFences(context->logical_device_handle, 1, &slot.fence_handle);
+
+		const glm::vec2* download_position = reinterpret_cast<const glm::vec2*>(slot.mapped_download_memory);
+		const glm::vec2* download_velocity = download_position + tile_capacity;
+		const float* download_density = reinterpret_cast<const float*>(download_velocity + tile_capacity);
+		const float* download_pressure = download_density + tile_capacity;
+		for (uint32_t i = slot.first_particle, slot_index = 0; i < slot.last_particle; i++, slot_index++)
+		{
+			const uint32_t particle = sorted_indices[i];
+			next_state.position[particle] = download_position[slot_index];
+			next_state.velocity[particle] = download_velocity[slot_index];
+			next_state.density[particle] = download_density[slot_index];
+			next_state.pressure[particle] = download_pressure[slot_index];
+		}
+		slot.first_particle = 0;
+		slot.last_particle = 0;
+	}
+
+	void out_of_core_simulator::read_state(particle_state& state) const
+	{
+		state = current_state;
+	}
+
+	void out_of_core_simulator::write_state(const particle_state& state)
+	{
+		const uint32_t particle_count = parameters.particle_count;
+		if (state.position.size() != particle_count || state.velocity.size() != particle_count)
+		{
+			throw std::runtime_error("particle state does not match the configured particle count");
+		}
+		current_state.position = state.position;
+		current_state.velocity = state.velocity;
+		// derived by the next step
+		current_state.density.assign(particle_count, 0);
+		current_state.pressure.assign(particle_count, 0);
+		current_state.mass.assign(particle_count, SPH_PARTICLE_MASS);
+		next_state = current_state;
+		sorted_indices.resize(particle_count);
+		for (uint32_t i = 0; i < particle_count; i++)
+		{
+			sorted_indices[i] = i;
+		}
+	}
+
+	const simulation_parameters& out_of_core_simulator::get_parameters() const
+	{
+		return parameters;
+	}
+
+	uint64_t out_of_core_simulator::get_step_count() const
+	{
+		return step_count;
+	}
+
+	uint32_t out_of_core_simulator::get_tile_count() const
+	{
+		return tile_count;
+	}
+
+	uint32_t out_of_core_simulator::get_tile_capacity() const
+	{
+		return tile_capacity;
+	}
+
+} // namespace sph
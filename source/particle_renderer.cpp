@@ -0,0 +1,385 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "particle_renderer.hpp"
+
+#include <stdexcept>
+#include <vector>
+
+namespace sph
+{
+
+	particle_renderer::particle_renderer(const vulkan_context& context, VkFormat format, VkImageLayout final_layout, uint32_t width, uint32_t height)
+		: context(&context), width(width), height(height)
+	{
+		create_render_pass(format, final_layout);
+		create_pipeline_layout();
+		create_pipeline();
+	}
+
+	particle_renderer::~particle_renderer()
+	{
+		VkDevice logical_device_handle = context->logical_device_handle;
+		vkDestroyPipeline(logical_device_handle, pipeline_handle, NULL);
+		vkDestroyPipelineLayout(logical_device_handle, pipeline_layout_handle, NULL);
+		vkDestroyRenderPass(logical_device_handle, render_pass_handle, NULL);
+	}
+
+	VkRenderPass particle_renderer::get_render_pass() const
+	{
+		return render_pass_handle;
+	}
+
+	uint32_t particle_renderer::get_width() const
+	{
+		return width;
+	}
+
+	uint32_t particle_renderer::get_height() const
+	{
+		return height;
+	}
+
+	void particle_renderer::record_draw(VkCommandBuffer command_buffer_handle, VkFramebuffer framebuffer_handle, const simulator& particle_simulator) const
+	{
+		VkClearValue clear_value{ 0.92f, 0.92f, 0.92f, 1.0f };
+		VkRenderPassBeginInfo render_pass_begin_info
+		{
+			VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+			NULL,
+			render_pass_handle,
+			framebuffer_handle,
+			{
+				{ 0, 0 },
+				{ width, height }
+			},
+			1,
+			&clear_value
+		};
+		vkCmdBeginRenderPass(command_buffer_handle, &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+
+		VkViewport viewport
+		{
+			0,
+			0,
+			static_cast<float>(width),
+			static_cast<float>(height),
+			0,
+			1
+		};
+
+		VkRect2D scissor
+		{
+			{ 0, 0 },
+			{ width, height }
+		};
+
+		vkCmdSetViewport(command_buffer_handle, 0, 1, &viewport);
+		vkCmdSetScissor(command_buffer_handle, 0, 1, &scissor);
+		vkCmdBindPipeline(command_buffer_handle, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_handle);
+
+		// the positions at the start of the simulator's particle buffer are the vertices
+		VkBuffer particle_buffer_handle = particle_simulator.get_particle_buffer();
+		VkDeviceSize offsets = 0;
+		vkCmdBindVertexBuffers(command_buffer_handle, 0, 1, &particle_buffer_handle, &offsets);
+		vkCmdDraw(command_buffer_handle, particle_simulator.get_parameters().particle_count, 1, 0, 0);
+
+		vkCmdEndRenderPass(command_buffer_handle);
+	}
+
+	void particle_renderer::create_render_pass(VkFormat format, VkImageLayout final_layout)
+	{
+		VkAttachmentDescription attachment_description
+		{
+			0,
+			format,
+			VK_SAMPLE_COUNT_1_BIT,
+			VK_ATTACHMENT_LOAD_OP_CLEAR,
+			VK_ATTACHMENT_STORE_OP_STORE,
+			VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+			VK_ATTACHMENT_STORE_OP_DONT_CARE,
+			VK_IMAGE_LAYOUT_UNDEFINED,
+			final_layout
+		};
+
+		VkAttachmentReference color_attachment_reference
+		{
+			0,
+			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+		};
+
+		VkSubpassDescription subpass_description
+		{
+			0,
+			VK_PIPELINE_BIND_POINT_GRAPHICS,
+			0,
+			NULL,
+			1,
+			&color_attachment_reference,
+			NULL,
+			NULL,
+			0,
+			NULL
+		};
+
+		// the clear waits for whatever used the attachment before, the acquire of a swapchain image or the copy of the
+		// previous capture, and whatever uses it next waits for the draw
+		const VkSubpassDependency subpass_dependencies[]
+		{
+			{
+				VK_SUBPASS_EXTERNAL,
+				0,
+				VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+				0,
+				VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+				0
+			},
+			{
+				0,
+				VK_SUBPASS_EXTERNAL,
+				VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+				VK_ACCESS_TRANSFER_READ_BIT,
+				0
+			}
+		};
+
+		VkRenderPassCreateInfo render_pass_create_info
+		{
+			VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+			NULL,
+			0,
+			1,
+			&attachment_description,
+			1,
+			&subpass_description,
+			2,
+			subpass_dependencies
+		};
+		if (vkCreateRenderPass(context->logical_device_handle, &render_pass_create_info, NULL, &render_pass_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("render pass creation failed");
+		}
+	}
+
+	void particle_renderer::create_pipeline_layout()
+	{
+		VkPipelineLayoutCreateInfo pipeline_layout_create_info
+		{
+			VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+			NULL,
+			0,
+			0,
+			NULL,
+			0,
+			NULL
+		};
+		if (vkCreatePipelineLayout(context->logical_device_handle, &pipeline_layout_create_info, NULL, &pipeline_layout_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("pipeline layout creation failed");
+		}
+	}
+
+	void particle_renderer::create_pipeline()
+	{
+		std::vector<VkPipelineShaderStageCreateInfo> shader_stage_create_infos;
+
+		// create shader stage infos
+		VkShaderModule vertex_shader_module = context->create_shader_module_from_file("particle.vert.spv");
+
+		VkShaderModule fragment_shader_module = context->create_shader_module_from_file("particle.frag.spv");
+
+		VkPipelineShaderStageCreateInfo vertex_shader_stage_create_info
+		{
+			VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			NULL,
+			0,
+			VK_SHADER_STAGE_VERTEX_BIT,
+			vertex_shader_module,
+			"main",
+			NULL
+		};
+
+		VkPipelineShaderStageCreateInfo fragment_shader_stage_create_info
+		{
+			VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			NULL,
+			0,
+			VK_SHADER_STAGE_FRAGMENT_BIT,
+			fragment_shader_module,
+			"main",
+			NULL
+		};
+
+		shader_stage_create_infos.push_back(vertex_shader_stage_create_info);
+		shader_stage_create_infos.push_back(fragment_shader_stage_create_info);
+
+		VkVertexInputBindingDescription vertex_input_binding_description
+		{
+			0,
+			sizeof(glm::vec2),
+			VK_VERTEX_INPUT_RATE_VERTEX
+		};
+
+		// layout(location = 0) in vec2 position;
+		VkVertexInputAttributeDescription vertex_input_attribute_description
+		{
+			0,
+			0,
+			VK_FORMAT_R32G32_SFLOAT,
+			0
+		};
+
+		VkPipelineVertexInputStateCreateInfo vertex_input_state_create_info
+		{
+			VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+			NULL,
+			0,
+			1,
+			&vertex_input_binding_description,
+			1,
+			&vertex_input_attribute_description
+		};
+
+		VkPipelineInputAssemblyStateCreateInfo input_assembly_state_create_info
+		{
+			VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+			NULL,
+			0,
+			VK_PRIMITIVE_TOPOLOGY_POINT_LIST,
+			VK_FALSE
+		};
+
+		VkViewport viewport
+		{
+			0,
+			0,
+			static_cast<float>(width),
+			static_cast<float>(height),
+			0,
+			1
+		};
+
+		VkRect2D scissor
+		{
+			{ 0, 0 },
+			{ width, height }
+		};
+
+		VkPipelineViewportStateCreateInfo viewport_state_create_info
+		{
+			VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+			NULL,
+			0,
+			1,
+			&viewport,
+			1,
+			&scissor
+		};
+
+		VkPipelineRasterizationStateCreateInfo rasterization_state_create_info
+		{
+			VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+			NULL,
+			0,
+			VK_FALSE,
+			VK_FALSE,
+			VK_POLYGON_MODE_FILL,
+			VK_CULL_MODE_NONE,
+			VK_FRONT_FACE_COUNTER_CLOCKWISE,
+			VK_FALSE,
+			0,
+			0,
+			0,
+			1
+		};
+
+		VkPipelineMultisampleStateCreateInfo multisample_state_create_info
+		{
+			VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+			NULL,
+			0,
+			VK_SAMPLE_COUNT_1_BIT,
+			VK_FALSE,
+			0,
+			NULL,
+			VK_FALSE,
+			VK_FALSE
+		};
+
+		VkPipelineColorBlendAttachmentState color_blend_attachment
+		{
+			VK_FALSE,
+			VK_BLEND_FACTOR_ONE,
+			VK_BLEND_FACTOR_ZERO,
+			VK_BLEND_OP_ADD,
+			VK_BLEND_FACTOR_ONE,
+			VK_BLEND_FACTOR_ZERO,
+			VK_BLEND_OP_ADD,
+			VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT
+		};
+
+		VkPipelineColorBlendStateCreateInfo color_blend_state_create_info
+		{
+			VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+			NULL,
+			0,
+			VK_FALSE,
+			VK_LOGIC_OP_COPY,
+			1,
+			&color_blend_attachment,
+			{0, 0, 0, 0}
+		};
+
+		VkGraphicsPipelineCreateInfo graphics_pipeline_create_info
+		{
+			VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+			NULL,
+			0,
+			static_cast<uint32_t>(shader_stage_create_infos.size()),
+			shader_stage_create_infos.data(),
+			&vertex_input_state_create_info,
+			&input_assembly_state_create_info,
+			NULL,
+			&viewport_state_create_info,
+			&rasterization_state_create_info,
+			&multisample_state_create_info,
+			NULL,
+			&color_blend_state_create_info,
+			NULL,
+			pipeline_layout_handle,
+			render_pass_handle,
+			0,
+			VK_NULL_HANDLE,
+			-1
+		};
+		VkResult result = vkCreateGraphicsPipelines(context->logical_device_handle, context->global_pipeline_cache_handle, 1, &graphics_pipeline_create_info, NULL, &pipeline_handle);
+		vkDestroyShaderModule(context->logical_device_handle, vertex_shader_module, NULL);
+		vkDestroyShaderModule(context->logical_device_handle, fragment_shader_module, NULL);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("graphics pipeline creation failed");
+		}
+	}
+
+} // namespace sph
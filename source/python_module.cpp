@@ -0,0 +1,537 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+// CPython extension module "sph": scripts the simulator from Python without a dependency beyond the Python headers.
+// The particle fields are exported through the buffer protocol as views of the mapped readback buffer, so
+// numpy.asarray(simulator.position) is a (particle count, 2) float32 array that each read_back refreshes in place
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "simulator.hpp"
+
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <utility>
+
+namespace sph
+{
+
+	struct python_simulator
+	{
+		PyObject_HEAD
+		simulator* instance;
+		// steps run without the GIL, so calls from several Python threads take turns here
+		std::mutex* mutex;
+		// NULL until the first read_back
+		const char* mapped_readback_memory;
+	};
+
+	struct python_particle_field
+	{
+		PyObject_HEAD
+		// keeps the simulator and with it the mapping alive while arrays view the field
+		python_simulator* owner;
+		particle_field field;
+	};
+
+	static PyTypeObject python_simulator_type = { PyVarObject_HEAD_INIT(NULL, 0) };
+	static PyTypeObject python_particle_field_type = { PyVarObject_HEAD_INIT(NULL, 0) };
+
+	// run a simulator call with the GIL released, a C++ exception becomes a RuntimeError
+	template <typename function_type>
+	static bool call_without_gil(python_simulator* self, function_type&& function)
+	{
+		std::string error;
+		Py_BEGIN_ALLOW_THREADS
+		try
+		{
+			std::lock_guard<std::mutex> lock(*self->mutex);
+			function();
+		}
+		catch (const std::exception& exception)
+		{
+			error = exception.what();
+			if (error.empty())
+			{
+				error = "simulator error";
+			}
+		}
+		Py_END_ALLOW_THREADS
+		if (!error.empty())
+		{
+			PyErr_SetString(PyExc_RuntimeError, error.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	static bool is_float32_format(const char* format)
+	{
+		return format == NULL || std::strcmp(format, "f") == 0 || std::strcmp(format, "<f") == 0 || std::strcmp(format, "=f") == 0;
+	}
+
+	// a C-contiguous float32 buffer of exactly count floats into values
+	static bool copy_float_buffer(PyObject* object, const char* name, size_t count, float* values)
+	{
+		Py_buffer buffer;
+		if (PyObject_GetBuffer(object, &buffer, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) != 0)
+		{
+			return false;
+		}
+		const bool valid = is_float32_format(buffer.format) && buffer.itemsize == sizeof(float) && static_cast<size_t>(buffer.len) == count * sizeof(float);
+		if (valid)
+		{
+			std::memcpy(values, buffer.buf, count * sizeof(float));
+		}
+		else
+		{
+			PyErr_Format(PyExc_ValueError, "%s must be %zu contiguous float32 values", name, count);
+		}
+		PyBuffer_Release(&buffer);
+		return valid;
+	}
+
+	static PyObject* python_particle_field_new(python_simulator* owner, particle_field field)
+	{
+		python_particle_field* self = PyObject_New(python_particle_field, &python_particle_field_type);
+		if (self == NULL)
+		{
+			return NULL;
+		}
+		Py_INCREF(owner);
+		self->owner = owner;
+		self->field = field;
+		return reinterpret_cast<PyObject*>(self);
+	}
+
+	static void python_particle_field_dealloc(python_particle_field* self)
+	{
+		Py_DECREF(self->owner);
+		PyObject_Free(self);
+	}
+
+	static int python_particle_field_get_buffer(python_particle_field* self, Py_buffer* view, int flags)
+	{
+		if (flags & PyBUF_WRITABLE)
+		{
+			PyErr_SetString(PyExc_BufferError, "particle fields are read-only, use write_state to change the particles");
+			return -1;
+		}
+		const char* mapped_memory = self->owner->mapped_readback_memory;
+		if (mapped_memory == NULL)
+		{
+			PyErr_SetString(PyExc_BufferError, "call read_back before viewing the particle fields");
+			return -1;
+		}
+		const VkDescriptorBufferInfo field_buffer_info = self->owner->instance->get_particle_field_buffer_info(self->field);
+		const bool is_vector = self->field == particle_field::position || self->field == particle_field::velocity;
+		const uint32_t particle_count = self->owner->instance->get_total_particle_count();
+
+		// shape and strides live in the internal pointer, which the view frees through releasebuffer
+		Py_ssize_t* layout = new (std::nothrow) Py_ssize_t[4]{ particle_count, 2, 2 * sizeof(float), sizeof(float) };
+		if (layout == NULL)
+		{
+			PyErr_NoMemory();
+			return -1;
+		}
+		if (!is_vector)
+		{
+			layout[2] = sizeof(float);
+		}
+		view->obj = reinterpret_cast<PyObject*>(self);
+		Py_INCREF(self);
+		view->buf = const_cast<char*>(mapped_memory + field_buffer_info.offset);
+		view->len = static_cast<Py_ssize_t>(field_buffer_info.range);
+		view->readonly = 1;
+		view->itemsize = sizeof(float);
+		view->format = (flags & PyBUF_FORMAT) ? const_cast<char*>("f") : NULL;
+		view->ndim = is_vector ? 2 : 1;
+		view->shape = (flags & PyBUF_ND) ? layout : NULL;
+		view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? layout + 2 : NULL;
+		view->suboffsets = NULL;
+		view->internal = layout;
+		return 0;
+	}
+
+	static void python_particle_field_release_buffer(python_particle_field*, Py_buffer* view)
+	{
+		delete[] static_cast<Py_ssize_t*>(view->internal);
+	}
+
+	static PyBufferProcs python_particle_field_buffer_procs
+	{
+		reinterpret_cast<getbufferproc>(python_particle_field_get_buffer),
+		reinterpret_cast<releasebufferproc>(python_particle_field_release_buffer)
+	};
+
+	static PyObject* python_simulator_new(PyTypeObject* type, PyObject*, PyObject*)
+	{
+		python_simulator* self = reinterpret_cast<python_simulator*>(type->tp_alloc(type, 0));
+		if (self == NULL)
+		{
+			return NULL;
+		}
+		self->instance = NULL;
+		self->mutex = new (std::nothrow) std::mutex();
+		self->mapped_readback_memory = NULL;
+		if (self->mutex == NULL)
+		{
+			Py_DECREF(self);
+			return PyErr_NoMemory();
+		}
+		return reinterpret_cast<PyObject*>(self);
+	}
+
+	static int python_simulator_init(python_simulator* self, PyObject* arguments, PyObject* keyword_arguments)
+	{
+		static const char* keywords[] = { "particle_count", "scene", "ensemble_size", "deterministic", "adaptive_resolution", "sleeping", "autotune", "allow_subgroup_kernels", NULL };
+		simulation_parameters parameters;
+		unsigned int particle_count = parameters.particle_count;
+		unsigned long long scene_id = parameters.scene_id;
+		unsigned int ensemble_size = parameters.ensemble_size;
+		int deterministic = parameters.deterministic;
+		int adaptive_resolution = parameters.adaptive_resolution;
+		int sleeping = parameters.sleeping;
+		int autotune = parameters.autotune;
+		int allow_subgroup_kernels = parameters.allow_subgroup_kernels;
+		if (!PyArg_ParseTupleAndKeywords(arguments, keyword_arguments, "|IKIpppppp", const_cast<char**>(keywords), &particle_count, &scene_id, &ensemble_size,
+			&deterministic, &adaptive_resolution, &sleeping, &autotune, &allow_subgroup_kernels))
+		{
+			return -1;
+		}
+		if (self->instance)
+		{
+			PyErr_SetString(PyExc_RuntimeError, "simulator is already initialized");
+			return -1;
+		}
+		parameters.particle_count = particle_count;
+		parameters.scene_id = scene_id;
+		parameters.ensemble_size = ensemble_size;
+		parameters.deterministic = deterministic != 0;
+		parameters.adaptive_resolution = adaptive_resolution != 0;
+		parameters.sleeping = sleeping != 0;
+		parameters.autotune = autotune != 0;
+		parameters.allow_subgroup_kernels = allow_subgroup_kernels != 0;
+
+		simulator* instance = NULL;
+		const bool initialized = call_without_gil(self, [&instance, &parameters]()
+			{
+				// the headless context is owned by the simulator, the shaders are loaded from the working directory
+				std::unique_ptr<simulator> new_instance = std::make_unique<simulator>();
+				new_instance->configure(parameters);
+				new_instance->initialize();
+				instance = new_instance.release();
+			});
+		self->instance = instance;
+		return initialized ? 0 : -1;
+	}
+
+	static void python_simulator_dealloc(python_simulator* self)
+	{
+		delete self->instance;
+		delete self->mutex;
+		Py_TYPE(self)->tp_free(reinterpret_cast<PyObject*>(self));
+	}
+
+	static bool check_initialized(python_simulator* self)
+	{
+		if (self->instance == NULL)
+		{
+			PyErr_SetString(PyExc_RuntimeError, "simulator is not initialized");
+			return false;
+		}
+		return true;
+	}
+
+	static PyObject* python_simulator_step(python_simulator* self, PyObject* arguments, PyObject* keyword_arguments)
+	{
+		static const char* keywords[] = { "count", NULL };
+		unsigned int step_count = 1;
+		if (!PyArg_ParseTupleAndKeywords(arguments, keyword_arguments, "|I", const_cast<char**>(keywords), &step_count) || !check_initialized(self))
+		{
+			return NULL;
+		}
+		if (!call_without_gil(self, [self, step_count]() { self->instance->step(step_count); }))
+		{
+			return NULL;
+		}
+		Py_RETURN_NONE;
+	}
+
+	static PyObject* python_simulator_wait_idle(python_simulator* self, PyObject*)
+	{
+		if (!check_initialized(self) || !call_without_gil(self, [self]() { self->instance->wait_idle(); }))
+		{
+			return NULL;
+		}
+		Py_RETURN_NONE;
+	}
+
+	static PyObject* python_simulator_read_back(python_simulator* self, PyObject*)
+	{
+		if (!check_initialized(self))
+		{
+			return NULL;
+		}
+		const void* mapped_memory = NULL;
+		if (!call_without_gil(self, [self, &mapped_memory]() { mapped_memory = self->instance->read_back(); }))
+		{
+			return NULL;
+		}
+		self->mapped_readback_memory = static_cast<const char*>(mapped_memory);
+		Py_RETURN_NONE;
+	}
+
+	static PyObject* python_simulator_write_state(python_simulator* self, PyObject* arguments, PyObject* keyword_arguments)
+	{
+		static const char* keywords[] = { "position", "velocity", "mass", NULL };
+		PyObject* position = NULL;
+		PyObject* velocity = NULL;
+		PyObject* mass = Py_None;
+		if (!PyArg_ParseTupleAndKeywords(arguments, keyword_arguments, "OO|O", const_cast<char**>(keywords), &position, &velocity, &mass) || !check_initialized(self))
+		{
+			return NULL;
+		}
+		const size_t particle_count = self->instance->get_total_particle_count();
+		particle_state state;
+		state.position.resize(particle_count);
+		state.velocity.resize(particle_count);
+		if (!copy_float_buffer(position, "position", 2 * particle_count, &state.position[0].x)
+			|| !copy_float_buffer(velocity, "velocity", 2 * particle_count, &state.velocity[0].x))
+		{
+			return NULL;
+		}
+		if (mass != Py_None)
+		{
+			state.mass.resize(particle_count);
+			if (!copy_float_buffer(mass, "mass", particle_count, state.mass.data()))
+			{
+				return NULL;
+			}
+		}
+		if (!call_without_gil(self, [self, &state]() { self->instance->write_state(state); }))
+		{
+			return NULL;
+		}
+		Py_RETURN_NONE;
+	}
+
+	static PyObject* python_simulator_get_member_parameters(python_simulator* self, PyObject* arguments, PyObject* keyword_arguments)
+	{
+		static const char* keywords[] = { "member", NULL };
+		unsigned int member = 0;
+		if (!PyArg_ParseTupleAndKeywords(arguments, keyword_arguments, "|I", const_cast<char**>(keywords), &member) || !check_initialized(self))
+		{
+			return NULL;
+		}
+		const simulation_parameters& parameters = self->instance->get_parameters();
+		if (member >= parameters.ensemble_size)
+		{
+			PyErr_SetString(PyExc_IndexError, "ensemble member out of range");
+			return NULL;
+		}
+		const ensemble_member_parameters& member_parameters = parameters.member_parameters[member];
+		return Py_BuildValue("{s:I,s:I,s:f,s:f,s:f,s:f,s:(ff)}",
+			"first_particle", member_parameters.first_particle,
+			"particle_count", member_parameters.particle_count,
+			"stiffness", member_parameters.stiffness,
+			"resting_density", member_parameters.resting_density,
+			"viscosity", member_parameters.viscosity,
+			"wall_damping", member_parameters.wall_damping,
+			"gravity", member_parameters.gravity.x, member_parameters.gravity.y);
+	}
+
+	static PyObject* python_simulator_set_member_parameters(python_simulator* self, PyObject* arguments, PyObject* keyword_arguments)
+	{
+		static const char* keywords[] = { "member", "stiffness", "resting_density", "viscosity", "wall_damping", "gravity", NULL };
+		unsigned int member = 0;
+		PyObject* stiffness = NULL;
+		PyObject* resting_density = NULL;
+		PyObject* viscosity = NULL;
+		PyObject* wall_damping = NULL;
+		PyObject* gravity = NULL;
+		if (!PyArg_ParseTupleAndKeywords(arguments, keyword_arguments, "|I$OOOOO", const_cast<char**>(keywords), &member, &stiffness, &resting_density, &viscosity,
+			&wall_damping, &gravity) || !check_initialized(self))
+		{
+			return NULL;
+		}
+		const simulation_parameters& parameters = self->instance->get_parameters();
+		if (member >= parameters.ensemble_size)
+		{
+			PyErr_SetString(PyExc_IndexError, "ensemble member out of range");
+			return NULL;
+		}
+		// unspecified parameters keep their values
+		ensemble_member_parameters member_parameters = parameters.member_parameters[member];
+		const std::pair<PyObject*, float*> scalars[]
+		{
+			{ stiffness, &member_parameters.stiffness },
+			{ resting_density, &member_parameters.resting_density },
+			{ viscosity, &member_parameters.viscosity },
+			{ wall_damping, &member_parameters.wall_damping }
+		};
+		for (const auto& scalar : scalars)
+		{
+			if (scalar.first)
+			{
+				*scalar.second = static_cast<float>(PyFloat_AsDouble(scalar.first));
+				if (PyErr_Occurred())
+				{
+					return NULL;
+				}
+			}
+		}
+		if (gravity && !PyArg_ParseTuple(gravity, "ff", &member_parameters.gravity.x, &member_parameters.gravity.y))
+		{
+			return NULL;
+		}
+		if (!call_without_gil(self, [self, member, &member_parameters]() { self->instance->set_member_parameters(member, member_parameters); }))
+		{
+			return NULL;
+		}
+		Py_RETURN_NONE;
+	}
+
+	// getter closures of the field properties
+	static particle_field python_particle_fields[] = { particle_field::position, particle_field::velocity, particle_field::density, particle_field::pressure, particle_field::mass };
+
+	static PyObject* python_simulator_get_field(python_simulator* self, void* field)
+	{
+		if (!check_initialized(self))
+		{
+			return NULL;
+		}
+		return python_particle_field_new(self, *static_cast<const particle_field*>(field));
+	}
+
+	static PyObject* python_simulator_get_particle_count(python_simulator* self, void*)
+	{
+		return check_initialized(self) ? PyLong_FromUnsignedLong(self->instance->get_total_particle_count()) : NULL;
+	}
+
+	static PyObject* python_simulator_get_step_count(python_simulator* self, void*)
+	{
+		return check_initialized(self) ? PyLong_FromUnsignedLongLong(self->instance->get_step_count()) : NULL;
+	}
+
+	static PyObject* python_simulator_get_active_particle_count(python_simulator* self, void*)
+	{
+		return check_initialized(self) ? PyLong_FromUnsignedLong(self->instance->get_active_particle_count()) : NULL;
+	}
+
+	static PyObject* python_simulator_get_awake_particle_count(python_simulator* self, void*)
+	{
+		return check_initialized(self) ? PyLong_FromUnsignedLong(self->instance->get_awake_particle_count()) : NULL;
+	}
+
+	static PyMethodDef python_simulator_methods[]
+	{
+		{ "step", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)(void)>(python_simulator_step)), METH_VARARGS | METH_KEYWORDS,
+			"step(count=1)\n\nSubmit count steps to the device and return without waiting for them." },
+		{ "wait_idle", reinterpret_cast<PyCFunction>(python_simulator_wait_idle), METH_NOARGS,
+			"wait_idle()\n\nWait for the submitted steps." },
+		{ "read_back", reinterpret_cast<PyCFunction>(python_simulator_read_back), METH_NOARGS,
+			"read_back()\n\nWait for the submitted steps and copy the particles into the readback buffer that the field views look at." },
+		{ "write_state", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)(void)>(python_simulator_write_state)), METH_VARARGS | METH_KEYWORDS,
+			"write_state(position, velocity, mass=None)\n\nReplace the particles with float32 buffers of particle_count x 2, particle_count x 2 and particle_count values." },
+		{ "get_member_parameters", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)(void)>(python_simulator_get_member_parameters)), METH_VARARGS | METH_KEYWORDS,
+			"get_member_parameters(member=0)\n\nThe physical parameters of an ensemble member as a dict." },
+		{ "set_member_parameters", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)(void)>(python_simulator_set_member_parameters)), METH_VARARGS | METH_KEYWORDS,
+			"set_member_parameters(member=0, *, stiffness, resting_density, viscosity, wall_damping, gravity)\n\nChange the given parameters of an ensemble member for the following steps." },
+		{ NULL, NULL, 0, NULL }
+	};
+
+	static PyGetSetDef python_simulator_getset[]
+	{
+		{ "position", reinterpret_cast<getter>(python_simulator_get_field), NULL, "positions as a read-only (particle_count, 2) float32 buffer", &python_particle_fields[0] },
+		{ "velocity", reinterpret_cast<getter>(python_simulator_get_field), NULL, "velocities as a read-only (particle_count, 2) float32 buffer", &python_particle_fields[1] },
+		{ "density", reinterpret_cast<getter>(python_simulator_get_field), NULL, "densities as a read-only float32 buffer", &python_particle_fields[2] },
+		{ "pressure", reinterpret_cast<getter>(python_simulator_get_field), NULL, "pressures as a read-only float32 buffer", &python_particle_fields[3] },
+		{ "mass", reinterpret_cast<getter>(python_simulator_get_field), NULL, "masses as a read-only float32 buffer, zero for unused slots", &python_particle_fields[4] },
+		{ "particle_count", reinterpret_cast<getter>(python_simulator_get_particle_count), NULL, "particle count times ensemble size", NULL },
+		{ "step_count", reinterpret_cast<getter>(python_simulator_get_step_count), NULL, "number of submitted steps", NULL },
+		{ "active_particle_count", reinterpret_cast<getter>(python_simulator_get_active_particle_count), NULL, "particles in use with adaptive resolution", NULL },
+		{ "awake_particle_count", reinterpret_cast<getter>(python_simulator_get_awake_particle_count), NULL, "particles stepped in the last step with sleeping", NULL },
+		{ NULL, NULL, NULL, NULL, NULL }
+	};
+
+	static PyModuleDef python_module
+	{
+		PyModuleDef_HEAD_INIT,
+		"sph",
+		"2D smoothed particle hydrodynamics on Vulkan compute",
+		-1,
+		NULL,
+		NULL,
+		NULL,
+		NULL,
+		NULL
+	};
+
+} // namespace sph
+
+PyMODINIT_FUNC PyInit_sph()
+{
+	using namespace sph;
+	python_particle_field_type.tp_name = "sph.ParticleField";
+	python_particle_field_type.tp_basicsize = sizeof(python_particle_field);
+	python_particle_field_type.tp_dealloc = reinterpret_cast<destructor>(python_particle_field_dealloc);
+	python_particle_field_type.tp_as_buffer = &python_particle_field_buffer_procs;
+	python_particle_field_type.tp_flags = Py_TPFLAGS_DEFAULT;
+	python_particle_field_type.tp_doc = "read-only view of one particle field of the last read_back, for numpy.asarray or memoryview";
+	if (PyType_Ready(&python_particle_field_type) < 0)
+	{
+		return NULL;
+	}
+
+	python_simulator_type.tp_name = "sph.Simulator";
+	python_simulator_type.tp_basicsize = sizeof(python_simulator);
+	python_simulator_type.tp_new = python_simulator_new;
+	python_simulator_type.tp_init = reinterpret_cast<initproc>(python_simulator_init);
+	python_simulator_type.tp_dealloc = reinterpret_cast<destructor>(python_simulator_dealloc);
+	python_simulator_type.tp_methods = python_simulator_methods;
+	python_simulator_type.tp_getset = python_simulator_getset;
+	python_simulator_type.tp_flags = Py_TPFLAGS_DEFAULT;
+	python_simulator_type.tp_doc = "Simulator(particle_count=20000, scene=0, ensemble_size=1, deterministic=False, adaptive_resolution=False, sleeping=False, "
+		"autotune=True, allow_subgroup_kernels=True)\n\nA simulator on its own headless Vulkan context.";
+	if (PyType_Ready(&python_simulator_type) < 0)
+	{
+		return NULL;
+	}
+
+	PyObject* module = PyModule_Create(&python_module);
+	if (module == NULL)
+	{
+		return NULL;
+	}
+	Py_INCREF(&python_simulator_type);
+	if (PyModule_AddObject(module, "Simulator", reinterpret_cast<PyObject*>(&python_simulator_type)) < 0)
+	{
+		Py_DECREF(&python_simulator_type);
+		Py_DECREF(module);
+		return NULL;
+	}
+	return module;
+}
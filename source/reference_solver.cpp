@@ -0,0 +1,187 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "reference_solver.hpp"
+
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+namespace sph
+{
+
+	// mirror the constants of the compute shaders
+	static const float pi = 3.1415927410125732421875f;
+	static const float particle_mass = 0.02f;
+	static const float smoothing_length = 4 * SPH_PARTICLE_RADIUS;
+
+	reference_solver::reference_solver(const simulation_parameters& parameters)
+		: parameters(parameters)
+	{
+		if (parameters.member_parameters.size() != parameters.ensemble_size)
+		{
+			throw std::runtime_error("reference solver needs the member ranges of a configured simulator");
+		}
+		if (parameters.integrator != time_integrator::semi_implicit_euler)
+		{
+			throw std::runtime_error("reference solver only mirrors semi-implicit Euler");
+		}
+		if (parameters.kernel != smoothing_kernel::muller)
+		{
+			throw std::runtime_error("reference solver only mirrors the Muller et al. kernels");
+		}
+	}
+
+	void reference_solver::set_state(const particle_state& state)
+	{
+		const size_t total_particle_count = static_cast<size_t>(parameters.particle_count) * parameters.ensemble_size;
+		if (state.position.size() != total_particle_count || state.velocity.size() != total_particle_count)
+		{
+			throw std::runtime_error("particle state does not match the configured particle count");
+		}
+		this->state.position = state.position;
+		this->state.velocity = state.velocity;
+		this->state.density.assign(total_particle_count, 0.f);
+		this->state.pressure.assign(total_particle_count, 0.f);
+		force.assign(total_particle_count, glm::vec2(0, 0));
+	}
+
+	const particle_state& reference_solver::get_state() const
+	{
+		return state;
+	}
+
+	void reference_solver::step(uint32_t step_count)
+	{
+		for (uint32_t step = 0; step < step_count; step++)
+		{
+			compute_density_pressure();
+			compute_force();
+			integrate();
+		}
+	}
+
+	void reference_solver::compute_density_pressure()
+	{
+		for (const ensemble_member_parameters& member : parameters.member_parameters)
+		{
+			const uint32_t member_end = member.first_particle + member.particle_count;
+			for (uint32_t i = member.first_particle; i < member_end; i++)
+			{
+				// the particle itself with r = 0 comes first, like the self term of the shader
+				float density_sum = particle_mass * /* poly6 kernel */ 315.f * std::pow(smoothing_length * smoothing_length, 3.f) / (64.f * pi * std::pow(smoothing_length, 9.f));
+				for (uint32_t j = member.first_particle; j < member_end; j++)
+				{
+					if (i == j)
+					{
+						continue;
+					}
+					glm::vec2 delta = state.position[i] - state.position[j];
+					float r = glm::length(delta);
+					if (r < smoothing_length)
+					{
+						density_sum += particle_mass * /* poly6 kernel */ 315.f * std::pow(smoothing_length * smoothing_length - r * r, 3.f) / (64.f * pi * std::pow(smoothing_length, 9.f));
+					}
+				}
+				state.density[i] = density_sum;
+				// compute pressure
+				state.pressure[i] = std::max(member.stiffness * (density_sum - member.resting_density), 0.f);
+			}
+		}
+	}
+
+	void reference_solver::compute_force()
+	{
+		for (const ensemble_member_parameters& member : parameters.member_parameters)
+		{
+			const uint32_t member_end = member.first_particle + member.particle_count;
+			for (uint32_t i = member.first_particle; i < member_end; i++)
+			{
+				// compute all forces
+				glm::vec2 pressure_force(0, 0);
+				glm::vec2 viscosity_force(0, 0);
+				for (uint32_t j = member.first_particle; j < member_end; j++)
+				{
+					if (i == j)
+					{
+						continue;
+					}
+					glm::vec2 delta = state.position[i] - state.position[j];
+					float r = glm::length(delta);
+					if (r < smoothing_length)
+					{
+						pressure_force -= particle_mass * (state.pressure[i] + state.pressure[j]) / (2.f * state.density[j]) *
+							// gradient of spiky kernel
+							-45.f / (pi * std::pow(smoothing_length, 6.f)) * std::pow(smoothing_length - r, 2.f) * glm::normalize(delta);
+						viscosity_force += particle_mass * (state.velocity[j] - state.velocity[i]) / state.density[j] *
+							// Laplacian of viscosity kernel
+							45.f / (pi * std::pow(smoothing_length, 6.f)) * (smoothing_length - r);
+					}
+				}
+				viscosity_force *= member.viscosity;
+				glm::vec2 external_force = state.density[i] * member.gravity;
+
+				force[i] = pressure_force + viscosity_force + external_force;
+			}
+		}
+	}
+
+	void reference_solver::integrate()
+	{
+		for (const ensemble_member_parameters& member : parameters.member_parameters)
+		{
+			const uint32_t member_end = member.first_particle + member.particle_count;
+			for (uint32_t i = member.first_particle; i < member_end; i++)
+			{
+				// integrate
+				glm::vec2 acceleration = force[i] / state.density[i];
+				glm::vec2 new_velocity = state.velocity[i] + parameters.time_step * acceleration;
+				glm::vec2 new_position = state.position[i] + parameters.time_step * new_velocity;
+
+				// boundary conditions, only one wall per step like the shader
+				if (new_position.x < -1)
+				{
+					new_position.x = -1;
+					new_velocity.x *= -1 * member.wall_damping;
+				}
+				else if (new_position.x > 1)
+				{
+					new_position.x = 1;
+					new_velocity.x *= -1 * member.wall_damping;
+				}
+				else if (new_position.y < -1)
+				{
+					new_position.y = -1;
+					new_velocity.y *= -1 * member.wall_damping;
+				}
+				else if (new_position.y > 1)
+				{
+					new_position.y = 1;
+					new_velocity.y *= -1 * member.wall_damping;
+				}
+
+				state.velocity[i] = new_velocity;
+				state.position[i] = new_position;
+			}
+		}
+	}
+
+} // namespace sph
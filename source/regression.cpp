@@ -0,0 +1,187 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "regression.hpp"
+#include "reference_solver.hpp"
+#include "simulator.hpp"
+
+#include <cmath>
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+
+#include <iostream>
+#include <fstream>
+
+namespace sph
+{
+
+	// "SPHG"
+	static const uint32_t golden_magic = 0x47485053;
+	static const uint32_t golden_version = 1;
+
+	struct state_difference
+	{
+		float max_position_difference = 0;
+		float max_relative_velocity_difference = 0;
+	};
+
+	static bool is_finite(const glm::vec2& value)
+	{
+		return std::isfinite(value.x) && std::isfinite(value.y);
+	}
+
+	static state_difference compare_states(const particle_state& actual, const particle_state& expected)
+	{
+		float max_speed = 1e-6f;
+		for (const auto& velocity : expected.velocity)
+		{
+			if (is_finite(velocity))
+			{
+				max_speed = std::max(max_speed, glm::length(velocity));
+			}
+		}
+		state_difference difference;
+		for (size_t i = 0; i < expected.position.size(); i++)
+		{
+			// std::max ignores a NaN, so a non-finite value in either state fails both comparisons explicitly
+			if (!is_finite(actual.position[i]) || !is_finite(actual.velocity[i]) || !is_finite(expected.position[i]) || !is_finite(expected.velocity[i]))
+			{
+				difference.max_position_difference = INFINITY;
+				difference.max_relative_velocity_difference = INFINITY;
+				return difference;
+			}
+			glm::vec2 position_difference = glm::abs(actual.position[i] - expected.position[i]);
+			difference.max_position_difference = std::max({ difference.max_position_difference, position_difference.x, position_difference.y });
+			difference.max_relative_velocity_difference = std::max(difference.max_relative_velocity_difference, glm::length(actual.velocity[i] - expected.velocity[i]) / max_speed);
+		}
+		return difference;
+	}
+
+	static void write_golden(const std::string& path, uint32_t step_count, const particle_state& state)
+	{
+		// a fresh checkout has no golden directory yet
+		const std::filesystem::path parent_path = std::filesystem::path(path).parent_path();
+		if (!parent_path.empty())
+		{
+			std::filesystem::create_directories(parent_path);
+		}
+		std::ofstream file(path, std::ios::binary);
+		if (!file)
+		{
+			throw std::runtime_error("cannot write golden snapshot " + path);
+		}
+		const uint32_t header[]{ golden_magic, golden_version, static_cast<uint32_t>(state.position.size()), step_count };
+		file.write(reinterpret_cast<const char*>(header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(state.position.data()), sizeof(glm::vec2) * state.position.size());
+		file.write(reinterpret_cast<const char*>(state.velocity.data()), sizeof(glm::vec2) * state.velocity.size());
+	}
+
+	static bool read_golden(const std::string& path, uint32_t particle_count, uint32_t step_count, particle_state& state)
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file)
+		{
+			return false;
+		}
+		uint32_t header[4];
+		file.read(reinterpret_cast<char*>(header), sizeof(header));
+		if (!file || header[0] != golden_magic || header[1] != golden_version || header[2] != particle_count || header[3] != step_count)
+		{
+			throw std::runtime_error("golden snapshot " + path + " does not match the regression settings, regenerate it with -update-golden");
+		}
+		state.position.resize(particle_count);
+		state.velocity.resize(particle_count);
+		file.read(reinterpret_cast<char*>(state.position.data()), sizeof(glm::vec2) * particle_count);
+		file.read(reinterpret_cast<char*>(state.velocity.data()), sizeof(glm::vec2) * particle_count);
+		if (!file)
+		{
+			throw std::runtime_error("golden snapshot " + path + " is truncated");
+		}
+		return true;
+	}
+
+	static bool check(const char* name, const state_difference& difference, float tolerance)
+	{
+		bool passed = difference.max_position_difference <= tolerance && difference.max_relative_velocity_difference <= tolerance;
+		std::cout << (passed ? "[INFO] " : "[ERROR] ") << name << ": max position difference " << difference.max_position_difference
+			<< ", max relative velocity difference " << difference.max_relative_velocity_difference
+			<< " (tolerance " << tolerance << ")" << (passed ? "" : " FAILED") << std::endl;
+		return passed;
+	}
+
+	uint32_t run_regression(const regression_options& options)
+	{
+		// one context for every scene, so only the simulators are created per scene
+		vulkan_context context;
+		uint32_t failure_count = 0;
+		for (uint64_t scene_id = 0; scene_id < 2; scene_id++)
+		{
+			std::cout << "[INFO] regression scene " << scene_id << ": " << options.particle_count << " particles, " << options.step_count << " steps" << std::endl;
+			simulation_parameters parameters;
+			parameters.scene_id = scene_id;
+			parameters.particle_count = options.particle_count;
+			parameters.deterministic = true;
+			// the scalar kernels give the same results with any launch configuration, so skip the timing
+			parameters.autotune = false;
+
+			simulator gpu_simulator;
+			gpu_simulator.configure(parameters);
+			gpu_simulator.initialize(context);
+			particle_state initial_state;
+			gpu_simulator.read_state(initial_state);
+
+			gpu_simulator.step(options.step_count);
+			particle_state gpu_state;
+			gpu_simulator.read_state(gpu_state);
+			if (gpu_simulator.get_neighbor_list_status().overflow_count != 0)
+			{
+				std::cout << "[WARN] neighbor lists overflowed, the CPU reference keeps every neighbor" << std::endl;
+			}
+
+			// golden snapshots are device specific and not part of the repository, so a missing snapshot skips the
+			// comparison instead of failing it, -update-golden records it
+			const std::string golden_path = options.golden_directory + "/scene" + std::to_string(scene_id) + ".golden";
+			particle_state golden_state;
+			if (options.update_golden)
+			{
+				write_golden(golden_path, options.step_count, gpu_state);
+				std::cout << "[INFO] wrote " << golden_path << std::endl;
+			}
+			else if (read_golden(golden_path, options.particle_count, options.step_count, golden_state))
+			{
+				failure_count += check("GPU vs golden", compare_states(gpu_state, golden_state), options.golden_tolerance) ? 0 : 1;
+			}
+			else
+			{
+				std::cout << "[WARN] missing golden snapshot " << golden_path << ", skipped the comparison, record it with -update-golden" << std::endl;
+			}
+
+			reference_solver cpu_solver(gpu_simulator.get_parameters());
+			cpu_solver.set_state(initial_state);
+			cpu_solver.step(options.step_count);
+			failure_count += check("GPU vs CPU reference", compare_states(gpu_state, cpu_solver.get_state()), options.reference_tolerance) ? 0 : 1;
+		}
+		std::cout << (failure_count == 0 ? "[INFO] regression passed" : "[ERROR] regression failed: ") << (failure_count == 0 ? "" : std::to_string(failure_count) + " comparisons") << std::endl;
+		return failure_count;
+	}
+
+} // namespace sph
@@ -0,0 +1,191 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "render_benchmark.hpp"
+#include "particle_renderer.hpp"
+#include "splat_renderer.hpp"
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+
+namespace sph
+{
+
+	// the attachment of particle_renderer and the blit target of splat_renderer, in the format of the frame capture
+	struct benchmark_target
+	{
+		benchmark_target(const vulkan_context& context, VkRenderPass render_pass_handle, uint32_t width, uint32_t height)
+			: context(&context)
+		{
+			VkImageCreateInfo image_create_info
+			{
+				VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+				NULL,
+				0,
+				VK_IMAGE_TYPE_2D,
+				VK_FORMAT_R8G8B8A8_SRGB,
+				{ width, height, 1 },
+				1,
+				1,
+				VK_SAMPLE_COUNT_1_BIT,
+				VK_IMAGE_TILING_OPTIMAL,
+				VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+				VK_SHARING_MODE_EXCLUSIVE,
+				0,
+				NULL,
+				VK_IMAGE_LAYOUT_UNDEFINED
+			};
+			if (vkCreateImage(context.logical_device_handle, &image_create_info, NULL, &image_handle) != VK_SUCCESS)
+			{
+				throw std::runtime_error("image creation failed");
+			}
+			VkMemoryRequirements memory_requirements;
+			vkGetImageMemoryRequirements(context.logical_device_handle, image_handle, &memory_requirements);
+			VkMemoryAllocateInfo memory_allocate_info
+			{
+				VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+				NULL,
+				memory_requirements.size,
+				context.get_memory_type_index(memory_requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+			};
+			if (vkAllocateMemory(context.logical_device_handle, &memory_allocate_info, NULL, &memory_handle) != VK_SUCCESS)
+			{
+				throw std::runtime_error("image memory allocation failed");
+			}
+			vkBindImageMemory(context.logical_device_handle, image_handle, memory_handle, 0);
+
+			VkImageViewCreateInfo image_view_create_info
+			{
+				VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+				NULL,
+				0,
+				image_handle,
+				VK_IMAGE_VIEW_TYPE_2D,
+				VK_FORMAT_R8G8B8A8_SRGB,
+				{ VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY },
+				{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }
+			};
+			if (vkCreateImageView(context.logical_device_handle, &image_view_create_info, NULL, &image_view_handle) != VK_SUCCESS)
+			{
+				throw std::runtime_error("image view creation failed");
+			}
+
+			VkFramebufferCreateInfo framebuffer_create_info
+			{
+				VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+				NULL,
+				0,
+				render_pass_handle,
+				1,
+				&image_view_handle,
+				width,
+				height,
+				1
+			};
+			if (vkCreateFramebuffer(context.logical_device_handle, &framebuffer_create_info, NULL, &frame_buffer_handle) != VK_SUCCESS)
+			{
+				throw std::runtime_error("frame buffer creation failed");
+			}
+		}
+
+		benchmark_target(const benchmark_target&) = delete;
+
+		~benchmark_target()
+		{
+			vkDestroyFramebuffer(context->logical_device_handle, frame_buffer_handle, NULL);
+			vkDestroyImageView(context->logical_device_handle, image_view_handle, NULL);
+			vkDestroyImage(context->logical_device_handle, image_handle, NULL);
+			vkFreeMemory(context->logical_device_handle, memory_handle, NULL);
+		}
+
+		const vulkan_context* context = NULL;
+		VkImage image_handle = VK_NULL_HANDLE;
+		VkDeviceMemory memory_handle = VK_NULL_HANDLE;
+		VkImageView image_view_handle = VK_NULL_HANDLE;
+		VkFramebuffer frame_buffer_handle = VK_NULL_HANDLE;
+	};
+
+	// frames per second of frame_count draws in one submission, after one draw to warm up
+	static double measure_frame_rate(const vulkan_context& context, uint32_t frame_count, const std::function<void(VkCommandBuffer)>& record_draw)
+	{
+		context.execute_one_time_commands(record_draw);
+		auto start = std::chrono::high_resolution_clock::now();
+		context.execute_one_time_commands([&](VkCommandBuffer command_buffer_handle)
+		{
+			for (uint32_t frame = 0; frame < frame_count; frame++)
+			{
+				record_draw(command_buffer_handle);
+			}
+		});
+		auto end = std::chrono::high_resolution_clock::now();
+		return frame_count / (1e-9 * std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+	}
+
+	void run_render_benchmark(const simulation_parameters& parameters, const render_benchmark_options& options)
+	{
+		vulkan_context context;
+		if (!(context.queue_family_flags & VK_QUEUE_GRAPHICS_BIT))
+		{
+			throw std::runtime_error("the render benchmark needs a queue family with graphics support");
+		}
+		particle_renderer renderer(context, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, options.width, options.height);
+		benchmark_target target(context, renderer.get_render_pass(), options.width, options.height);
+
+		for (uint32_t particle_count : options.particle_counts)
+		{
+			simulation_parameters benchmark_parameters = parameters;
+			benchmark_parameters.particle_count = particle_count;
+			benchmark_parameters.ensemble_size = 1;
+			benchmark_parameters.member_parameters.clear();
+			simulator particle_simulator;
+			particle_simulator.configure(benchmark_parameters);
+			particle_simulator.initialize(context);
+
+			// a fixed seed, so that every run draws the same image
+			std::mt19937 generator(particle_count);
+			std::uniform_real_distribution<float> distribution(-1, 1);
+			particle_state state;
+			state.position.resize(particle_simulator.get_total_particle_count());
+			state.velocity.assign(particle_simulator.get_total_particle_count(), glm::vec2(0, 0));
+			for (auto& position : state.position)
+			{
+				position = glm::vec2(distribution(generator), distribution(generator));
+			}
+			particle_simulator.write_state(state);
+
+			splat_renderer splat(particle_simulator, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, options.width, options.height);
+			const double graphics_frame_rate = measure_frame_rate(context, options.frame_count, [&](VkCommandBuffer command_buffer_handle)
+			{
+				renderer.record_draw(command_buffer_handle, target.frame_buffer_handle, particle_simulator);
+			});
+			const double splat_frame_rate = measure_frame_rate(context, options.frame_count, [&](VkCommandBuffer command_buffer_handle)
+			{
+				splat.record_draw(command_buffer_handle, target.image_handle);
+			});
+			std::cout << "[INFO] " << particle_count << " particles: graphics pipeline " << graphics_frame_rate << " frames/s, compute splats "
+				<< splat_frame_rate << " frames/s, speedup " << splat_frame_rate / graphics_frame_rate << "x" << std::endl;
+		}
+	}
+
+} // namespace sph
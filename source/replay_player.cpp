@@ -0,0 +1,442 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "replay_player.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+namespace sph
+{
+
+	replay_player::replay_player(simulator& particle_simulator, const replay_player_options& options)
+		: particle_simulator(&particle_simulator), context(&particle_simulator.get_context()), options(options), reader(options.path)
+	{
+		particle_count = reader.get_particle_count();
+		if (particle_simulator.get_parameters().ensemble_size != 1 || particle_simulator.get_parameters().particle_count != particle_count)
+		{
+			throw std::runtime_error("replay needs a simulator with a single ensemble member and the " + std::to_string(particle_count) + " particles of " + options.path);
+		}
+		if (reader.get_frame_count() == 0)
+		{
+			throw std::runtime_error(options.path + " has no frames");
+		}
+		if (options.ring_size < 2)
+		{
+			// one slot is uploading while the next frame is decoded
+			throw std::runtime_error("replay needs at least two ring slots");
+		}
+		create_ring();
+		const uint32_t worker_count = options.worker_count ? options.worker_count : std::max(1u, std::thread::hardware_concurrency() / 2);
+		for (uint32_t i = 0; i < worker_count; i++)
+		{
+			// mapping the file again shares its pages, and every decoder keeps its own keyframe
+			worker_readers.push_back(std::make_unique<trajectory_reader>(options.path));
+			workers.emplace_back(&replay_player::run_worker, this, worker_readers.back().get());
+		}
+		std::cout << "[INFO] replaying " << reader.get_frame_count() << " frames of " << particle_count << " particles from " << options.path << std::endl;
+	}
+
+	replay_player::~replay_player()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+			jobs.clear();
+		}
+		job_available.notify_all();
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+
+		VkDevice logical_device_handle = context->logical_device_handle;
+		for (auto& slot : ring)
+		{
+			if (slot.state == slot_state::uploading)
+			{
+				vkWaitForFences(logical_device_handle, 1, &slot.fence_handle, VK_TRUE, UINT64_MAX);
+			}
+			vkDestroyFence(logical_device_handle, slot.fence_handle, NULL);
+			vkFreeCommandBuffers(logical_device_handle, command_pool_handle, 1, &slot.command_buffer_handle);
+			vkUnmapMemory(logical_device_handle, slot.memory_handle);
+			vkDestroyBuffer(logical_device_handle, slot.buffer_handle, NULL);
+			vkFreeMemory(logical_device_handle, slot.memory_handle, NULL);
+		}
+		vkDestroyCommandPool(logical_device_handle, command_pool_handle, NULL);
+	}
+
+	void replay_player::update(bool playing)
+	{
+		const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		const double elapsed_seconds = first_update ? 0 : std::chrono::duration<double>(now - last_update_time).count();
+		last_update_time = now;
+		first_update = false;
+		if (playing)
+		{
+			const double previous_position = position;
+			set_position(position + elapsed_seconds * options.frames_per_second);
+			last_advance = options.loop ? elapsed_seconds * options.frames_per_second : position - previous_position;
+		}
+		else
+		{
+			last_advance = 0;
+		}
+
+		// the slots whose copies are done take the next frames
+		// the stride follows the speed, so faster than real time playback decodes only the frames it shows
+		const int64_t frame_stride = std::max<int64_t>(1, std::llround(std::abs(last_advance)));
+		const uint64_t frame = static_cast<uint64_t>(position);
+		// the frame at the position, or the newest decoded one the playback has passed since the displayed frame
+		// when the decoders are behind
+		ring_slot* decoded_slot = NULL;
+		uint64_t decoded_slot_distance = get_playback_distance(displayed_frame, frame);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (auto& slot : ring)
+			{
+				if (slot.state == slot_state::uploading && vkGetFenceStatus(context->logical_device_handle, slot.fence_handle) == VK_SUCCESS)
+				{
+					slot.state = slot_state::free;
+				}
+				const uint64_t distance = get_playback_distance(slot.frame, frame);
+				if (slot.state == slot_state::ready && distance < decoded_slot_distance && distance < frame_stride * static_cast<uint64_t>(ring.size()))
+				{
+					decoded_slot = &slot;
+					decoded_slot_distance = distance;
+				}
+			}
+		}
+		if (decoded_slot)
+		{
+			if (displayed_frame != UINT64_MAX && playing && !seeked)
+			{
+				skipped_frame_count += get_playback_distance(displayed_frame, decoded_slot->frame) - 1;
+			}
+			displayed_frame = decoded_slot->frame;
+			seeked = false;
+			upload(*decoded_slot);
+		}
+
+		prefetch(frame, options.frames_per_second >= 0 ? frame_stride : -frame_stride);
+	}
+
+	uint64_t replay_player::get_playback_distance(uint64_t from_frame, uint64_t to_frame) const
+	{
+		const uint64_t frame_count = reader.get_frame_count();
+		if (from_frame >= frame_count)
+		{
+			return UINT64_MAX;
+		}
+		const bool forward = options.frames_per_second >= 0;
+		if (options.loop)
+		{
+			return forward ? (to_frame + frame_count - from_frame) % frame_count : (from_frame + frame_count - to_frame) % frame_count;
+		}
+		if (forward ? to_frame < from_frame : to_frame > from_frame)
+		{
+			return UINT64_MAX;
+		}
+		return forward ? to_frame - from_frame : from_frame - to_frame;
+	}
+
+	void replay_player::seek(double frame)
+	{
+		set_position(frame);
+		seeked = true;
+	}
+
+	void replay_player::set_position(double frame)
+	{
+		const double frame_count = static_cast<double>(reader.get_frame_count());
+		if (!std::isfinite(frame))
+		{
+			return;
+		}
+		if (options.loop)
+		{
+			position = std::fmod(frame, frame_count);
+			if (position < 0)
+			{
+				position += frame_count;
+			}
+			// fmod of a value just below zero can round up to the frame count
+			if (position >= frame_count)
+			{
+				position = 0;
+			}
+		}
+		else
+		{
+			position = std::clamp(frame, 0.0, frame_count - 1);
+		}
+	}
+
+	void replay_player::set_frames_per_second(double frames_per_second)
+	{
+		options.frames_per_second = frames_per_second;
+	}
+
+	double replay_player::get_frames_per_second() const
+	{
+		return options.frames_per_second;
+	}
+
+	uint64_t replay_player::get_frame_count() const
+	{
+		return reader.get_frame_count();
+	}
+
+	uint64_t replay_player::get_frame() const
+	{
+		return displayed_frame;
+	}
+
+	uint64_t replay_player::get_step_count() const
+	{
+		return displayed_frame == UINT64_MAX ? 0 : reader.get_step_count(displayed_frame);
+	}
+
+	uint64_t replay_player::get_skipped_frame_count() const
+	{
+		return skipped_frame_count;
+	}
+
+	void replay_player::create_ring()
+	{
+		VkCommandPoolCreateInfo command_pool_create_info
+		{
+			VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+			NULL,
+			0,
+			context->queue_family_index
+		};
+		if (vkCreateCommandPool(context->logical_device_handle, &command_pool_create_info, NULL, &command_pool_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("command pool creation failed");
+		}
+
+		const VkDeviceSize positions_size = 2 * sizeof(float) * static_cast<VkDeviceSize>(particle_count);
+		ring.resize(options.ring_size);
+		for (auto& slot : ring)
+		{
+			// written by the decoders straight into the mapping
+			context->create_buffer(positions_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				slot.buffer_handle, slot.memory_handle);
+			void* mapped_memory = NULL;
+			vkMapMemory(context->logical_device_handle, slot.memory_handle, 0, positions_size, 0, &mapped_memory);
+			slot.mapped_memory = static_cast<float*>(mapped_memory);
+
+			VkCommandBufferAllocateInfo command_buffer_allocate_info
+			{
+				VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+				NULL,
+				command_pool_handle,
+				VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+				1
+			};
+			if (vkAllocateCommandBuffers(context->logical_device_handle, &command_buffer_allocate_info, &slot.command_buffer_handle) != VK_SUCCESS)
+			{
+				throw std::runtime_error("command buffer allocation failed");
+			}
+			VkFenceCreateInfo fence_create_info
+			{
+				VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+				NULL,
+				0
+			};
+			if (vkCreateFence(context->logical_device_handle, &fence_create_info, NULL, &slot.fence_handle) != VK_SUCCESS)
+			{
+				throw std::runtime_error("fence creation failed");
+			}
+			record_command_buffer(slot);
+		}
+	}
+
+	void replay_player::record_command_buffer(const ring_slot& slot)
+	{
+		VkCommandBufferBeginInfo command_buffer_begin_info
+		{
+			VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			NULL,
+			0,
+			NULL
+		};
+		if (vkBeginCommandBuffer(slot.command_buffer_handle, &command_buffer_begin_info) != VK_SUCCESS)
+		{
+			throw std::runtime_error("command buffer begin failed");
+		}
+
+		// Barrier: the draws of the previous frames read the positions as vertices or in the splat shader
+		vkCmdPipelineBarrier(slot.command_buffer_handle, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 0, NULL);
+
+		const VkDescriptorBufferInfo position_buffer_info = particle_simulator->get_particle_field_buffer_info(particle_field::position);
+		const VkBufferCopy buffer_copy
+		{
+			0,
+			position_buffer_info.offset,
+			2 * sizeof(float) * static_cast<VkDeviceSize>(particle_count)
+		};
+		vkCmdCopyBuffer(slot.command_buffer_handle, slot.buffer_handle, particle_simulator->get_particle_buffer(), 1, &buffer_copy);
+
+		// Barrier: the next draw reads the copied positions
+		VkMemoryBarrier transfer_to_draw_memory_barrier
+		{
+			VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			NULL,
+			VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT
+		};
+		vkCmdPipelineBarrier(slot.command_buffer_handle, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+			&transfer_to_draw_memory_barrier, 0, NULL, 0, NULL);
+
+		if (vkEndCommandBuffer(slot.command_buffer_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("command buffer end failed");
+		}
+	}
+
+	void replay_player::upload(ring_slot& slot)
+	{
+		if (vkResetFences(context->logical_device_handle, 1, &slot.fence_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("fence reset failed");
+		}
+		// the queue of the draws, so the next one sees the frame without a semaphore
+		const VkSubmitInfo submit_info
+		{
+			VK_STRUCTURE_TYPE_SUBMIT_INFO,
+			NULL,
+			0,
+			NULL,
+			NULL,
+			1,
+			&slot.command_buffer_handle,
+			0,
+			NULL
+		};
+		if (vkQueueSubmit(context->graphics_queue_handle, 1, &submit_info, slot.fence_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("replay upload submission failed");
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		slot.state = slot_state::uploading;
+	}
+
+	void replay_player::prefetch(uint64_t frame, int64_t stride)
+	{
+		const int64_t frame_count = static_cast<int64_t>(reader.get_frame_count());
+		// the frames the next updates will want, nearest first, one slot is left for the upload in flight
+		std::vector<uint64_t> wanted_frames;
+		for (int64_t i = 0; wanted_frames.size() + 1 < ring.size(); i++)
+		{
+			int64_t wanted_frame = static_cast<int64_t>(frame) + i * stride;
+			if (options.loop)
+			{
+				wanted_frame = (wanted_frame % frame_count + frame_count) % frame_count;
+			}
+			else if (wanted_frame < 0 || wanted_frame >= frame_count)
+			{
+				break;
+			}
+			if (std::find(wanted_frames.begin(), wanted_frames.end(), static_cast<uint64_t>(wanted_frame)) != wanted_frames.end())
+			{
+				// the whole trajectory fits into the ring
+				break;
+			}
+			wanted_frames.push_back(static_cast<uint64_t>(wanted_frame));
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			// decoded frames the playback has passed or seeked away from make room
+			for (auto& slot : ring)
+			{
+				if ((slot.state == slot_state::ready || slot.state == slot_state::failed)
+					&& std::find(wanted_frames.begin(), wanted_frames.end(), slot.frame) == wanted_frames.end())
+				{
+					slot.state = slot_state::free;
+				}
+			}
+			for (uint64_t wanted_frame : wanted_frames)
+			{
+				const bool requested = std::any_of(ring.begin(), ring.end(), [wanted_frame](const ring_slot& slot)
+				{
+					return slot.state != slot_state::free && slot.state != slot_state::uploading && slot.frame == wanted_frame;
+				});
+				if (requested || wanted_frame == displayed_frame)
+				{
+					continue;
+				}
+				const auto free_slot = std::find_if(ring.begin(), ring.end(), [](const ring_slot& slot) { return slot.state == slot_state::free; });
+				if (free_slot == ring.end())
+				{
+					break;
+				}
+				free_slot->frame = wanted_frame;
+				free_slot->state = slot_state::decoding;
+				jobs.push_back(static_cast<uint32_t>(free_slot - ring.begin()));
+			}
+		}
+		job_available.notify_all();
+	}
+
+	void replay_player::run_worker(trajectory_reader* reader)
+	{
+		while (true)
+		{
+			uint32_t index = 0;
+			uint64_t frame = 0;
+			float* positions = NULL;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				job_available.wait(lock, [this]() { return stopping || !jobs.empty(); });
+				if (stopping)
+				{
+					return;
+				}
+				index = jobs.front();
+				jobs.pop_front();
+				frame = ring[index].frame;
+				positions = ring[index].mapped_memory;
+			}
+
+			// the slot is not touched by the player until its state changes
+			slot_state state = slot_state::ready;
+			try
+			{
+				reader->read_positions(frame, positions);
+			}
+			catch (const std::exception& exception)
+			{
+				std::cout << "[ERROR] replay: " << exception.what() << std::endl;
+				state = slot_state::failed;
+			}
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				ring[index].state = state;
+			}
+		}
+	}
+
+} // namespace sph
@@ -0,0 +1,229 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "shared_state.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace sph
+{
+
+	shared_memory_region::~shared_memory_region()
+	{
+		close();
+	}
+
+	void shared_memory_region::create(const std::string& name, size_t size)
+	{
+		close();
+#ifdef _WIN32
+		mapping_handle = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, static_cast<DWORD>(static_cast<uint64_t>(size) >> 32), static_cast<DWORD>(size), name.c_str());
+		if (mapping_handle == NULL)
+		{
+			throw std::runtime_error("failed to create shared memory " + name);
+		}
+		data = MapViewOfFile(mapping_handle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+		if (data == NULL)
+		{
+			CloseHandle(mapping_handle);
+			mapping_handle = NULL;
+			throw std::runtime_error("failed to map shared memory " + name);
+		}
+#else
+		// a region left behind by a crashed run may have another size
+		shm_unlink(name.c_str());
+		int file_descriptor = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+		if (file_descriptor < 0)
+		{
+			throw std::runtime_error("failed to create shared memory " + name);
+		}
+		if (ftruncate(file_descriptor, static_cast<off_t>(size)) != 0)
+		{
+			::close(file_descriptor);
+			shm_unlink(name.c_str());
+			throw std::runtime_error("failed to size shared memory " + name);
+		}
+		data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, file_descriptor, 0);
+		::close(file_descriptor);
+		if (data == MAP_FAILED)
+		{
+			data = NULL;
+			shm_unlink(name.c_str());
+			throw std::runtime_error("failed to map shared memory " + name);
+		}
+#endif
+		this->name = name;
+		this->size = size;
+		owner = true;
+	}
+
+	void shared_memory_region::open_read_only(const std::string& name)
+	{
+		close();
+#ifdef _WIN32
+		mapping_handle = OpenFileMappingA(FILE_MAP_READ, FALSE, name.c_str());
+		if (mapping_handle == NULL)
+		{
+			throw std::runtime_error("failed to open shared memory " + name);
+		}
+		data = MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+		MEMORY_BASIC_INFORMATION memory_information{};
+		if (data == NULL || VirtualQuery(data, &memory_information, sizeof(memory_information)) == 0)
+		{
+			close();
+			throw std::runtime_error("failed to map shared memory " + name);
+		}
+		size = memory_information.RegionSize;
+#else
+		int file_descriptor = shm_open(name.c_str(), O_RDONLY, 0);
+		if (file_descriptor < 0)
+		{
+			throw std::runtime_error("failed to open shared memory " + name);
+		}
+		struct stat file_status{};
+		if (fstat(file_descriptor, &file_status) != 0)
+		{
+			::close(file_descriptor);
+			throw std::runtime_error("failed to query shared memory " + name);
+		}
+		size = static_cast<size_t>(file_status.st_size);
+		data = mmap(NULL, size, PROT_READ, MAP_SHARED, file_descriptor, 0);
+		::close(file_descriptor);
+		if (data == MAP_FAILED)
+		{
+			data = NULL;
+			throw std::runtime_error("failed to map shared memory " + name);
+		}
+#endif
+		this->name = name;
+		owner = false;
+	}
+
+	void shared_memory_region::close()
+	{
+#ifdef _WIN32
+		if (data)
+		{
+			UnmapViewOfFile(data);
+		}
+		if (mapping_handle)
+		{
+			CloseHandle(mapping_handle);
+		}
+		mapping_handle = NULL;
+#else
+		if (data)
+		{
+			munmap(data, size);
+		}
+		// readers that still have it mapped keep their mapping
+		if (owner)
+		{
+			shm_unlink(name.c_str());
+		}
+#endif
+		data = NULL;
+		size = 0;
+		owner = false;
+	}
+
+	void* shared_memory_region::get_data() const
+	{
+		return data;
+	}
+
+	size_t shared_memory_region::get_size() const
+	{
+		return size;
+	}
+
+	shared_state_reader::shared_state_reader(const std::string& name)
+	{
+		region.open_read_only(name);
+		header = static_cast<const shared_state_header*>(region.get_data());
+		if (region.get_size() < sizeof(shared_state_header) || header->magic != SPH_SHARED_STATE_MAGIC || header->version != SPH_SHARED_STATE_VERSION
+			|| header->slot_count == 0 || header->slot_count > SPH_SHARED_STATE_MAX_SLOTS
+			|| header->first_slot_offset + header->slot_count * header->slot_size > region.get_size())
+		{
+			throw std::runtime_error("shared memory " + name + " does not hold a published simulator state");
+		}
+	}
+
+	const shared_state_header& shared_state_reader::get_header() const
+	{
+		return *header;
+	}
+
+	bool shared_state_reader::read_latest(shared_state_frame& frame) const
+	{
+		const char* base = static_cast<const char*>(region.get_data());
+		while (true)
+		{
+			const uint64_t latest_frame = header->latest_frame.load(std::memory_order_acquire);
+			if (latest_frame == 0 || latest_frame <= frame.frame)
+			{
+				return false;
+			}
+			const uint32_t slot_index = static_cast<uint32_t>((latest_frame - 1) % header->slot_count);
+			const shared_state_slot& slot = header->slots[slot_index];
+			const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+			if (sequence != 2 * latest_frame)
+			{
+				// already being overwritten by a newer frame
+				continue;
+			}
+			const uint64_t step_count = slot.step_count;
+			const char* slot_data = base + header->first_slot_offset + slot_index * header->slot_size;
+			for (uint32_t field = 0; field < SPH_SHARED_STATE_FIELD_COUNT; field++)
+			{
+				if (!(header->field_mask & (1u << field)))
+				{
+					frame.fields[field].clear();
+					continue;
+				}
+				const size_t component_count = (field < 2 ? 2 : 1) * static_cast<size_t>(header->particle_count);
+				frame.fields[field].resize(component_count);
+				std::memcpy(frame.fields[field].data(), slot_data + header->field_offsets[field], component_count * sizeof(float));
+			}
+			// the copy is only valid if the publisher did not start on the slot in the meantime
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (slot.sequence.load(std::memory_order_relaxed) == sequence)
+			{
+				frame.frame = latest_frame;
+				frame.step_count = step_count;
+				return true;
+			}
+		}
+	}
+
+} // namespace sph
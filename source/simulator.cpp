@@ -0,0 +1,1985 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "simulator.hpp"
+
+#include <cfloat>
+#include <cmath>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include <iterator>
+#include <exception>
+#include <stdexcept>
+
+#include <iostream>
+
+namespace sph
+{
+
+	// storage buffer bindings of the compute descriptor set
+	static const uint32_t compute_binding_count = 24;
+	// the only binding that is not a storage buffer
+	static const uint32_t kernel_table_binding = 20;
+	// a vec4 of kernel, derivative and Laplacian shapes per sample
+	static const uint64_t kernel_table_buffer_size = 4 * sizeof(float) * SPH_KERNEL_TABLE_SIZE;
+
+	static uint64_t align_up(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	const char* get_step_pass_name(uint32_t pass)
+	{
+		// in the order the passes are recorded
+		static const char* const pass_names[SPH_STEP_TIMESTAMP_COUNT - 1] =
+		{
+			"check neighbor list",
+			"build neighbor list",
+			"density pressure",
+			"force",
+			"integrate",
+			"update resolution"
+		};
+		if (pass >= SPH_STEP_TIMESTAMP_COUNT - 1)
+		{
+			throw std::runtime_error("step pass index out of range");
+		}
+		return pass_names[pass];
+	}
+
+	particle_state create_scene_state(const simulation_parameters& parameters)
+	{
+		// set the initial particles data, every member of the ensemble starts from the same scene
+		const uint32_t total_particle_count = parameters.particle_count * parameters.ensemble_size;
+		particle_state initial_state;
+		initial_state.position.resize(total_particle_count);
+		initial_state.velocity.assign(total_particle_count, glm::vec2(0, 0));
+
+		// test case 1: dropping a cube of water
+		if (parameters.scene_id == 0)
+		{
+			for (uint32_t i = 0, x = 0, y = 0; i < parameters.particle_count; i++)
+			{
+				initial_state.position[i].x = -0.625f + SPH_PARTICLE_RADIUS * 2 * x;
+				initial_state.position[i].y = -1 + SPH_PARTICLE_RADIUS * 2 * y;
+				x++;
+				if (x >= 125)
+				{
+					x = 0;
+					y++;
+				}
+			}
+		}
+		// test case 2: dam break
+		else
+		{
+			for (uint32_t i = 0, x = 0, y = 0; i < parameters.particle_count; i++)
+			{
+				initial_state.position[i].x = -1 + SPH_PARTICLE_RADIUS * 2 * x;
+				initial_state.position[i].y = 1 - SPH_PARTICLE_RADIUS * 2 * y;
+				x++;
+				if (x >= 100)
+				{
+					x = 0;
+					y++;
+				}
+			}
+		}
+		for (uint32_t member = 1; member < parameters.ensemble_size; member++)
+		{
+			std::copy(initial_state.position.begin(), initial_state.position.begin() + parameters.particle_count, initial_state.position.begin() + member * parameters.particle_count);
+		}
+		return initial_state;
+	}
+
+	simulator::simulator()
+	{
+	}
+
+	simulator::~simulator()
+	{
+		if (context)
+		{
+			destroy_vulkan();
+		}
+	}
+
+	void simulator::configure(const simulation_parameters& parameters)
+	{
+		if (context)
+		{
+			throw std::runtime_error("simulator must be configured before it is initialized");
+		}
+		if (parameters.ensemble_size == 0 || (!parameters.member_parameters.empty() && parameters.member_parameters.size() != parameters.ensemble_size))
+		{
+			throw std::runtime_error("member parameters must be empty or have one entry per ensemble member");
+		}
+		if (static_cast<uint64_t>(parameters.particle_count) * parameters.ensemble_size * SPH_SUBGROUP_CLUSTER_SIZE > UINT32_MAX)
+		{
+			throw std::runtime_error("too many particles in the ensemble");
+		}
+		// the unused slots are shared by the whole buffer, and where a split lands depends on the order of atomics
+		if (parameters.adaptive_resolution && (parameters.ensemble_size != 1 || parameters.deterministic))
+		{
+			throw std::runtime_error("adaptive resolution needs a single ensemble member and is not deterministic");
+		}
+		if (parameters.adaptive_resolution && parameters.resolution_interval == 0)
+		{
+			throw std::runtime_error("resolution interval must be at least 1");
+		}
+		// merged and split particles would inherit the history of the slots they land in
+		if (parameters.integrator != time_integrator::semi_implicit_euler && parameters.adaptive_resolution)
+		{
+			throw std::runtime_error("leapfrog and the predictor-corrector are not available with adaptive resolution");
+		}
+		if (!(parameters.time_step > 0))
+		{
+			throw std::runtime_error("time step must be positive");
+		}
+		// merges and splits would move and create particles behind the back of the awake list
+		if (parameters.sleeping && parameters.adaptive_resolution)
+		{
+			throw std::runtime_error("sleeping is not available with adaptive resolution");
+		}
+		if (parameters.sleeping && parameters.sleep_steps == 0)
+		{
+			throw std::runtime_error("sleep steps must be at least 1");
+		}
+		// the atomics sum in any order, and the half lists leave out the pairs that the resolution update and the
+		// wake up of sleeping particles look for
+		if (parameters.symmetric_pairs && (parameters.deterministic || parameters.adaptive_resolution || parameters.sleeping))
+		{
+			throw std::runtime_error("symmetric pairs are not available in deterministic mode, with adaptive resolution or with sleeping");
+		}
+		// the symmetric kernels scatter into both particles of a pair, a particle is not the unit of their work
+		if (parameters.persistent_threads && parameters.symmetric_pairs)
+		{
+			throw std::runtime_error("persistent threads are not available with symmetric pairs");
+		}
+		if (!(parameters.grid_fragmentation_limit >= 0 && parameters.grid_fragmentation_limit <= 16))
+		{
+			throw std::runtime_error("grid fragmentation limit must be between 0 and 16");
+		}
+		if (parameters.time_bin_count == 0 || parameters.time_bin_count > 16 || !(parameters.time_bin_courant > 0))
+		{
+			throw std::runtime_error("time bin count must be between 1 and 16 and the time bin Courant factor positive");
+		}
+		// the kick of a block is taken back in part when it ends early, which needs the single kick of semi-implicit
+		// Euler. Merges and splits have no bin, the due list replaces the awake list, and the half lists and atomic
+		// sums of symmetric pairs would add to particles that are not due
+		if (parameters.time_bin_count > 1 && (parameters.integrator != time_integrator::semi_implicit_euler || parameters.adaptive_resolution || parameters.sleeping || parameters.symmetric_pairs))
+		{
+			throw std::runtime_error("time bins need semi-implicit Euler and are not available with adaptive resolution, sleeping or symmetric pairs");
+		}
+		this->parameters = parameters;
+		// members are laid out one after another
+		if (this->parameters.member_parameters.empty())
+		{
+			this->parameters.member_parameters.resize(parameters.ensemble_size);
+		}
+		for (uint32_t member = 0; member < parameters.ensemble_size; member++)
+		{
+			this->parameters.member_parameters[member].first_particle = member * parameters.particle_count;
+			this->parameters.member_parameters[member].particle_count = parameters.particle_count;
+		}
+		total_particle_count = parameters.particle_count * parameters.ensemble_size;
+	}
+
+	void simulator::initialize()
+	{
+		owned_context = std::make_unique<vulkan_context>();
+		initialize(*owned_context);
+	}
+
+	void simulator::initialize(vulkan_context& context)
+	{
+		if (this->context)
+		{
+			throw std::runtime_error("simulator is already initialized");
+		}
+		this->context = &context;
+		initialize_vulkan();
+	}
+
+	void simulator::initialize_vulkan()
+	{
+		// the subgroup kernels shuffle within clusters of consecutive invocations, so they need shuffles, clustered
+		// reductions (and min/max for the ensemble member ranges of the build) and a subgroup size that both holds whole clusters and fits in a work group.
+		// clusters map to invocations through gl_SubgroupID, which only covers the work group without gaps when every
+		// subgroup is full, so the kernels also need full subgroups, and a work group that holds whole subgroups of the largest size
+		const VkPhysicalDeviceSubgroupProperties& subgroup_properties = context->physical_device_subgroup_properties;
+		const VkSubgroupFeatureFlags required_subgroup_operations = VK_SUBGROUP_FEATURE_BASIC_BIT | VK_SUBGROUP_FEATURE_SHUFFLE_BIT | VK_SUBGROUP_FEATURE_ARITHMETIC_BIT | VK_SUBGROUP_FEATURE_CLUSTERED_BIT;
+		use_symmetric_pairs = parameters.symmetric_pairs && context->shader_atomic_float_features.shaderBufferFloat32AtomicAdd;
+		if (parameters.symmetric_pairs && !use_symmetric_pairs)
+		{
+			std::cout << "[WARN] the device has no float atomics on storage buffers, symmetric pairs fall back to the gather kernels" << std::endl;
+		}
+		use_subgroup_kernels = parameters.allow_subgroup_kernels && !parameters.deterministic && !parameters.adaptive_resolution && !use_symmetric_pairs
+			&& (subgroup_properties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT)
+			&& (subgroup_properties.supportedOperations & required_subgroup_operations) == required_subgroup_operations
+			&& subgroup_properties.subgroupSize >= SPH_SUBGROUP_CLUSTER_SIZE
+			&& subgroup_properties.subgroupSize <= SPH_WORK_GROUP_SIZE
+			&& context->subgroup_size_control_features.computeFullSubgroups
+			&& context->physical_device_subgroup_size_control_properties.maxSubgroupSize <= SPH_WORK_GROUP_SIZE;
+		// subgroups claim the batches with the basic subgroup operations, which every device has in compute shaders
+		use_persistent_threads = parameters.persistent_threads;
+		std::cout << "[INFO] compute kernels: " << (use_symmetric_pairs ? "symmetric" : use_subgroup_kernels ? "subgroup" : "scalar") << (parameters.deterministic ? " (deterministic)" : "")
+			<< (use_persistent_threads ? ", persistent density and force" : "") << std::endl;
+
+		for (auto& configuration : launch_configurations)
+		{
+			configuration = { SPH_WORK_GROUP_SIZE, 0 };
+		}
+
+		compute_buffer_layout();
+		create_descriptor_pool();
+		create_buffers();
+
+		create_compute_descriptor_set_layout();
+		update_compute_descriptor_sets();
+		create_compute_pipeline_layout();
+		create_compute_command_pool();
+		build_kernel_table();
+
+		set_ensemble_data();
+		set_initial_particle_data();
+
+		if (parameters.autotune)
+		{
+			autotune();
+		}
+		create_compute_pipelines();
+		create_compute_command_buffer();
+	}
+
+	void simulator::destroy_vulkan()
+	{
+		VkDevice logical_device_handle = context->logical_device_handle;
+		vkDeviceWaitIdle(logical_device_handle);
+		// clean up
+		vkFreeCommandBuffers(logical_device_handle, compute_command_pool_handle, 1, &compute_command_buffer_handle);
+		if (timestamp_query_pool_handle != VK_NULL_HANDLE)
+		{
+			vkFreeCommandBuffers(logical_device_handle, compute_command_pool_handle, SPH_TRACED_STEP_SLOT_COUNT, traced_command_buffer_handles);
+			for (VkFence fence_handle : traced_step_fence_handles)
+			{
+				vkDestroyFence(logical_device_handle, fence_handle, NULL);
+			}
+			vkDestroyQueryPool(logical_device_handle, timestamp_query_pool_handle, NULL);
+		}
+		vkDestroyCommandPool(logical_device_handle, compute_command_pool_handle, NULL);
+		vkDestroyDescriptorSetLayout(logical_device_handle, compute_descriptor_set_layout_handle, NULL);
+		vkDestroyPipelineLayout(logical_device_handle, compute_pipeline_layout_handle, NULL);
+		for (const auto& handle : compute_pipeline_handles)
+		{
+			vkDestroyPipeline(logical_device_handle, handle, NULL);
+		}
+
+		vkDestroyBuffer(logical_device_handle, packed_particles_buffer_handle, NULL);
+		vkFreeMemory(logical_device_handle, packed_particles_memory_handle, NULL);
+		vkDestroyBuffer(logical_device_handle, neighbor_list_buffer_handle, NULL);
+		vkFreeMemory(logical_device_handle, neighbor_list_memory_handle, NULL);
+		vkUnmapMemory(logical_device_handle, neighbor_list_status_memory_handle);
+		vkDestroyBuffer(logical_device_handle, neighbor_list_status_buffer_handle, NULL);
+		vkFreeMemory(logical_device_handle, neighbor_list_status_memory_handle, NULL);
+		vkDestroyBuffer(logical_device_handle, ensemble_buffer_handle, NULL);
+		vkFreeMemory(logical_device_handle, ensemble_memory_handle, NULL);
+		vkUnmapMemory(logical_device_handle, adaptive_resolution_status_memory_handle);
+		vkDestroyBuffer(logical_device_handle, adaptive_resolution_status_buffer_handle, NULL);
+		vkFreeMemory(logical_device_handle, adaptive_resolution_status_memory_handle, NULL);
+		vkDestroyBuffer(logical_device_handle, resolution_work_buffer_handle, NULL);
+		vkFreeMemory(logical_device_handle, resolution_work_memory_handle, NULL);
+		vkUnmapMemory(logical_device_handle, particle_activity_status_memory_handle);
+		vkDestroyBuffer(logical_device_handle, particle_activity_status_buffer_handle, NULL);
+		vkFreeMemory(logical_device_handle, particle_activity_status_memory_handle, NULL);
+		vkDestroyBuffer(logical_device_handle, particle_activity_buffer_handle, NULL);
+		vkFreeMemory(logical_device_handle, particle_activity_memory_handle, NULL);
+		vkDestroyBuffer(logical_device_handle, integrator_state_buffer_handle, NULL);
+		vkFreeMemory(logical_device_handle, integrator_state_memory_handle, NULL);
+		vkDestroyBuffer(logical_device_handle, kernel_table_buffer_handle, NULL);
+		vkFreeMemory(logical_device_handle, kernel_table_memory_handle, NULL);
+		if (staging_buffer_handle != VK_NULL_HANDLE)
+		{
+			vkUnmapMemory(logical_device_handle, staging_memory_handle);
+			vkDestroyBuffer(logical_device_handle, staging_buffer_handle, NULL);
+			vkFreeMemory(logical_device_handle, staging_memory_handle, NULL);
+		}
+		if (readback_buffer_handle != VK_NULL_HANDLE)
+		{
+			vkUnmapMemory(logical_device_handle, readback_memory_handle);
+			vkDestroyBuffer(logical_device_handle, readback_buffer_handle, NULL);
+			vkFreeMemory(logical_device_handle, readback_memory_handle, NULL);
+		}
+
+		vkDestroyDescriptorPool(logical_device_handle, descriptor_pool_handle, NULL);
+		context = NULL;
+	}
+
+	void simulator::set_trace_recorder(trace_recorder* tracer)
+	{
+		if (context)
+		{
+			throw std::runtime_error("trace recorder must be set before the simulator is initialized");
+		}
+		this->tracer = tracer;
+	}
+
+	void simulator::set_pass_timing(uint32_t interval)
+	{
+		if (context)
+		{
+			throw std::runtime_error("pass timing must be set before the simulator is initialized");
+		}
+		pass_timing_interval = interval;
+	}
+
+	void simulator::step(uint32_t step_count)
+	{
+		if (step_count == 0)
+		{
+			return;
+		}
+		if (timestamp_query_pool_handle != VK_NULL_HANDLE && tracer)
+		{
+			step_traced(step_count);
+		}
+		else if (timestamp_query_pool_handle != VK_NULL_HANDLE)
+		{
+			step_sampled(step_count);
+		}
+		else
+		{
+			submit_steps(step_count);
+		}
+		this->step_count += step_count;
+	}
+
+	void simulator::submit_steps(uint32_t step_count)
+	{
+		// submissions of the same command buffer up to max_batch_size times each, consecutive steps are ordered by
+		// the barriers recorded at the end of the command buffer. The cap bounds the array of command buffer handles
+		// however many steps are asked for at once
+		const uint32_t max_batch_size = 256;
+		const uint32_t batch_size = std::min(step_count, max_batch_size);
+		if (step_command_buffer_handles.size() < batch_size)
+		{
+			step_command_buffer_handles.resize(batch_size, compute_command_buffer_handle);
+		}
+		compute_submit_info.pCommandBuffers = step_command_buffer_handles.data();
+		for (uint32_t submitted = 0; submitted < step_count; submitted += batch_size)
+		{
+			compute_submit_info.commandBufferCount = std::min(batch_size, step_count - submitted);
+			if (vkQueueSubmit(context->compute_queue_handle, 1, &compute_submit_info, VK_NULL_HANDLE) != VK_SUCCESS)
+			{
+				throw std::runtime_error("compute queue submission failed");
+			}
+		}
+	}
+
+	void simulator::step_traced(uint32_t step_count)
+	{
+		// one submission per step, with the traced command buffers in turn. A command buffer is submitted again only
+		// after the timestamps of its previous submission have been read, which keeps at most
+		// SPH_TRACED_STEP_SLOT_COUNT steps in flight and makes tracing slower than untraced stepping
+		compute_submit_info.commandBufferCount = 1;
+		for (uint32_t i = 0; i < step_count; i++)
+		{
+			const uint32_t index = next_traced_command_buffer;
+			collect_step_timestamps(index, true);
+			compute_submit_info.pCommandBuffers = &traced_command_buffer_handles[index];
+			if (vkQueueSubmit(context->compute_queue_handle, 1, &compute_submit_info, traced_step_fence_handles[index]) != VK_SUCCESS)
+			{
+				throw std::runtime_error("compute queue submission failed");
+			}
+			traced_step_pending[index] = true;
+			traced_step_numbers[index] = this->step_count + i + 1;
+			next_traced_command_buffer = (index + 1) % SPH_TRACED_STEP_SLOT_COUNT;
+		}
+	}
+
+	void simulator::step_sampled(uint32_t step_count)
+	{
+		// the untraced command buffer up to the next step to time, then that step with the oldest traced command
+		// buffer when its timestamps have been read. Otherwise the step is not timed rather than waited for
+		uint32_t submitted = 0;
+		while (submitted < step_count)
+		{
+			const uint64_t next_step_number = this->step_count + submitted + 1;
+			const uint32_t untimed_count = std::min(static_cast<uint32_t>((pass_timing_interval - next_step_number % pass_timing_interval) % pass_timing_interval),
+				step_count - submitted);
+			if (untimed_count > 0)
+			{
+				submit_steps(untimed_count);
+				submitted += untimed_count;
+				continue;
+			}
+
+			collect_available_step_timestamps(false);
+			const uint32_t index = next_traced_command_buffer;
+			if (traced_step_pending[index])
+			{
+				submit_steps(1);
+			}
+			else
+			{
+				compute_submit_info.commandBufferCount = 1;
+				compute_submit_info.pCommandBuffers = &traced_command_buffer_handles[index];
+				if (vkQueueSubmit(context->compute_queue_handle, 1, &compute_submit_info, traced_step_fence_handles[index]) != VK_SUCCESS)
+				{
+					throw std::runtime_error("compute queue submission failed");
+				}
+				traced_step_pending[index] = true;
+				traced_step_numbers[index] = next_step_number;
+				next_traced_command_buffer = (index + 1) % SPH_TRACED_STEP_SLOT_COUNT;
+			}
+			submitted++;
+		}
+	}
+
+	bool simulator::collect_step_timestamps(uint32_t index, bool wait)
+	{
+		if (!traced_step_pending[index])
+		{
+			return true;
+		}
+		// the fence of a complete step is signaled, so the query that follows returns at once
+		VkFence& fence_handle = traced_step_fence_handles[index];
+		const VkResult fence_status = wait ? vkWaitForFences(context->logical_device_handle, 1, &fence_handle, VK_TRUE, UINT64_MAX)
+			: vkGetFenceStatus(context->logical_device_handle, fence_handle);
+		if (fence_status == VK_NOT_READY)
+		{
+			return false;
+		}
+		if (fence_status != VK_SUCCESS || vkResetFences(context->logical_device_handle, 1, &fence_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to wait for a traced step");
+		}
+		uint64_t timestamps[SPH_STEP_TIMESTAMP_COUNT];
+		if (vkGetQueryPoolResults(context->logical_device_handle, timestamp_query_pool_handle, index * SPH_STEP_TIMESTAMP_COUNT, SPH_STEP_TIMESTAMP_COUNT,
+			sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to get timestamp query results");
+		}
+		traced_step_pending[index] = false;
+
+		const uint32_t valid_bits = context->queue_family_timestamp_valid_bits;
+		const uint64_t mask = valid_bits >= 64 ? ~0ull : (1ull << valid_bits) - 1;
+		const double timestamp_period = context->physical_device_properties.limits.timestampPeriod;
+		const uint32_t pass_count = parameters.adaptive_resolution ? SPH_STEP_TIMESTAMP_COUNT - 1 : SPH_STEP_TIMESTAMP_COUNT - 2;
+		last_step_pass_times.pass_count = pass_count;
+		for (uint32_t pass = 0; pass < pass_count; pass++)
+		{
+			last_step_pass_times.time_ns[pass] = static_cast<double>((timestamps[pass + 1] - timestamps[pass]) & mask) * timestamp_period;
+			if (tracer)
+			{
+				tracer->add_gpu_event(get_step_pass_name(pass), timestamps[pass], timestamps[pass + 1]);
+			}
+		}
+		// the steps are read in the order they were submitted
+		const uint64_t previous_step = last_step_pass_times.step;
+		last_step_pass_times.step_period_ns = previous_step != 0 && traced_step_numbers[index] > previous_step
+			? static_cast<double>((timestamps[0] - last_traced_step_start) & mask) * timestamp_period / static_cast<double>(traced_step_numbers[index] - previous_step) : 0;
+		last_step_pass_times.step = traced_step_numbers[index];
+		last_traced_step_start = timestamps[0];
+		return true;
+	}
+
+	void simulator::collect_available_step_timestamps(bool wait)
+	{
+		// submissions complete in order, so a step that is not complete holds up the later ones
+		for (uint32_t i = 0; i < SPH_TRACED_STEP_SLOT_COUNT; i++)
+		{
+			if (!collect_step_timestamps((next_traced_command_buffer + i) % SPH_TRACED_STEP_SLOT_COUNT, wait))
+			{
+				return;
+			}
+		}
+	}
+
+	void simulator::wait_idle()
+	{
+		if (vkQueueWaitIdle(context->compute_queue_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("vkQueueWaitIdle failed");
+		}
+		if (timestamp_query_pool_handle != VK_NULL_HANDLE)
+		{
+			collect_available_step_timestamps(true);
+		}
+	}
+
+	void simulator::read_state(particle_state& state)
+	{
+		const char* mapped_memory = static_cast<const char*>(read_back());
+		state.position.resize(total_particle_count);
+		state.velocity.resize(total_particle_count);
+		state.density.resize(total_particle_count);
+		state.pressure.resize(total_particle_count);
+		state.mass.resize(total_particle_count);
+		std::memcpy(state.position.data(), mapped_memory + position_ssbo_offset, position_ssbo_size);
+		std::memcpy(state.velocity.data(), mapped_memory + velocity_ssbo_offset, velocity_ssbo_size);
+		std::memcpy(state.density.data(), mapped_memory + density_ssbo_offset, density_ssbo_size);
+		std::memcpy(state.pressure.data(), mapped_memory + pressure_ssbo_offset, pressure_ssbo_size);
+		std::memcpy(state.mass.data(), mapped_memory + mass_ssbo_offset, mass_ssbo_size);
+	}
+
+	void simulator::write_state(const particle_state& state)
+	{
+		if (state.position.size() != total_particle_count || state.velocity.size() != total_particle_count
+			|| (!state.mass.empty() && state.mass.size() != total_particle_count))
+		{
+			throw std::runtime_error("particle state does not match the configured particle count");
+		}
+		create_staging_buffer();
+		wait_idle();
+
+		const std::vector<float> mass = state.mass.empty() ? std::vector<float>(total_particle_count, SPH_PARTICLE_MASS) : state.mass;
+		char* mapped_memory = static_cast<char*>(mapped_staging_memory);
+		std::memcpy(mapped_memory + position_ssbo_offset, state.position.data(), position_ssbo_size);
+		std::memcpy(mapped_memory + velocity_ssbo_offset, state.velocity.data(), velocity_ssbo_size);
+		std::memcpy(mapped_memory + mass_ssbo_offset, mass.data(), mass_ssbo_size);
+		context->execute_one_time_commands(
+			[this](VkCommandBuffer command_buffer_handle)
+			{
+				const VkBufferCopy buffer_copy_regions[]
+				{
+					{
+						position_ssbo_offset,
+						position_ssbo_offset,
+						position_ssbo_size
+					},
+					{
+						velocity_ssbo_offset,
+						velocity_ssbo_offset,
+						velocity_ssbo_size
+					},
+					{
+						mass_ssbo_offset,
+						mass_ssbo_offset,
+						mass_ssbo_size
+					}
+				};
+				vkCmdCopyBuffer(command_buffer_handle, staging_buffer_handle, packed_particles_buffer_handle, 3, buffer_copy_regions);
+				// the history of the time integrator belongs to the old particles
+				vkCmdFillBuffer(command_buffer_handle, integrator_state_buffer_handle, 0, integrator_state_buffer_size, 0);
+			}
+		);
+		// the particles may have moved arbitrarily far
+		invalidate_neighbor_lists();
+		reset_adaptive_resolution_status(mass);
+		reset_particle_activity();
+	}
+
+	const void* simulator::read_back()
+	{
+		create_readback_buffer();
+		wait_idle();
+		context->execute_one_time_commands(
+			[this](VkCommandBuffer command_buffer_handle)
+			{
+				VkBufferCopy buffer_copy_region
+				{
+					0,
+					0,
+					packed_buffer_size
+				};
+				vkCmdCopyBuffer(command_buffer_handle, packed_particles_buffer_handle, readback_buffer_handle, 1, &buffer_copy_region);
+			}
+		);
+		return mapped_readback_memory;
+	}
+
+	void simulator::set_member_parameters(uint32_t member, const ensemble_member_parameters& member_parameters)
+	{
+		if (member >= parameters.ensemble_size)
+		{
+			throw std::runtime_error("ensemble member out of range");
+		}
+		ensemble_member_parameters& stored_parameters = parameters.member_parameters[member];
+		const uint32_t first_particle = stored_parameters.first_particle;
+		const uint32_t particle_count = stored_parameters.particle_count;
+		stored_parameters = member_parameters;
+		stored_parameters.first_particle = first_particle;
+		stored_parameters.particle_count = particle_count;
+		// the submitted steps keep the old parameters
+		wait_idle();
+		context->execute_one_time_commands(
+			[this, member](VkCommandBuffer command_buffer_handle)
+			{
+				vkCmdUpdateBuffer(command_buffer_handle, ensemble_buffer_handle, member_parameters_ssbo_offset + member * sizeof(ensemble_member_parameters),
+					sizeof(ensemble_member_parameters), &parameters.member_parameters[member]);
+			}
+		);
+	}
+
+	void simulator::invalidate_neighbor_lists()
+	{
+		mapped_neighbor_list_status->steps_since_build = parameters.neighbor_list_max_age;
+		mapped_neighbor_list_status->grid_rebuild_requested = 1;
+	}
+
+	const simulation_parameters& simulator::get_parameters() const
+	{
+		return parameters;
+	}
+
+	uint32_t simulator::get_total_particle_count() const
+	{
+		return total_particle_count;
+	}
+
+	vulkan_context& simulator::get_context() const
+	{
+		return *context;
+	}
+
+	uint64_t simulator::get_step_count() const
+	{
+		return step_count;
+	}
+
+	bool simulator::is_using_subgroup_kernels() const
+	{
+		return use_subgroup_kernels;
+	}
+
+	bool simulator::is_using_symmetric_pairs() const
+	{
+		return use_symmetric_pairs;
+	}
+
+	bool simulator::is_using_persistent_threads() const
+	{
+		return use_persistent_threads;
+	}
+
+	VkBuffer simulator::get_particle_buffer() const
+	{
+		return packed_particles_buffer_handle;
+	}
+
+	VkDescriptorBufferInfo simulator::get_particle_field_buffer_info(particle_field field) const
+	{
+		switch (field)
+		{
+		case particle_field::position:
+			return { packed_particles_buffer_handle, position_ssbo_offset, position_ssbo_size };
+		case particle_field::velocity:
+			return { packed_particles_buffer_handle, velocity_ssbo_offset, velocity_ssbo_size };
+		case particle_field::density:
+			return { packed_particles_buffer_handle, density_ssbo_offset, density_ssbo_size };
+		case particle_field::pressure:
+			return { packed_particles_buffer_handle, pressure_ssbo_offset, pressure_ssbo_size };
+		case particle_field::mass:
+			return { packed_particles_buffer_handle, mass_ssbo_offset, mass_ssbo_size };
+		}
+		throw std::runtime_error("unknown particle field");
+	}
+
+	const neighbor_list_status& simulator::get_neighbor_list_status() const
+	{
+		return *mapped_neighbor_list_status;
+	}
+
+	const adaptive_resolution_status& simulator::get_adaptive_resolution_status() const
+	{
+		return *mapped_adaptive_resolution_status;
+	}
+
+	uint32_t simulator::get_active_particle_count() const
+	{
+		return total_particle_count - mapped_adaptive_resolution_status->free_slot_count;
+	}
+
+	const particle_activity_status& simulator::get_particle_activity_status() const
+	{
+		return *mapped_particle_activity_status;
+	}
+
+	uint32_t simulator::get_awake_particle_count() const
+	{
+		return use_awake_list ? mapped_particle_activity_status->last_awake_count : get_active_particle_count();
+	}
+
+	VkDeviceSize simulator::get_neighbor_list_buffer_size() const
+	{
+		return neighbor_buffer_size;
+	}
+
+	VkDeviceSize simulator::get_device_buffer_size() const
+	{
+		return packed_buffer_size + neighbor_buffer_size + ensemble_buffer_size + resolution_work_buffer_size + particle_activity_buffer_size
+			+ integrator_state_buffer_size + kernel_table_buffer_size;
+	}
+
+	const step_pass_times& simulator::get_last_step_pass_times() const
+	{
+		return last_step_pass_times;
+	}
+
+	void simulator::compute_buffer_layout()
+	{
+		const uint64_t alignment = context->physical_device_properties.limits.minStorageBufferOffsetAlignment;
+		const uint64_t particle_count = total_particle_count;
+
+		// ssbo sizes
+		position_ssbo_size = sizeof(glm::vec2) * particle_count;
+		velocity_ssbo_size = sizeof(glm::vec2) * particle_count;
+		force_ssbo_size = sizeof(glm::vec2) * particle_count;
+		density_ssbo_size = sizeof(float) * particle_count;
+		pressure_ssbo_size = sizeof(float) * particle_count;
+		mass_ssbo_size = sizeof(float) * particle_count;
+		// ssbo offsets
+		position_ssbo_offset = 0;
+		velocity_ssbo_offset = align_up(position_ssbo_offset + position_ssbo_size, alignment);
+		force_ssbo_offset = align_up(velocity_ssbo_offset + velocity_ssbo_size, alignment);
+		density_ssbo_offset = align_up(force_ssbo_offset + force_ssbo_size, alignment);
+		pressure_ssbo_offset = align_up(density_ssbo_offset + density_ssbo_size, alignment);
+		mass_ssbo_offset = align_up(pressure_ssbo_offset + pressure_ssbo_size, alignment);
+		packed_buffer_size = mass_ssbo_offset + mass_ssbo_size;
+
+		// neighbor list ssbo sizes
+		neighbor_list_ssbo_size = sizeof(uint32_t) * parameters.max_neighbors * particle_count;
+		neighbor_reference_position_ssbo_size = sizeof(glm::vec2) * particle_count;
+		neighbor_count_ssbo_size = sizeof(uint32_t) * particle_count;
+		// neighbor list ssbo offsets
+		neighbor_list_ssbo_offset = 0;
+		neighbor_reference_position_ssbo_offset = align_up(neighbor_list_ssbo_offset + neighbor_list_ssbo_size, alignment);
+		neighbor_count_ssbo_offset = align_up(neighbor_reference_position_ssbo_offset + neighbor_reference_position_ssbo_size, alignment);
+		// the hashed grid lives with the lists it builds, the load factor stays below one half
+		hash_table_size = 1;
+		while (parameters.hashed_grid && hash_table_size < 2 * particle_count)
+		{
+			hash_table_size *= 2;
+		}
+		// merges and splits move particles without the integration, so adaptive resolution rebuilds the grid
+		use_incremental_grid = parameters.hashed_grid && !parameters.adaptive_resolution && parameters.grid_fragmentation_limit > 0;
+		grid_node_count = parameters.hashed_grid ? particle_count : 1;
+		if (use_incremental_grid)
+		{
+			grid_node_count += static_cast<uint32_t>(std::ceil(parameters.grid_fragmentation_limit * particle_count));
+		}
+		grid_cell_head_ssbo_size = sizeof(uint32_t) * hash_table_size;
+		grid_node_ssbo_size = 2 * sizeof(uint32_t) * grid_node_count;
+		grid_particle_ssbo_size = 2 * sizeof(uint32_t) * (use_incremental_grid ? particle_count : 1);
+		grid_cell_head_ssbo_offset = align_up(neighbor_count_ssbo_offset + neighbor_count_ssbo_size, alignment);
+		grid_node_ssbo_offset = align_up(grid_cell_head_ssbo_offset + grid_cell_head_ssbo_size, alignment);
+		grid_particle_ssbo_offset = align_up(grid_node_ssbo_offset + grid_node_ssbo_size, alignment);
+		neighbor_buffer_size = grid_particle_ssbo_offset + grid_particle_ssbo_size;
+
+		// ensemble ssbo sizes
+		member_index_ssbo_size = sizeof(uint32_t) * particle_count;
+		member_parameters_ssbo_size = sizeof(ensemble_member_parameters) * parameters.ensemble_size;
+		// ensemble ssbo offsets
+		member_index_ssbo_offset = 0;
+		member_parameters_ssbo_offset = align_up(member_index_ssbo_offset + member_index_ssbo_size, alignment);
+		ensemble_buffer_size = member_parameters_ssbo_offset + member_parameters_ssbo_size;
+
+		// adaptive resolution sizes
+		const uint64_t resolution_slot_count = parameters.adaptive_resolution ? particle_count : 1;
+		adaptive_resolution_status_buffer_size = sizeof(adaptive_resolution_status) + sizeof(uint32_t) * resolution_slot_count;
+		resolution_work_buffer_size = 2 * sizeof(uint32_t) * resolution_slot_count;
+
+		// particle activity ssbo sizes, the time bins hold the bin, the next bin, the limit and the aligned bin count
+		use_awake_list = parameters.sleeping || parameters.time_bin_count > 1;
+		particle_activity_ssbo_size = 2 * sizeof(uint32_t) * (parameters.sleeping ? particle_count : 1);
+		awake_list_ssbo_size = sizeof(uint32_t) * (use_awake_list ? particle_count : 1);
+		time_bin_ssbo_size = 4 * sizeof(uint32_t) * (parameters.time_bin_count > 1 ? particle_count : 1);
+		// particle activity ssbo offsets
+		particle_activity_ssbo_offset = 0;
+		awake_list_ssbo_offset = align_up(particle_activity_ssbo_offset + particle_activity_ssbo_size, alignment);
+		time_bin_ssbo_offset = align_up(awake_list_ssbo_offset + awake_list_ssbo_size, alignment);
+		particle_activity_buffer_size = time_bin_ssbo_offset + time_bin_ssbo_size;
+
+		// integrator state size, velocity, two accelerations and a flag padded to 32 bytes per particle
+		const uint64_t integrator_slot_count = parameters.integrator != time_integrator::semi_implicit_euler ? particle_count : 1;
+		integrator_state_buffer_size = 8 * sizeof(float) * integrator_slot_count;
+	}
+
+	void simulator::create_descriptor_pool()
+	{
+		const VkDescriptorPoolSize descriptor_pool_sizes[]
+		{
+			{
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				compute_binding_count - 1
+			},
+			{
+				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+				1
+			}
+		};
+
+		VkDescriptorPoolCreateInfo descriptor_pool_create_info
+		{
+			VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+			NULL,
+			0,
+			1,
+			2,
+			descriptor_pool_sizes
+		};
+		if (vkCreateDescriptorPool(context->logical_device_handle, &descriptor_pool_create_info, NULL, &descriptor_pool_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("descriptor pool creation failed");
+		}
+	}
+
+	void simulator::create_buffers()
+	{
+		// the renderer binds the positions as a vertex buffer, read_state and write_state copy from and to it
+		context->create_buffer(packed_buffer_size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, packed_particles_buffer_handle, packed_particles_memory_handle);
+
+		// neighbor lists are only touched by the compute shaders, the hash table is cleared with a fill every step
+		context->create_buffer(neighbor_buffer_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			neighbor_list_buffer_handle, neighbor_list_memory_handle);
+
+		context->create_buffer(sizeof(neighbor_list_status), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, neighbor_list_status_buffer_handle, neighbor_list_status_memory_handle);
+		vkMapMemory(context->logical_device_handle, neighbor_list_status_memory_handle, 0, sizeof(neighbor_list_status), 0, reinterpret_cast<void**>(&mapped_neighbor_list_status));
+		reset_neighbor_list_status();
+
+		context->create_buffer(ensemble_buffer_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, ensemble_buffer_handle, ensemble_memory_handle);
+
+		context->create_buffer(adaptive_resolution_status_buffer_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, adaptive_resolution_status_buffer_handle, adaptive_resolution_status_memory_handle);
+		vkMapMemory(context->logical_device_handle, adaptive_resolution_status_memory_handle, 0, adaptive_resolution_status_buffer_size, 0, reinterpret_cast<void**>(&mapped_adaptive_resolution_status));
+		std::memset(mapped_adaptive_resolution_status, 0, adaptive_resolution_status_buffer_size);
+		mapped_adaptive_resolution_status->update_dispatch = { 0, 1, 1 };
+		context->create_buffer(resolution_work_buffer_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, resolution_work_buffer_handle, resolution_work_memory_handle);
+
+		// the step copies the awake count of the last step within the status buffer before resetting it
+		context->create_buffer(sizeof(particle_activity_status), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, particle_activity_status_buffer_handle, particle_activity_status_memory_handle);
+		vkMapMemory(context->logical_device_handle, particle_activity_status_memory_handle, 0, sizeof(particle_activity_status), 0, reinterpret_cast<void**>(&mapped_particle_activity_status));
+		std::memset(mapped_particle_activity_status, 0, sizeof(particle_activity_status));
+		// write_state fills the awake list from the staging buffer
+		context->create_buffer(particle_activity_buffer_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			particle_activity_buffer_handle, particle_activity_memory_handle);
+		// write_state zeroes it, so the particles start without history
+		context->create_buffer(integrator_state_buffer_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			integrator_state_buffer_handle, integrator_state_memory_handle);
+		context->create_buffer(kernel_table_buffer_size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			kernel_table_buffer_handle, kernel_table_memory_handle);
+	}
+
+	void simulator::reset_neighbor_list_status()
+	{
+		std::memset(mapped_neighbor_list_status, 0, sizeof(neighbor_list_status));
+		mapped_neighbor_list_status->build_dispatch = { 0, 1, 1 };
+		mapped_neighbor_list_status->steps_since_build = parameters.neighbor_list_max_age;
+		mapped_neighbor_list_status->grid_clear_dispatch = { 0, 1, 1 };
+		mapped_neighbor_list_status->grid_insert_dispatch = { 0, 1, 1 };
+		mapped_neighbor_list_status->grid_rebuild_requested = 1;
+	}
+
+	void simulator::reset_adaptive_resolution_status(const std::vector<float>& mass)
+	{
+		if (!parameters.adaptive_resolution)
+		{
+			return;
+		}
+		adaptive_resolution_status& status = *mapped_adaptive_resolution_status;
+		status.steps_since_update = 0;
+		status.merged_slot_count = 0;
+		status.split_request_count = 0;
+		uint32_t* free_slots = reinterpret_cast<uint32_t*>(mapped_adaptive_resolution_status + 1);
+		status.free_slot_count = 0;
+		for (uint32_t i = 0; i < total_particle_count; i++)
+		{
+			if (mass[i] == 0)
+			{
+				free_slots[status.free_slot_count++] = i;
+			}
+		}
+	}
+
+	void simulator::reset_particle_activity()
+	{
+		if (!use_awake_list)
+		{
+			return;
+		}
+		// the awake count covers every particle until the first check, so the autotuner times full dispatches. The
+		// time bins start over at substep 0, where every particle is due in bin 0
+		particle_activity_status& status = *mapped_particle_activity_status;
+		std::memset(&status, 0, sizeof(particle_activity_status));
+		status.density_dispatch = { 0, 1, 1 };
+		status.force_dispatch = { 0, 1, 1 };
+		status.integrate_dispatch = { 0, 1, 1 };
+		status.awake_count = total_particle_count;
+		status.last_awake_count = total_particle_count;
+
+		uint32_t* awake_particles = static_cast<uint32_t*>(mapped_staging_memory);
+		for (uint32_t i = 0; i < total_particle_count; i++)
+		{
+			awake_particles[i] = i;
+		}
+		context->execute_one_time_commands(
+			[this](VkCommandBuffer command_buffer_handle)
+			{
+				vkCmdFillBuffer(command_buffer_handle, particle_activity_buffer_handle, particle_activity_ssbo_offset, particle_activity_ssbo_size, 0);
+				vkCmdFillBuffer(command_buffer_handle, particle_activity_buffer_handle, time_bin_ssbo_offset, time_bin_ssbo_size, 0);
+				VkBufferCopy buffer_copy_region
+				{
+					0,
+					awake_list_ssbo_offset,
+					awake_list_ssbo_size
+				};
+				vkCmdCopyBuffer(command_buffer_handle, staging_buffer_handle, particle_activity_buffer_handle, 1, &buffer_copy_region);
+			}
+		);
+	}
+
+	void simulator::build_kernel_table()
+	{
+		if (parameters.kernel_lookup != kernel_evaluation::uniform_table)
+		{
+			return;
+		}
+		// kept with the other pipelines until destruction, the passes read the table from the first step on
+		compute_pipeline_handles[10] = create_compute_pipeline(10, { SPH_WORK_GROUP_SIZE, 0 });
+		context->execute_one_time_commands(
+			[this](VkCommandBuffer command_buffer_handle)
+			{
+				vkCmdBindDescriptorSets(command_buffer_handle, VK_PIPELINE_BIND_POINT_COMPUTE, compute_pipeline_layout_handle, 0, 1, &compute_descriptor_set_handle, 0, NULL);
+				vkCmdBindPipeline(command_buffer_handle, VK_PIPELINE_BIND_POINT_COMPUTE, compute_pipeline_handles[10]);
+				vkCmdDispatch(command_buffer_handle, (SPH_KERNEL_TABLE_SIZE + SPH_WORK_GROUP_SIZE - 1) / SPH_WORK_GROUP_SIZE, 1, 1);
+			}
+		);
+	}
+
+	void simulator::fill_hashed_grid()
+	{
+		// a throwaway insertion pipeline for the positions as they are, with the build's current work group size
+		VkPipeline pipeline_handle = create_compute_pipeline(9, { SPH_WORK_GROUP_SIZE, 0 });
+		const uint32_t work_group_count = get_work_group_count(4, launch_configurations[4].work_group_size);
+		context->execute_one_time_commands(
+			[&](VkCommandBuffer command_buffer_handle)
+			{
+				vkCmdFillBuffer(command_buffer_handle, neighbor_list_buffer_handle, grid_cell_head_ssbo_offset, grid_cell_head_ssbo_size, UINT32_MAX);
+				VkMemoryBarrier transfer_to_compute_memory_barrier
+				{
+					VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+					NULL,
+					VK_ACCESS_TRANSFER_WRITE_BIT,
+					VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+				};
+				vkCmdPipelineBarrier(command_buffer_handle, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &transfer_to_compute_memory_barrier, 0, NULL, 0, NULL);
+				vkCmdBindDescriptorSets(command_buffer_handle, VK_PIPELINE_BIND_POINT_COMPUTE, compute_pipeline_layout_handle, 0, 1, &compute_descriptor_set_handle, 0, NULL);
+				vkCmdBindPipeline(command_buffer_handle, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_handle);
+				vkCmdDispatch(command_buffer_handle, work_group_count, 1, 1);
+			}
+		);
+		vkDestroyPipeline(context->logical_device_handle, pipeline_handle, NULL);
+	}
+
+	void simulator::create_staging_buffer()
+	{
+		if (staging_buffer_handle != VK_NULL_HANDLE)
+		{
+			return;
+		}
+		context->create_buffer(packed_buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging_buffer_handle, staging_memory_handle);
+		vkMapMemory(context->logical_device_handle, staging_memory_handle, 0, packed_buffer_size, 0, &mapped_staging_memory);
+	}
+
+	void simulator::create_readback_buffer()
+	{
+		if (readback_buffer_handle != VK_NULL_HANDLE)
+		{
+			return;
+		}
+		// cached memory makes the host reads of post-processing fast, where the device has it
+		VkMemoryPropertyFlags memory_property_flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+		const VkPhysicalDeviceMemoryProperties& memory_properties = context->physical_device_memory_properties;
+		if (std::none_of(memory_properties.memoryTypes, memory_properties.memoryTypes + memory_properties.memoryTypeCount,
+			[memory_property_flags](const VkMemoryType& memory_type) { return (memory_type.propertyFlags & memory_property_flags) == memory_property_flags; }))
+		{
+			memory_property_flags &= ~VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+		}
+		context->create_buffer(packed_buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, memory_property_flags, readback_buffer_handle, readback_memory_handle);
+		void* mapped_memory = NULL;
+		vkMapMemory(context->logical_device_handle, readback_memory_handle, 0, packed_buffer_size, 0, &mapped_memory);
+		mapped_readback_memory = mapped_memory;
+	}
+
+	void simulator::set_initial_particle_data()
+	{
+		write_state(create_scene_state(parameters));
+	}
+
+	void simulator::set_ensemble_data()
+	{
+		create_staging_buffer();
+		if (ensemble_buffer_size > packed_buffer_size)
+		{
+			throw std::runtime_error("ensemble data does not fit in the staging buffer");
+		}
+		uint32_t* member_index = reinterpret_cast<uint32_t*>(static_cast<char*>(mapped_staging_memory) + member_index_ssbo_offset);
+		for (uint32_t member = 0; member < parameters.ensemble_size; member++)
+		{
+			const ensemble_member_parameters& member_parameters = parameters.member_parameters[member];
+			std::fill(member_index + member_parameters.first_particle, member_index + member_parameters.first_particle + member_parameters.particle_count, member);
+		}
+		std::memcpy(static_cast<char*>(mapped_staging_memory) + member_parameters_ssbo_offset, parameters.member_parameters.data(), member_parameters_ssbo_size);
+		context->execute_one_time_commands(
+			[this](VkCommandBuffer command_buffer_handle)
+			{
+				VkBufferCopy buffer_copy_region
+				{
+					0,
+					0,
+					ensemble_buffer_size
+				};
+				vkCmdCopyBuffer(command_buffer_handle, staging_buffer_handle, ensemble_buffer_handle, 1, &buffer_copy_region);
+			}
+		);
+	}
+
+	void simulator::create_compute_descriptor_set_layout()
+	{
+		// create descriptor layout
+		// bindings 0 to 4 are the particle properties, 5 to 8 the neighbor lists and their status, 9 and 10 the
+		// ensemble member of every particle and the member parameters, 11 the mass of every particle, 12 and 13 the
+		// adaptive resolution status and decisions, 14 to 16 the particle activity status, the activity of every
+		// particle and the awake list, 17 and 18 the hash table and the chains of the hashed grid, 19 the state of the
+		// time integrator, 20 and 21 the kernel table as a uniform buffer and as a storage buffer for its build, 22 the
+		// node and hash table entry of every particle in the incremental grid, 23 the time bin of every particle
+		VkDescriptorSetLayoutBinding descriptor_set_layout_bindings[compute_binding_count];
+		for (uint32_t binding = 0; binding < compute_binding_count; binding++)
+		{
+			descriptor_set_layout_bindings[binding] =
+			{
+				binding,
+				binding == kernel_table_binding ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				1,
+				VK_SHADER_STAGE_COMPUTE_BIT,
+				NULL
+			};
+		}
+
+		VkDescriptorSetLayoutCreateInfo descriptor_set_layout_create_info
+		{
+			VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+			NULL,
+			0,
+			compute_binding_count,
+			descriptor_set_layout_bindings
+		};
+		if (vkCreateDescriptorSetLayout(context->logical_device_handle, &descriptor_set_layout_create_info, NULL, &compute_descriptor_set_layout_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("compute descriptor layout creation failed");
+		}
+	}
+
+	void simulator::update_compute_descriptor_sets()
+	{
+		// allocate descriptor sets
+		VkDescriptorSetAllocateInfo descriptor_set_allocate_info
+		{
+			VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+			NULL,
+			descriptor_pool_handle,
+			1,
+			&compute_descriptor_set_layout_handle
+		};
+		if (vkAllocateDescriptorSets(context->logical_device_handle, &descriptor_set_allocate_info, &compute_descriptor_set_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("compute descriptor set allocation failed");
+		}
+		VkDescriptorBufferInfo descriptor_buffer_infos[]
+		{
+			{
+				packed_particles_buffer_handle,
+				position_ssbo_offset,
+				position_ssbo_size
+			},
+			{
+				packed_particles_buffer_handle,
+				velocity_ssbo_offset,
+				velocity_ssbo_size
+			},
+			{
+				packed_particles_buffer_handle,
+				force_ssbo_offset,
+				force_ssbo_size
+			},
+			{
+				packed_particles_buffer_handle,
+				density_ssbo_offset,
+				density_ssbo_size
+			},
+			{
+				packed_particles_buffer_handle,
+				pressure_ssbo_offset,
+				pressure_ssbo_size
+			},
+			{
+				neighbor_list_buffer_handle,
+				neighbor_count_ssbo_offset,
+				neighbor_count_ssbo_size
+			},
+			{
+				neighbor_list_buffer_handle,
+				neighbor_list_ssbo_offset,
+				neighbor_list_ssbo_size
+			},
+			{
+				neighbor_list_buffer_handle,
+				neighbor_reference_position_ssbo_offset,
+				neighbor_reference_position_ssbo_size
+			},
+			{
+				neighbor_list_status_buffer_handle,
+				0,
+				sizeof(neighbor_list_status)
+			},
+			{
+				ensemble_buffer_handle,
+				member_index_ssbo_offset,
+				member_index_ssbo_size
+			},
+			{
+				ensemble_buffer_handle,
+				member_parameters_ssbo_offset,
+				member_parameters_ssbo_size
+			},
+			{
+				packed_particles_buffer_handle,
+				mass_ssbo_offset,
+				mass_ssbo_size
+			},
+			{
+				adaptive_resolution_status_buffer_handle,
+				0,
+				adaptive_resolution_status_buffer_size
+			},
+			{
+				resolution_work_buffer_handle,
+				0,
+				resolution_work_buffer_size
+			},
+			{
+				particle_activity_status_buffer_handle,
+				0,
+				sizeof(particle_activity_status)
+			},
+			{
+				particle_activity_buffer_handle,
+				particle_activity_ssbo_offset,
+				particle_activity_ssbo_size
+			},
+			{
+				particle_activity_buffer_handle,
+				awake_list_ssbo_offset,
+				awake_list_ssbo_size
+			},
+			{
+				neighbor_list_buffer_handle,
+				grid_cell_head_ssbo_offset,
+				grid_cell_head_ssbo_size
+			},
+			{
+				neighbor_list_buffer_handle,
+				grid_node_ssbo_offset,
+				grid_node_ssbo_size
+			},
+			{
+				integrator_state_buffer_handle,
+				0,
+				integrator_state_buffer_size
+			},
+			{
+				kernel_table_buffer_handle,
+				0,
+				kernel_table_buffer_size
+			},
+			{
+				kernel_table_buffer_handle,
+				0,
+				kernel_table_buffer_size
+			},
+			{
+				neighbor_list_buffer_handle,
+				grid_particle_ssbo_offset,
+				grid_particle_ssbo_size
+			},
+			{
+				particle_activity_buffer_handle,
+				time_bin_ssbo_offset,
+				time_bin_ssbo_size
+			}
+		};
+		// write descriptor sets
+		VkWriteDescriptorSet write_descriptor_sets[compute_binding_count];
+		for (uint32_t binding = 0; binding < compute_binding_count; binding++)
+		{
+			write_descriptor_sets[binding] =
+			{
+				VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+				NULL,
+				compute_descriptor_set_handle,
+				binding,
+				0,
+				1,
+				binding == kernel_table_binding ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				VK_NULL_HANDLE,
+				&descriptor_buffer_infos[binding],
+				VK_NULL_HANDLE
+			};
+		}
+		vkUpdateDescriptorSets(context->logical_device_handle, compute_binding_count, write_descriptor_sets, 0, NULL);
+	}
+
+	void simulator::create_compute_pipeline_layout()
+	{
+		// create pipeline layout
+		VkPipelineLayoutCreateInfo pipeline_layout_create_info
+		{
+			VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+			NULL,
+			0,
+			1,
+			&compute_descriptor_set_layout_handle,
+			0,
+			NULL
+		};
+		if (vkCreatePipelineLayout(context->logical_device_handle, &pipeline_layout_create_info, NULL, &compute_pipeline_layout_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("compute pipeline layout creation failed");
+		}
+	}
+
+	void simulator::create_compute_pipelines()
+	{
+		for (uint32_t i = 0; i < 5; i++)
+		{
+			compute_pipeline_handles[i] = create_compute_pipeline(i, launch_configurations[i]);
+			work_group_counts[i] = get_work_group_count(i, launch_configurations[i].work_group_size);
+		}
+		if (parameters.adaptive_resolution)
+		{
+			for (uint32_t i = 5; i < 9; i++)
+			{
+				compute_pipeline_handles[i] = create_compute_pipeline(i, { SPH_WORK_GROUP_SIZE, 0 });
+			}
+		}
+		if (parameters.hashed_grid)
+		{
+			// the insertion declares the build's work group size, so it shares the build's indirect dispatch
+			compute_pipeline_handles[9] = create_compute_pipeline(9, { SPH_WORK_GROUP_SIZE, 0 });
+		}
+		if (use_incremental_grid)
+		{
+			compute_pipeline_handles[11] = create_compute_pipeline(11, { SPH_WORK_GROUP_SIZE, 0 });
+		}
+	}
+
+	VkPipeline simulator::create_compute_pipeline(uint32_t pipeline_index, const kernel_launch_configuration& configuration) const
+	{
+		// simulation parameters are passed as specialization constants, shaders ignore the ones they do not declare
+		struct compute_specialization
+		{
+			float neighbor_skin;
+			uint32_t max_neighbors;
+			uint32_t neighbor_list_max_age;
+			uint32_t total_particle_count;
+			uint32_t work_group_size;
+			uint32_t build_work_group_size;
+			VkBool32 adaptive_resolution;
+			uint32_t resolution_interval;
+			uint32_t resolution_work_group_size;
+			float surface_density_ratio;
+			float merge_density_ratio;
+			float split_vorticity;
+			VkBool32 sleeping;
+			float sleep_speed;
+			float sleep_acceleration;
+			uint32_t sleep_steps;
+			uint32_t density_particles_per_work_group;
+			uint32_t force_particles_per_work_group;
+			uint32_t integrate_particles_per_work_group;
+			VkBool32 symmetric_pairs;
+			VkBool32 hashed_grid;
+			uint32_t hash_table_size;
+			VkBool32 open_domain;
+			float time_step;
+			uint32_t integrator;
+			uint32_t kernel;
+			uint32_t kernel_lookup;
+			VkBool32 incremental_grid;
+			uint32_t grid_node_count;
+			uint32_t time_bin_count;
+			float time_bin_courant;
+		};
+		const compute_specialization specialization_data{ parameters.neighbor_skin, parameters.max_neighbors, parameters.neighbor_list_max_age, total_particle_count,
+			configuration.work_group_size, launch_configurations[4].work_group_size,
+			parameters.adaptive_resolution ? VK_TRUE : VK_FALSE, parameters.resolution_interval, SPH_WORK_GROUP_SIZE,
+			parameters.surface_density_ratio, parameters.merge_density_ratio, parameters.split_vorticity,
+			parameters.sleeping ? VK_TRUE : VK_FALSE, parameters.sleep_speed, parameters.sleep_acceleration, parameters.sleep_steps,
+			get_particles_per_work_group(0, launch_configurations[0].work_group_size), get_particles_per_work_group(1, launch_configurations[1].work_group_size),
+			get_particles_per_work_group(2, launch_configurations[2].work_group_size), use_symmetric_pairs ? VK_TRUE : VK_FALSE,
+			parameters.hashed_grid ? VK_TRUE : VK_FALSE, hash_table_size, parameters.open_domain ? VK_TRUE : VK_FALSE,
+			parameters.time_step, static_cast<uint32_t>(parameters.integrator), static_cast<uint32_t>(parameters.kernel), static_cast<uint32_t>(parameters.kernel_lookup),
+			use_incremental_grid ? VK_TRUE : VK_FALSE, grid_node_count, parameters.time_bin_count, parameters.time_bin_courant };
+		const VkSpecializationMapEntry specialization_map_entries[]
+		{
+			{ 0, offsetof(compute_specialization, neighbor_skin), sizeof(float) },
+			{ 1, offsetof(compute_specialization, max_neighbors), sizeof(uint32_t) },
+			{ 2, offsetof(compute_specialization, neighbor_list_max_age), sizeof(uint32_t) },
+			{ 3, offsetof(compute_specialization, total_particle_count), sizeof(uint32_t) },
+			{ 4, offsetof(compute_specialization, work_group_size), sizeof(uint32_t) },
+			{ 5, offsetof(compute_specialization, build_work_group_size), sizeof(uint32_t) },
+			{ 6, offsetof(compute_specialization, adaptive_resolution), sizeof(VkBool32) },
+			{ 7, offsetof(compute_specialization, resolution_interval), sizeof(uint32_t) },
+			{ 8, offsetof(compute_specialization, resolution_work_group_size), sizeof(uint32_t) },
+			{ 9, offsetof(compute_specialization, surface_density_ratio), sizeof(float) },
+			{ 10, offsetof(compute_specialization, merge_density_ratio), sizeof(float) },
+			{ 11, offsetof(compute_specialization, split_vorticity), sizeof(float) },
+			{ 12, offsetof(compute_specialization, sleeping), sizeof(VkBool32) },
+			{ 13, offsetof(compute_specialization, sleep_speed), sizeof(float) },
+			{ 14, offsetof(compute_specialization, sleep_acceleration), sizeof(float) },
+			{ 15, offsetof(compute_specialization, sleep_steps), sizeof(uint32_t) },
+			{ 16, offsetof(compute_specialization, density_particles_per_work_group), sizeof(uint32_t) },
+			{ 17, offsetof(compute_specialization, force_particles_per_work_group), sizeof(uint32_t) },
+			{ 18, offsetof(compute_specialization, integrate_particles_per_work_group), sizeof(uint32_t) },
+			{ 19, offsetof(compute_specialization, symmetric_pairs), sizeof(VkBool32) },
+			{ 20, offsetof(compute_specialization, hashed_grid), sizeof(VkBool32) },
+			{ 21, offsetof(compute_specialization, hash_table_size), sizeof(uint32_t) },
+			{ 22, offsetof(compute_specialization, open_domain), sizeof(VkBool32) },
+			{ 23, offsetof(compute_specialization, time_step), sizeof(float) },
+			{ 24, offsetof(compute_specialization, integrator), sizeof(uint32_t) },
+			{ 25, offsetof(compute_specialization, kernel), sizeof(uint32_t) },
+			{ 26, offsetof(compute_specialization, kernel_lookup), sizeof(uint32_t) },
+			{ 27, offsetof(compute_specialization, incremental_grid), sizeof(VkBool32) },
+			{ 28, offsetof(compute_specialization, grid_node_count), sizeof(uint32_t) },
+			{ 29, offsetof(compute_specialization, time_bin_count), sizeof(uint32_t) },
+			{ 30, offsetof(compute_specialization, time_bin_courant), sizeof(float) }
+		};
+		const VkSpecializationInfo specialization_info
+		{
+			31,
+			specialization_map_entries,
+			sizeof(specialization_data),
+			&specialization_data
+		};
+
+		// density and pressure, force, integrate, check neighbor list, build neighbor list, then the resolution update
+		// and the insertion into the hashed grid, which only the scalar build walks, the build of the kernel table and
+		// the emptying of the hash table before the rebuilds of the incremental grid
+		const char* shader_file_names[]
+		{
+			use_symmetric_pairs ? "compute_density_pressure_symmetric.comp.spv" : use_persistent_threads ? "compute_density_pressure_persistent.comp.spv"
+				: is_subgroup_kernel(0) ? "compute_density_pressure_subgroup.comp.spv" : "compute_density_pressure.comp.spv",
+			use_symmetric_pairs ? "compute_force_symmetric.comp.spv" : use_persistent_threads ? "compute_force_persistent.comp.spv"
+				: is_subgroup_kernel(1) ? "compute_force_subgroup.comp.spv" : "compute_force.comp.spv",
+			"integrate.comp.spv",
+			"check_neighbor_list.comp.spv",
+			use_subgroup_kernels && !parameters.hashed_grid ? "build_neighbor_list_subgroup.comp.spv" : "build_neighbor_list.comp.spv",
+			"classify_resolution.comp.spv",
+			"pair_resolution.comp.spv",
+			"merge_particles.comp.spv",
+			"split_particles.comp.spv",
+			"insert_hashed_grid.comp.spv",
+			"build_kernel_table.comp.spv",
+			"clear_hashed_grid.comp.spv"
+		};
+
+		VkShaderModule shader_module = context->create_shader_module_from_file(shader_file_names[pipeline_index]);
+
+		// the subgroup kernels map clusters to invocations through gl_SubgroupID, so they always need every subgroup
+		// to be full, whether or not the subgroup size is required
+		VkPipelineShaderStageRequiredSubgroupSizeCreateInfoEXT required_subgroup_size_create_info
+		{
+			VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_REQUIRED_SUBGROUP_SIZE_CREATE_INFO_EXT,
+			NULL,
+			configuration.required_subgroup_size
+		};
+		const bool require_subgroup_size = configuration.required_subgroup_size != 0;
+		VkPipelineShaderStageCreateInfo compute_shader_stage_create_info
+		{
+			VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			require_subgroup_size ? &required_subgroup_size_create_info : NULL,
+			static_cast<VkPipelineShaderStageCreateFlags>(is_subgroup_kernel(pipeline_index) ? VK_PIPELINE_SHADER_STAGE_CREATE_REQUIRE_FULL_SUBGROUPS_BIT_EXT : 0),
+			VK_SHADER_STAGE_COMPUTE_BIT,
+			shader_module,
+			"main",
+			&specialization_info
+		};
+
+		VkComputePipelineCreateInfo compute_pipeline_create_info
+		{
+			VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+			NULL,
+			0,
+			compute_shader_stage_create_info,
+			compute_pipeline_layout_handle,
+			VK_NULL_HANDLE,
+			0
+		};
+
+		VkPipeline pipeline_handle = VK_NULL_HANDLE;
+		VkResult result = vkCreateComputePipelines(context->logical_device_handle, context->global_pipeline_cache_handle, 1, &compute_pipeline_create_info, NULL, &pipeline_handle);
+		vkDestroyShaderModule(context->logical_device_handle, shader_module, NULL);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error(std::string("compute pipeline creation failed: ") + shader_file_names[pipeline_index]);
+		}
+		return pipeline_handle;
+	}
+
+	bool simulator::is_subgroup_kernel(uint32_t pipeline_index) const
+	{
+		// density and pressure, force and build neighbor list have subgroup variants, density and force only without
+		// persistent threads and the build only without the hashed grid
+		return use_subgroup_kernels && (((pipeline_index == 0 || pipeline_index == 1) && !use_persistent_threads) || (pipeline_index == 4 && !parameters.hashed_grid));
+	}
+
+	uint32_t simulator::get_particles_per_work_group(uint32_t pipeline_index, uint32_t work_group_size) const
+	{
+		// the subgroup kernels of density and force run a cluster of invocations per particle
+		return is_subgroup_kernel(pipeline_index) && pipeline_index != 4 ? work_group_size / SPH_SUBGROUP_CLUSTER_SIZE : work_group_size;
+	}
+
+	uint32_t simulator::get_work_group_count(uint32_t pipeline_index, uint32_t work_group_size) const
+	{
+		// work group count is the ceiling of particle count divided by particles per work group
+		const uint32_t particles_per_work_group = get_particles_per_work_group(pipeline_index, work_group_size);
+		const uint32_t work_group_count = (total_particle_count + particles_per_work_group - 1) / particles_per_work_group;
+		// the persistent passes loop until their queues run dry, so a work group handles several batches
+		if (use_persistent_threads && (pipeline_index == 0 || pipeline_index == 1))
+		{
+			return parameters.persistent_work_group_count ? parameters.persistent_work_group_count : std::max(work_group_count / 4, 1u);
+		}
+		return work_group_count;
+	}
+
+	void simulator::autotune()
+	{
+		// the fastest configuration also depends on the kernel variant, the particle count and every parameter that
+		// changes the work of the timed kernels: the ensemble size, the neighbor list length and skin, the awake list
+		// of sleeping and time bins, the smoothing kernel and its evaluation, the grid, the integrator, the particles
+		// split and merged by adaptive resolution and those let in and out by the open domain. symmetric pairs are the
+		// kernel variant
+		autotune_cache cache(parameters.autotune_cache_path);
+		const std::string key = autotune_cache::make_key(*context, std::string(use_symmetric_pairs ? "symmetric" : use_subgroup_kernels ? "subgroup" : "scalar") + ":" + std::to_string(total_particle_count)
+			+ ":ensemble" + std::to_string(parameters.ensemble_size)
+			+ ":neighbors" + std::to_string(parameters.max_neighbors) + ":skin" + std::to_string(parameters.neighbor_skin)
+			+ (parameters.sleeping ? ":sleeping" : "")
+			+ ":bins" + std::to_string(parameters.time_bin_count)
+			+ ":kernel" + std::to_string(static_cast<uint32_t>(parameters.kernel)) + ":" + std::to_string(static_cast<uint32_t>(parameters.kernel_lookup))
+			+ ":integrator" + std::to_string(static_cast<uint32_t>(parameters.integrator))
+			+ (parameters.hashed_grid ? ":hashed" : "")
+			+ (parameters.adaptive_resolution ? ":adaptive" : "")
+			+ (parameters.open_domain ? ":open" : "")
+			+ (use_persistent_threads ? ":persistent" + std::to_string(get_work_group_count(0, SPH_WORK_GROUP_SIZE)) : ""));
+		std::vector<kernel_launch_configuration> configurations(std::begin(launch_configurations), std::end(launch_configurations));
+		if (cache.find(key, configurations))
+		{
+			std::copy(configurations.begin(), configurations.end(), launch_configurations);
+			std::cout << "[INFO] autotuned launch configurations loaded from " << parameters.autotune_cache_path << std::endl;
+			return;
+		}
+
+		// the build goes first so that density and force, which follow in step order, are timed on filled lists
+		static const uint32_t tuning_order[5] = { 4, 3, 0, 1, 2 };
+		static const char* const pipeline_names[5] = { "density pressure", "force", "integrate", "check neighbor list", "build neighbor list" };
+		for (uint32_t pipeline_index : tuning_order)
+		{
+			// the timed builds walk the hashed grid, which the particles do not leave while they are timed
+			if (pipeline_index == 4 && parameters.hashed_grid)
+			{
+				fill_hashed_grid();
+			}
+			double best_time_ns = DBL_MAX;
+			for (const kernel_launch_configuration& candidate : get_candidate_configurations(pipeline_index))
+			{
+				VkPipeline pipeline_handle = create_compute_pipeline(pipeline_index, candidate);
+				const double time_ns = time_compute_pipeline(pipeline_handle, get_work_group_count(pipeline_index, candidate.work_group_size), use_persistent_threads && pipeline_index < 2);
+				vkDestroyPipeline(context->logical_device_handle, pipeline_handle, NULL);
+				if (time_ns < best_time_ns)
+				{
+					best_time_ns = time_ns;
+					launch_configurations[pipeline_index] = candidate;
+				}
+			}
+			// the timed checks have appended the particles to the awake list over and over
+			if (pipeline_index == 3)
+			{
+				reset_particle_activity();
+			}
+			std::cout << "[INFO] autotuned " << pipeline_names[pipeline_index] << ": work group size " << launch_configurations[pipeline_index].work_group_size
+				<< ", subgroup size " << (launch_configurations[pipeline_index].required_subgroup_size ? std::to_string(launch_configurations[pipeline_index].required_subgroup_size) : std::string("default"))
+				<< ", " << 1e-3 * best_time_ns << " us per dispatch" << std::endl;
+		}
+		configurations.assign(std::begin(launch_configurations), std::end(launch_configurations));
+		cache.store(key, configurations);
+
+		// the timed integrations have moved the particles and the timed builds have changed the statistics
+		reset_neighbor_list_status();
+		set_initial_particle_data();
+	}
+
+	std::vector<kernel_launch_configuration> simulator::get_candidate_configurations(uint32_t pipeline_index) const
+	{
+		const VkPhysicalDeviceLimits& limits = context->physical_device_properties.limits;
+		const uint32_t max_work_group_size = std::min(limits.maxComputeWorkGroupSize[0], limits.maxComputeWorkGroupInvocations);
+
+		// the default subgroup size, then every size the device can be asked for in compute shaders
+		std::vector<uint32_t> subgroup_sizes{ 0 };
+		const VkPhysicalDeviceSubgroupSizeControlPropertiesEXT& size_control_properties = context->physical_device_subgroup_size_control_properties;
+		if (context->subgroup_size_control_features.subgroupSizeControl && (size_control_properties.requiredSubgroupSizeStages & VK_SHADER_STAGE_COMPUTE_BIT))
+		{
+			for (uint32_t size = std::max<uint32_t>(size_control_properties.minSubgroupSize, SPH_SUBGROUP_CLUSTER_SIZE); size <= size_control_properties.maxSubgroupSize; size *= 2)
+			{
+				subgroup_sizes.push_back(size);
+			}
+		}
+
+		std::vector<kernel_launch_configuration> candidates;
+		for (uint32_t work_group_size = 32; work_group_size <= max_work_group_size && work_group_size <= 1024; work_group_size *= 2)
+		{
+			for (uint32_t subgroup_size : subgroup_sizes)
+			{
+				// the subgroup kernels need whole subgroups in a work group, and full subgroups without a required size
+				// need a multiple of the largest size the device may pick
+				const uint32_t effective_subgroup_size = subgroup_size ? subgroup_size
+					: std::max(context->physical_device_subgroup_properties.subgroupSize, size_control_properties.maxSubgroupSize);
+				if (is_subgroup_kernel(pipeline_index) && work_group_size % effective_subgroup_size != 0)
+				{
+					continue;
+				}
+				if (subgroup_size && work_group_size > size_control_properties.maxComputeWorkgroupSubgroups * subgroup_size)
+				{
+					continue;
+				}
+				candidates.push_back({ work_group_size, subgroup_size });
+			}
+		}
+		return candidates;
+	}
+
+	double simulator::time_compute_pipeline(VkPipeline pipeline_handle, uint32_t work_group_count, bool reset_work_queues) const
+	{
+		// back-to-back dispatches separated by barriers like in a step, the best of a few runs skips warm-up and
+		// clock ramp-up
+		const uint32_t dispatch_count = 16;
+		const uint32_t run_count = 3;
+
+		// device timestamps when the queue family has them, otherwise host time around the whole submission
+		const bool use_timestamps = context->queue_family_timestamp_valid_bits != 0;
+		VkQueryPool query_pool_handle = VK_NULL_HANDLE;
+		if (use_timestamps)
+		{
+			VkQueryPoolCreateInfo query_pool_create_info
+			{
+				VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+				NULL,
+				0,
+				VK_QUERY_TYPE_TIMESTAMP,
+				2,
+				0
+			};
+			if (vkCreateQueryPool(context->logical_device_handle, &query_pool_create_info, NULL, &query_pool_handle) != VK_SUCCESS)
+			{
+				throw std::runtime_error("query pool creation failed");
+			}
+		}
+
+		double best_time_ns = DBL_MAX;
+		for (uint32_t run = 0; run < run_count; run++)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			context->execute_one_time_commands(
+				[&](VkCommandBuffer command_buffer_handle)
+				{
+					if (use_timestamps)
+					{
+						vkCmdResetQueryPool(command_buffer_handle, query_pool_handle, 0, 2);
+						vkCmdWriteTimestamp(command_buffer_handle, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool_handle, 0);
+					}
+					vkCmdBindDescriptorSets(command_buffer_handle, VK_PIPELINE_BIND_POINT_COMPUTE, compute_pipeline_layout_handle, 0, 1, &compute_descriptor_set_handle, 0, NULL);
+					vkCmdBindPipeline(command_buffer_handle, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_handle);
+					VkMemoryBarrier compute_to_compute_memory_barrier
+					{
+						VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+						NULL,
+						VK_ACCESS_SHADER_WRITE_BIT,
+						VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+					};
+					VkMemoryBarrier transfer_to_compute_memory_barrier
+					{
+						VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+						NULL,
+						VK_ACCESS_TRANSFER_WRITE_BIT,
+						VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+					};
+					for (uint32_t i = 0; i < dispatch_count; i++)
+					{
+						// the previous dispatch has emptied the queue
+						if (reset_work_queues)
+						{
+							vkCmdFillBuffer(command_buffer_handle, particle_activity_status_buffer_handle, offsetof(particle_activity_status, density_queue_head), 2 * sizeof(uint32_t), 0);
+							vkCmdPipelineBarrier(command_buffer_handle, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &transfer_to_compute_memory_barrier, 0, NULL, 0, NULL);
+						}
+						vkCmdDispatch(command_buffer_handle, work_group_count, 1, 1);
+						vkCmdPipelineBarrier(command_buffer_handle, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &compute_to_compute_memory_barrier, 0, NULL, 0, NULL);
+					}
+					if (use_timestamps)
+					{
+						vkCmdWriteTimestamp(command_buffer_handle, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool_handle, 1);
+					}
+				}
+			);
+			auto end = std::chrono::high_resolution_clock::now();
+
+			double time_ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+			if (use_timestamps)
+			{
+				uint64_t timestamps[2];
+				if (vkGetQueryPoolResults(context->logical_device_handle, query_pool_handle, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) != VK_SUCCESS)
+				{
+					throw std::runtime_error("failed to get timestamp query results");
+				}
+				const uint32_t valid_bits = context->queue_family_timestamp_valid_bits;
+				const uint64_t mask = valid_bits >= 64 ? ~0ull : (1ull << valid_bits) - 1;
+				time_ns = static_cast<double>((timestamps[1] - timestamps[0]) & mask) * context->physical_device_properties.limits.timestampPeriod;
+			}
+			best_time_ns = std::min(best_time_ns, time_ns / dispatch_count);
+		}
+
+		if (use_timestamps)
+		{
+			vkDestroyQueryPool(context->logical_device_handle, query_pool_handle, NULL);
+		}
+		return best_time_ns;
+	}
+
+	void simulator::create_compute_command_pool()
+	{
+		// create compute command pool
+		VkCommandPoolCreateInfo command_pool_create_info
+		{
+			VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+			NULL,
+			VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+			context->queue_family_index
+		};
+		if (vkCreateCommandPool(context->logical_device_handle, &command_pool_create_info, NULL, &compute_command_pool_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("command pool creation failed");
+		}
+	}
+
+	void simulator::create_compute_command_buffer()
+	{
+		// allocate command buffer
+		VkCommandBufferAllocateInfo command_buffer_allocate_info
+		{
+			VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+			NULL,
+			compute_command_pool_handle,
+			VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+			1
+		};
+		if (vkAllocateCommandBuffers(context->logical_device_handle, &command_buffer_allocate_info, &compute_command_buffer_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("buffer allocation failed");
+		}
+		record_compute_command_buffer(compute_command_buffer_handle, UINT32_MAX);
+
+		if ((tracer || pass_timing_interval) && context->queue_family_timestamp_valid_bits == 0)
+		{
+			std::cout << "[WARN] compute queue family does not support timestamps, GPU passes are not traced" << std::endl;
+		}
+		else if (tracer || pass_timing_interval)
+		{
+			// the traced variants take turns, so the timestamps of one step can be read while the next ones run
+			VkQueryPoolCreateInfo query_pool_create_info
+			{
+				VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+				NULL,
+				0,
+				VK_QUERY_TYPE_TIMESTAMP,
+				SPH_TRACED_STEP_SLOT_COUNT * SPH_STEP_TIMESTAMP_COUNT,
+				0
+			};
+			if (vkCreateQueryPool(context->logical_device_handle, &query_pool_create_info, NULL, &timestamp_query_pool_handle) != VK_SUCCESS)
+			{
+				throw std::runtime_error("query pool creation failed");
+			}
+			command_buffer_allocate_info.commandBufferCount = SPH_TRACED_STEP_SLOT_COUNT;
+			if (vkAllocateCommandBuffers(context->logical_device_handle, &command_buffer_allocate_info, traced_command_buffer_handles) != VK_SUCCESS)
+			{
+				throw std::runtime_error("buffer allocation failed");
+			}
+			VkFenceCreateInfo fence_create_info
+			{
+				VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+				NULL,
+				0
+			};
+			for (uint32_t i = 0; i < SPH_TRACED_STEP_SLOT_COUNT; i++)
+			{
+				if (vkCreateFence(context->logical_device_handle, &fence_create_info, NULL, &traced_step_fence_handles[i]) != VK_SUCCESS)
+				{
+					throw std::runtime_error("fence creation failed");
+				}
+				record_compute_command_buffer(traced_command_buffer_handles[i], i * SPH_STEP_TIMESTAMP_COUNT);
+			}
+		}
+	}
+
+	void simulator::record_compute_command_buffer(VkCommandBuffer command_buffer_handle, uint32_t timestamp_query_base)
+	{
+		// build command buffer
+		VkCommandBufferBeginInfo command_buffer_begin_info
+		{
+			VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			NULL,
+			VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT,
+			NULL
+		};
+		if (vkBeginCommandBuffer(command_buffer_handle, &command_buffer_begin_info) != VK_SUCCESS)
+		{
+			throw std::runtime_error("command buffer begin failed");
+		}
+
+		// timestamps of the traced variant: begin, then the end of the check, build, first, second and third dispatch
+		// and of the resolution update
+		const bool traced = timestamp_query_base != UINT32_MAX;
+		if (traced)
+		{
+			vkCmdResetQueryPool(command_buffer_handle, timestamp_query_pool_handle, timestamp_query_base, SPH_STEP_TIMESTAMP_COUNT);
+			vkCmdWriteTimestamp(command_buffer_handle, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestamp_query_pool_handle, timestamp_query_base);
+		}
+
+		vkCmdBindDescriptorSets(command_buffer_handle, VK_PIPELINE_BIND_POINT_COMPUTE, compute_pipeline_layout_handle, 0, 1, &compute_descriptor_set_handle, 0, NULL);
+
+		// Neighbor list maintenance
+		// Reset the work group count of the build, the check dispatch raises it again if the lists went stale.
+		// The previous step's build has read the count and the integration has written the positions by now.
+		vkCmdFillBuffer(command_buffer_handle, neighbor_list_status_buffer_handle, offsetof(neighbor_list_status, build_dispatch), sizeof(uint32_t), 0);
+		// likewise for the resolution update, which the check dispatch schedules every resolution_interval steps
+		if (parameters.adaptive_resolution)
+		{
+			vkCmdFillBuffer(command_buffer_handle, adaptive_resolution_status_buffer_handle, offsetof(adaptive_resolution_status, update_dispatch), sizeof(uint32_t), 0);
+		}
+		// and for the passes over the awake or due particles, which the check dispatch compacts again. The count of
+		// the last step is kept for the host first
+		if (use_awake_list)
+		{
+			VkBufferCopy awake_count_copy_region
+			{
+				offsetof(particle_activity_status, awake_count),
+				offsetof(particle_activity_status, last_awake_count),
+				sizeof(uint32_t)
+			};
+			vkCmdCopyBuffer(command_buffer_handle, particle_activity_status_buffer_handle, particle_activity_status_buffer_handle, 1, &awake_count_copy_region);
+			VkMemoryBarrier transfer_to_transfer_memory_barrier
+			{
+				VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+				NULL,
+				VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+				VK_ACCESS_TRANSFER_WRITE_BIT
+			};
+			vkCmdPipelineBarrier(command_buffer_handle, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &transfer_to_transfer_memory_barrier, 0, NULL, 0, NULL);
+			static const uint32_t reset_dispatches[] = { 0, 1, 1, 0, 1, 1, 0, 1, 1, 0 };
+			vkCmdUpdateBuffer(command_buffer_handle, particle_activity_status_buffer_handle, 0, sizeof(reset_dispatches), reset_dispatches);
+		}
+		// the persistent passes claim their particles from the start of the queues again
+		if (use_persistent_threads)
+		{
+			vkCmdFillBuffer(command_buffer_handle, particle_activity_status_buffer_handle, offsetof(particle_activity_status, density_queue_head), 2 * sizeof(uint32_t), 0);
+		}
+		// the symmetric density pass adds to the densities of both particles of a pair, so they start from zero
+		if (use_symmetric_pairs)
+		{
+			vkCmdFillBuffer(command_buffer_handle, packed_particles_buffer_handle, density_ssbo_offset, density_ssbo_size, 0);
+		}
+		// the hashed grid is inserted into empty chains, on steps without a rebuild nothing reads the emptied table.
+		// The incremental grid is kept between steps and emptied by a dispatch on the steps that rebuild it
+		if (parameters.hashed_grid && !use_incremental_grid)
+		{
+			vkCmdFillBuffer(command_buffer_handle, neighbor_list_buffer_handle, grid_cell_head_ssbo_offset, grid_cell_head_ssbo_size, UINT32_MAX);
+		}
+		VkMemoryBarrier transfer_to_compute_memory_barrier
+		{
+			VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			NULL,
+			VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+		};
+		vkCmdPipelineBarrier(command_buffer_handle, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &transfer_to_compute_memory_barrier, 0, NULL, 0, NULL);
+
+		vkCmdBindPipeline(command_buffer_handle, VK_PIPELINE_BIND_POINT_COMPUTE, compute_pipeline_handles[3]);
+		vkCmdDispatch(command_buffer_handle, work_group_counts[3], 1, 1);
+		if (traced)
+		{
+			vkCmdWriteTimestamp(command_buffer_handle, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, timestamp_query_pool_handle, timestamp_query_base + 1);
+		}
+
+		// Barrier: the check dispatch writes the indirect arguments of the build dispatch
+		VkMemoryBarrier compute_to_indirect_memory_barrier
+		{
+			VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			NULL,
+			VK_ACCESS_SHADER_WRITE_BIT,
+			VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+		};
+		vkCmdPipelineBarrier(command_buffer_handle, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &compute_to_indirect_memory_barrier, 0, NULL, 0, NULL);
+
+		// Dispatches zero work groups unless the lists need a rebuild, like the insertion into the hashed grid before it.
+		// The incremental grid is instead only emptied and filled again when the check has scheduled a rebuild
+		if (parameters.hashed_grid)
+		{
+			VkMemoryBarrier compute_to_compute_memory_barrier
+			{
+				VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+				NULL,
+				VK_ACCESS_SHADER_WRITE_BIT,
+				VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+			};
+			if (use_incremental_grid)
+			{
+				vkCmdBindPipeline(command_buffer_handle, VK_PIPELINE_BIND_POINT_COMPUTE, compute_pipeline_handles[11]);
+				vkCmdDispatchIndirect(command_buffer_handle, neighbor_list_status_buffer_handle, offsetof(neighbor_list_status, grid_clear_dispatch));
+				vkCmdPipelineBarrier(command_buffer_handle, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &compute_to_compute_memory_barrier, 0, NULL, 0, NULL);
+			}
+			vkCmdBindPipeline(command_buffer_handle, VK_PIPELINE_BIND_POINT_COMPUTE, compute_pipeline_handles[9]);
+			vkCmdDispatchIndirect(command_buffer_handle, neighbor_list_status_buffer_handle,
+				use_incremental_grid ? offsetof(neighbor_list_status, grid_insert_dispatch) : offsetof(neighbor_list_status, build_dispatch));
+			vkCmdPipelineBarrier(command_buffer_handle, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &compute_to_compute_memory_barrier, 0, NULL, 0, NULL);
+		}
+		vkCmdBindPipeline(command_buffer_handle, VK_PIPELINE_BIND_POINT_COMPUTE, compute_pipeline_handles[4]);
+		vkCmdDispatchIndirect(command_buffer_handle, neighbor_list_status_buffer_handle, offsetof(neighbor_list_status, build_dispatch));
+		if (traced)
+		{
+			vkCmdWriteTimestamp(command_buffer_handle, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, timestamp_query_pool_handle, timestamp_query_base + 2);
+		}
+
+		// Barrier: the build writes the neighbor lists, the first dispatch reads them
+		VkMemoryBarrier compute_to_compute_memory_barrier
+		{
+			VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			NULL,
+			VK_ACCESS_SHADER_WRITE_BIT,
+			VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+		};
+		vkCmdPipelineBarrier(command_buffer_handle, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &compute_to_compute_memory_barrier, 0, NULL, 0, NULL);
+
+		// First dispatch
+		// with sleeping, this and the next two dispatches only cover the awake particles. With time bins, this and
+		// the next one cover the due particles, and the integration drifts every particle. The persistent passes read
+		// the count of the list themselves
+		vkCmdBindPipeline(command_buffer_handle, VK_PIPELINE_BIND_POINT_COMPUTE, compute_pipeline_handles[0]);
+		if (use_awake_list && !use_persistent_threads)
+		{
+			vkCmdDispatchIndirect(command_buffer_handle, particle_activity_status_buffer_handle, offsetof(particle_activity_status, density_dispatch));
+		}
+		else
+		{
+			vkCmdDispatch(command_buffer_handle, work_group_counts[0], 1, 1);
+		}
+		if (traced)
+		{
+			vkCmdWriteTimestamp(command_buffer_handle, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, timestamp_query_pool_handle, timestamp_query_base + 3);
+		}
+
+		// Barrier: compute to compute dependencies
+		// First dispatch writes to a storage buffer, second dispatch reads from that storage buffer
+		vkCmdPipelineBarrier(command_buffer_handle, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &compute_to_compute_memory_barrier, 0, NULL, 0, NULL);
+
+		// Second dispatch
+		vkCmdBindPipeline(command_buffer_handle, VK_PIPELINE_BIND_POINT_COMPUTE, compute_pipeline_handles[1]);
+		if (use_awake_list && !use_persistent_threads)
+		{
+			vkCmdDispatchIndirect(command_buffer_handle, particle_activity_status_buffer_handle, offsetof(particle_activity_status, force_dispatch));
+		}
+		else
+		{
+			vkCmdDispatch(command_buffer_handle, work_group_counts[1], 1, 1);
+		}
+		if (traced)
+		{
+			vkCmdWriteTimestamp(command_buffer_handle, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, timestamp_query_pool_handle, timestamp_query_base + 4);
+		}
+
+		// Barrier: compute to compute dependencies
+		// Second dispatch writes to a storage buffer, third dispatch reads from that storage buffer
+		vkCmdPipelineBarrier(command_buffer_handle, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &compute_to_compute_memory_barrier, 0, NULL, 0, NULL);
+
+		// Third dispatch
+		// Third dispatch writes to the storage buffer. Later, vkCmdDraw reads that buffer as a vertex buffer with vkCmdBindVertexBuffers.
+		vkCmdBindPipeline(command_buffer_handle, VK_PIPELINE_BIND_POINT_COMPUTE, compute_pipeline_handles[2]);
+		if (parameters.sleeping)
+		{
+			vkCmdDispatchIndirect(command_buffer_handle, particle_activity_status_buffer_handle, offsetof(particle_activity_status, integrate_dispatch));
+		}
+		else
+		{
+			vkCmdDispatch(command_buffer_handle, work_group_counts[2], 1, 1);
+		}
+		if (traced)
+		{
+			vkCmdWriteTimestamp(command_buffer_handle, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, timestamp_query_pool_handle, timestamp_query_base + 5);
+		}
+
+		// Resolution update: classify, pair, merge and split, each reading what the one before has written.
+		// Dispatches zero work groups except every resolution_interval steps. Merges go before splits, so the
+		// splits can take the slots the merges have freed
+		if (parameters.adaptive_resolution)
+		{
+			for (uint32_t i = 5; i < 9; i++)
+			{
+				vkCmdPipelineBarrier(command_buffer_handle, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &compute_to_compute_memory_barrier, 0, NULL, 0, NULL);
+				vkCmdBindPipeline(command_buffer_handle, VK_PIPELINE_BIND_POINT_COMPUTE, compute_pipeline_handles[i]);
+				vkCmdDispatchIndirect(command_buffer_handle, adaptive_resolution_status_buffer_handle, offsetof(adaptive_resolution_status, update_dispatch));
+			}
+		}
+		if (traced)
+		{
+			vkCmdWriteTimestamp(command_buffer_handle, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, timestamp_query_pool_handle, timestamp_query_base + 6);
+		}
+
+		// Barrier: the next step's fill of the build dispatch arguments must wait for the integration and the build,
+		// and copies of the state after the steps must see the integrated positions
+		VkMemoryBarrier compute_to_next_step_memory_barrier
+		{
+			VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			NULL,
+			VK_ACCESS_SHADER_WRITE_BIT,
+			VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT
+		};
+		vkCmdPipelineBarrier(command_buffer_handle, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &compute_to_next_step_memory_barrier, 0, NULL, 0, NULL);
+
+		if (vkEndCommandBuffer(command_buffer_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("command buffer end failed");
+		}
+	}
+
+} // namespace sph
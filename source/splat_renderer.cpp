@@ -0,0 +1,397 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "splat_renderer.hpp"
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+namespace sph
+{
+
+	splat_renderer::splat_renderer(const simulator& particle_simulator, VkFormat target_format, VkImageLayout final_layout, uint32_t width, uint32_t height)
+		: context(&particle_simulator.get_context()), final_layout(final_layout), width(width), height(height), particle_count(particle_simulator.get_parameters().particle_count)
+	{
+		VkFormatProperties format_properties;
+		vkGetPhysicalDeviceFormatProperties(context->physical_device_handle, target_format, &format_properties);
+		if (!(format_properties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT))
+		{
+			throw std::runtime_error("the target format of the splat renderer does not support blits");
+		}
+		create_splat_buffer();
+		create_color_image();
+		create_descriptor_set(particle_simulator);
+		create_pipelines();
+	}
+
+	splat_renderer::~splat_renderer()
+	{
+		VkDevice logical_device_handle = context->logical_device_handle;
+		for (VkPipeline pipeline_handle : pipeline_handles)
+		{
+			vkDestroyPipeline(logical_device_handle, pipeline_handle, NULL);
+		}
+		vkDestroyPipelineLayout(logical_device_handle, pipeline_layout_handle, NULL);
+		vkDestroyDescriptorSetLayout(logical_device_handle, descriptor_set_layout_handle, NULL);
+		vkDestroyDescriptorPool(logical_device_handle, descriptor_pool_handle, NULL);
+		vkDestroyImageView(logical_device_handle, color_image_view_handle, NULL);
+		vkDestroyImage(logical_device_handle, color_image_handle, NULL);
+		vkFreeMemory(logical_device_handle, color_image_memory_handle, NULL);
+		vkDestroyBuffer(logical_device_handle, splat_buffer_handle, NULL);
+		vkFreeMemory(logical_device_handle, splat_memory_handle, NULL);
+	}
+
+	uint32_t splat_renderer::get_width() const
+	{
+		return width;
+	}
+
+	uint32_t splat_renderer::get_height() const
+	{
+		return height;
+	}
+
+	void splat_renderer::record_draw(VkCommandBuffer command_buffer_handle, VkImage target_image_handle) const
+	{
+		// Barrier: the resolve of the previous draw reads the splats before they are cleared
+		vkCmdPipelineBarrier(command_buffer_handle, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 0, NULL);
+		// all ones is the background, above every splat
+		vkCmdFillBuffer(command_buffer_handle, splat_buffer_handle, 0, VK_WHOLE_SIZE, UINT32_MAX);
+
+		// Barrier: the splats are cleared, and the integration of the last step writes the positions
+		VkMemoryBarrier splat_memory_barrier
+		{
+			VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			NULL,
+			VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+			VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+		};
+		vkCmdPipelineBarrier(command_buffer_handle, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &splat_memory_barrier, 0, NULL, 0, NULL);
+
+		vkCmdBindDescriptorSets(command_buffer_handle, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout_handle, 0, 1, &descriptor_set_handle, 0, NULL);
+		vkCmdBindPipeline(command_buffer_handle, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_handles[0]);
+		vkCmdDispatch(command_buffer_handle, (particle_count + 127) / 128, 1, 1);
+
+		// Barrier: the resolve reads the splats, and overwrites the colour image that the blit of the previous draw read
+		VkMemoryBarrier resolve_memory_barrier
+		{
+			VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			NULL,
+			VK_ACCESS_SHADER_WRITE_BIT,
+			VK_ACCESS_SHADER_READ_BIT
+		};
+		VkImageMemoryBarrier color_image_to_general_barrier
+		{
+			VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+			NULL,
+			0,
+			VK_ACCESS_SHADER_WRITE_BIT,
+			VK_IMAGE_LAYOUT_UNDEFINED,
+			VK_IMAGE_LAYOUT_GENERAL,
+			VK_QUEUE_FAMILY_IGNORED,
+			VK_QUEUE_FAMILY_IGNORED,
+			color_image_handle,
+			{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }
+		};
+		vkCmdPipelineBarrier(command_buffer_handle, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+			1, &resolve_memory_barrier, 0, NULL, 1, &color_image_to_general_barrier);
+
+		vkCmdBindPipeline(command_buffer_handle, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_handles[1]);
+		vkCmdDispatch(command_buffer_handle, (width + 15) / 16, (height + 15) / 16, 1);
+
+		// Barrier: the blit reads the colour image and overwrites the target. The color attachment output stage chains
+		// the wait for the acquire of a swapchain image, the transfer stage the copy of the previous capture
+		const VkImageMemoryBarrier blit_image_barriers[]
+		{
+			{
+				VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+				NULL,
+				VK_ACCESS_SHADER_WRITE_BIT,
+				VK_ACCESS_TRANSFER_READ_BIT,
+				VK_IMAGE_LAYOUT_GENERAL,
+				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				VK_QUEUE_FAMILY_IGNORED,
+				VK_QUEUE_FAMILY_IGNORED,
+				color_image_handle,
+				{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }
+			},
+			{
+				VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+				NULL,
+				0,
+				VK_ACCESS_TRANSFER_WRITE_BIT,
+				VK_IMAGE_LAYOUT_UNDEFINED,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				VK_QUEUE_FAMILY_IGNORED,
+				VK_QUEUE_FAMILY_IGNORED,
+				target_image_handle,
+				{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }
+			}
+		};
+		vkCmdPipelineBarrier(command_buffer_handle, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 2, blit_image_barriers);
+
+		// same size, so this is a copy with the conversion to the target format, e.g. the sRGB encoding
+		const VkImageBlit image_blit
+		{
+			{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+			{ { 0, 0, 0 }, { static_cast<int32_t>(width), static_cast<int32_t>(height), 1 } },
+			{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+			{ { 0, 0, 0 }, { static_cast<int32_t>(width), static_cast<int32_t>(height), 1 } }
+		};
+		vkCmdBlitImage(command_buffer_handle, color_image_handle, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, target_image_handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &image_blit, VK_FILTER_NEAREST);
+
+		// Barrier: whatever uses the target next, the presentation or the copy of a capture, waits for the blit
+		VkImageMemoryBarrier target_to_final_layout_barrier
+		{
+			VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+			NULL,
+			VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_ACCESS_TRANSFER_READ_BIT,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			final_layout,
+			VK_QUEUE_FAMILY_IGNORED,
+			VK_QUEUE_FAMILY_IGNORED,
+			target_image_handle,
+			{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }
+		};
+		vkCmdPipelineBarrier(command_buffer_handle, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &target_to_final_layout_barrier);
+	}
+
+	void splat_renderer::create_splat_buffer()
+	{
+		// one packed depth and colour per pixel, only touched on the device
+		context->create_buffer(sizeof(uint32_t) * width * height, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, splat_buffer_handle, splat_memory_handle);
+	}
+
+	void splat_renderer::create_color_image()
+	{
+		// linear like the output of particle.frag, the blit encodes it for an sRGB target
+		VkImageCreateInfo image_create_info
+		{
+			VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+			NULL,
+			0,
+			VK_IMAGE_TYPE_2D,
+			VK_FORMAT_R8G8B8A8_UNORM,
+			{ width, height, 1 },
+			1,
+			1,
+			VK_SAMPLE_COUNT_1_BIT,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+			VK_SHARING_MODE_EXCLUSIVE,
+			0,
+			NULL,
+			VK_IMAGE_LAYOUT_UNDEFINED
+		};
+		if (vkCreateImage(context->logical_device_handle, &image_create_info, NULL, &color_image_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("image creation failed");
+		}
+		VkMemoryRequirements memory_requirements;
+		vkGetImageMemoryRequirements(context->logical_device_handle, color_image_handle, &memory_requirements);
+		VkMemoryAllocateInfo memory_allocate_info
+		{
+			VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+			NULL,
+			memory_requirements.size,
+			context->get_memory_type_index(memory_requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+		};
+		if (vkAllocateMemory(context->logical_device_handle, &memory_allocate_info, NULL, &color_image_memory_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("image memory allocation failed");
+		}
+		vkBindImageMemory(context->logical_device_handle, color_image_handle, color_image_memory_handle, 0);
+
+		VkImageViewCreateInfo image_view_create_info
+		{
+			VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+			NULL,
+			0,
+			color_image_handle,
+			VK_IMAGE_VIEW_TYPE_2D,
+			VK_FORMAT_R8G8B8A8_UNORM,
+			{ VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY },
+			{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }
+		};
+		if (vkCreateImageView(context->logical_device_handle, &image_view_create_info, NULL, &color_image_view_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("image view creation failed");
+		}
+	}
+
+	void splat_renderer::create_descriptor_set(const simulator& particle_simulator)
+	{
+		// 0 the positions of the simulator, 1 the splats, 2 the colour image
+		const VkDescriptorSetLayoutBinding descriptor_set_layout_bindings[]
+		{
+			{ 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, NULL },
+			{ 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, NULL },
+			{ 2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT, NULL }
+		};
+		VkDescriptorSetLayoutCreateInfo descriptor_set_layout_create_info
+		{
+			VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+			NULL,
+			0,
+			3,
+			descriptor_set_layout_bindings
+		};
+		if (vkCreateDescriptorSetLayout(context->logical_device_handle, &descriptor_set_layout_create_info, NULL, &descriptor_set_layout_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("splat descriptor layout creation failed");
+		}
+
+		const VkDescriptorPoolSize descriptor_pool_sizes[]
+		{
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2 },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1 }
+		};
+		VkDescriptorPoolCreateInfo descriptor_pool_create_info
+		{
+			VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+			NULL,
+			0,
+			1,
+			2,
+			descriptor_pool_sizes
+		};
+		if (vkCreateDescriptorPool(context->logical_device_handle, &descriptor_pool_create_info, NULL, &descriptor_pool_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("descriptor pool creation failed");
+		}
+
+		VkDescriptorSetAllocateInfo descriptor_set_allocate_info
+		{
+			VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+			NULL,
+			descriptor_pool_handle,
+			1,
+			&descriptor_set_layout_handle
+		};
+		if (vkAllocateDescriptorSets(context->logical_device_handle, &descriptor_set_allocate_info, &descriptor_set_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("splat descriptor set allocation failed");
+		}
+
+		// the positions of the first ensemble member are the first ones of the field
+		const VkDescriptorBufferInfo descriptor_buffer_infos[]
+		{
+			particle_simulator.get_particle_field_buffer_info(particle_field::position),
+			{
+				splat_buffer_handle,
+				0,
+				VK_WHOLE_SIZE
+			}
+		};
+		const VkDescriptorImageInfo descriptor_image_info
+		{
+			VK_NULL_HANDLE,
+			color_image_view_handle,
+			VK_IMAGE_LAYOUT_GENERAL
+		};
+		const VkWriteDescriptorSet write_descriptor_sets[]
+		{
+			{ VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, NULL, descriptor_set_handle, 0, 0, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, NULL, &descriptor_buffer_infos[0], NULL },
+			{ VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, NULL, descriptor_set_handle, 1, 0, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, NULL, &descriptor_buffer_infos[1], NULL },
+			{ VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, NULL, descriptor_set_handle, 2, 0, 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, &descriptor_image_info, NULL, NULL }
+		};
+		vkUpdateDescriptorSets(context->logical_device_handle, 3, write_descriptor_sets, 0, NULL);
+	}
+
+	void splat_renderer::create_pipelines()
+	{
+		VkPipelineLayoutCreateInfo pipeline_layout_create_info
+		{
+			VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+			NULL,
+			0,
+			1,
+			&descriptor_set_layout_handle,
+			0,
+			NULL
+		};
+		if (vkCreatePipelineLayout(context->logical_device_handle, &pipeline_layout_create_info, NULL, &pipeline_layout_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("splat pipeline layout creation failed");
+		}
+
+		// shaders ignore the specialization constants they do not declare
+		struct splat_specialization
+		{
+			uint32_t particle_count;
+			uint32_t width;
+			uint32_t height;
+		};
+		const splat_specialization specialization_data{ particle_count, width, height };
+		const VkSpecializationMapEntry specialization_map_entries[]
+		{
+			{ 0, offsetof(splat_specialization, particle_count), sizeof(uint32_t) },
+			{ 1, offsetof(splat_specialization, width), sizeof(uint32_t) },
+			{ 2, offsetof(splat_specialization, height), sizeof(uint32_t) }
+		};
+		const VkSpecializationInfo specialization_info
+		{
+			3,
+			specialization_map_entries,
+			sizeof(specialization_data),
+			&specialization_data
+		};
+
+		const char* shader_file_names[]
+		{
+			"splat_particles.comp.spv",
+			"resolve_splats.comp.spv"
+		};
+		for (uint32_t i = 0; i < 2; i++)
+		{
+			VkShaderModule shader_module = context->create_shader_module_from_file(shader_file_names[i]);
+			VkComputePipelineCreateInfo compute_pipeline_create_info
+			{
+				VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+				NULL,
+				0,
+				{
+					VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+					NULL,
+					0,
+					VK_SHADER_STAGE_COMPUTE_BIT,
+					shader_module,
+					"main",
+					&specialization_info
+				},
+				pipeline_layout_handle,
+				VK_NULL_HANDLE,
+				0
+			};
+			VkResult result = vkCreateComputePipelines(context->logical_device_handle, context->global_pipeline_cache_handle, 1, &compute_pipeline_create_info, NULL, &pipeline_handles[i]);
+			vkDestroyShaderModule(context->logical_device_handle, shader_module, NULL);
+			if (result != VK_SUCCESS)
+			{
+				throw std::runtime_error(std::string("compute pipeline creation failed: ") + shader_file_names[i]);
+			}
+		}
+	}
+
+} // namespace sph
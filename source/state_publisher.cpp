@@ -0,0 +1,431 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "state_publisher.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+
+namespace sph
+{
+
+	static uint64_t align_up(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	state_publisher::state_publisher(simulator& particle_simulator, const state_publisher_options& options)
+		: particle_simulator(&particle_simulator), context(&particle_simulator.get_context()), options(options)
+	{
+		if (options.slot_count < 2 || options.slot_count > SPH_SHARED_STATE_MAX_SLOTS)
+		{
+			throw std::runtime_error("state publisher needs between 2 and " + std::to_string(SPH_SHARED_STATE_MAX_SLOTS) + " slots");
+		}
+		if (options.fields.empty())
+		{
+			throw std::runtime_error("state publisher needs at least one field");
+		}
+		create_region();
+		create_ring();
+		std::cout << "[INFO] publishing " << options.fields.size() << " particle fields to shared memory " << options.name
+			<< (zero_copy ? " (device writes it directly)" : " (through staging buffers)") << std::endl;
+	}
+
+	state_publisher::~state_publisher()
+	{
+		complete_frames(true);
+
+		VkDevice logical_device_handle = context->logical_device_handle;
+		for (auto& slot : ring)
+		{
+			vkDestroyFence(logical_device_handle, slot.fence_handle, NULL);
+			vkFreeCommandBuffers(logical_device_handle, command_pool_handle, 1, &slot.command_buffer_handle);
+			if (slot.staging_memory)
+			{
+				vkUnmapMemory(logical_device_handle, slot.memory_handle);
+			}
+			vkDestroyBuffer(logical_device_handle, slot.buffer_handle, NULL);
+			vkFreeMemory(logical_device_handle, slot.memory_handle, NULL);
+		}
+		vkDestroyCommandPool(logical_device_handle, command_pool_handle, NULL);
+		// imported memory is freed above, before the region is unmapped
+		region.close();
+	}
+
+	bool state_publisher::publish()
+	{
+		complete_frames(false);
+		// at most slot_count - 1 frames in flight, so the slot of the latest complete frame stays intact until a newer
+		// one is complete
+		if (submitted_frame_count - completed_frame_count >= options.slot_count - 1)
+		{
+			dropped_frame_count++;
+			return false;
+		}
+
+		const uint64_t frame = submitted_frame_count + 1;
+		const uint32_t slot_index = static_cast<uint32_t>((frame - 1) % options.slot_count);
+		ring_slot& slot = ring[slot_index];
+		shared_state_slot& shared_slot = header->slots[slot_index];
+		// odd while the slot is written, readers that see it retry
+		shared_slot.sequence.store(2 * frame - 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		shared_slot.step_count = particle_simulator->get_step_count();
+
+		if (vkResetFences(context->logical_device_handle, 1, &slot.fence_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("fence reset failed");
+		}
+		// the same queue as the steps, so the copy sees the particles of every step submitted before
+		const VkSubmitInfo submit_info
+		{
+			VK_STRUCTURE_TYPE_SUBMIT_INFO,
+			NULL,
+			0,
+			NULL,
+			NULL,
+			1,
+			&slot.command_buffer_handle,
+			0,
+			NULL
+		};
+		if (vkQueueSubmit(context->compute_queue_handle, 1, &submit_info, slot.fence_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("state publisher submission failed");
+		}
+		submitted_frame_count = frame;
+		return true;
+	}
+
+	void state_publisher::poll()
+	{
+		complete_frames(false);
+	}
+
+	uint64_t state_publisher::get_published_frame_count() const
+	{
+		return completed_frame_count;
+	}
+
+	uint64_t state_publisher::get_dropped_frame_count() const
+	{
+		return dropped_frame_count;
+	}
+
+	bool state_publisher::is_zero_copy() const
+	{
+		return zero_copy;
+	}
+
+	void state_publisher::complete_frames(bool wait)
+	{
+		// the frames share a queue, so they complete in order
+		while (completed_frame_count < submitted_frame_count)
+		{
+			const uint64_t frame = completed_frame_count + 1;
+			const uint32_t slot_index = static_cast<uint32_t>((frame - 1) % options.slot_count);
+			const ring_slot& slot = ring[slot_index];
+			if (wait)
+			{
+				if (vkWaitForFences(context->logical_device_handle, 1, &slot.fence_handle, VK_TRUE, UINT64_MAX) != VK_SUCCESS)
+				{
+					throw std::runtime_error("waiting for a state snapshot failed");
+				}
+			}
+			else if (vkGetFenceStatus(context->logical_device_handle, slot.fence_handle) != VK_SUCCESS)
+			{
+				break;
+			}
+			if (slot.staging_memory)
+			{
+				void* slot_data = static_cast<char*>(region.get_data()) + header->first_slot_offset + slot_index * header->slot_size;
+				std::memcpy(slot_data, slot.staging_memory, header->slot_size);
+			}
+			header->slots[slot_index].sequence.store(2 * frame, std::memory_order_release);
+			header->latest_frame.store(frame, std::memory_order_release);
+			completed_frame_count = frame;
+		}
+	}
+
+	void state_publisher::create_region()
+	{
+		// imported host memory must start and end on the import alignment, which is at least a page
+		slot_alignment = 4096;
+		if (context->is_device_extension_enabled(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME))
+		{
+			VkPhysicalDeviceExternalMemoryHostPropertiesEXT external_memory_host_properties
+			{
+				VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_MEMORY_HOST_PROPERTIES_EXT,
+				NULL,
+				0
+			};
+			VkPhysicalDeviceProperties2 physical_device_properties2
+			{
+				VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+				&external_memory_host_properties
+			};
+			vkGetPhysicalDeviceProperties2(context->physical_device_handle, &physical_device_properties2);
+			slot_alignment = std::max<uint64_t>(slot_alignment, external_memory_host_properties.minImportedHostPointerAlignment);
+		}
+
+		// fields packed in the order of particle_field, each aligned for the readers' SIMD loads
+		const uint64_t particle_count = particle_simulator->get_total_particle_count();
+		uint64_t field_offsets[SPH_SHARED_STATE_FIELD_COUNT];
+		std::fill(field_offsets, field_offsets + SPH_SHARED_STATE_FIELD_COUNT, UINT64_MAX);
+		uint32_t field_mask = 0;
+		for (particle_field field : options.fields)
+		{
+			field_mask |= 1u << static_cast<uint32_t>(field);
+		}
+		uint64_t slot_size = 0;
+		for (uint32_t field = 0; field < SPH_SHARED_STATE_FIELD_COUNT; field++)
+		{
+			if (field_mask & (1u << field))
+			{
+				field_offsets[field] = slot_size;
+				slot_size = align_up(slot_size + particle_simulator->get_particle_field_buffer_info(static_cast<particle_field>(field)).range, 64);
+			}
+		}
+		slot_size = align_up(slot_size, slot_alignment);
+		const uint64_t first_slot_offset = align_up(sizeof(shared_state_header), slot_alignment);
+
+		region.create(options.name, first_slot_offset + slot_size * options.slot_count);
+		header = new (region.get_data()) shared_state_header{};
+		header->magic = SPH_SHARED_STATE_MAGIC;
+		header->version = SPH_SHARED_STATE_VERSION;
+		header->slot_count = options.slot_count;
+		header->particle_count = static_cast<uint32_t>(particle_count);
+		header->field_mask = field_mask;
+		header->first_slot_offset = first_slot_offset;
+		header->slot_size = slot_size;
+		std::copy(field_offsets, field_offsets + SPH_SHARED_STATE_FIELD_COUNT, header->field_offsets);
+	}
+
+	bool state_publisher::import_slot(ring_slot& slot, void* slot_data)
+	{
+		VkDevice logical_device_handle = context->logical_device_handle;
+		auto get_memory_host_pointer_properties = reinterpret_cast<PFN_vkGetMemoryHostPointerPropertiesEXT>(vkGetDeviceProcAddr(logical_device_handle, "vkGetMemoryHostPointerPropertiesEXT"));
+		VkMemoryHostPointerPropertiesEXT memory_host_pointer_properties
+		{
+			VK_STRUCTURE_TYPE_MEMORY_HOST_POINTER_PROPERTIES_EXT,
+			NULL,
+			0
+		};
+		if (get_memory_host_pointer_properties(logical_device_handle, VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT, slot_data, &memory_host_pointer_properties) != VK_SUCCESS)
+		{
+			return false;
+		}
+
+		VkExternalMemoryBufferCreateInfo external_memory_buffer_create_info
+		{
+			VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO,
+			NULL,
+			VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT
+		};
+		VkBufferCreateInfo buffer_create_info
+		{
+			VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+			&external_memory_buffer_create_info,
+			0,
+			header->slot_size,
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_SHARING_MODE_EXCLUSIVE,
+			0,
+			NULL
+		};
+		if (vkCreateBuffer(logical_device_handle, &buffer_create_info, NULL, &slot.buffer_handle) != VK_SUCCESS)
+		{
+			return false;
+		}
+		VkMemoryRequirements memory_requirements;
+		vkGetBufferMemoryRequirements(logical_device_handle, slot.buffer_handle, &memory_requirements);
+		// coherent, so readers see the copy after the fence without an invalidation
+		uint32_t memory_type_index = UINT32_MAX;
+		const uint32_t memory_type_bits = memory_requirements.memoryTypeBits & memory_host_pointer_properties.memoryTypeBits;
+		for (uint32_t i = 0; i < context->physical_device_memory_properties.memoryTypeCount; i++)
+		{
+			if ((memory_type_bits & (1u << i)) && (context->physical_device_memory_properties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+			{
+				memory_type_index = i;
+				break;
+			}
+		}
+		if (memory_type_index == UINT32_MAX || memory_requirements.size > header->slot_size)
+		{
+			vkDestroyBuffer(logical_device_handle, slot.buffer_handle, NULL);
+			slot.buffer_handle = VK_NULL_HANDLE;
+			return false;
+		}
+
+		VkImportMemoryHostPointerInfoEXT import_memory_host_pointer_info
+		{
+			VK_STRUCTURE_TYPE_IMPORT_MEMORY_HOST_POINTER_INFO_EXT,
+			NULL,
+			VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT,
+			slot_data
+		};
+		VkMemoryAllocateInfo memory_allocate_info
+		{
+			VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+			&import_memory_host_pointer_info,
+			header->slot_size,
+			memory_type_index
+		};
+		if (vkAllocateMemory(logical_device_handle, &memory_allocate_info, NULL, &slot.memory_handle) != VK_SUCCESS)
+		{
+			vkDestroyBuffer(logical_device_handle, slot.buffer_handle, NULL);
+			slot.buffer_handle = VK_NULL_HANDLE;
+			return false;
+		}
+		vkBindBufferMemory(logical_device_handle, slot.buffer_handle, slot.memory_handle, 0);
+		return true;
+	}
+
+	void state_publisher::create_staging_slot(ring_slot& slot)
+	{
+		context->create_buffer(header->slot_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			slot.buffer_handle, slot.memory_handle);
+		void* mapped_memory = NULL;
+		vkMapMemory(context->logical_device_handle, slot.memory_handle, 0, header->slot_size, 0, &mapped_memory);
+		slot.staging_memory = mapped_memory;
+	}
+
+	void state_publisher::create_ring()
+	{
+		VkCommandPoolCreateInfo command_pool_create_info
+		{
+			VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+			NULL,
+			0,
+			context->queue_family_index
+		};
+		if (vkCreateCommandPool(context->logical_device_handle, &command_pool_create_info, NULL, &command_pool_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("command pool creation failed");
+		}
+
+		// import every slot or none, so completion handles them all the same way
+		zero_copy = context->is_device_extension_enabled(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME);
+		ring.resize(options.slot_count);
+		for (uint32_t i = 0; zero_copy && i < options.slot_count; i++)
+		{
+			zero_copy = import_slot(ring[i], static_cast<char*>(region.get_data()) + header->first_slot_offset + i * header->slot_size);
+		}
+		if (!zero_copy)
+		{
+			if (context->is_device_extension_enabled(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME))
+			{
+				std::cout << "[WARN] the device cannot import the shared memory, state snapshots go through staging buffers" << std::endl;
+			}
+			for (auto& slot : ring)
+			{
+				vkDestroyBuffer(context->logical_device_handle, slot.buffer_handle, NULL);
+				vkFreeMemory(context->logical_device_handle, slot.memory_handle, NULL);
+				slot = ring_slot{};
+				create_staging_slot(slot);
+			}
+		}
+
+		for (auto& slot : ring)
+		{
+			VkCommandBufferAllocateInfo command_buffer_allocate_info
+			{
+				VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+				NULL,
+				command_pool_handle,
+				VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+				1
+			};
+			if (vkAllocateCommandBuffers(context->logical_device_handle, &command_buffer_allocate_info, &slot.command_buffer_handle) != VK_SUCCESS)
+			{
+				throw std::runtime_error("command buffer allocation failed");
+			}
+			VkFenceCreateInfo fence_create_info
+			{
+				VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+				NULL,
+				0
+			};
+			if (vkCreateFence(context->logical_device_handle, &fence_create_info, NULL, &slot.fence_handle) != VK_SUCCESS)
+			{
+				throw std::runtime_error("fence creation failed");
+			}
+			record_command_buffer(slot);
+		}
+	}
+
+	void state_publisher::record_command_buffer(const ring_slot& slot)
+	{
+		VkCommandBufferBeginInfo command_buffer_begin_info
+		{
+			VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			NULL,
+			0,
+			NULL
+		};
+		if (vkBeginCommandBuffer(slot.command_buffer_handle, &command_buffer_begin_info) != VK_SUCCESS)
+		{
+			throw std::runtime_error("command buffer begin failed");
+		}
+
+		// Barrier: the passes of the last step write the particles, the copy reads them
+		VkMemoryBarrier compute_to_transfer_memory_barrier
+		{
+			VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			NULL,
+			VK_ACCESS_SHADER_WRITE_BIT,
+			VK_ACCESS_TRANSFER_READ_BIT
+		};
+		vkCmdPipelineBarrier(slot.command_buffer_handle, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &compute_to_transfer_memory_barrier, 0, NULL, 0, NULL);
+
+		std::vector<VkBufferCopy> buffer_copies;
+		VkBuffer source_buffer_handle = VK_NULL_HANDLE;
+		for (uint32_t field = 0; field < SPH_SHARED_STATE_FIELD_COUNT; field++)
+		{
+			if (header->field_mask & (1u << field))
+			{
+				const VkDescriptorBufferInfo field_buffer_info = particle_simulator->get_particle_field_buffer_info(static_cast<particle_field>(field));
+				source_buffer_handle = field_buffer_info.buffer;
+				buffer_copies.push_back({ field_buffer_info.offset, header->field_offsets[field], field_buffer_info.range });
+			}
+		}
+		vkCmdCopyBuffer(slot.command_buffer_handle, source_buffer_handle, slot.buffer_handle, static_cast<uint32_t>(buffer_copies.size()), buffer_copies.data());
+
+		// Barrier: readers and the staging memcpy read the slot on the host after the fence
+		VkMemoryBarrier transfer_to_host_memory_barrier
+		{
+			VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			NULL,
+			VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_ACCESS_HOST_READ_BIT
+		};
+		vkCmdPipelineBarrier(slot.command_buffer_handle, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &transfer_to_host_memory_barrier, 0, NULL, 0, NULL);
+
+		if (vkEndCommandBuffer(slot.command_buffer_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("command buffer end failed");
+		}
+	}
+
+} // namespace sph
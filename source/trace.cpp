@@ -0,0 +1,231 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "trace.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <iostream>
+#include <fstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+namespace sph
+{
+
+	trace_recorder::trace_recorder()
+		: start_time(std::chrono::steady_clock::now())
+	{
+	}
+
+	void trace_recorder::calibrate(const vulkan_context& context)
+	{
+		if (context.queue_family_timestamp_valid_bits == 0)
+		{
+			std::cout << "[WARN] the queue family does not support timestamps, the trace has no GPU events" << std::endl;
+			return;
+		}
+		timestamp_period_ns = context.physical_device_properties.limits.timestampPeriod;
+		timestamp_mask = context.queue_family_timestamp_valid_bits >= 64 ? ~0ull : (1ull << context.queue_family_timestamp_valid_bits) - 1;
+
+		// steady_clock counts the same clock as the host time domain: QueryPerformanceCounter with MSVC,
+		// CLOCK_MONOTONIC with libstdc++ and libc++
+#ifdef _WIN32
+		const VkTimeDomainEXT host_time_domain = VK_TIME_DOMAIN_QUERY_PERFORMANCE_COUNTER_EXT;
+#else
+		const VkTimeDomainEXT host_time_domain = VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT;
+#endif
+		bool host_time_domain_supported = false;
+		if (context.is_device_extension_enabled(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME))
+		{
+			auto get_calibrateable_time_domains = reinterpret_cast<PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT>(vkGetInstanceProcAddr(context.instance_handle, "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT"));
+			uint32_t time_domain_count = 0;
+			get_calibrateable_time_domains(context.physical_device_handle, &time_domain_count, NULL);
+			std::vector<VkTimeDomainEXT> time_domains(time_domain_count);
+			get_calibrateable_time_domains(context.physical_device_handle, &time_domain_count, time_domains.data());
+			host_time_domain_supported = std::find(time_domains.begin(), time_domains.end(), host_time_domain) != time_domains.end()
+				&& std::find(time_domains.begin(), time_domains.end(), VK_TIME_DOMAIN_DEVICE_EXT) != time_domains.end();
+		}
+
+		if (host_time_domain_supported)
+		{
+			auto get_calibrated_timestamps = reinterpret_cast<PFN_vkGetCalibratedTimestampsEXT>(vkGetDeviceProcAddr(context.logical_device_handle, "vkGetCalibratedTimestampsEXT"));
+			const VkCalibratedTimestampInfoEXT calibrated_timestamp_infos[]
+			{
+				{
+					VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT,
+					NULL,
+					VK_TIME_DOMAIN_DEVICE_EXT
+				},
+				{
+					VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT,
+					NULL,
+					host_time_domain
+				}
+			};
+			uint64_t timestamps[2];
+			uint64_t max_deviation = 0;
+			if (get_calibrated_timestamps(context.logical_device_handle, 2, calibrated_timestamp_infos, timestamps, &max_deviation) != VK_SUCCESS)
+			{
+				throw std::runtime_error("vkGetCalibratedTimestampsEXT failed");
+			}
+#ifdef _WIN32
+			LARGE_INTEGER performance_frequency;
+			QueryPerformanceFrequency(&performance_frequency);
+			const int64_t host_ns = static_cast<int64_t>(static_cast<double>(timestamps[1]) * 1e9 / static_cast<double>(performance_frequency.QuadPart));
+#else
+			const int64_t host_ns = static_cast<int64_t>(timestamps[1]);
+#endif
+			calibration_ticks = timestamps[0];
+			calibration_ns = host_ns - std::chrono::duration_cast<std::chrono::nanoseconds>(start_time.time_since_epoch()).count();
+			std::cout << "[INFO] trace clocks calibrated with VK_EXT_calibrated_timestamps, max deviation " << max_deviation << " ns" << std::endl;
+		}
+		else
+		{
+			// write a timestamp and take the host time once the submission has completed
+			VkQueryPoolCreateInfo query_pool_create_info
+			{
+				VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+				NULL,
+				0,
+				VK_QUERY_TYPE_TIMESTAMP,
+				1,
+				0
+			};
+			VkQueryPool query_pool_handle = VK_NULL_HANDLE;
+			if (vkCreateQueryPool(context.logical_device_handle, &query_pool_create_info, NULL, &query_pool_handle) != VK_SUCCESS)
+			{
+				throw std::runtime_error("query pool creation failed");
+			}
+			context.execute_one_time_commands(
+				[query_pool_handle](VkCommandBuffer command_buffer_handle)
+				{
+					vkCmdResetQueryPool(command_buffer_handle, query_pool_handle, 0, 1);
+					vkCmdWriteTimestamp(command_buffer_handle, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool_handle, 0);
+				}
+			);
+			calibration_ns = static_cast<int64_t>(now());
+			vkGetQueryPoolResults(context.logical_device_handle, query_pool_handle, 0, 1, sizeof(uint64_t), &calibration_ticks, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+			vkDestroyQueryPool(context.logical_device_handle, query_pool_handle, NULL);
+			std::cout << "[INFO] trace clocks calibrated without VK_EXT_calibrated_timestamps, GPU events may appear late by the submission latency" << std::endl;
+		}
+		calibrated = true;
+	}
+
+	bool trace_recorder::is_calibrated() const
+	{
+		return calibrated;
+	}
+
+	uint64_t trace_recorder::now() const
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_time).count();
+	}
+
+	void trace_recorder::add_cpu_event(const char* name, uint64_t begin_ns, uint64_t end_ns)
+	{
+		if (events.size() >= max_event_count)
+		{
+			dropped_event_count++;
+			return;
+		}
+		events.push_back({ name, track::cpu, begin_ns, end_ns });
+	}
+
+	void trace_recorder::add_gpu_event(const char* name, uint64_t begin_ticks, uint64_t end_ticks)
+	{
+		if (!calibrated)
+		{
+			return;
+		}
+		if (events.size() >= max_event_count)
+		{
+			dropped_event_count++;
+			return;
+		}
+		// events from before the recorder was created are clamped to its start
+		const int64_t begin_ns = gpu_ticks_to_ns(begin_ticks);
+		const int64_t end_ns = gpu_ticks_to_ns(end_ticks);
+		events.push_back({ name, track::gpu, static_cast<uint64_t>(std::max<int64_t>(begin_ns, 0)), static_cast<uint64_t>(std::max<int64_t>(end_ns, 0)) });
+	}
+
+	int64_t trace_recorder::gpu_ticks_to_ns(uint64_t ticks) const
+	{
+		// timestamps only have the valid bits of the queue family, so the difference wraps around at the mask
+		uint64_t delta = (ticks - calibration_ticks) & timestamp_mask;
+		int64_t signed_delta = static_cast<int64_t>(delta);
+		if (timestamp_mask != ~0ull && delta > (timestamp_mask >> 1))
+		{
+			signed_delta -= static_cast<int64_t>(timestamp_mask) + 1;
+		}
+		return calibration_ns + static_cast<int64_t>(static_cast<double>(signed_delta) * timestamp_period_ns);
+	}
+
+	void trace_recorder::write(const std::string& path) const
+	{
+		std::ofstream file(path);
+		if (!file)
+		{
+			throw std::runtime_error("cannot write trace file " + path);
+		}
+		file.setf(std::ios_base::fixed, std::ios_base::floatfield);
+		file.precision(3);
+		// timestamps are in microseconds
+		file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" << std::endl
+			<< "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << static_cast<uint32_t>(track::cpu) << ",\"args\":{\"name\":\"CPU\"}}," << std::endl
+			<< "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << static_cast<uint32_t>(track::gpu) << ",\"args\":{\"name\":\"GPU\"}}";
+		for (const event& e : events)
+		{
+			file << "," << std::endl << "{\"name\":\"" << e.name << "\",\"cat\":\"" << (e.event_track == track::cpu ? "cpu" : "gpu")
+				<< "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << static_cast<uint32_t>(e.event_track)
+				<< ",\"ts\":" << 1e-3 * e.begin_ns << ",\"dur\":" << 1e-3 * (e.end_ns > e.begin_ns ? e.end_ns - e.begin_ns : 0) << "}";
+		}
+		file << std::endl << "]}" << std::endl;
+		std::cout << "[INFO] wrote " << events.size() << " trace events to " << path << std::endl;
+		if (dropped_event_count > 0)
+		{
+			std::cout << "[WARN] " << dropped_event_count << " trace events were dropped after the first " << max_event_count << std::endl;
+		}
+	}
+
+	scoped_trace_event::scoped_trace_event(trace_recorder* recorder, const char* name)
+		: recorder(recorder), name(name)
+	{
+		if (recorder)
+		{
+			begin_ns = recorder->now();
+		}
+	}
+
+	scoped_trace_event::~scoped_trace_event()
+	{
+		if (recorder)
+		{
+			recorder->add_cpu_event(name, begin_ns, recorder->now());
+		}
+	}
+
+} // namespace sph
@@ -0,0 +1,729 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "trajectory.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace sph
+{
+
+	// Rice codes of the residuals: per block a 6-bit parameter k, then per value the high bits in unary and the k low
+	// bits. High parts of escape_length or more are written as escape_length zeros followed by the 64-bit value
+	static const uint32_t parameter_bits = 6;
+	static const uint64_t escape_length = 32;
+
+	// small magnitudes of either sign to small codes
+	static uint64_t zigzag_encode(int64_t value)
+	{
+		return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+	}
+
+	static int64_t zigzag_decode(uint64_t value)
+	{
+		return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+	}
+
+	static int64_t quantize(float value, float quantum)
+	{
+		// non-finite values and values beyond the range of the codes are clamped rather than lost
+		if (!std::isfinite(value))
+		{
+			return 0;
+		}
+		const double scaled = std::clamp(static_cast<double>(value) / quantum, -9007199254740992.0, 9007199254740992.0);
+		return std::llround(scaled);
+	}
+
+	class bit_writer
+	{
+	public:
+		explicit bit_writer(std::vector<uint8_t>& bytes)
+			: bytes(bytes)
+		{
+		}
+
+		// at most 32 bits at a time
+		void write(uint64_t value, uint32_t bit_count)
+		{
+			accumulator |= (value & ((1ull << bit_count) - 1)) << accumulated_bit_count;
+			accumulated_bit_count += bit_count;
+			while (accumulated_bit_count >= 8)
+			{
+				bytes.push_back(static_cast<uint8_t>(accumulator));
+				accumulator >>= 8;
+				accumulated_bit_count -= 8;
+			}
+		}
+
+		void write_zeros(uint64_t count)
+		{
+			for (; count >= 32; count -= 32)
+			{
+				write(0, 32);
+			}
+			write(0, static_cast<uint32_t>(count));
+		}
+
+		void flush()
+		{
+			if (accumulated_bit_count > 0)
+			{
+				write(0, 8 - accumulated_bit_count);
+			}
+		}
+
+	private:
+		std::vector<uint8_t>& bytes;
+		uint64_t accumulator = 0;
+		uint32_t accumulated_bit_count = 0;
+	};
+
+	class bit_reader
+	{
+	public:
+		bit_reader(const uint8_t* bytes, size_t size)
+			: bytes(bytes), size(size)
+		{
+		}
+
+		// at most 32 bits at a time, zeros past the end
+		uint64_t read(uint32_t bit_count)
+		{
+			if (accumulated_bit_count < bit_count)
+			{
+				refill();
+			}
+			const uint64_t value = accumulator & ((1ull << bit_count) - 1);
+			accumulator >>= bit_count;
+			accumulated_bit_count -= bit_count;
+			return value;
+		}
+
+		// zeros before the next one, which is consumed as well, or limit zeros
+		uint64_t read_zeros(uint64_t limit)
+		{
+			uint64_t count = 0;
+			while (count < limit)
+			{
+				if (accumulated_bit_count == 0)
+				{
+					refill();
+				}
+				if (accumulator == 0)
+				{
+					const uint64_t taken = std::min<uint64_t>(accumulated_bit_count, limit - count);
+					count += taken;
+					read(static_cast<uint32_t>(taken));
+					continue;
+				}
+				const uint64_t zero_count = static_cast<uint64_t>(std::countr_zero(accumulator));
+				if (count + zero_count >= limit)
+				{
+					read(static_cast<uint32_t>(limit - count));
+					return limit;
+				}
+				read(static_cast<uint32_t>(zero_count + 1));
+				return count + zero_count;
+			}
+			return count;
+		}
+
+		// whether more bits were consumed than there are, the refill reads ahead
+		bool is_overrun() const
+		{
+			return 8 * static_cast<uint64_t>(position) - accumulated_bit_count > 8 * static_cast<uint64_t>(size);
+		}
+
+	private:
+		// whole bytes until more than 56 bits are buffered, the bits above them are zero
+		void refill()
+		{
+			while (accumulated_bit_count <= 56)
+			{
+				const uint64_t byte = position < size ? bytes[position] : 0;
+				position++;
+				accumulator |= byte << accumulated_bit_count;
+				accumulated_bit_count += 8;
+			}
+		}
+
+		const uint8_t* bytes;
+		size_t size;
+		size_t position = 0;
+		uint64_t accumulator = 0;
+		uint32_t accumulated_bit_count = 0;
+	};
+
+	// one component of one field of every particle, residuals[i * stride]
+	static void encode_residuals(bit_writer& writer, const int64_t* residuals, uint32_t count, uint32_t stride)
+	{
+		uint64_t codes[SPH_TRAJECTORY_BLOCK_SIZE];
+		for (uint32_t first = 0; first < count; first += SPH_TRAJECTORY_BLOCK_SIZE)
+		{
+			const uint32_t block_size = std::min(SPH_TRAJECTORY_BLOCK_SIZE, count - first);
+			uint64_t sum = 0;
+			for (uint32_t i = 0; i < block_size; i++)
+			{
+				codes[i] = zigzag_encode(residuals[static_cast<size_t>(first + i) * stride]);
+				sum += std::min<uint64_t>(codes[i], UINT64_MAX / SPH_TRAJECTORY_BLOCK_SIZE);
+			}
+			// the parameter of a geometric distribution with the mean of the block, then the cheapest one next to it
+			const uint64_t mean = sum / block_size;
+			uint32_t estimate = 0;
+			while (estimate < 62 && (2ull << estimate) <= mean)
+			{
+				estimate++;
+			}
+			uint32_t best_parameter = estimate;
+			uint64_t best_bit_count = UINT64_MAX;
+			for (uint32_t parameter = estimate > 0 ? estimate - 1 : 0; parameter <= std::min(estimate + 1, 63u); parameter++)
+			{
+				uint64_t bit_count = 0;
+				for (uint32_t i = 0; i < block_size; i++)
+				{
+					const uint64_t high = codes[i] >> parameter;
+					bit_count += high < escape_length ? high + 1 + parameter : escape_length + 64;
+				}
+				if (bit_count < best_bit_count)
+				{
+					best_bit_count = bit_count;
+					best_parameter = parameter;
+				}
+			}
+
+			writer.write(best_parameter, parameter_bits);
+			for (uint32_t i = 0; i < block_size; i++)
+			{
+				const uint64_t high = codes[i] >> best_parameter;
+				if (high < escape_length)
+				{
+					writer.write_zeros(high);
+					writer.write(1, 1);
+					// the low bits in two halves, as the writer takes at most 32 at a time
+					writer.write(codes[i], std::min(best_parameter, 32u));
+					if (best_parameter > 32)
+					{
+						writer.write(codes[i] >> 32, best_parameter - 32);
+					}
+				}
+				else
+				{
+					writer.write_zeros(escape_length);
+					writer.write(codes[i], 32);
+					writer.write(codes[i] >> 32, 32);
+				}
+			}
+		}
+	}
+
+	static void decode_residuals(bit_reader& reader, int64_t* residuals, uint32_t count, uint32_t stride)
+	{
+		for (uint32_t first = 0; first < count; first += SPH_TRAJECTORY_BLOCK_SIZE)
+		{
+			const uint32_t block_size = std::min(SPH_TRAJECTORY_BLOCK_SIZE, count - first);
+			const uint32_t parameter = static_cast<uint32_t>(reader.read(parameter_bits));
+			for (uint32_t i = 0; i < block_size; i++)
+			{
+				const uint64_t high = reader.read_zeros(escape_length);
+				uint64_t code = 0;
+				if (high < escape_length)
+				{
+					code = reader.read(std::min(parameter, 32u));
+					if (parameter > 32)
+					{
+						code |= reader.read(parameter - 32) << 32;
+					}
+					code |= high << parameter;
+				}
+				else
+				{
+					code = reader.read(32);
+					code |= reader.read(32) << 32;
+				}
+				residuals[static_cast<size_t>(first + i) * stride] = zigzag_decode(code);
+			}
+		}
+	}
+
+	trajectory_writer::trajectory_writer(uint32_t particle_count, const trajectory_writer_options& options)
+		: particle_count(particle_count), options(options)
+	{
+		if (options.keyframe_interval == 0 || options.queue_size == 0 || options.worker_count == 0)
+		{
+			throw std::runtime_error("trajectory writer needs a keyframe interval, a queue and a worker");
+		}
+		if (!(options.position_precision > 0) || !(options.velocity_precision > 0))
+		{
+			throw std::runtime_error("trajectory precision must be positive");
+		}
+		quantum[0] = 2 * options.position_precision;
+		quantum[1] = 2 * options.velocity_precision;
+		file.open(options.path, std::ios::binary | std::ios::trunc);
+		if (!file)
+		{
+			throw std::runtime_error("failed to create trajectory file " + options.path);
+		}
+		const trajectory_file_header header
+		{
+			SPH_TRAJECTORY_MAGIC,
+			SPH_TRAJECTORY_VERSION,
+			particle_count,
+			options.keyframe_interval,
+			0,
+			0
+		};
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file_size = sizeof(header);
+		for (uint32_t i = 0; i < options.worker_count; i++)
+		{
+			workers.emplace_back(&trajectory_writer::run_worker, this);
+		}
+	}
+
+	trajectory_writer::~trajectory_writer()
+	{
+		close();
+	}
+
+	void trajectory_writer::write_frame(uint64_t step_count, const float* position, const float* velocity)
+	{
+		if (closed)
+		{
+			throw std::runtime_error("trajectory writer is closed");
+		}
+		const size_t value_count = 2 * static_cast<size_t>(particle_count);
+		const float* const fields[SPH_TRAJECTORY_FIELD_COUNT] = { position, velocity };
+		std::unique_ptr<job> frame_job = std::make_unique<job>();
+		frame_job->frame = frame_count;
+		frame_job->step_count = step_count;
+		if (frame_count % options.keyframe_interval == 0)
+		{
+			// the keyframe is coded from the quantized values that the frames after it are coded against
+			for (uint32_t field = 0; field < SPH_TRAJECTORY_FIELD_COUNT; field++)
+			{
+				auto values = std::make_shared<std::vector<int64_t>>(value_count);
+				for (size_t i = 0; i < value_count; i++)
+				{
+					(*values)[i] = quantize(fields[field][i], quantum[field]);
+				}
+				keyframe_values[field] = values;
+			}
+			keyframe = frame_count;
+		}
+		else
+		{
+			for (uint32_t field = 0; field < SPH_TRAJECTORY_FIELD_COUNT; field++)
+			{
+				frame_job->values[field].assign(fields[field], fields[field] + value_count);
+			}
+		}
+		frame_job->keyframe = keyframe;
+		for (uint32_t field = 0; field < SPH_TRAJECTORY_FIELD_COUNT; field++)
+		{
+			frame_job->keyframe_values[field] = keyframe_values[field];
+		}
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			job_done.wait(lock, [this]() { return pending_job_count < options.queue_size; });
+			jobs.push_back(std::move(frame_job));
+			pending_job_count++;
+		}
+		job_available.notify_one();
+		frame_count++;
+	}
+
+	void trajectory_writer::close()
+	{
+		if (closed)
+		{
+			return;
+		}
+		closed = true;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		job_available.notify_all();
+		// the workers code the queued frames before they stop
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+		workers.clear();
+
+		const uint64_t index_offset = file_size;
+		file.write(reinterpret_cast<const char*>(index.data()), static_cast<std::streamsize>(index.size() * sizeof(trajectory_index_entry)));
+		const trajectory_file_header header
+		{
+			SPH_TRAJECTORY_MAGIC,
+			SPH_TRAJECTORY_VERSION,
+			particle_count,
+			options.keyframe_interval,
+			index_offset,
+			index.size()
+		};
+		file.seekp(0);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.close();
+		if (!file)
+		{
+			std::cout << "[ERROR] trajectory: failed to write " << options.path << std::endl;
+		}
+	}
+
+	uint64_t trajectory_writer::get_frame_count() const
+	{
+		return frame_count;
+	}
+
+	uint64_t trajectory_writer::get_file_size() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return file_size;
+	}
+
+	void trajectory_writer::run_worker()
+	{
+		while (true)
+		{
+			std::unique_ptr<job> frame_job;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				job_available.wait(lock, [this]() { return stopping || !jobs.empty(); });
+				if (jobs.empty())
+				{
+					return;
+				}
+				frame_job = std::move(jobs.front());
+				jobs.pop_front();
+			}
+			std::vector<uint8_t> bytes = encode(*frame_job);
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				completed.emplace(frame_job->frame, std::move(bytes));
+				flush_completed();
+				pending_job_count--;
+			}
+			job_done.notify_all();
+		}
+	}
+
+	std::vector<uint8_t> trajectory_writer::encode(const job& frame_job) const
+	{
+		std::vector<uint8_t> bytes(sizeof(trajectory_frame_header));
+		bit_writer writer(bytes);
+		const size_t value_count = 2 * static_cast<size_t>(particle_count);
+		std::vector<int64_t> residuals(value_count);
+		for (uint32_t field = 0; field < SPH_TRAJECTORY_FIELD_COUNT; field++)
+		{
+			const std::vector<int64_t>& key = *frame_job.keyframe_values[field];
+			if (frame_job.frame == frame_job.keyframe)
+			{
+				// against the same component of the particle before, which is close in the initial scenes
+				residuals[0] = key[0];
+				residuals[1] = key[1];
+				for (size_t i = 2; i < value_count; i++)
+				{
+					residuals[i] = key[i] - key[i - 2];
+				}
+			}
+			else
+			{
+				for (size_t i = 0; i < value_count; i++)
+				{
+					residuals[i] = quantize(frame_job.values[field][i], quantum[field]) - key[i];
+				}
+			}
+			encode_residuals(writer, residuals.data(), particle_count, 2);
+			encode_residuals(writer, residuals.data() + 1, particle_count, 2);
+		}
+		writer.flush();
+
+		trajectory_frame_header frame_header
+		{
+			bytes.size(),
+			frame_job.step_count,
+			frame_job.keyframe,
+			{ quantum[0], quantum[1] }
+		};
+		std::memcpy(bytes.data(), &frame_header, sizeof(frame_header));
+		return bytes;
+	}
+
+	void trajectory_writer::flush_completed()
+	{
+		for (auto next = completed.find(next_written_frame); next != completed.end(); next = completed.find(next_written_frame))
+		{
+			const std::vector<uint8_t>& bytes = next->second;
+			trajectory_frame_header frame_header;
+			std::memcpy(&frame_header, bytes.data(), sizeof(frame_header));
+			index.push_back({ file_size, frame_header.step_count, frame_header.keyframe });
+			file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+			if (!file)
+			{
+				std::cout << "[ERROR] trajectory: failed to write frame " << next_written_frame << " to " << options.path << std::endl;
+			}
+			file_size += bytes.size();
+			completed.erase(next);
+			next_written_frame++;
+		}
+	}
+
+	trajectory_reader::trajectory_reader(const std::string& path)
+		: path(path)
+	{
+#ifdef _WIN32
+		file_handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		LARGE_INTEGER file_size{};
+		if (file_handle == INVALID_HANDLE_VALUE || !GetFileSizeEx(file_handle, &file_size))
+		{
+			file_handle = NULL;
+			throw std::runtime_error("failed to open trajectory file " + path);
+		}
+		size = static_cast<uint64_t>(file_size.QuadPart);
+		mapping_handle = size > 0 ? CreateFileMappingA(file_handle, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+		data = mapping_handle ? static_cast<const uint8_t*>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0)) : NULL;
+#else
+		int file_descriptor = open(path.c_str(), O_RDONLY);
+		struct stat file_status{};
+		if (file_descriptor < 0 || fstat(file_descriptor, &file_status) != 0)
+		{
+			if (file_descriptor >= 0)
+			{
+				close(file_descriptor);
+			}
+			throw std::runtime_error("failed to open trajectory file " + path);
+		}
+		size = static_cast<uint64_t>(file_status.st_size);
+		void* mapped_data = size > 0 ? mmap(NULL, size, PROT_READ, MAP_SHARED, file_descriptor, 0) : MAP_FAILED;
+		close(file_descriptor);
+		data = mapped_data == MAP_FAILED ? NULL : static_cast<const uint8_t*>(mapped_data);
+#endif
+		if (!data || size < sizeof(header))
+		{
+			unmap();
+			throw std::runtime_error("failed to map trajectory file " + path);
+		}
+		std::memcpy(&header, data, sizeof(header));
+		if (header.magic != SPH_TRAJECTORY_MAGIC || header.version != SPH_TRAJECTORY_VERSION)
+		{
+			unmap();
+			throw std::runtime_error(path + " is not a trajectory file of this version");
+		}
+		if (header.index_offset != 0 && header.index_offset <= size && header.frame_count <= (size - header.index_offset) / sizeof(trajectory_index_entry))
+		{
+			index.resize(header.frame_count);
+			std::memcpy(index.data(), data + header.index_offset, index.size() * sizeof(trajectory_index_entry));
+			return;
+		}
+
+		// the writer did not close the file or the index is cut off, so it is rebuilt from the complete frames
+		uint64_t offset = sizeof(header);
+		trajectory_frame_header frame_header;
+		while (offset + sizeof(frame_header) <= size)
+		{
+			std::memcpy(&frame_header, data + offset, sizeof(frame_header));
+			if (frame_header.size < sizeof(frame_header) || frame_header.size > size - offset)
+			{
+				break;
+			}
+			index.push_back({ offset, frame_header.step_count, frame_header.keyframe });
+			offset += frame_header.size;
+		}
+		std::cout << "[WARN] trajectory " << path << " has no index, " << index.size() << " complete frames found" << std::endl;
+	}
+
+	trajectory_reader::~trajectory_reader()
+	{
+		unmap();
+	}
+
+	void trajectory_reader::unmap()
+	{
+#ifdef _WIN32
+		if (data)
+		{
+			UnmapViewOfFile(data);
+		}
+		if (mapping_handle)
+		{
+			CloseHandle(mapping_handle);
+		}
+		if (file_handle)
+		{
+			CloseHandle(file_handle);
+		}
+		file_handle = NULL;
+		mapping_handle = NULL;
+#else
+		if (data)
+		{
+			munmap(const_cast<uint8_t*>(data), size);
+		}
+#endif
+		data = NULL;
+	}
+
+	uint32_t trajectory_reader::get_particle_count() const
+	{
+		return header.particle_count;
+	}
+
+	uint64_t trajectory_reader::get_frame_count() const
+	{
+		return index.size();
+	}
+
+	uint64_t trajectory_reader::get_step_count(uint64_t frame) const
+	{
+		if (frame >= index.size())
+		{
+			throw std::runtime_error("trajectory frame out of range");
+		}
+		return index[frame].step_count;
+	}
+
+	void trajectory_reader::read_frame(uint64_t frame, trajectory_frame& result)
+	{
+		float* outputs[SPH_TRAJECTORY_FIELD_COUNT];
+		for (uint32_t field = 0; field < SPH_TRAJECTORY_FIELD_COUNT; field++)
+		{
+			result.fields[field].resize(2 * static_cast<size_t>(header.particle_count));
+			outputs[field] = result.fields[field].data();
+		}
+		read_fields(frame, SPH_TRAJECTORY_FIELD_COUNT, outputs);
+		result.frame = frame;
+		result.step_count = index[frame].step_count;
+	}
+
+	void trajectory_reader::read_positions(uint64_t frame, float* position)
+	{
+		read_fields(frame, 1, &position);
+	}
+
+	void trajectory_reader::read_fields(uint64_t frame, uint32_t field_count, float* const* outputs)
+	{
+		if (frame >= index.size())
+		{
+			throw std::runtime_error("trajectory frame out of range");
+		}
+		const uint64_t keyframe = index[frame].keyframe;
+		if (keyframe >= index.size() || index[keyframe].keyframe != keyframe)
+		{
+			throw std::runtime_error("trajectory frame refers to a missing keyframe");
+		}
+		const size_t value_count = 2 * static_cast<size_t>(header.particle_count);
+		if (keyframe != cached_keyframe || cached_keyframe_field_count < field_count)
+		{
+			decode(keyframe, field_count, cached_keyframe_values);
+			for (uint32_t field = 0; field < field_count; field++)
+			{
+				std::vector<int64_t>& values = cached_keyframe_values[field];
+				for (size_t i = 2; i < value_count; i++)
+				{
+					values[i] += values[i - 2];
+				}
+			}
+			cached_keyframe = keyframe;
+			cached_keyframe_field_count = field_count;
+		}
+
+		if (frame != keyframe)
+		{
+			decode(frame, field_count, residuals);
+		}
+		const trajectory_frame_header frame_header = get_frame_header(frame);
+		for (uint32_t field = 0; field < field_count; field++)
+		{
+			const std::vector<int64_t>& key = cached_keyframe_values[field];
+			const double quantum = frame_header.quantum[field];
+			float* output = outputs[field];
+			if (frame != keyframe)
+			{
+				const std::vector<int64_t>& residual = residuals[field];
+				for (size_t i = 0; i < value_count; i++)
+				{
+					output[i] = static_cast<float>(static_cast<double>(key[i] + residual[i]) * quantum);
+				}
+			}
+			else
+			{
+				for (size_t i = 0; i < value_count; i++)
+				{
+					output[i] = static_cast<float>(static_cast<double>(key[i]) * quantum);
+				}
+			}
+		}
+	}
+
+	trajectory_frame_header trajectory_reader::get_frame_header(uint64_t frame) const
+	{
+		const uint64_t offset = index[frame].offset;
+		trajectory_frame_header frame_header;
+		if (offset < sizeof(header) || offset > size - sizeof(frame_header))
+		{
+			throw std::runtime_error("failed to read trajectory frame " + std::to_string(frame));
+		}
+		// frames are not padded, so the header may be unaligned in the mapping
+		std::memcpy(&frame_header, data + offset, sizeof(frame_header));
+		if (frame_header.size < sizeof(frame_header) || frame_header.size > size - offset)
+		{
+			throw std::runtime_error("failed to read trajectory frame " + std::to_string(frame));
+		}
+		return frame_header;
+	}
+
+	void trajectory_reader::decode(uint64_t frame, uint32_t field_count, std::vector<int64_t> (&values)[SPH_TRAJECTORY_FIELD_COUNT]) const
+	{
+		const trajectory_frame_header frame_header = get_frame_header(frame);
+		bit_reader reader(data + index[frame].offset + sizeof(frame_header), frame_header.size - sizeof(frame_header));
+		const uint32_t particle_count = header.particle_count;
+		for (uint32_t field = 0; field < field_count; field++)
+		{
+			values[field].resize(2 * static_cast<size_t>(particle_count));
+			decode_residuals(reader, values[field].data(), particle_count, 2);
+			decode_residuals(reader, values[field].data() + 1, particle_count, 2);
+		}
+		if (reader.is_overrun())
+		{
+			throw std::runtime_error("trajectory frame " + std::to_string(frame) + " of " + path + " is truncated");
+		}
+	}
+
+} // namespace sph
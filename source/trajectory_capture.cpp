@@ -0,0 +1,242 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "trajectory_capture.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+namespace sph
+{
+
+	trajectory_capture::trajectory_capture(simulator& particle_simulator, trajectory_writer& writer, uint32_t slot_count)
+		: particle_simulator(&particle_simulator), context(&particle_simulator.get_context()), writer(&writer), slot_count(slot_count)
+	{
+		if (slot_count < 1)
+		{
+			throw std::runtime_error("trajectory capture needs at least one slot");
+		}
+		// the first particle_count particles of every field belong to the first member
+		field_size = 2 * sizeof(float) * static_cast<VkDeviceSize>(particle_simulator.get_parameters().particle_count);
+		create_ring();
+	}
+
+	trajectory_capture::~trajectory_capture()
+	{
+		flush();
+
+		VkDevice logical_device_handle = context->logical_device_handle;
+		for (auto& slot : ring)
+		{
+			vkDestroyFence(logical_device_handle, slot.fence_handle, NULL);
+			vkFreeCommandBuffers(logical_device_handle, command_pool_handle, 1, &slot.command_buffer_handle);
+			vkUnmapMemory(logical_device_handle, slot.memory_handle);
+			vkDestroyBuffer(logical_device_handle, slot.buffer_handle, NULL);
+			vkFreeMemory(logical_device_handle, slot.memory_handle, NULL);
+		}
+		vkDestroyCommandPool(logical_device_handle, command_pool_handle, NULL);
+	}
+
+	void trajectory_capture::capture()
+	{
+		complete_frames(false);
+		// every slot in flight, only the oldest frame is waited for and the steps behind it keep running
+		if (submitted_frame_count - completed_frame_count >= slot_count)
+		{
+			stalled_frame_count++;
+			complete_frames(true, completed_frame_count + 1);
+		}
+
+		const uint64_t frame = submitted_frame_count + 1;
+		ring_slot& slot = ring[(frame - 1) % slot_count];
+		slot.step_count = particle_simulator->get_step_count();
+		if (vkResetFences(context->logical_device_handle, 1, &slot.fence_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("fence reset failed");
+		}
+		// the same queue as the steps, so the copy sees the particles of every step submitted before
+		const VkSubmitInfo submit_info
+		{
+			VK_STRUCTURE_TYPE_SUBMIT_INFO,
+			NULL,
+			0,
+			NULL,
+			NULL,
+			1,
+			&slot.command_buffer_handle,
+			0,
+			NULL
+		};
+		if (vkQueueSubmit(context->compute_queue_handle, 1, &submit_info, slot.fence_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("trajectory capture submission failed");
+		}
+		submitted_frame_count = frame;
+	}
+
+	void trajectory_capture::poll()
+	{
+		complete_frames(false);
+	}
+
+	void trajectory_capture::flush()
+	{
+		complete_frames(true);
+	}
+
+	uint64_t trajectory_capture::get_stalled_frame_count() const
+	{
+		return stalled_frame_count;
+	}
+
+	void trajectory_capture::complete_frames(bool wait, uint64_t frame_limit)
+	{
+		// the frames share a queue, so they complete in order
+		while (completed_frame_count < std::min(submitted_frame_count, frame_limit))
+		{
+			const uint64_t frame = completed_frame_count + 1;
+			const ring_slot& slot = ring[(frame - 1) % slot_count];
+			if (wait)
+			{
+				if (vkWaitForFences(context->logical_device_handle, 1, &slot.fence_handle, VK_TRUE, UINT64_MAX) != VK_SUCCESS)
+				{
+					throw std::runtime_error("waiting for a trajectory frame failed");
+				}
+			}
+			else if (vkGetFenceStatus(context->logical_device_handle, slot.fence_handle) != VK_SUCCESS)
+			{
+				break;
+			}
+			// the writer copies the fields before it returns, so the slot can be reused right after
+			writer->write_frame(slot.step_count, slot.mapped_memory, slot.mapped_memory + field_size / sizeof(float));
+			completed_frame_count = frame;
+		}
+	}
+
+	void trajectory_capture::create_ring()
+	{
+		VkCommandPoolCreateInfo command_pool_create_info
+		{
+			VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+			NULL,
+			0,
+			context->queue_family_index
+		};
+		if (vkCreateCommandPool(context->logical_device_handle, &command_pool_create_info, NULL, &command_pool_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("command pool creation failed");
+		}
+
+		// cached memory makes the copies of the writer fast, where the device has it
+		VkMemoryPropertyFlags memory_property_flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+		const VkPhysicalDeviceMemoryProperties& memory_properties = context->physical_device_memory_properties;
+		if (std::none_of(memory_properties.memoryTypes, memory_properties.memoryTypes + memory_properties.memoryTypeCount,
+			[memory_property_flags](const VkMemoryType& memory_type) { return (memory_type.propertyFlags & memory_property_flags) == memory_property_flags; }))
+		{
+			memory_property_flags &= ~VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+		}
+
+		ring.resize(slot_count);
+		for (auto& slot : ring)
+		{
+			context->create_buffer(2 * field_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, memory_property_flags, slot.buffer_handle, slot.memory_handle);
+			void* mapped_memory = NULL;
+			vkMapMemory(context->logical_device_handle, slot.memory_handle, 0, 2 * field_size, 0, &mapped_memory);
+			slot.mapped_memory = static_cast<const float*>(mapped_memory);
+
+			VkCommandBufferAllocateInfo command_buffer_allocate_info
+			{
+				VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+				NULL,
+				command_pool_handle,
+				VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+				1
+			};
+			if (vkAllocateCommandBuffers(context->logical_device_handle, &command_buffer_allocate_info, &slot.command_buffer_handle) != VK_SUCCESS)
+			{
+				throw std::runtime_error("command buffer allocation failed");
+			}
+			VkFenceCreateInfo fence_create_info
+			{
+				VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+				NULL,
+				0
+			};
+			if (vkCreateFence(context->logical_device_handle, &fence_create_info, NULL, &slot.fence_handle) != VK_SUCCESS)
+			{
+				throw std::runtime_error("fence creation failed");
+			}
+			record_command_buffer(slot);
+		}
+	}
+
+	void trajectory_capture::record_command_buffer(const ring_slot& slot)
+	{
+		VkCommandBufferBeginInfo command_buffer_begin_info
+		{
+			VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			NULL,
+			0,
+			NULL
+		};
+		if (vkBeginCommandBuffer(slot.command_buffer_handle, &command_buffer_begin_info) != VK_SUCCESS)
+		{
+			throw std::runtime_error("command buffer begin failed");
+		}
+
+		// Barrier: the passes of the last step write the particles, the copy reads them
+		VkMemoryBarrier compute_to_transfer_memory_barrier
+		{
+			VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			NULL,
+			VK_ACCESS_SHADER_WRITE_BIT,
+			VK_ACCESS_TRANSFER_READ_BIT
+		};
+		vkCmdPipelineBarrier(slot.command_buffer_handle, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &compute_to_transfer_memory_barrier, 0, NULL, 0, NULL);
+
+		// only the first member, the other members of an ensemble are not written
+		const VkDescriptorBufferInfo position_buffer_info = particle_simulator->get_particle_field_buffer_info(particle_field::position);
+		const VkDescriptorBufferInfo velocity_buffer_info = particle_simulator->get_particle_field_buffer_info(particle_field::velocity);
+		const VkBufferCopy buffer_copies[2]
+		{
+			{ position_buffer_info.offset, 0, field_size },
+			{ velocity_buffer_info.offset, field_size, field_size }
+		};
+		vkCmdCopyBuffer(slot.command_buffer_handle, position_buffer_info.buffer, slot.buffer_handle, 2, buffer_copies);
+
+		// Barrier: the writer reads the slot on the host after the fence
+		VkMemoryBarrier transfer_to_host_memory_barrier
+		{
+			VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			NULL,
+			VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_ACCESS_HOST_READ_BIT
+		};
+		vkCmdPipelineBarrier(slot.command_buffer_handle, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &transfer_to_host_memory_barrier, 0, NULL, 0, NULL);
+
+		if (vkEndCommandBuffer(slot.command_buffer_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("command buffer end failed");
+		}
+	}
+
+} // namespace sph
@@ -0,0 +1,707 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "vulkan_context.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+static VKAPI_ATTR VkBool32 VKAPI_CALL vulkan_debug_callback(VkDebugReportFlagsEXT flags, VkDebugReportObjectTypeEXT obj_type, uint64_t obj, size_t location, int32_t code, const char* layer_prefix, const char* msg, void*)
+{
+	std::string tags;
+
+	switch (flags)
+	{
+	case VK_DEBUG_REPORT_ERROR_BIT_EXT:
+		tags += "[ERROR]";
+		break;
+	case VK_DEBUG_REPORT_WARNING_BIT_EXT:
+		tags += "[WARN]";
+		break;
+	case VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT:
+		tags += "[PERF]";
+		break;
+	case VK_DEBUG_REPORT_INFORMATION_BIT_EXT:
+		tags += "[INFO]";
+		break;
+	case VK_DEBUG_REPORT_DEBUG_BIT_EXT:
+		tags += "[DEBUG]";
+		break;
+	default:
+		tags += "[?]";
+	}
+
+	switch (obj_type)
+	{
+	case VK_DEBUG_REPORT_OBJECT_TYPE_UNKNOWN_EXT:
+		tags += "[UNKNOWN]";
+		break;
+	case VK_DEBUG_REPORT_OBJECT_TYPE_INSTANCE_EXT:
+		tags += "[INSTANCE]";
+		break;
+	case VK_DEBUG_REPORT_OBJECT_TYPE_PHYSICAL_DEVICE_EXT:
+		tags += "[PHYSICAL_DEVICE]";
+		break;
+	case VK_DEBUG_REPORT_OBJECT_TYPE_DEVICE_EXT:
+		tags += "[DEVICE]";
+		break;
+	case VK_DEBUG_REPORT_OBJECT_TYPE_QUEUE_EXT:
+		tags += "[QUEUE]";
+		break;
+	case VK_DEBUG_REPORT_OBJECT_TYPE_SEMAPHORE_EXT:
+		tags += "[SEMAPHORE]";
+		break;
+	case VK_DEBUG_REPORT_OBJECT_TYPE_COMMAND_BUFFER_EXT:
+		tags += "[COMMAND_BUFFER]";
+		break;
+	case VK_DEBUG_REPORT_OBJECT_TYPE_FENCE_EXT:
+		tags += "[FENCE]";
+		break;
+	case VK_DEBUG_REPORT_OBJECT_TYPE_DEVICE_MEMORY_EXT:
+		tags += "[DEVICE_MEMORY]";
+		break;
+	case VK_DEBUG_REPORT_OBJECT_TYPE_BUFFER_EXT:
+		tags += "[BUFFER]";
+		break;
+	case VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT:
+		tags += "[IMAGE]";
+		break;
+	case VK_DEBUG_REPORT_OBJECT_TYPE_EVENT_EXT:
+		tags += "[EVENT]";
+		break;
+	case VK_DEBUG_REPORT_OBJECT_TYPE_QUERY_POOL_EXT:
+		tags += "[QUERY_POOL]";
+		break;
+	case VK_DEBUG_REPORT_OBJECT_TYPE_BUFFER_VIEW_EXT:
+		tags += "[BUFFER_VIEW]";
+		break;
+	case VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_VIEW_EXT:
+		tags += "[IMAGE_VIEW]";
+		break;
+	case VK_DEBUG_REPORT_OBJECT_TYPE_SHADER_MODULE_EXT:
+		tags += "[SHADER_MODULE]";
+		break;
+	case VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_CACHE_EXT:
+		tags += "[PIPELINE_CACHE]";
+		break;
+	case VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_LAYOUT_EXT:
+		tags += "[PIPELINE_LAYOUT]";
+		break;
+	case VK_DEBUG_REPORT_OBJECT_TYPE_RENDER_PASS_EXT:
+		tags += "[RENDER_PASS]";
+		break;
+	case VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_EXT:
+		tags += "[PIPELINE]";
+		break;
+	case VK_DEBUG_REPORT_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT_EXT:
+		tags += "[DESCRIPTOR_SET_LAYOUT]";
+		break;
+	case VK_DEBUG_REPORT_OBJECT_TYPE_SAMPLER_EXT:
+		tags += "[SAMPLER]";
+		break;
+	case VK_DEBUG_REPORT_OBJECT_TYPE_DESCRIPTOR_POOL_EXT:
+		tags += "[DESCRIPTOR_POOL]";
+		break;
+	case VK_DEBUG_REPORT_OBJECT_TYPE_DESCRIPTOR_SET_EXT:
+		tags += "[DESCRIPTOR_SET]";
+		break;
+	case VK_DEBUG_REPORT_OBJECT_TYPE_FRAMEBUFFER_EXT:
+		tags += "[FRAMEBUFFER]";
+		break;
+	case VK_DEBUG_REPORT_OBJECT_TYPE_COMMAND_POOL_EXT:
+		tags += "[COMMAND_POOL]";
+		break;
+	case VK_DEBUG_REPORT_OBJECT_TYPE_SURFACE_KHR_EXT:
+		tags += "[SURFACE_KHR]";
+		break;
+	case VK_DEBUG_REPORT_OBJECT_TYPE_SWAPCHAIN_KHR_EXT:
+		tags += "[SWAPCHAIN_KHR]";
+		break;
+	case VK_DEBUG_REPORT_OBJECT_TYPE_DEBUG_REPORT_EXT:
+		tags += "[DEBUG_REPORT]";
+		break;
+	case VK_DEBUG_REPORT_OBJECT_TYPE_DISPLAY_KHR_EXT:
+		tags += "[DISPLAY_KHR]";
+		break;
+	case VK_DEBUG_REPORT_OBJECT_TYPE_DISPLAY_MODE_KHR_EXT:
+		tags += "[DISPLAY_MODE_KHR]";
+		break;
+	default:
+		tags += "[?]";
+	}
+
+	std::cout << tags << "[" << obj << "][" << location << "][" << code << "][" << layer_prefix << "] " << msg << std::endl;
+
+	return VK_FALSE;
+}
+namespace sph
+{
+
+	vulkan_context::vulkan_context()
+		: vulkan_context(vulkan_context_create_info{})
+	{
+	}
+
+	vulkan_context::vulkan_context(const vulkan_context_create_info& create_info)
+	{
+		create_instance(create_info.instance_extensions);
+#ifdef _DEBUG
+		create_debug_callback();
+#endif
+		if (create_info.create_surface)
+		{
+			surface_handle = create_info.create_surface(instance_handle);
+		}
+		select_physical_device();
+		create_logical_device(create_info.device_extensions, create_info.optional_device_extensions);
+		get_device_queues();
+		create_pipeline_cache();
+		create_transient_command_pool();
+	}
+
+	vulkan_context::~vulkan_context()
+	{
+		vkDeviceWaitIdle(logical_device_handle);
+		vkDestroyCommandPool(logical_device_handle, transient_command_pool_handle, NULL);
+		vkDestroyPipelineCache(logical_device_handle, global_pipeline_cache_handle, NULL);
+		vkDestroyDevice(logical_device_handle, NULL);
+		if (surface_handle != VK_NULL_HANDLE)
+		{
+			vkDestroySurfaceKHR(instance_handle, surface_handle, NULL);
+		}
+#ifdef _DEBUG
+		reinterpret_cast<PFN_vkDestroyDebugReportCallbackEXT>(vkGetInstanceProcAddr(instance_handle, "vkDestroyDebugReportCallbackEXT"))(instance_handle, debug_report_callback_handle, NULL);
+#endif
+		vkDestroyInstance(instance_handle, NULL);
+	}
+
+	void vulkan_context::create_instance(const std::vector<const char*>& extra_instance_extensions)
+	{
+		VkApplicationInfo vk_app_info
+		{
+			VK_STRUCTURE_TYPE_APPLICATION_INFO,
+			NULL,
+			"SPH Simulation Vulkan",
+			VK_MAKE_VERSION(1, 0, 0),
+			"Wonderful SPH Simulation Engine",
+			VK_MAKE_VERSION(1, 0, 0),
+			VK_API_VERSION_1_3
+		};
+		uint32_t instance_layer_count;
+		vkEnumerateInstanceLayerProperties(&instance_layer_count, NULL);
+		std::vector<VkLayerProperties> available_instance_layers(instance_layer_count);
+		vkEnumerateInstanceLayerProperties(&instance_layer_count, available_instance_layers.data());
+		std::cout << "[INFO] available vulkan layers:" << std::endl;
+		for (const auto& layer : available_instance_layers)
+		{
+			std::cout << "[INFO]     name: " << layer.layerName << " desc: " << layer.description << " impl_ver: "
+				<< VK_VERSION_MAJOR(layer.implementationVersion) << "."
+				<< VK_VERSION_MINOR(layer.implementationVersion) << "."
+				<< VK_VERSION_PATCH(layer.implementationVersion)
+				<< " spec_ver: "
+				<< VK_VERSION_MAJOR(layer.specVersion) << "."
+				<< VK_VERSION_MINOR(layer.specVersion) << "."
+				<< VK_VERSION_PATCH(layer.specVersion)
+				<< std::endl;
+		}
+
+		uint32_t instance_extension_count = 0;
+		vkEnumerateInstanceExtensionProperties(NULL, &instance_extension_count, NULL);
+		std::vector<VkExtensionProperties> available_instance_extensions(instance_extension_count);
+		vkEnumerateInstanceExtensionProperties(NULL, &instance_extension_count, available_instance_extensions.data());
+		std::cout << "[INFO] available vulkan extensions:" << std::endl;
+		for (const auto& extension : available_instance_extensions)
+		{
+			std::cout << "[INFO]     name: " << extension.extensionName << " spec_ver: "
+				<< VK_VERSION_MAJOR(extension.specVersion) << "."
+				<< VK_VERSION_MINOR(extension.specVersion) << "."
+				<< VK_VERSION_PATCH(extension.specVersion) << std::endl;
+		}
+
+		std::vector<const char*> instance_extensions(extra_instance_extensions);
+
+#ifdef _DEBUG
+		instance_extensions.push_back(VK_EXT_DEBUG_REPORT_EXTENSION_NAME);
+		const char* validation_layer_names = "VK_LAYER_KHRONOS_validation";
+#endif
+
+		VkInstanceCreateInfo instance_create_info
+		{
+			VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
+			NULL,
+			0,
+			&vk_app_info,
+	#ifdef _DEBUG
+			1,
+			&validation_layer_names,
+	#else
+			0,
+			NULL,
+	#endif
+			static_cast<uint32_t>(instance_extensions.size()),
+			instance_extensions.data()
+		};
+		if (vkCreateInstance(&instance_create_info, NULL, &instance_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("vulkan instance creation failed");
+		}
+	}
+
+
+	void vulkan_context::create_debug_callback()
+	{
+		VkDebugReportCallbackCreateInfoEXT debug_report_callback_create_info
+		{
+			VK_STRUCTURE_TYPE_DEBUG_REPORT_CALLBACK_CREATE_INFO_EXT,
+			NULL,
+			VK_DEBUG_REPORT_FLAG_BITS_MAX_ENUM_EXT,
+			vulkan_debug_callback,
+			NULL
+		};
+		if (reinterpret_cast<PFN_vkCreateDebugReportCallbackEXT>(vkGetInstanceProcAddr(instance_handle, "vkCreateDebugReportCallbackEXT"))(instance_handle, &debug_report_callback_create_info, NULL, &debug_report_callback_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("debug callback setup failed");
+		}
+	}
+
+	void vulkan_context::select_physical_device()
+	{
+		uint32_t physical_device_count = 0;
+		vkEnumeratePhysicalDevices(instance_handle, &physical_device_count, NULL);
+		if (physical_device_count == 0)
+		{
+			throw std::runtime_error("unable to find any device with vulkan support");
+		}
+		std::vector<VkPhysicalDevice> physical_devices(physical_device_count);
+		vkEnumeratePhysicalDevices(instance_handle, &physical_device_count, physical_devices.data());
+
+		// select first device and set it as the device used throughout the program
+		physical_device_handle = physical_devices[0];
+
+		// get this device extensions
+		uint32_t device_extension_count;
+		vkEnumerateDeviceExtensionProperties(physical_device_handle, NULL, &device_extension_count, NULL);
+		physical_device_extensions.resize(device_extension_count);
+		vkEnumerateDeviceExtensionProperties(physical_device_handle, NULL, &device_extension_count, physical_device_extensions.data());
+		// get this device properties and features
+		vkGetPhysicalDeviceProperties(physical_device_handle, &physical_device_properties);
+		physical_device_subgroup_properties = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES, NULL };
+		physical_device_subgroup_size_control_properties = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_SIZE_CONTROL_PROPERTIES_EXT, NULL };
+		if (is_device_extension_available(VK_EXT_SUBGROUP_SIZE_CONTROL_EXTENSION_NAME))
+		{
+			physical_device_subgroup_properties.pNext = &physical_device_subgroup_size_control_properties;
+		}
+		VkPhysicalDeviceProperties2 physical_device_properties2
+		{
+			VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+			&physical_device_subgroup_properties
+		};
+		vkGetPhysicalDeviceProperties2(physical_device_handle, &physical_device_properties2);
+		physical_device_subgroup_properties.pNext = NULL;
+		physical_device_subgroup_size_control_properties.pNext = NULL;
+		vkGetPhysicalDeviceFeatures(physical_device_handle, &physical_device_features);
+		// get memory properties
+		vkGetPhysicalDeviceMemoryProperties(physical_device_handle, &physical_device_memory_properties);
+		// print info
+		std::cout << "[INFO] selected device name: " << physical_device_properties.deviceName << std::endl
+			<< "[INFO] selected device type: ";
+		switch (physical_device_properties.deviceType)
+		{
+		case VK_PHYSICAL_DEVICE_TYPE_OTHER:
+			std::cout << "VK_PHYSICAL_DEVICE_TYPE_OTHER";
+			break;
+		case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+			std::cout << "VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU";
+			break;
+		case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+			std::cout << "VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU";
+			break;
+		case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+			std::cout << "VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU";
+			break;
+		case VK_PHYSICAL_DEVICE_TYPE_CPU:
+			std::cout << "VK_PHYSICAL_DEVICE_TYPE_CPU";
+			break;
+		default:
+			;
+		}
+		std::cout << " (" << physical_device_properties.deviceType << ")" << std::endl
+			<< "[INFO] selected device driver version: "
+			<< VK_VERSION_MAJOR(physical_device_properties.driverVersion) << "."
+			<< VK_VERSION_MINOR(physical_device_properties.driverVersion) << "."
+			<< VK_VERSION_PATCH(physical_device_properties.driverVersion) << std::endl
+			<< "[INFO] selected device vulkan api version: "
+			<< VK_VERSION_MAJOR(physical_device_properties.apiVersion) << "."
+			<< VK_VERSION_MINOR(physical_device_properties.apiVersion) << "."
+			<< VK_VERSION_PATCH(physical_device_properties.apiVersion) << std::endl;
+		std::cout << "[INFO] selected device subgroup size: " << physical_device_subgroup_properties.subgroupSize
+			<< " supported operations: " << physical_device_subgroup_properties.supportedOperations << std::endl;
+		if (physical_device_subgroup_size_control_properties.maxSubgroupSize != 0)
+		{
+			std::cout << "[INFO] selected device subgroup size range: " << physical_device_subgroup_size_control_properties.minSubgroupSize
+				<< " to " << physical_device_subgroup_size_control_properties.maxSubgroupSize << std::endl;
+		}
+		std::cout << "[INFO] selected device available extensions:" << std::endl;
+		for (const auto& extension : physical_device_extensions)
+		{
+			std::cout << "[INFO]     name: " << extension.extensionName << " spec_ver: "
+				<< VK_VERSION_MAJOR(extension.specVersion) << "."
+				<< VK_VERSION_MINOR(extension.specVersion) << "."
+				<< VK_VERSION_PATCH(extension.specVersion) << std::endl;
+		}
+	}
+
+	void vulkan_context::create_logical_device(const std::vector<const char*>& extra_device_extensions, const std::vector<const char*>& optional_device_extensions)
+	{
+		queue_family_index = UINT32_MAX;
+
+		uint32_t queue_family_count = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(physical_device_handle, &queue_family_count, NULL);
+		std::vector<VkQueueFamilyProperties> queue_families(queue_family_count);
+		vkGetPhysicalDeviceQueueFamilyProperties(physical_device_handle, &queue_family_count, queue_families.data());
+		std::cout << "[INFO] available queue families:" << std::endl;
+		// look for queue family indices
+		for (uint32_t index = 0; index < queue_families.size(); index++)
+		{
+			std::cout << "[INFO]     flags: ";
+			if (queue_families[index].queueFlags & VK_QUEUE_GRAPHICS_BIT)
+			{
+				std::cout << "VK_QUEUE_GRAPHICS_BIT ";
+			}
+			if (queue_families[index].queueFlags & VK_QUEUE_COMPUTE_BIT)
+			{
+				std::cout << "VK_QUEUE_COMPUTE_BIT ";
+			}
+			if (queue_families[index].queueFlags & VK_QUEUE_TRANSFER_BIT)
+			{
+				std::cout << "VK_QUEUE_TRANSFER_BIT ";
+			}
+			if (queue_families[index].queueFlags & VK_QUEUE_SPARSE_BINDING_BIT)
+			{
+				std::cout << "VK_QUEUE_SPARSE_BINDING_BIT ";
+			}
+			std::cout << "(" << queue_families[index].queueFlags << ") count: " << queue_families[index].queueCount << std::endl;
+
+			// try to search a queue family that contain graphics queue, compute queue, and presentation queue
+			// without a surface, prefer a family with graphics (offscreen rendering) but settle for compute only
+			// note: queue family index must be unique in the device queue create info
+			if (queue_families[index].queueCount == 0 || !(queue_families[index].queueFlags & VK_QUEUE_COMPUTE_BIT))
+			{
+				continue;
+			}
+			if (surface_handle != VK_NULL_HANDLE)
+			{
+				VkBool32 presentation_support = false;
+				vkGetPhysicalDeviceSurfaceSupportKHR(physical_device_handle, index, surface_handle, &presentation_support);
+				if (queue_families[index].queueFlags & VK_QUEUE_GRAPHICS_BIT && presentation_support)
+				{
+					queue_family_index = index;
+				}
+			}
+			else if (queue_family_index == UINT32_MAX || (queue_families[index].queueFlags & VK_QUEUE_GRAPHICS_BIT && !(queue_family_flags & VK_QUEUE_GRAPHICS_BIT)))
+			{
+				queue_family_index = index;
+			}
+			if (queue_family_index == index)
+			{
+				queue_family_flags = queue_families[index].queueFlags;
+				queue_family_timestamp_valid_bits = queue_families[index].timestampValidBits;
+			}
+		}
+		if (queue_family_index == UINT32_MAX)
+		{
+			throw std::runtime_error(surface_handle != VK_NULL_HANDLE ? "unable to find a family queue with graphics, presentation, and compute queue" : "unable to find a family queue with compute queue");
+		}
+		// 3 queues: 1 graphics queue, 1 compute queue, and 1 presentation queue, fewer if the family does not have
+		// that many, in which case they are shared
+		queue_count = std::min(queue_families[queue_family_index].queueCount, 3u);
+		const float queue_priorities[3]{ 1, 1, 1 };
+		VkDeviceQueueCreateInfo queue_create_info
+		{
+			VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+			NULL,
+			0,
+			queue_family_index,
+			queue_count,
+			queue_priorities
+		};
+
+		std::vector<const char*> enabled_extensions(extra_device_extensions);
+		if (surface_handle != VK_NULL_HANDLE)
+		{
+			enabled_extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+		}
+		// lets the simulator's autotuner try other subgroup sizes than the default
+		subgroup_size_control_features = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_SIZE_CONTROL_FEATURES_EXT, NULL };
+		if (is_device_extension_available(VK_EXT_SUBGROUP_SIZE_CONTROL_EXTENSION_NAME))
+		{
+			enabled_extensions.push_back(VK_EXT_SUBGROUP_SIZE_CONTROL_EXTENSION_NAME);
+			VkPhysicalDeviceFeatures2 physical_device_features2
+			{
+				VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+				&subgroup_size_control_features
+			};
+			vkGetPhysicalDeviceFeatures2(physical_device_handle, &physical_device_features2);
+			subgroup_size_control_features.pNext = NULL;
+		}
+		// float atomics for the symmetric density and force passes of the simulator
+		shader_atomic_float_features = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_ATOMIC_FLOAT_FEATURES_EXT, NULL };
+		if (is_device_extension_available(VK_EXT_SHADER_ATOMIC_FLOAT_EXTENSION_NAME))
+		{
+			enabled_extensions.push_back(VK_EXT_SHADER_ATOMIC_FLOAT_EXTENSION_NAME);
+			VkPhysicalDeviceFeatures2 physical_device_features2
+			{
+				VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+				&shader_atomic_float_features
+			};
+			vkGetPhysicalDeviceFeatures2(physical_device_handle, &physical_device_features2);
+			shader_atomic_float_features.pNext = NULL;
+		}
+		for (const char* extension_name : optional_device_extensions)
+		{
+			if (is_device_extension_available(extension_name))
+			{
+				enabled_extensions.push_back(extension_name);
+			}
+			else
+			{
+				std::cout << "[INFO] optional device extension not available: " << extension_name << std::endl;
+			}
+		}
+		enabled_device_extensions.assign(enabled_extensions.begin(), enabled_extensions.end());
+		VkDeviceCreateInfo device_create_info
+		{
+			VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+			NULL,
+			0,
+			1,
+			&queue_create_info,
+			0,
+			NULL,
+			static_cast<uint32_t>(enabled_extensions.size()),
+			enabled_extensions.data(),
+			NULL
+		};
+		// enables every supported feature of the extensions, the structures are all false without them
+		if (subgroup_size_control_features.subgroupSizeControl)
+		{
+			subgroup_size_control_features.pNext = const_cast<void*>(device_create_info.pNext);
+			device_create_info.pNext = &subgroup_size_control_features;
+		}
+		if (is_device_extension_available(VK_EXT_SHADER_ATOMIC_FLOAT_EXTENSION_NAME))
+		{
+			shader_atomic_float_features.pNext = const_cast<void*>(device_create_info.pNext);
+			device_create_info.pNext = &shader_atomic_float_features;
+		}
+		if (vkCreateDevice(physical_device_handle, &device_create_info, NULL, &logical_device_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("logical device creation failed");
+		}
+	}
+
+	void vulkan_context::get_device_queues()
+	{
+		vkGetDeviceQueue(logical_device_handle, queue_family_index, 0, &graphics_queue_handle);
+		vkGetDeviceQueue(logical_device_handle, queue_family_index, 1 % queue_count, &compute_queue_handle);
+		vkGetDeviceQueue(logical_device_handle, queue_family_index, 2 % queue_count, &presentation_queue_handle);
+	}
+
+	void vulkan_context::create_pipeline_cache()
+	{
+		VkPipelineCacheCreateInfo pipeline_cache_create_info
+		{
+			VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+			NULL,
+			0,
+			0,
+			NULL
+		};
+		if (vkCreatePipelineCache(logical_device_handle, &pipeline_cache_create_info, NULL, &global_pipeline_cache_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("pipeline cache creation failed");
+		}
+	}
+
+	VkShaderModule vulkan_context::create_shader_module_from_file(const std::string& path_to_file) const
+	{
+		std::ifstream shader_file(path_to_file, std::ios::ate | std::ios::binary);
+		if (!shader_file)
+		{
+			throw std::runtime_error("shader file load error");
+		}
+		size_t shader_file_size = (size_t)shader_file.tellg();
+		std::vector<char> shader_code(shader_file_size);
+		shader_file.seekg(0);
+		shader_file.read(shader_code.data(), shader_file_size);
+		shader_file.close();
+
+		VkShaderModuleCreateInfo shader_module_create_info;
+		shader_module_create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		shader_module_create_info.pNext = NULL;
+		shader_module_create_info.flags = 0;
+		shader_module_create_info.codeSize = shader_code.size();
+		shader_module_create_info.pCode = reinterpret_cast<const uint32_t*>(shader_code.data());
+		VkShaderModule shader_module;
+		if (vkCreateShaderModule(logical_device_handle, &shader_module_create_info, NULL, &shader_module) != VK_SUCCESS)
+		{
+			throw std::runtime_error("shader module creation failed");
+		}
+		return shader_module;
+	}
+
+
+	uint32_t vulkan_context::get_memory_type_index(uint32_t type_bits, VkMemoryPropertyFlags memory_property_flags) const
+	{
+		for (uint32_t i = 0; i < physical_device_memory_properties.memoryTypeCount; i++)
+		{
+			if ((type_bits & 1) == 1)
+			{
+				if ((physical_device_memory_properties.memoryTypes[i].propertyFlags & memory_property_flags) == memory_property_flags)
+				{
+					return i;
+				}
+			}
+			type_bits >>= 1;
+		}
+		throw std::runtime_error("memory type not found");
+	}
+
+	void vulkan_context::create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags memory_property_flags, VkBuffer& buffer_handle, VkDeviceMemory& memory_handle) const
+	{
+		VkBufferCreateInfo buffer_create_info
+		{
+			VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+			NULL,
+			0,
+			size,
+			usage,
+			VK_SHARING_MODE_EXCLUSIVE,
+			0,
+			NULL
+		};
+		if (vkCreateBuffer(logical_device_handle, &buffer_create_info, NULL, &buffer_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("buffer creation failed");
+		}
+		VkMemoryRequirements memory_requirements;
+		vkGetBufferMemoryRequirements(logical_device_handle, buffer_handle, &memory_requirements);
+		VkMemoryAllocateInfo memory_allocation_info
+		{
+			VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+			NULL,
+			memory_requirements.size,
+			get_memory_type_index(memory_requirements.memoryTypeBits, memory_property_flags)
+		};
+		if (vkAllocateMemory(logical_device_handle, &memory_allocation_info, NULL, &memory_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("memory allocation failed");
+		}
+		vkBindBufferMemory(logical_device_handle, buffer_handle, memory_handle, 0);
+	}
+
+	void vulkan_context::create_transient_command_pool()
+	{
+		VkCommandPoolCreateInfo command_pool_create_info
+		{
+			VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+			NULL,
+			VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+			queue_family_index
+		};
+		if (vkCreateCommandPool(logical_device_handle, &command_pool_create_info, NULL, &transient_command_pool_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("command pool creation failed");
+		}
+	}
+
+	void vulkan_context::execute_one_time_commands(const std::function<void(VkCommandBuffer)>& record_commands) const
+	{
+		VkCommandBuffer command_buffer_handle;
+		VkCommandBufferAllocateInfo command_buffer_allocation_info
+		{
+			VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+			NULL,
+			transient_command_pool_handle,
+			VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+			1
+		};
+		if (vkAllocateCommandBuffers(logical_device_handle, &command_buffer_allocation_info, &command_buffer_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("command buffer creation failed");
+		}
+
+		VkCommandBufferBeginInfo command_buffer_begin_info
+		{
+			VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			NULL,
+			VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+			NULL
+		};
+		if (vkBeginCommandBuffer(command_buffer_handle, &command_buffer_begin_info) != VK_SUCCESS)
+		{
+			throw std::runtime_error("command buffer begin failed");
+		}
+		record_commands(command_buffer_handle);
+		if (vkEndCommandBuffer(command_buffer_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("command buffer end failed");
+		}
+
+		VkSubmitInfo submit_info
+		{
+			VK_STRUCTURE_TYPE_SUBMIT_INFO,
+			NULL,
+			0,
+			NULL,
+			0,
+			1,
+			&command_buffer_handle,
+			0,
+			NULL
+		};
+		if (vkQueueSubmit(compute_queue_handle, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS)
+		{
+			throw std::runtime_error("command buffer submission failed");
+		}
+		if (vkQueueWaitIdle(compute_queue_handle) != VK_SUCCESS)
+		{
+			throw std::runtime_error("vkQueueWaitIdle failed");
+		}
+
+		vkFreeCommandBuffers(logical_device_handle, transient_command_pool_handle, 1, &command_buffer_handle);
+	}
+
+	bool vulkan_context::is_device_extension_available(const char* extension_name) const
+	{
+		return std::any_of(physical_device_extensions.begin(), physical_device_extensions.end(),
+			[extension_name](const VkExtensionProperties& extension) { return std::strcmp(extension.extensionName, extension_name) == 0; });
+	}
+
+	bool vulkan_context::is_device_extension_enabled(const char* extension_name) const
+	{
+		return std::find(enabled_device_extensions.begin(), enabled_device_extensions.end(), extension_name) != enabled_device_extensions.end();
+	}
+
+} // namespace sph